@@ -17,8 +17,11 @@ import com.fasterxml.jackson.databind.SerializationFeature;
 
 import java.io.*;
 import java.net.*;
+import java.nio.charset.StandardCharsets;
 import java.time.ZoneOffset;
+import java.util.Arrays;
 import java.util.LinkedHashMap;
+import java.util.function.Predicate;
 
 import static com.fasterxml.jackson.core.JsonParser.Feature.AUTO_CLOSE_SOURCE;
 
@@ -45,15 +48,29 @@ public class FapManagementProtocol_Client
 	private static final String PROTOCOL_PARAMETERS_GPS_COORDINATES_ALT			= "alt";
 	private static final String PROTOCOL_PARAMETERS_GPS_COORDINATES_TIMESTAMP	= "timestamp";
 	private static final String PROTOCOL_PARAMETERS_GPS_TIMESTAMP				= "gpsTimestamp";
+	private static final String PROTOCOL_PARAMETERS_ENCODING					= "encoding";
+	private static final String PROTOCOL_PARAMETERS_TRANSPORT					= "transport";
+	private static final String PROTOCOL_PARAMETERS_UPDATE_PERIOD				= "updatePeriod";
+
+	// Protocol "transport" values (for the GPS coordinates updates)
+	private static final String PROTOCOL_TRANSPORT_UDP							= "udp";
 
 	// User (des)association timeouts (in seconds)
 	private static final int USER_ASSOCIATION_TIMEOUT_SECONDS					= 2;
 	private static final int USER_DESASSOCIATION_TIMEOUT_SECONDS				= 2;
 
-	// GPS coordinates update period (in seconds)
+	// GPS coordinates update period (in seconds), until the server negotiates another one
 	private static final int GPS_COORDINATES_UPDATE_PERIOD_SECONDS				= 10;
 	private static final int GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS				= (2 * GPS_COORDINATES_UPDATE_PERIOD_SECONDS);
 
+	// Message framing: payload length (4 bytes, network byte order) + payload
+	private static final int MSG_FRAME_MAX_PAYLOAD								= 4092;
+
+	// GPS coordinates updates over UDP: maximum datagram payload and
+	// transmissions of an update (within GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS)
+	private static final int DATAGRAM_MAX_PAYLOAD								= 1024;
+	private static final int DATAGRAM_TRANSMISSIONS								= 4;
+
 
 	// ----- FAP MANAGEMENT PROTOCOL - SERVER ADDRESS ----- //
 //	private static final String SERVER_IP_ADDRESS		= "10.0.0.254";
@@ -68,17 +85,53 @@ public class FapManagementProtocol_Client
 	private Socket socket;
 	private ObjectMapper objectMapper;
 	private int userId;
-	private BufferedReader in;
-	private OutputStreamWriter out;
+	private DataInputStream in;
+	private DataOutputStream out;
+	private boolean binaryEncodingRequested;
+	private boolean binaryEncoding;
+	private boolean udpTransportRequested;
+	private boolean udpTransport;
+	private DatagramSocket datagramSocket;
+	private int updatePeriodSeconds;
+	private long nextUpdateNs;
 
 	// =========================================================
 	//           PUBLIC API
 	// =========================================================
 
 	/**
-	 * Constructor.
+	 * Constructor (JSON encoded GPS coordinates updates).
 	 */
 	public FapManagementProtocol_Client() {
+		this(false);
+	}
+
+	/**
+	 * Constructor.
+	 *
+	 * @param binaryEncoding	Request the compact binary encoding for the GPS
+	 * 							coordinates updates (negotiated on association).
+	 */
+	public FapManagementProtocol_Client(boolean binaryEncoding) {
+		this(binaryEncoding, false);
+	}
+
+	/**
+	 * Constructor.
+	 *
+	 * @param binaryEncoding	Request the compact binary encoding for the GPS
+	 * 							coordinates updates (negotiated on association).
+	 * @param udpTransport		Request the GPS coordinates updates to be sent as
+	 * 							UDP datagrams (negotiated on association).
+	 */
+	public FapManagementProtocol_Client(boolean binaryEncoding, boolean udpTransport) {
+		this.binaryEncodingRequested = binaryEncoding;
+		this.binaryEncoding = false;
+		this.udpTransportRequested = udpTransport;
+		this.udpTransport = false;
+		this.updatePeriodSeconds = GPS_COORDINATES_UPDATE_PERIOD_SECONDS;
+		this.nextUpdateNs = System.nanoTime();
+
 		/* Create an unconnected socket */
 		this.socket = new Socket();
 
@@ -122,6 +175,10 @@ public class FapManagementProtocol_Client
 		LinkedHashMap<String, Object> data = new LinkedHashMap<>();
 		data.put(PROTOCOL_PARAMETERS_USER_ID, this.userId);
 		data.put(PROTOCOL_PARAMETERS_MSG_TYPE, ProtocolMsgType.USER_ASSOCIATION_REQUEST.getMsgTypeValue());
+		if(this.binaryEncodingRequested)
+			data.put(PROTOCOL_PARAMETERS_ENCODING, ProtocolBinaryCodec.ENCODING_BINARY);
+		if(this.udpTransportRequested)
+			data.put(PROTOCOL_PARAMETERS_TRANSPORT, PROTOCOL_TRANSPORT_UDP);
 
 		String msg;
 		try {
@@ -142,7 +199,7 @@ public class FapManagementProtocol_Client
 
 		/* Create output stream */
 		try {
-			out = new OutputStreamWriter(socket.getOutputStream(), "UTF-8");
+			out = new DataOutputStream(new BufferedOutputStream(socket.getOutputStream()));
 		} catch (IOException e) {
 			return closeSocket(this.socket, RETURN_VALUE_ERROR);
 		}
@@ -164,19 +221,16 @@ public class FapManagementProtocol_Client
 
 
 		try {
-			 this.in = new BufferedReader(new InputStreamReader(this.socket.getInputStream()));
+			 this.in = new DataInputStream(new BufferedInputStream(this.socket.getInputStream()));
 		} catch (IOException e) {
 			return closeSocket(this.socket, RETURN_VALUE_ERROR);
 		}
 
 
 		/* Parse response and check its values */
-		LinkedHashMap response;
-		try {
-			response = this.objectMapper.readValue(this.in, LinkedHashMap.class);
-		} catch (Exception e) {
+		LinkedHashMap response = receiveMsg();
+		if(response == null)
 			return closeSocket(this.socket, RETURN_VALUE_ERROR);
-		}
 
 		int responseId = Integer.parseInt(response.get(PROTOCOL_PARAMETERS_USER_ID).toString());
 		int responseMsgType = Integer.parseInt(response.get(PROTOCOL_PARAMETERS_MSG_TYPE).toString());
@@ -188,7 +242,25 @@ public class FapManagementProtocol_Client
 			return closeSocket(this.socket, RETURN_VALUE_ERROR);
 		}
 
-		prettyPrint("requestUserAssociation", "Associated");
+		/* Fall back to JSON if the server did not accept the binary encoding */
+		this.binaryEncoding = this.binaryEncodingRequested
+			&& ProtocolBinaryCodec.ENCODING_BINARY.equals(response.get(PROTOCOL_PARAMETERS_ENCODING));
+
+		/* Fall back to TCP if the server did not accept the UDP transport */
+		this.udpTransport = this.udpTransportRequested
+			&& PROTOCOL_TRANSPORT_UDP.equals(response.get(PROTOCOL_PARAMETERS_TRANSPORT));
+
+		if(this.udpTransport && !connectDatagramSocket())
+			return closeSocket(this.socket, RETURN_VALUE_ERROR);
+
+		/* The first update is due right away, then at the period set by the server */
+		this.updatePeriodSeconds = GPS_COORDINATES_UPDATE_PERIOD_SECONDS;
+		setUpdatePeriod(response.get(PROTOCOL_PARAMETERS_UPDATE_PERIOD));
+		this.nextUpdateNs = System.nanoTime();
+
+		prettyPrint("requestUserAssociation", "Associated"
+			+ (this.binaryEncoding ? " (binary encoding)" : "")
+			+ (this.udpTransport ? " (UDP transport)" : ""));
 
 
 		/* If the function reached this point, everything must be OK */
@@ -241,12 +313,10 @@ public class FapManagementProtocol_Client
 		}
 
 		/* Parse response and check its values */
-		LinkedHashMap response;
-		try {
-			response = this.objectMapper.readValue(this.in, LinkedHashMap.class);
-		} catch (IOException e) {
+		LinkedHashMap response = receiveMsg();
+		if(response == null)
 			return closeSocket(this.socket, RETURN_VALUE_ERROR);
-		}
+
 		int responseId = Integer.parseInt(response.get(PROTOCOL_PARAMETERS_USER_ID).toString());
 		int responseMsgType = Integer.parseInt(response.get(PROTOCOL_PARAMETERS_MSG_TYPE).toString());
 
@@ -261,7 +331,55 @@ public class FapManagementProtocol_Client
 
 
 	/**
-	 * Send the GPS Coordinates to the FAP.
+	 * Get the GPS coordinates update period negotiated with the server (it
+	 * sets a shorter one for users moving fast or close to the edge of the
+	 * FAP's coverage, and a longer one for the others).
+	 *
+	 * @return		Update period (in seconds).
+	 */
+	public int getGpsCoordinatesUpdatePeriod() {
+		return this.updatePeriodSeconds;
+	}
+
+
+	/**
+	 * Check if the next GPS coordinates update is due: the negotiated period
+	 * (getGpsCoordinatesUpdatePeriod()) has elapsed since the last
+	 * acknowledged update.
+	 *
+	 * @return		True if an update would be sent now; false if it would
+	 * 				be skipped.
+	 */
+	public boolean isGpsCoordinatesUpdateDue() {
+		return this.nextUpdateNs - System.nanoTime() <= 0;
+	}
+
+
+	/**
+	 * Send the GPS Coordinates to the FAP, unless the update is not due yet
+	 * (isGpsCoordinatesUpdateDue()).
+	 *
+	 * @param gpsCoordinates	GPS coordinates.
+	 * @return					SENT / ERROR if the GPS coordinates were / were not ACK by
+	 * 							the server (considering GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS);
+	 * 							NOT_DUE if the update was skipped.
+	 */
+	public GpsCoordinatesUpdateResult sendGpsCoordinatesToFapIfDue(GpsCoordinates gpsCoordinates) {
+		/* Honor the update period negotiated with the server */
+		if(!isGpsCoordinatesUpdateDue()) {
+			long earlyNs = this.nextUpdateNs - System.nanoTime();
+			prettyPrint("sendGpsCoordinatesToFap", "Skipping coordinates update (next one due in "
+				+ (earlyNs + 999999999L) / 1000000000L + " s)");
+			return GpsCoordinatesUpdateResult.NOT_DUE;
+		}
+
+		return sendGpsCoordinatesToFap(gpsCoordinates) ? GpsCoordinatesUpdateResult.SENT : GpsCoordinatesUpdateResult.ERROR;
+	}
+
+
+	/**
+	 * Send the GPS Coordinates to the FAP, due or not (see
+	 * sendGpsCoordinatesToFapIfDue()).
 	 *
 	 * @param gpsCoordinates	GPS coordinates.
 	 * @return					True / false if the GPS coordinates were / were not ACK by
@@ -280,6 +398,9 @@ public class FapManagementProtocol_Client
 			objectMapper.configure(SerializationFeature.INDENT_OUTPUT, true);
 		}
 
+		if(this.binaryEncoding)
+			return sendBinaryGpsCoordinatesToFap(gpsCoordinates);
+
 
 		/* Create JSON formatted String with data */
 		LinkedHashMap<Object, Object> data = new LinkedHashMap<>();
@@ -307,26 +428,34 @@ public class FapManagementProtocol_Client
 
 		prettyPrint("sendGpsCoordinatesToFap", "Sending coordinates update: \n" + msg);
 
-		/* Send JSON message through socket */
-		if(!sendMsg(msg))
-			return closeSocket(this.socket, RETURN_VALUE_ERROR);
+		String timestamp = gpsCoordinates.getTimestamp().withNano(0).atZone(ZoneOffset.UTC).toString();
+		LinkedHashMap response;
 
+		if(this.udpTransport) {
+			/* Send JSON message as a datagram, until its ACK arrives */
+			byte[] ack = exchangeDatagram(msg.getBytes(StandardCharsets.UTF_8), payload -> {
+				LinkedHashMap map = parseMsg(payload);
+				return map != null && timestamp.equals(String.valueOf(map.get(PROTOCOL_PARAMETERS_GPS_TIMESTAMP)));
+			});
 
-		/* Set the timeout value and read response from socket */
-		try {
-			this.socket.setSoTimeout(GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS*1000);
-		} catch (SocketException e) {
-			return closeSocket(this.socket, RETURN_VALUE_ERROR);
-		}
+			response = parseMsg(ack);
+		} else {
+			/* Send JSON message through socket */
+			if(!sendMsg(msg))
+				return closeSocket(this.socket, RETURN_VALUE_ERROR);
 
-		/* Parse response and check its values */
-		LinkedHashMap response = null;
-		try {
-			response = this.objectMapper.readValue(this.in, LinkedHashMap.class);
-		} catch (IOException e) {
-			return closeSocket(this.socket, RETURN_VALUE_ERROR);
+
+			/* Set the timeout value and read response from socket */
+			try {
+				this.socket.setSoTimeout(GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS*1000);
+			} catch (SocketException e) {
+				return closeSocket(this.socket, RETURN_VALUE_ERROR);
+			}
+
+			response = receiveMsg();
 		}
 
+		/* Parse response and check its values */
 		if(response == null)
 			return closeSocket(this.socket, RETURN_VALUE_ERROR);
 
@@ -336,12 +465,15 @@ public class FapManagementProtocol_Client
 
 		if(responseId != this.userId
 				|| responseMsgType != ProtocolMsgType.GPS_COORDINATES_ACK.getMsgTypeValue()
-				|| !responseTimestamp.equals(gpsCoordinates.getTimestamp().withNano(0).atZone(ZoneOffset.UTC).toString())) {
+				|| !responseTimestamp.equals(timestamp)) {
 			return closeSocket(this.socket, RETURN_VALUE_ERROR);
 		}
 
+		setUpdatePeriod(response.get(PROTOCOL_PARAMETERS_UPDATE_PERIOD));
+		this.nextUpdateNs = System.nanoTime() + this.updatePeriodSeconds * 1000000000L;
 
-		prettyPrint("sendGpsCoordinatesToFap", "Coordinates acknowledgement received");
+		prettyPrint("sendGpsCoordinatesToFap", "Coordinates acknowledgement received (next update in "
+			+ this.updatePeriodSeconds + " s)");
 
 		return RETURN_VALUE_OK;
 	}
@@ -351,6 +483,92 @@ public class FapManagementProtocol_Client
 	//           PRIVATE FUNCTIONS
 	// =========================================================
 
+	/**
+	 * Send the GPS Coordinates to the FAP using the binary encoding.
+	 *
+	 * @param gpsCoordinates	GPS coordinates.
+	 * @return					True / false if the GPS coordinates were / were not ACK by
+	 * 							the server (considering GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS).
+	 */
+	private boolean sendBinaryGpsCoordinatesToFap(GpsCoordinates gpsCoordinates) {
+		long timestamp = gpsCoordinates.getTimestamp().toEpochSecond(ZoneOffset.UTC);
+
+		ProtocolBinaryCodec request = new ProtocolBinaryCodec();
+		request.msgType = ProtocolMsgType.GPS_COORDINATES_UPDATE.getMsgTypeValue();
+		request.userId = this.userId;
+		request.latitude = gpsCoordinates.getLatitude();
+		request.longitude = gpsCoordinates.getLongitude();
+		request.altitude = gpsCoordinates.getAltitude();
+		request.timestamp = timestamp;
+
+		prettyPrint("sendGpsCoordinatesToFap", "Sending coordinates update (binary): " + gpsCoordinates);
+
+		ProtocolBinaryCodec response;
+
+		if(this.udpTransport) {
+			/* Send binary message as a datagram, until its ACK arrives */
+			byte[] ack = exchangeDatagram(request.encode(), payload -> {
+				ProtocolBinaryCodec msg = ProtocolBinaryCodec.decode(payload);
+				return msg != null && msg.timestamp == timestamp;
+			});
+
+			response = ProtocolBinaryCodec.decode(ack);
+		} else {
+			/* Send binary message through socket */
+			if(!sendFrame(request.encode()))
+				return closeSocket(this.socket, RETURN_VALUE_ERROR);
+
+
+			/* Set the timeout value and read response from socket */
+			try {
+				this.socket.setSoTimeout(GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS*1000);
+			} catch (SocketException e) {
+				return closeSocket(this.socket, RETURN_VALUE_ERROR);
+			}
+
+			response = ProtocolBinaryCodec.decode(receiveFrame());
+		}
+
+		/* Decode response and check its values */
+
+		if(response == null
+				|| response.userId != this.userId
+				|| response.msgType != ProtocolMsgType.GPS_COORDINATES_ACK.getMsgTypeValue()
+				|| response.timestamp != timestamp) {
+			return closeSocket(this.socket, RETURN_VALUE_ERROR);
+		}
+
+		setUpdatePeriod(response.updatePeriod);
+		this.nextUpdateNs = System.nanoTime() + this.updatePeriodSeconds * 1000000000L;
+
+		prettyPrint("sendGpsCoordinatesToFap", "Coordinates acknowledgement received (next update in "
+			+ this.updatePeriodSeconds + " s)");
+
+		return RETURN_VALUE_OK;
+	}
+
+	/**
+	 * Take the GPS coordinates update period set by the server (kept as is
+	 * if the server did not set one).
+	 *
+	 * @param updatePeriod		"updatePeriod" of the response (in seconds).
+	 */
+	private void setUpdatePeriod(Object updatePeriod) {
+		int seconds;
+
+		if(updatePeriod == null)
+			return;
+
+		try {
+			seconds = Integer.parseInt(updatePeriod.toString());
+		} catch (NumberFormatException e) {
+			return;
+		}
+
+		if(seconds > 0)
+			this.updatePeriodSeconds = seconds;
+	}
+
 	// Protocol (Client)
 
 	/**
@@ -398,17 +616,32 @@ public class FapManagementProtocol_Client
 	}
 
 	/**
-	 * Sends a message over the output stream
+	 * Sends a message over the output stream, as a single frame
+	 * (payload length in network byte order, followed by the payload)
 	 *
 	 * @param msg 		String message to send (pref JSON format)
 	 */
 	private boolean sendMsg(String msg) {
+		return sendFrame(msg.getBytes(StandardCharsets.UTF_8));
+	}
+
+	/**
+	 * Sends a payload over the output stream, as a single frame
+	 *
+	 * @param payload 	Payload to send (JSON or binary message)
+	 */
+	private boolean sendFrame(byte[] payload) {
 		if(this.out == null) {
 			return false;
 		}
 
+		if(payload.length > MSG_FRAME_MAX_PAYLOAD) {
+			return false;
+		}
+
 		try {
-			this.out.write(msg);
+			this.out.writeInt(payload.length);
+			this.out.write(payload);
 			this.out.flush();
 		} catch (IOException e) {
 			return false;
@@ -418,10 +651,132 @@ public class FapManagementProtocol_Client
 		return true;
 	}
 
+	/**
+	 * Receives a (framed) JSON message from the input stream
+	 *
+	 * @return 			Parsed message; null if it could not be read or parsed
+	 */
+	private LinkedHashMap receiveMsg() {
+		return parseMsg(receiveFrame());
+	}
+
+	/**
+	 * Parses a JSON message
+	 *
+	 * @param payload 	JSON message
+	 * @return 			JSON object; null if the payload is not a valid JSON message
+	 */
+	private LinkedHashMap parseMsg(byte[] payload) {
+		if(payload == null) {
+			return null;
+		}
+
+		try {
+			return this.objectMapper.readValue(payload, LinkedHashMap.class);
+		} catch (IOException e) {
+			return null;
+		}
+	}
+
+	/**
+	 * Receives a frame's payload from the input stream
+	 *
+	 * @return 			Payload; null if it could not be read
+	 */
+	private byte[] receiveFrame() {
+		if(this.in == null) {
+			return null;
+		}
+
+		try {
+			int length = this.in.readInt();
+			if(length < 0 || length > MSG_FRAME_MAX_PAYLOAD)
+				return null;
+
+			byte[] payload = new byte[length];
+			this.in.readFully(payload);
+
+			return payload;
+		} catch (IOException e) {
+			return null;
+		}
+	}
+
+	/**
+	 * Sends a GPS coordinates update as a datagram and waits for its ACK,
+	 * sending it again (updates are idempotent) if the ACK does not arrive in time
+	 *
+	 * @param payload 	Update to send (JSON or binary message)
+	 * @param isAck 	Checks if a received datagram is the update's ACK
+	 * 					(late ACKs of previous updates are ignored)
+	 * @return 			ACK payload; null if no ACK arrived
+	 */
+	private byte[] exchangeDatagram(byte[] payload, Predicate<byte[]> isAck) {
+		if(this.datagramSocket == null) {
+			return null;
+		}
+
+		byte[] buffer = new byte[DATAGRAM_MAX_PAYLOAD];
+
+		try {
+			this.datagramSocket.setSoTimeout(GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS*1000 / DATAGRAM_TRANSMISSIONS);
+
+			for(int i = 0; i < DATAGRAM_TRANSMISSIONS; i++) {
+				this.datagramSocket.send(new DatagramPacket(payload, payload.length));
+
+				try {
+					while(true) {
+						DatagramPacket packet = new DatagramPacket(buffer, buffer.length);
+						this.datagramSocket.receive(packet);
+
+						byte[] ack = Arrays.copyOf(packet.getData(), packet.getLength());
+						if(isAck.test(ack))
+							return ack;
+					}
+				} catch (SocketTimeoutException e) {
+					prettyPrint("sendGpsCoordinatesToFap", "No acknowledgement, sending the update again");
+				}
+			}
+		} catch (IOException e) {
+			return null;
+		}
+
+		return null;
+	}
+
+	/**
+	 * Open the datagram socket for the GPS coordinates updates (connected to the server,
+	 * so that only its datagrams are received)
+	 *
+	 * @return 			True/False in case of success/failure
+	 */
+	private boolean connectDatagramSocket() {
+		closeDatagramSocket();
+
+		try {
+			this.datagramSocket = new DatagramSocket();
+			this.datagramSocket.connect(new InetSocketAddress(SERVER_IP_ADDRESS, SERVER_PORT_NUMBER));
+		} catch (IOException e) {
+			closeDatagramSocket();
+			return false;
+		}
+
+		return true;
+	}
+
+	private void closeDatagramSocket() {
+		if(this.datagramSocket != null) {
+			this.datagramSocket.close();
+			this.datagramSocket = null;
+		}
+	}
+
 	/**
 	 * @param socket 	Socket to be closed
 	 */
 	private boolean closeSocket(Socket socket, boolean retval) {
+		closeDatagramSocket();
+
 		if(socket != null && socket.isConnected()) {
 			try {
 				socket.close();
@@ -0,0 +1,22 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Client)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+package FapManagementProtocolClient;
+
+
+/**
+ * Enum with the results of a GPS coordinates update that honors the
+ * negotiated update period.
+ */
+public enum GpsCoordinatesUpdateResult
+{
+	// ----- RESULTS ----- //
+	SENT,			// Sent and ACK by the server
+	NOT_DUE,		// Skipped: the negotiated period has not elapsed yet
+	ERROR;			// Not ACK by the server (the connection is closed)
+}
@@ -0,0 +1,101 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Client)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+package FapManagementProtocolClient;
+
+import java.nio.ByteBuffer;
+
+
+/**
+ * Encoder / decoder of the binary FAP Management Protocol messages.
+ *
+ * Wire layout (MSG_SIZE bytes, network byte order):
+ * msgType (1), version (1), updatePeriod (2, in seconds), userId (4),
+ * lat (4, float), lon (4, float), alt (4, float),
+ * timestamp (8, seconds since the Unix epoch, UTC).
+ *
+ * The update period (of the next GPS coordinates updates) is only set in
+ * the GPS coordinates ACKs; it is 0 in the other messages.
+ */
+class ProtocolBinaryCodec
+{
+	// =========================================================
+	//           CONSTANTS
+	// =========================================================
+
+	public static final int MSG_SIZE		= 28;
+	public static final int VERSION			= 1;
+
+	// Values of the "encoding" parameter negotiated on association
+	public static final String ENCODING_JSON	= "json";
+	public static final String ENCODING_BINARY	= "binary";
+
+
+	// =========================================================
+	//           MEMBERS
+	// =========================================================
+	public int msgType;
+	public int updatePeriod;
+	public int userId;
+	public float latitude;
+	public float longitude;
+	public float altitude;
+	public long timestamp;
+
+
+	// =========================================================
+	//           FUNCTIONS
+	// =========================================================
+
+	/**
+	 * Encode the message.
+	 *
+	 * @return		Encoded message (MSG_SIZE bytes).
+	 */
+	public byte[] encode()
+	{
+		ByteBuffer buffer = ByteBuffer.allocate(MSG_SIZE);
+
+		buffer.put((byte) this.msgType);
+		buffer.put((byte) VERSION);
+		buffer.putShort((short) this.updatePeriod);
+		buffer.putInt(this.userId);
+		buffer.putFloat(this.latitude);
+		buffer.putFloat(this.longitude);
+		buffer.putFloat(this.altitude);
+		buffer.putLong(this.timestamp);
+
+		return buffer.array();
+	}
+
+	/**
+	 * Decode a message.
+	 *
+	 * @param payload	Encoded message.
+	 * @return			Decoded message; null if the payload is not a valid binary message.
+	 */
+	public static ProtocolBinaryCodec decode(byte[] payload)
+	{
+		if (payload == null || payload.length != MSG_SIZE || payload[1] != VERSION)
+			return null;
+
+		ByteBuffer buffer = ByteBuffer.wrap(payload);
+		ProtocolBinaryCodec msg = new ProtocolBinaryCodec();
+
+		msg.msgType = buffer.get() & 0xFF;
+		buffer.get();
+		msg.updatePeriod = buffer.getShort() & 0xFFFF;
+		msg.userId = buffer.getInt();
+		msg.latitude = buffer.getFloat();
+		msg.longitude = buffer.getFloat();
+		msg.altitude = buffer.getFloat();
+		msg.timestamp = buffer.getLong();
+
+		return msg;
+	}
+}
@@ -45,7 +45,7 @@ public class Test_FapManagementProtocol_Client
 			"FAP MANAGEMENT PROTOCOL (CLIENT) TEST\n" +
 			"=============================================\n");
 
-		runTests();
+		System.exit(runTests() == 0 ? 0 : 1);
 	}
 
 
@@ -55,13 +55,17 @@ public class Test_FapManagementProtocol_Client
 
 	/**
 	 * Run tests.
+	 *
+	 * @return	Number of errors detected.
 	 */
-	private static void runTests()
+	private static int runTests()
 	{
 		int nErrors = 0;
 
-		// Run tests
-		nErrors += runTest_fapManagementProtocol();
+		// Run tests (JSON over TCP, binary over TCP, binary over UDP)
+		nErrors += runTest_fapManagementProtocol(false, false);
+		nErrors += runTest_fapManagementProtocol(true, false);
+		nErrors += runTest_fapManagementProtocol(true, true);
 
 		if(nErrors == 0) {
 			System.out.println("\n# TEST SUMMARY: Tests passed!");
@@ -70,23 +74,29 @@ public class Test_FapManagementProtocol_Client
 			if(nErrors == 2 || nErrors == 3)
 				System.out.println(" Check the server log. Coordinates could be out of bounds.");
 		}
+
+		return nErrors;
 	}
 
 	/**
 	 * Test - FAP Management Protocol.
 	 *
-	 * @return	Number of errors detected.
+	 * @param binaryEncoding	Request the binary encoding for the GPS coordinates updates.
+	 * @param udpTransport		Request the UDP transport for the GPS coordinates updates.
+	 * @return					Number of errors detected.
 	 */
-	private static int runTest_fapManagementProtocol()
+	private static int runTest_fapManagementProtocol(boolean binaryEncoding, boolean udpTransport)
 	{
 		System.out.println("==========");
-		System.out.println("TEST: FAP Management Protocol (Client)");
+		System.out.println("TEST: FAP Management Protocol (Client)"
+			+ (binaryEncoding ? " - binary encoding" : "")
+			+ (udpTransport ? " - UDP transport" : ""));
 		System.out.println("==========");
 
 		int nErrors = 0;
 
 		// Initialize the FAP Management Protocol
-		FapManagementProtocol_Client fmp = new FapManagementProtocol_Client();
+		FapManagementProtocol_Client fmp = new FapManagementProtocol_Client(binaryEncoding, udpTransport);
 
 		// Request user association
 		nErrors += assertCondition(fmp.requestUserAssociation() == FapManagementProtocol_Client.RETURN_VALUE_OK,
@@ -103,11 +113,20 @@ public class Test_FapManagementProtocol_Client
 
 			GpsCoordinates gpsCoordinates = new GpsCoordinates(latitude, longitude, 0, LocalDateTime.now(ZoneId.of("Z")));
 
-			// Send GPS coordinates
-			nErrors += assertCondition(fmp.sendGpsCoordinatesToFap(gpsCoordinates) == FapManagementProtocol_Client.RETURN_VALUE_OK,
+			// Only the first update is due: the second one comes before the negotiated period
+			nErrors += assertCondition(fmp.isGpsCoordinatesUpdateDue() == (i == 0),
+				"Checking if the GPS coordinates update is due");
+
+			// Send GPS coordinates (the second one is skipped)
+			nErrors += assertCondition(fmp.sendGpsCoordinatesToFapIfDue(gpsCoordinates)
+					== ((i == 0) ? GpsCoordinatesUpdateResult.SENT : GpsCoordinatesUpdateResult.NOT_DUE),
 				"Sending GPS Coordinates");
 		}
 
+		// The server negotiated the period of the next updates
+		nErrors += assertCondition(fmp.getGpsCoordinatesUpdatePeriod() > 0 && !fmp.isGpsCoordinatesUpdateDue(),
+			"Negotiating the GPS coordinates update period");
+
 
 		// Terminate the FAP Management Protocol
 		nErrors += assertCondition(fmp.requestUserDesassociation() == FapManagementProtocol_Client.RETURN_VALUE_OK,
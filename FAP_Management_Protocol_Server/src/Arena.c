@@ -0,0 +1,125 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "Arena.h"
+
+// JSON parser
+#include "json/parson.h"
+
+// C headers
+#include <pthread.h>
+#include <stdlib.h>
+
+
+// =========================================================
+//           GLOBAL VARIABLES
+// =========================================================
+
+// Arena serving the JSON parser's allocations in each thread (if any)
+static __thread Arena *jsonArena = NULL;
+
+static pthread_once_t jsonAllocationOnce = PTHREAD_ONCE_INIT;
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+static inline int isArenaMemory(const Arena *arena, const void *ptr)
+{
+	const unsigned char *p = ptr;
+
+	return arena != NULL && p >= arena->block && p < arena->block + arena->size;
+}
+
+static void *jsonMalloc(size_t size)
+{
+	void *ptr;
+
+	if (jsonArena != NULL && (ptr = allocateArena(jsonArena, size)) != NULL)
+		return ptr;
+
+	return malloc(size);
+}
+
+static void jsonFree(void *ptr)
+{
+	// Arena memory is released by resetArena()
+	if (!isArenaMemory(jsonArena, ptr))
+		free(ptr);
+}
+
+static void installJsonAllocationFunctions(void)
+{
+	json_set_allocation_functions(jsonMalloc, jsonFree);
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeArena(Arena *arena, size_t size)
+{
+	// Check arguments
+	if (arena == NULL || size == 0)
+		return RETURN_VALUE_ERROR;
+
+	if ((arena->block = aligned_alloc(ARENA_ALIGNMENT, (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1))) == NULL)
+		return RETURN_VALUE_ERROR;
+
+	arena->size = size;
+	arena->used = 0;
+	arena->peak = 0;
+	arena->overflows = 0;
+
+	return RETURN_VALUE_OK;
+}
+
+
+void terminateArena(Arena *arena)
+{
+	if (jsonArena == arena)
+		jsonArena = NULL;
+
+	free(arena->block);
+	arena->block = NULL;
+	arena->size = arena->used = 0;
+}
+
+
+void *allocateArena(Arena *arena, size_t size)
+{
+	size_t offset = (arena->used + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+
+	if (size > arena->size || offset > arena->size - size)
+	{
+		arena->overflows++;
+		return NULL;
+	}
+
+	arena->used = offset + size;
+	if (arena->used > arena->peak)
+		arena->peak = arena->used;
+
+	return arena->block + offset;
+}
+
+
+void resetArena(Arena *arena)
+{
+	arena->used = 0;
+}
+
+
+void setJsonArena(Arena *arena)
+{
+	pthread_once(&jsonAllocationOnce, installJsonAllocationFunctions);
+
+	jsonArena = arena;
+}
@@ -0,0 +1,90 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <stddef.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Alignment of the arena's allocations
+#define ARENA_ALIGNMENT				16
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Bump allocator: allocations are carved out of a single block and are
+ * all released at once by resetArena(). Meant for the short-lived
+ * allocations of handling one message.
+ */
+typedef struct _Arena
+{
+	unsigned char *block;		// Memory block
+	size_t size;				// Block's size
+	size_t used;				// Bytes handed out since the last reset
+	size_t peak;				// Highest use since the arena was initialized
+	size_t overflows;			// Allocations that didn't fit (served by malloc)
+} Arena;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize an arena.
+ *
+ * @param arena			Pointer to the Arena to be initialized.
+ * @param size			Size of the arena's block (in bytes).
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeArena(Arena *arena, size_t size);
+
+/**
+ * Terminate an arena, releasing its block.
+ *
+ * @param arena			Pointer to the Arena.
+ */
+void terminateArena(Arena *arena);
+
+/**
+ * Allocate memory from an arena.
+ *
+ * @param arena			Pointer to the Arena.
+ * @param size			Size of the allocation (in bytes).
+ * @return				Pointer to the allocation; NULL if it doesn't fit.
+ */
+void *allocateArena(Arena *arena, size_t size);
+
+/**
+ * Release every allocation of an arena.
+ *
+ * @param arena			Pointer to the Arena.
+ */
+void resetArena(Arena *arena);
+
+/**
+ * Serve the JSON parser's (parson) allocations, in the calling thread, from
+ * an arena. Frees of arena memory are ignored until resetArena(); allocations
+ * that don't fit in the arena, and those of other threads, use malloc/free.
+ *
+ * @param arena			Pointer to the Arena (NULL to go back to malloc/free).
+ */
+void setJsonArena(Arena *arena);
@@ -0,0 +1,129 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "DatagramBatch.h"
+
+// C headers
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Point the first n message headers at their buffers and addresses.
+ *
+ * @param batch			Pointer to the DatagramBatch.
+ * @param n				Number of message headers.
+ * @param length		Buffer length of each message.
+ */
+static void prepareDatagramBatch(DatagramBatch *batch, unsigned int n, size_t length)
+{
+	for (unsigned int i = 0; i < n; i++)
+	{
+		batch->iovecs[i].iov_base = batch->payloads[i];
+		batch->iovecs[i].iov_len = length;
+
+		memset(&batch->messages[i], 0, sizeof(batch->messages[i]));
+		batch->messages[i].msg_hdr.msg_name = &batch->addresses[i];
+		batch->messages[i].msg_hdr.msg_namelen = sizeof(batch->addresses[i]);
+		batch->messages[i].msg_hdr.msg_iov = &batch->iovecs[i];
+		batch->messages[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+void initializeDatagramBatch(DatagramBatch *batch)
+{
+	batch->count = 0;
+}
+
+
+int receiveDatagramBatch(DatagramBatch *batch, int fd)
+{
+	int n;
+
+	prepareDatagramBatch(batch, DATAGRAM_BATCH_SIZE, DATAGRAM_MAX_PAYLOAD);
+	batch->count = 0;
+
+	do
+		n = recvmmsg(fd, batch->messages, DATAGRAM_BATCH_SIZE, MSG_DONTWAIT, NULL);
+	while (n < 0 && errno == EINTR);
+
+	if (n < 0)
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : RETURN_VALUE_ERROR;
+
+	for (int i = 0; i < n; i++)
+	{
+		size_t length = batch->messages[i].msg_len;
+
+		if (batch->messages[i].msg_hdr.msg_flags & MSG_TRUNC)
+			length = 0;
+
+		batch->payloads[i][length] = '\0';
+		batch->lengths[i] = length;
+	}
+	batch->count = n;
+
+	return n;
+}
+
+
+int queueDatagram(DatagramBatch *batch, const struct sockaddr_in *address, const void *payload, size_t length)
+{
+	unsigned int i = batch->count;
+
+	if (i == DATAGRAM_BATCH_SIZE || length > DATAGRAM_MAX_PAYLOAD || address == NULL)
+		return RETURN_VALUE_ERROR;
+
+	memcpy(batch->payloads[i], payload, length);
+	batch->lengths[i] = length;
+	batch->addresses[i] = *address;
+	batch->count++;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int flushDatagramBatch(DatagramBatch *batch, int fd)
+{
+	unsigned int next = 0;
+	int sent = 0;
+
+	prepareDatagramBatch(batch, batch->count, 0);
+	for (unsigned int i = 0; i < batch->count; i++)
+		batch->iovecs[i].iov_len = batch->lengths[i];
+
+	while (next < batch->count)
+	{
+		int n = sendmmsg(fd, batch->messages + next, batch->count - next, MSG_DONTWAIT);
+
+		if (n > 0)
+		{
+			next += n;
+			sent += n;
+		}
+		else if (n < 0 && errno == EINTR)
+			continue;
+		else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		else
+			next++;		// Skip the datagram that failed (e.g. unreachable destination)
+	}
+
+	batch->count = 0;
+
+	return sent;
+}
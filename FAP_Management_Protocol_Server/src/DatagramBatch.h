@@ -0,0 +1,98 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <stddef.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Maximum number of datagrams moved per system call
+#define DATAGRAM_BATCH_SIZE			64
+
+// Maximum payload of a datagram (in bytes)
+#define DATAGRAM_MAX_PAYLOAD		1024
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Batch of datagrams, received with a single recvmmsg() or sent with a
+ * single sendmmsg().
+ *
+ * After receiveDatagramBatch(), datagram i is payloads[i] (NUL-terminated),
+ * with lengths[i] bytes, sent from addresses[i]. Truncated datagrams are
+ * reported with a length of 0.
+ */
+typedef struct _DatagramBatch
+{
+	struct mmsghdr messages[DATAGRAM_BATCH_SIZE];			// recvmmsg() / sendmmsg() headers
+	struct iovec iovecs[DATAGRAM_BATCH_SIZE];				// One buffer per datagram
+	struct sockaddr_in addresses[DATAGRAM_BATCH_SIZE];		// Source / destination addresses
+	char payloads[DATAGRAM_BATCH_SIZE][DATAGRAM_MAX_PAYLOAD + 1];
+	size_t lengths[DATAGRAM_BATCH_SIZE];					// Payload lengths
+	unsigned int count;										// Datagrams in the batch
+} DatagramBatch;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize (empty) a datagram batch.
+ *
+ * @param batch			Pointer to the DatagramBatch to be initialized.
+ */
+void initializeDatagramBatch(DatagramBatch *batch);
+
+/**
+ * Receive up to DATAGRAM_BATCH_SIZE datagrams from a non-blocking socket,
+ * replacing the batch's contents.
+ *
+ * @param batch			Pointer to the DatagramBatch.
+ * @param fd			Socket.
+ * @return				Number of datagrams received (0 if the socket would block);
+ *						RETURN_VALUE_ERROR on socket errors.
+ */
+int receiveDatagramBatch(DatagramBatch *batch, int fd);
+
+/**
+ * Append a datagram to the batch (to be sent by flushDatagramBatch()).
+ *
+ * @param batch			Pointer to the DatagramBatch.
+ * @param address		Destination address.
+ * @param payload		Payload.
+ * @param length		Payload's length (up to DATAGRAM_MAX_PAYLOAD).
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise (batch full or payload too large), return RETURN_VALUE_ERROR.
+ */
+int queueDatagram(DatagramBatch *batch, const struct sockaddr_in *address, const void *payload, size_t length);
+
+/**
+ * Send every queued datagram and empty the batch. Datagrams the socket
+ * can't take right away, or can't send at all, are dropped (like any
+ * other lost datagram).
+ *
+ * @param batch			Pointer to the DatagramBatch.
+ * @param fd			Socket.
+ * @return				Number of datagrams sent.
+ */
+int flushDatagramBatch(DatagramBatch *batch, int fd);
@@ -0,0 +1,244 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "EventLog.h"
+
+// C headers
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+#define NS_PER_SECOND		1000000000LL
+
+// Length of a record, padded to the alignment
+#define RECORD_LENGTH(payloadLength)	\
+	((sizeof(EventLogRecordHeader) + (payloadLength) + EVENT_LOG_ALIGNMENT - 1) & ~(size_t) (EVENT_LOG_ALIGNMENT - 1))
+
+// Offset of the first record
+#define FILE_HEADER_LENGTH	\
+	((sizeof(EventLogFileHeader) + EVENT_LOG_ALIGNMENT - 1) & ~(size_t) (EVENT_LOG_ALIGNMENT - 1))
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Time of a clock (in ns).
+ */
+static int64_t clockNs(clockid_t clock)
+{
+	struct timespec now;
+
+	clock_gettime(clock, &now);
+
+	return (int64_t) now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+/**
+ * Grow the file by a chunk and map it (the previous chunk is unmapped).
+ */
+static int mapChunk(EventLog *log, size_t chunkOffset)
+{
+	uint8_t *chunk;
+
+	if (ftruncate(log->fd, chunkOffset + EVENT_LOG_CHUNK_SIZE) < 0)
+		return RETURN_VALUE_ERROR;
+
+	chunk = mmap(NULL, EVENT_LOG_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, log->fd, chunkOffset);
+	if (chunk == MAP_FAILED)
+		return RETURN_VALUE_ERROR;
+
+	if (log->chunk != NULL)
+		munmap(log->chunk, EVENT_LOG_CHUNK_SIZE);
+	log->chunk = chunk;
+	log->chunkOffset = chunkOffset;
+	log->position = 0;
+
+	return RETURN_VALUE_OK;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int openEventLog(EventLog *log, const char *path)
+{
+	EventLogFileHeader header = {EVENT_LOG_MAGIC};
+
+	memset(log, 0, sizeof(*log));
+
+	if ((log->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+		return RETURN_VALUE_ERROR;
+
+	if (mapChunk(log, 0) != RETURN_VALUE_OK || pthread_mutex_init(&log->lock, NULL) != 0)
+	{
+		if (log->chunk != NULL)
+			munmap(log->chunk, EVENT_LOG_CHUNK_SIZE);
+		close(log->fd);
+		log->fd = -1;
+		return RETURN_VALUE_ERROR;
+	}
+
+	header.version = EVENT_LOG_VERSION;
+	header.headerSize = sizeof(header);
+	header.epochNs = clockNs(CLOCK_REALTIME);
+	header.monotonicNs = clockNs(CLOCK_MONOTONIC);
+	memcpy(log->chunk, &header, sizeof(header));
+	log->position = FILE_HEADER_LENGTH;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int closeEventLog(EventLog *log)
+{
+	int res;
+
+	if (log->fd < 0)
+		return RETURN_VALUE_ERROR;
+
+	// If not trimmed, the unused end of the chunk (zeros) still ends the log
+	munmap(log->chunk, EVENT_LOG_CHUNK_SIZE);
+	res = ftruncate(log->fd, log->chunkOffset + log->position);
+	close(log->fd);
+	pthread_mutex_destroy(&log->lock);
+	log->fd = -1;
+	log->chunk = NULL;
+
+	return res == 0 ? RETURN_VALUE_OK : RETURN_VALUE_ERROR;
+}
+
+
+int appendEventLog(EventLog *log, EventLogType type, uint16_t code, int32_t connectionId, int32_t userId,
+				   const void *payload, size_t payloadLength)
+{
+	EventLogRecordHeader *header;
+	size_t length;
+
+	if (payloadLength > EVENT_LOG_MAX_PAYLOAD)
+		payloadLength = EVENT_LOG_MAX_PAYLOAD;
+	length = RECORD_LENGTH(payloadLength);
+
+	pthread_mutex_lock(&log->lock);
+
+	// Records don't straddle chunks: the end of a full chunk is padding
+	if (log->position + length > EVENT_LOG_CHUNK_SIZE)
+	{
+		if (log->position < EVENT_LOG_CHUNK_SIZE)
+		{
+			header = (EventLogRecordHeader *) (log->chunk + log->position);
+			header->type = EVENT_LOG_PADDING;
+			__atomic_store_n(&header->length, EVENT_LOG_CHUNK_SIZE - log->position, __ATOMIC_RELEASE);
+		}
+
+		if (mapChunk(log, log->chunkOffset + EVENT_LOG_CHUNK_SIZE) != RETURN_VALUE_OK)
+		{
+			pthread_mutex_unlock(&log->lock);
+			return RETURN_VALUE_ERROR;
+		}
+	}
+
+	header = (EventLogRecordHeader *) (log->chunk + log->position);
+	header->type = type;
+	header->code = code;
+	header->monotonicNs = clockNs(CLOCK_MONOTONIC);
+	header->connectionId = connectionId;
+	header->userId = userId;
+	header->payloadLength = payloadLength;
+	header->reserved = 0;
+	if (payloadLength > 0)
+		memcpy(header + 1, payload, payloadLength);
+
+	// Written last: the record exists once its length does
+	__atomic_store_n(&header->length, length, __ATOMIC_RELEASE);
+	log->position += length;
+	log->records++;
+
+	pthread_mutex_unlock(&log->lock);
+
+	return RETURN_VALUE_OK;
+}
+
+
+int openEventLogReader(EventLogReader *reader, const char *path)
+{
+	struct stat status;
+	int fd;
+
+	memset(reader, 0, sizeof(*reader));
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return RETURN_VALUE_ERROR;
+
+	if (fstat(fd, &status) < 0 || (size_t) status.st_size < sizeof(EventLogFileHeader)
+			|| (reader->map = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		reader->map = NULL;
+		close(fd);
+		return RETURN_VALUE_ERROR;
+	}
+	close(fd);
+
+	reader->size = status.st_size;
+	memcpy(&reader->header, reader->map, sizeof(reader->header));
+
+	if (memcmp(reader->header.magic, EVENT_LOG_MAGIC, sizeof(reader->header.magic)) != 0
+			|| reader->header.version != EVENT_LOG_VERSION || reader->header.headerSize != sizeof(EventLogFileHeader))
+	{
+		closeEventLogReader(reader);
+		return RETURN_VALUE_ERROR;
+	}
+	reader->position = FILE_HEADER_LENGTH;
+
+	return RETURN_VALUE_OK;
+}
+
+
+void closeEventLogReader(EventLogReader *reader)
+{
+	if (reader->map != NULL)
+		munmap((void *) reader->map, reader->size);
+	reader->map = NULL;
+}
+
+
+int readEventLog(EventLogReader *reader, EventLogRecord *record)
+{
+	while (reader->position + sizeof(EventLogRecordHeader) <= reader->size)
+	{
+		const uint8_t *at = reader->map + reader->position;
+		uint32_t length = __atomic_load_n((const uint32_t *) at, __ATOMIC_ACQUIRE);
+
+		// The end (never written), or a record cut short
+		if (length == 0 || length % EVENT_LOG_ALIGNMENT != 0 || reader->position + length > reader->size)
+			return RETURN_VALUE_ERROR;
+
+		memcpy(&record->header, at, sizeof(record->header));
+		reader->position += length;
+
+		if (record->header.type == EVENT_LOG_PADDING)
+			continue;
+		if (sizeof(EventLogRecordHeader) + record->header.payloadLength > length)
+			return RETURN_VALUE_ERROR;
+
+		record->payload = at + sizeof(EventLogRecordHeader);
+		return RETURN_VALUE_OK;
+	}
+
+	return RETURN_VALUE_ERROR;
+}
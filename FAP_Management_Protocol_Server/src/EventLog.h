@@ -0,0 +1,197 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK						0
+#define RETURN_VALUE_ERROR					(-1)
+
+// File identification
+#define EVENT_LOG_MAGIC						"FAPEVLOG"
+#define EVENT_LOG_VERSION					1
+
+// The file grows (and is mapped) by chunks of this size (in bytes)
+#define EVENT_LOG_CHUNK_SIZE				(1 << 20)
+
+// Longest payload of a record (longer ones are truncated)
+#define EVENT_LOG_MAX_PAYLOAD				1024
+
+// Records start at multiples of this alignment (in bytes)
+#define EVENT_LOG_ALIGNMENT					8
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Types of records.
+ */
+typedef enum _EventLogType
+{
+	EVENT_LOG_PADDING				= 0,		// Unused end of a chunk (skipped)
+	EVENT_LOG_PROTOCOL_MESSAGE		= 1,		// Message received from a user (code: message type; payload: as received)
+	EVENT_LOG_MAVLINK_COMMAND		= 2,		// Command sent to the autopilot (code: MAVLink message ID; payload: float x, y, z)
+	EVENT_LOG_EVICTION				= 3,		// User dropped by the server (code: EventLogEvictionReason)
+	EVENT_LOG_CONNECTION_CLOSED		= 4			// Connection closed
+} EventLogType;
+
+/**
+ * Reasons of an EVENT_LOG_EVICTION.
+ */
+typedef enum _EventLogEvictionReason
+{
+	EVENT_LOG_EVICTION_TIMEOUT		= 1,		// Too long without messages
+	EVENT_LOG_EVICTION_REASSOCIATED	= 2,		// The user associated from another connection (from the same address)
+	EVENT_LOG_EVICTION_OUT_OF_COVERAGE	= 3		// The user's last position is out of the FAP's coverage
+} EventLogEvictionReason;
+
+/**
+ * Header of the log file.
+ */
+typedef struct _EventLogFileHeader
+{
+	char magic[8];								// EVENT_LOG_MAGIC
+	uint32_t version;							// EVENT_LOG_VERSION
+	uint32_t headerSize;						// Size of this header (records follow it)
+	int64_t epochNs;							// Opening time (ns since the Unix epoch)...
+	int64_t monotonicNs;						// ... and the same instant on the monotonic clock
+} EventLogFileHeader;
+
+/**
+ * Header of a record (followed by its payload). A record of length 0 ends
+ * the log (the rest of the file was never written).
+ */
+typedef struct _EventLogRecordHeader
+{
+	uint32_t length;							// Record's length, padded to EVENT_LOG_ALIGNMENT (written last)
+	uint16_t type;								// EventLogType
+	uint16_t code;								// Type specific
+	int64_t monotonicNs;						// Time (monotonic ns)
+	int32_t connectionId;						// Connection (user slot; -1 if none)
+	int32_t userId;								// User ID (-1 if none)
+	uint32_t payloadLength;						// Payload's length
+	uint32_t reserved;
+} EventLogRecordHeader;
+
+/**
+ * Append-only binary log of events (e.g. every protocol message and
+ * MAVLink command), for replaying what happened.
+ *
+ * Records are copied straight into a shared memory mapping of the file,
+ * which grows by chunks: appending is a memcpy(), without system calls
+ * (but once per chunk). A record is only readable once its length is
+ * written, so a log cut short (e.g. a crash) ends at its last whole record.
+ */
+typedef struct _EventLog
+{
+	int fd;										// Log file
+	uint8_t *chunk;								// Mapping of the current chunk
+	size_t chunkOffset;							// Offset of the current chunk in the file
+	size_t position;							// Next record's offset in the chunk
+	pthread_mutex_t lock;						// Serializes the appends
+	unsigned long records;						// Records appended
+} EventLog;
+
+/**
+ * Record read from a log.
+ */
+typedef struct _EventLogRecord
+{
+	EventLogRecordHeader header;				// Header
+	const uint8_t *payload;						// Payload (header.payloadLength bytes, in the reader's mapping)
+} EventLogRecord;
+
+/**
+ * Reader of a log (a read-only mapping of the file).
+ */
+typedef struct _EventLogReader
+{
+	const uint8_t *map;							// Mapping of the file
+	size_t size;								// File's size
+	size_t position;							// Next record's offset
+	EventLogFileHeader header;					// File's header
+} EventLogReader;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Create (or truncate) an event log.
+ *
+ * @param log					Pointer to the EventLog to be initialized.
+ * @param path					Log file.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int openEventLog(EventLog *log, const char *path);
+
+/**
+ * Close an event log (trimming the file to its records).
+ *
+ * @param log					Pointer to the EventLog.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int closeEventLog(EventLog *log);
+
+/**
+ * Append a record, timestamped now (from any thread).
+ *
+ * @param log					Pointer to the EventLog.
+ * @param type					EventLogType.
+ * @param code					Type specific.
+ * @param connectionId			Connection (-1 if none).
+ * @param userId				User ID (-1 if none).
+ * @param payload				Payload (may be NULL if payloadLength is 0).
+ * @param payloadLength			Payload's length (at most EVENT_LOG_MAX_PAYLOAD are kept).
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int appendEventLog(EventLog *log, EventLogType type, uint16_t code, int32_t connectionId, int32_t userId,
+				   const void *payload, size_t payloadLength);
+
+/**
+ * Open an event log for reading.
+ *
+ * @param reader				Pointer to the EventLogReader to be initialized.
+ * @param path					Log file.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise (not a log), return RETURN_VALUE_ERROR.
+ */
+int openEventLogReader(EventLogReader *reader, const char *path);
+
+/**
+ * Close an event log reader (its records' payloads become invalid).
+ *
+ * @param reader				Pointer to the EventLogReader.
+ */
+void closeEventLogReader(EventLogReader *reader);
+
+/**
+ * Read the next record (padding is skipped).
+ *
+ * @param reader				Pointer to the EventLogReader.
+ * @param record				Pointer to the EventLogRecord to be initialized.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise (end of the log), return RETURN_VALUE_ERROR.
+ */
+int readEventLog(EventLogReader *reader, EventLogRecord *record);
@@ -0,0 +1,182 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "EventLoop.h"
+
+// C headers
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Drain the wakeup eventfd. The loop itself checks the running flag
+ * after every dispatched batch.
+ *
+ * @param handler	Wakeup handler.
+ * @param events	Ready events.
+ */
+static void onWakeup(EventLoopHandler *handler, uint32_t events)
+{
+	uint64_t value;
+
+	(void) events;
+	while (read(handler->fd, &value, sizeof(value)) > 0)
+		;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeEventLoop(EventLoop *eventLoop)
+{
+	// Check arguments
+	if (eventLoop == NULL)
+		return RETURN_VALUE_ERROR;
+
+	eventLoop->running = 1;
+
+	// Create epoll instance
+	if ((eventLoop->epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return RETURN_VALUE_ERROR;
+
+	// Create wakeup eventfd
+	if ((eventLoop->wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+	{
+		close(eventLoop->epollFd);
+		return RETURN_VALUE_ERROR;
+	}
+
+	eventLoop->wakeupHandler.fd = eventLoop->wakeupFd;
+	eventLoop->wakeupHandler.callback = onWakeup;
+	eventLoop->wakeupHandler.context = eventLoop;
+
+	if (addEventLoopHandler(eventLoop, &eventLoop->wakeupHandler, EPOLLIN) != RETURN_VALUE_OK)
+	{
+		close(eventLoop->wakeupFd);
+		close(eventLoop->epollFd);
+		return RETURN_VALUE_ERROR;
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+
+int terminateEventLoop(EventLoop *eventLoop)
+{
+	// Check arguments
+	if (eventLoop == NULL)
+		return RETURN_VALUE_ERROR;
+
+	close(eventLoop->wakeupFd);
+	close(eventLoop->epollFd);
+	eventLoop->wakeupFd = eventLoop->epollFd = -1;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int addEventLoopHandler(EventLoop *eventLoop, EventLoopHandler *handler, uint32_t events)
+{
+	// Check arguments
+	if (eventLoop == NULL || handler == NULL || handler->callback == NULL)
+		return RETURN_VALUE_ERROR;
+
+	struct epoll_event event = {.events = events, .data.ptr = handler};
+
+	if (epoll_ctl(eventLoop->epollFd, EPOLL_CTL_ADD, handler->fd, &event) < 0)
+		return RETURN_VALUE_ERROR;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int modifyEventLoopHandler(EventLoop *eventLoop, EventLoopHandler *handler, uint32_t events)
+{
+	// Check arguments
+	if (eventLoop == NULL || handler == NULL)
+		return RETURN_VALUE_ERROR;
+
+	struct epoll_event event = {.events = events, .data.ptr = handler};
+
+	if (epoll_ctl(eventLoop->epollFd, EPOLL_CTL_MOD, handler->fd, &event) < 0)
+		return RETURN_VALUE_ERROR;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int removeEventLoopHandler(EventLoop *eventLoop, EventLoopHandler *handler)
+{
+	// Check arguments
+	if (eventLoop == NULL || handler == NULL)
+		return RETURN_VALUE_ERROR;
+
+	if (epoll_ctl(eventLoop->epollFd, EPOLL_CTL_DEL, handler->fd, NULL) < 0)
+		return RETURN_VALUE_ERROR;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int runEventLoop(EventLoop *eventLoop)
+{
+	struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+
+	// Check arguments
+	if (eventLoop == NULL)
+		return RETURN_VALUE_ERROR;
+
+	while (eventLoop->running)
+	{
+		int n = epoll_wait(eventLoop->epollFd, events, EVENT_LOOP_MAX_EVENTS, -1);
+
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			eventLoop->running = 0;
+			return RETURN_VALUE_ERROR;
+		}
+
+		// Dispatch ready handlers
+		for (int i = 0; i < n && eventLoop->running; i++)
+		{
+			EventLoopHandler *handler = events[i].data.ptr;
+			handler->callback(handler, events[i].events);
+		}
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+
+int stopEventLoop(EventLoop *eventLoop)
+{
+	uint64_t value = 1;
+
+	// Check arguments
+	if (eventLoop == NULL)
+		return RETURN_VALUE_ERROR;
+
+	eventLoop->running = 0;
+
+	if (write(eventLoop->wakeupFd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+		return RETURN_VALUE_ERROR;
+
+	return RETURN_VALUE_OK;
+}
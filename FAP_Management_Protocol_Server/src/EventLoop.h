@@ -0,0 +1,139 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <stdint.h>
+#include <sys/epoll.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Maximum number of ready events handled per epoll_wait() call
+#define EVENT_LOOP_MAX_EVENTS		64
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+struct _EventLoopHandler;
+
+/**
+ * Callback invoked by the event loop when a registered file descriptor is ready.
+ * Note: callbacks run on the event loop's thread and must not block. A callback
+ * may be invoked spuriously (e.g. for a slot reused within the same batch),
+ * so file descriptors should be non-blocking and tolerate EAGAIN.
+ *
+ * @param handler	Handler registered for the ready file descriptor.
+ * @param events	Ready events (EPOLLIN, EPOLLOUT, EPOLLHUP, ...).
+ */
+typedef void (*EventLoopCallback)(struct _EventLoopHandler *handler, uint32_t events);
+
+/**
+ * File descriptor registration. The memory is owned by the caller and must
+ * remain valid until the handler is removed from the event loop.
+ */
+typedef struct _EventLoopHandler
+{
+	int fd;										// Watched file descriptor
+	EventLoopCallback callback;					// Callback invoked when the fd is ready
+	void *context;								// User data
+} EventLoopHandler;
+
+/**
+ * Single-threaded epoll reactor.
+ */
+typedef struct _EventLoop
+{
+	int epollFd;								// epoll instance
+	int wakeupFd;								// eventfd used to interrupt epoll_wait()
+	volatile int running;						// Set on initialization, cleared by stopEventLoop()
+	EventLoopHandler wakeupHandler;				// Registration of wakeupFd
+} EventLoop;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize an event loop.
+ *
+ * @param eventLoop		Pointer to the EventLoop to be initialized.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeEventLoop(EventLoop *eventLoop);
+
+/**
+ * Terminate an event loop, closing its internal file descriptors.
+ * Registered file descriptors are not closed.
+ *
+ * @param eventLoop		Pointer to the EventLoop to be terminated.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int terminateEventLoop(EventLoop *eventLoop);
+
+/**
+ * Register a file descriptor in the event loop.
+ *
+ * @param eventLoop		Pointer to the EventLoop.
+ * @param handler		Pointer to the handler (fd, callback and context must be set).
+ * @param events		epoll events to watch (e.g. EPOLLIN).
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int addEventLoopHandler(EventLoop *eventLoop, EventLoopHandler *handler, uint32_t events);
+
+/**
+ * Change the events watched for an already registered file descriptor.
+ *
+ * @param eventLoop		Pointer to the EventLoop.
+ * @param handler		Pointer to the registered handler.
+ * @param events		New epoll events to watch.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int modifyEventLoopHandler(EventLoop *eventLoop, EventLoopHandler *handler, uint32_t events);
+
+/**
+ * Unregister a file descriptor from the event loop.
+ *
+ * @param eventLoop		Pointer to the EventLoop.
+ * @param handler		Pointer to the registered handler.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int removeEventLoopHandler(EventLoop *eventLoop, EventLoopHandler *handler);
+
+/**
+ * Run the event loop on the calling thread until stopEventLoop() is called.
+ *
+ * @param eventLoop		Pointer to the EventLoop.
+ * @return				Return RETURN_VALUE_OK if the loop was stopped;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int runEventLoop(EventLoop *eventLoop);
+
+/**
+ * Stop a running event loop. Safe to call from any thread.
+ *
+ * @param eventLoop		Pointer to the EventLoop.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int stopEventLoop(EventLoop *eventLoop);
@@ -0,0 +1,460 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "FapCoordinator.h"
+
+// C headers
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Jobs of the clustering threads
+#define JOB_SEED				0			// Distance to the newest seeded center
+#define JOB_ASSIGN				1			// Assign the users to their nearest center
+#define JOB_EXIT				2			// Stop the thread
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+static inline float squaredDistance(const FapCoordinator *coordinator, size_t i, int center)
+{
+	float dx = coordinator->x[i] - coordinator->centerX[center];
+	float dy = coordinator->y[i] - coordinator->centerY[center];
+
+	return dx * dx + dy * dy;
+}
+
+/**
+ * k-center seeding step: update each user's distance to its nearest center
+ * with the newest one, finding the user farthest from every center.
+ */
+static void seedRange(FapCoordinatorWorker *worker)
+{
+	FapCoordinator *coordinator = worker->coordinator;
+
+	worker->farthest = worker->first;
+	worker->farthestDistance = -1;
+
+	for (size_t i = worker->first; i < worker->last; i++)
+	{
+		float distance = squaredDistance(coordinator, i, coordinator->center);
+
+		if (distance < coordinator->nearest[i])
+			coordinator->nearest[i] = distance;
+		if (coordinator->nearest[i] > worker->farthestDistance)
+		{
+			worker->farthestDistance = coordinator->nearest[i];
+			worker->farthest = i;
+		}
+	}
+}
+
+/**
+ * k-means step: assign each user to its nearest center, summing the users
+ * of each cluster.
+ */
+static void assignRange(FapCoordinatorWorker *worker)
+{
+	FapCoordinator *coordinator = worker->coordinator;
+
+	memset(worker->sumX, 0, coordinator->nFaps * sizeof(double));
+	memset(worker->sumY, 0, coordinator->nFaps * sizeof(double));
+	memset(worker->count, 0, coordinator->nFaps * sizeof(size_t));
+	worker->changed = 0;
+	worker->farthest = worker->first;
+	worker->farthestDistance = -1;
+
+	for (size_t i = worker->first; i < worker->last; i++)
+	{
+		float best = squaredDistance(coordinator, i, 0);
+		int center = 0;
+
+		for (int c = 1; c < coordinator->nFaps; c++)
+		{
+			float distance = squaredDistance(coordinator, i, c);
+
+			if (distance < best)
+			{
+				best = distance;
+				center = c;
+			}
+		}
+
+		worker->changed += (coordinator->assignment[i] != center);
+		coordinator->assignment[i] = center;
+		worker->sumX[center] += coordinator->x[i];
+		worker->sumY[center] += coordinator->y[i];
+		worker->count[center]++;
+
+		if (best > worker->farthestDistance)
+		{
+			worker->farthestDistance = best;
+			worker->farthest = i;
+		}
+	}
+}
+
+static void runJob(FapCoordinatorWorker *worker, int job)
+{
+	if (job == JOB_SEED)
+		seedRange(worker);
+	else if (job == JOB_ASSIGN)
+		assignRange(worker);
+}
+
+static void *workerThread(void *arg)
+{
+	FapCoordinatorWorker *worker = arg;
+	FapCoordinator *coordinator = worker->coordinator;
+	unsigned generation = 0;
+	int job;
+
+	for (;;)
+	{
+		// Wait for a new job
+		pthread_mutex_lock(&coordinator->lock);
+		while (coordinator->generation == generation)
+			pthread_cond_wait(&coordinator->wake, &coordinator->lock);
+		generation = coordinator->generation;
+		job = coordinator->job;
+		pthread_mutex_unlock(&coordinator->lock);
+
+		if (job == JOB_EXIT)
+			return NULL;
+
+		runJob(worker, job);
+
+		pthread_mutex_lock(&coordinator->lock);
+		if (--coordinator->pending == 0)
+			pthread_cond_signal(&coordinator->idle);
+		pthread_mutex_unlock(&coordinator->lock);
+	}
+}
+
+/**
+ * Run a job over the users, split across the workers (the caller runs the
+ * first range), and wait for all of them.
+ */
+static void dispatchJob(FapCoordinator *coordinator, int job)
+{
+	for (int w = 0; w < coordinator->nThreads; w++)
+	{
+		coordinator->workers[w].first = coordinator->n * w / coordinator->nThreads;
+		coordinator->workers[w].last = coordinator->n * (w + 1) / coordinator->nThreads;
+	}
+
+	pthread_mutex_lock(&coordinator->lock);
+	coordinator->job = job;
+	coordinator->pending = coordinator->nThreads - 1;
+	coordinator->generation++;
+	pthread_cond_broadcast(&coordinator->wake);
+	pthread_mutex_unlock(&coordinator->lock);
+
+	if (job == JOB_EXIT)
+		return;
+
+	runJob(&coordinator->workers[0], job);
+
+	pthread_mutex_lock(&coordinator->lock);
+	while (coordinator->pending > 0)
+		pthread_cond_wait(&coordinator->idle, &coordinator->lock);
+	pthread_mutex_unlock(&coordinator->lock);
+}
+
+/**
+ * User farthest from its center (or from every center, while seeding),
+ * over the workers' results.
+ */
+static size_t farthestUser(const FapCoordinator *coordinator)
+{
+	const FapCoordinatorWorker *farthest = &coordinator->workers[0];
+
+	for (int w = 1; w < coordinator->nThreads; w++)
+	{
+		if (coordinator->workers[w].farthestDistance > farthest->farthestDistance)
+			farthest = &coordinator->workers[w];
+	}
+
+	return farthest->farthest;
+}
+
+/**
+ * k-center seeding (farthest-first traversal): each center is the user
+ * farthest from the previous ones.
+ */
+static void seedCenters(FapCoordinator *coordinator)
+{
+	size_t next = 0;
+
+	for (size_t i = 0; i < coordinator->n; i++)
+		coordinator->nearest[i] = INFINITY;
+
+	for (int c = 0; c < coordinator->nFaps; c++)
+	{
+		coordinator->centerX[c] = coordinator->x[next];
+		coordinator->centerY[c] = coordinator->y[next];
+		coordinator->center = c;
+		dispatchJob(coordinator, JOB_SEED);
+		next = farthestUser(coordinator);
+	}
+
+	coordinator->hasCenters = 1;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeFapCoordinator(FapCoordinator *coordinator, int nFaps, size_t capacity, int nThreads,
+							const GpsRawCoordinates *originRawCoordinates)
+{
+	int maxThreads;
+
+	// Check arguments
+	if (coordinator == NULL || nFaps <= 0 || capacity == 0 || nThreads < 0 || originRawCoordinates == NULL)
+		return RETURN_VALUE_ERROR;
+
+	// One thread per core by default
+	maxThreads = (nThreads > 0) ? nThreads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (maxThreads < 1)
+		maxThreads = 1;
+	if (maxThreads > FAP_COORDINATOR_MAX_THREADS)
+		maxThreads = FAP_COORDINATOR_MAX_THREADS;
+
+	memset(coordinator, 0, sizeof(*coordinator));
+	coordinator->nFaps = nFaps;
+	coordinator->nThreads = 1;
+	coordinator->capacity = capacity;
+	pthread_mutex_init(&coordinator->lock, NULL);
+	pthread_cond_init(&coordinator->wake, NULL);
+	pthread_cond_init(&coordinator->idle, NULL);
+
+	coordinator->faps = calloc(nFaps, sizeof(MavlinkEmulator));
+	coordinator->placements = calloc(nFaps, sizeof(FapPlacement));
+	coordinator->centerX = calloc(nFaps, sizeof(float));
+	coordinator->centerY = calloc(nFaps, sizeof(float));
+	coordinator->offsets = calloc(nFaps + 1, sizeof(size_t));
+	coordinator->assignment = malloc(capacity * sizeof(int));
+	coordinator->nearest = malloc(capacity * sizeof(float));
+	coordinator->groupX = malloc(capacity * sizeof(float));
+	coordinator->groupY = malloc(capacity * sizeof(float));
+	coordinator->groupZ = malloc(capacity * sizeof(float));
+	coordinator->workers = calloc(FAP_COORDINATOR_MAX_THREADS, sizeof(FapCoordinatorWorker));
+
+	if (coordinator->faps == NULL || coordinator->placements == NULL || coordinator->centerX == NULL
+			|| coordinator->centerY == NULL || coordinator->offsets == NULL || coordinator->assignment == NULL
+			|| coordinator->nearest == NULL || coordinator->groupX == NULL || coordinator->groupY == NULL
+			|| coordinator->groupZ == NULL || coordinator->workers == NULL)
+	{
+		terminateFapCoordinator(coordinator);
+		return RETURN_VALUE_ERROR;
+	}
+
+	// No user assigned yet
+	for (size_t i = 0; i < capacity; i++)
+		coordinator->assignment[i] = -1;
+
+	// A MAVLink emulator and a placement per FAP
+	for (int f = 0; f < nFaps; f++)
+	{
+		if (initializeFapPlacement(&coordinator->placements[f], capacity, FAP_PLACEMENT_HYSTERESIS_METERS, FAP_PLACEMENT_REBUILD_PERIOD_MS) != RETURN_VALUE_OK
+				|| initializeMavlinkEmulator(&coordinator->faps[f], f + 1, originRawCoordinates) != RETURN_VALUE_OK)
+		{
+			terminateFapCoordinator(coordinator);
+			return RETURN_VALUE_ERROR;
+		}
+	}
+
+	// Partial results of each worker
+	for (int w = 0; w < maxThreads; w++)
+	{
+		FapCoordinatorWorker *worker = &coordinator->workers[w];
+
+		worker->coordinator = coordinator;
+		worker->sumX = malloc(nFaps * sizeof(double));
+		worker->sumY = malloc(nFaps * sizeof(double));
+		worker->count = malloc(nFaps * sizeof(size_t));
+
+		if (worker->sumX == NULL || worker->sumY == NULL || worker->count == NULL)
+		{
+			terminateFapCoordinator(coordinator);
+			return RETURN_VALUE_ERROR;
+		}
+	}
+
+	// Worker 0 is the caller; a thread for each of the others
+	while (coordinator->nThreads < maxThreads)
+	{
+		FapCoordinatorWorker *worker = &coordinator->workers[coordinator->nThreads];
+
+		if (pthread_create(&worker->thread, NULL, workerThread, worker) != 0)
+		{
+			terminateFapCoordinator(coordinator);
+			return RETURN_VALUE_ERROR;
+		}
+		coordinator->nThreads++;
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+
+void terminateFapCoordinator(FapCoordinator *coordinator)
+{
+	// Stop the threads
+	if (coordinator->workers != NULL)
+	{
+		dispatchJob(coordinator, JOB_EXIT);
+		for (int w = 1; w < coordinator->nThreads; w++)
+			pthread_join(coordinator->workers[w].thread, NULL);
+
+		for (int w = 0; w < FAP_COORDINATOR_MAX_THREADS; w++)
+		{
+			free(coordinator->workers[w].sumX);
+			free(coordinator->workers[w].sumY);
+			free(coordinator->workers[w].count);
+		}
+	}
+
+	for (int f = 0; coordinator->faps != NULL && coordinator->placements != NULL && f < coordinator->nFaps; f++)
+	{
+		if (coordinator->faps[f].initialized)
+			terminateMavlinkEmulator(&coordinator->faps[f]);
+		terminateFapPlacement(&coordinator->placements[f]);
+	}
+
+	pthread_mutex_destroy(&coordinator->lock);
+	pthread_cond_destroy(&coordinator->wake);
+	pthread_cond_destroy(&coordinator->idle);
+
+	free(coordinator->faps);
+	free(coordinator->placements);
+	free(coordinator->centerX);
+	free(coordinator->centerY);
+	free(coordinator->offsets);
+	free(coordinator->assignment);
+	free(coordinator->nearest);
+	free(coordinator->groupX);
+	free(coordinator->groupY);
+	free(coordinator->groupZ);
+	free(coordinator->workers);
+	memset(coordinator, 0, sizeof(*coordinator));
+}
+
+
+int clusterUsers(FapCoordinator *coordinator, const float *x, const float *y, size_t n)
+{
+	int iteration;
+
+	// Check arguments
+	if (n == 0 || n > coordinator->capacity)
+		return RETURN_VALUE_ERROR;
+
+	coordinator->x = x;
+	coordinator->y = y;
+	coordinator->n = n;
+
+	// The first time, seed the clusters; then start from the previous ones
+	if (!coordinator->hasCenters)
+		seedCenters(coordinator);
+
+	for (iteration = 0; iteration < FAP_COORDINATOR_MAX_ITERATIONS; iteration++)
+	{
+		size_t changed = 0;
+		int reseeded = 0;
+
+		dispatchJob(coordinator, JOB_ASSIGN);
+		for (int w = 0; w < coordinator->nThreads; w++)
+			changed += coordinator->workers[w].changed;
+
+		// Converged: the centers already are their clusters' means
+		if (iteration > 0 && changed == 0)
+			break;
+
+		// Move each center to its cluster's mean (reduced in worker order)
+		for (int c = 0; c < coordinator->nFaps; c++)
+		{
+			double sumX = 0, sumY = 0;
+			size_t count = 0;
+
+			for (int w = 0; w < coordinator->nThreads; w++)
+			{
+				sumX += coordinator->workers[w].sumX[c];
+				sumY += coordinator->workers[w].sumY[c];
+				count += coordinator->workers[w].count[c];
+			}
+
+			if (count > 0)
+			{
+				coordinator->centerX[c] = sumX / count;
+				coordinator->centerY[c] = sumY / count;
+			}
+			else if (!reseeded && n >= (size_t) coordinator->nFaps)
+			{
+				// Empty cluster: take over the user farthest from its center
+				size_t farthest = farthestUser(coordinator);
+
+				coordinator->centerX[c] = x[farthest];
+				coordinator->centerY[c] = y[farthest];
+				reseeded = 1;
+			}
+		}
+	}
+
+	return iteration;
+}
+
+
+int updateFapCoordinator(FapCoordinator *coordinator, const float *x, const float *y, const float *z, size_t n)
+{
+	size_t *offsets = coordinator->offsets;
+	int moved = 0;
+
+	if (clusterUsers(coordinator, x, y, n) == RETURN_VALUE_ERROR)
+		return RETURN_VALUE_ERROR;
+
+	// Group the users by FAP (counting sort)
+	memset(offsets, 0, (coordinator->nFaps + 1) * sizeof(size_t));
+	for (size_t i = 0; i < n; i++)
+		offsets[coordinator->assignment[i] + 1]++;
+	for (int f = 0; f < coordinator->nFaps; f++)
+		offsets[f + 1] += offsets[f];
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t position = offsets[coordinator->assignment[i]]++;
+
+		coordinator->groupX[position] = x[i];
+		coordinator->groupY[position] = y[i];
+		coordinator->groupZ[position] = z[i];
+	}
+
+	// offsets[f] is now the end of FAP f's users: place each FAP over its users
+	for (int f = 0; f < coordinator->nFaps; f++)
+	{
+		size_t first = (f > 0) ? offsets[f - 1] : 0;
+
+		if (offsets[f] > first
+				&& updateFapPlacement(&coordinator->placements[f], coordinator->groupX + first, coordinator->groupY + first,
+									  coordinator->groupZ + first, offsets[f] - first)
+				&& sendMavlinkEmulatorMsg_setPositionTargetLocalNed(&coordinator->faps[f], &coordinator->placements[f].target) == RETURN_VALUE_OK)
+		{
+			moved++;
+		}
+	}
+
+	return moved;
+}
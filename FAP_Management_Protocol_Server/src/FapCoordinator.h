@@ -0,0 +1,154 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// Module headers
+#include "FapPlacement.h"
+#include "GpsCoordinates.h"
+#include "MavlinkEmulator.h"
+
+// C headers
+#include <pthread.h>
+#include <stddef.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK					0
+#define RETURN_VALUE_ERROR				(-1)
+
+// Maximum number of k-means iterations per clustering
+#define FAP_COORDINATOR_MAX_ITERATIONS	50
+
+// Maximum number of clustering threads
+#define FAP_COORDINATOR_MAX_THREADS		16
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+struct _FapCoordinator;
+
+/**
+ * Clustering thread: works on a range of the users, into its own partial
+ * results (reduced by the coordinator in thread order, so the clustering
+ * doesn't depend on the scheduling).
+ */
+typedef struct _FapCoordinatorWorker
+{
+	struct _FapCoordinator *coordinator;		// Coordinator of the worker
+	pthread_t thread;							// Thread (none for worker 0, the caller)
+	size_t first;								// First user of the range
+	size_t last;								// Last user of the range (exclusive)
+	double *sumX;								// Sum of the X of each cluster's users
+	double *sumY;								// Sum of the Y of each cluster's users
+	size_t *count;								// Number of users of each cluster
+	size_t changed;								// Users that changed cluster
+	size_t farthest;							// User farthest from its center
+	float farthestDistance;						// Squared distance of the farthest user
+} FapCoordinatorWorker;
+
+/**
+ * Coordinator of several FAPs: the users are clustered (k-center seeding,
+ * then k-means, both parallel over the users), one cluster per FAP, and
+ * each FAP is placed over its cluster (as FapPlacement) through its own
+ * MAVLink emulator instance.
+ *
+ * The clusters are seeded from the previous ones, so each FAP keeps
+ * following the same group of users.
+ *
+ * Library only: the FAP Management Protocol server drives a single FAP (see
+ * setFapAutoPlacement()), and doesn't run a coordinator. A deployment of
+ * several FAPs would feed updateFapCoordinator() with the users' positions
+ * of a SpatialIndex (its dense x, y, z and count).
+ */
+typedef struct _FapCoordinator
+{
+	int nFaps;									// Number of FAPs (clusters)
+	int nThreads;								// Number of clustering threads
+	size_t capacity;							// Maximum number of users
+	MavlinkEmulator *faps;						// MAVLink emulator of each FAP
+	FapPlacement *placements;					// Placement of each FAP
+	float *centerX;								// X of each cluster's center
+	float *centerY;								// Y of each cluster's center
+	int hasCenters;								// The centers were seeded
+	int *assignment;							// FAP of each user
+	float *nearest;								// Squared distance to the nearest center (seeding)
+	float *groupX;								// Users' X, grouped by FAP
+	float *groupY;								// Users' Y, grouped by FAP
+	float *groupZ;								// Users' Z, grouped by FAP
+	size_t *offsets;							// First user of each FAP in the groups
+	FapCoordinatorWorker *workers;				// Clustering threads
+	pthread_mutex_t lock;						// Protects the job's dispatch
+	pthread_cond_t wake;						// Signaled on a new job
+	pthread_cond_t idle;						// Signaled when the workers are done
+	unsigned generation;						// Number of jobs dispatched
+	int pending;								// Workers still running the job
+	int job;									// Job of the workers
+	int center;									// Center being seeded
+	const float *x;								// Users' X (of the current clustering)
+	const float *y;								// Users' Y (of the current clustering)
+	size_t n;									// Number of users (of the current clustering)
+} FapCoordinator;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize a FAP coordinator, with a MAVLink emulator per FAP and its
+ * clustering threads.
+ *
+ * @param coordinator			Pointer to the FapCoordinator to be initialized.
+ * @param nFaps					Number of FAPs.
+ * @param capacity				Maximum number of users.
+ * @param nThreads				Number of clustering threads (0 for one per core).
+ * @param originRawCoordinates	Pointer to the GPS RAW coordinates of the origin (0,0,0).
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeFapCoordinator(FapCoordinator *coordinator, int nFaps, size_t capacity, int nThreads,
+							const GpsRawCoordinates *originRawCoordinates);
+
+/**
+ * Terminate a FAP coordinator, stopping its threads and emulators.
+ *
+ * @param coordinator			Pointer to the FapCoordinator.
+ */
+void terminateFapCoordinator(FapCoordinator *coordinator);
+
+/**
+ * Cluster the users, one cluster per FAP (coordinator->assignment).
+ *
+ * @param coordinator			Pointer to the FapCoordinator.
+ * @param x						Users' X (NED, in meters).
+ * @param y						Users' Y (NED, in meters).
+ * @param n						Number of users (at most the coordinator's capacity).
+ * @return						Number of k-means iterations; or RETURN_VALUE_ERROR
+ *								on errors.
+ */
+int clusterUsers(FapCoordinator *coordinator, const float *x, const float *y, size_t n);
+
+/**
+ * Cluster the users and move each FAP whose optimal position (over its
+ * cluster) moved beyond the hysteresis.
+ *
+ * @param coordinator			Pointer to the FapCoordinator.
+ * @param x						Users' X (NED, in meters).
+ * @param y						Users' Y (NED, in meters).
+ * @param z						Users' Z (NED, in meters).
+ * @param n						Number of users (at most the coordinator's capacity).
+ * @return						Number of FAPs moved; or RETURN_VALUE_ERROR on errors.
+ */
+int updateFapCoordinator(FapCoordinator *coordinator, const float *x, const float *y, const float *z, size_t n);
@@ -13,17 +13,35 @@
 // Module headers
 #include "FapManagementProtocol_Server.h"
 #include "MavlinkEmulator.h"
+#include "MavlinkLink.h"
+#include "TelemetryCache.h"
+#include "PeriodicScheduler.h"
+#include "Logger.h"
+#include "EventLog.h"
 #include "GpsCoordinates.h"
+#include "EventLoop.h"
+#include "TimerWheel.h"
+#include "UserRegistry.h"
+#include "StreamFramer.h"
+#include "ProtocolBinary.h"
+#include "DatagramBatch.h"
+#include "ProtocolParser.h"
+#include "Arena.h"
+#include "PositionTable.h"
+#include "NedConverter.h"
+#include "SpatialIndex.h"
+#include "FapPlacement.h"
+#include "TrajectoryPredictor.h"
 
 
 // MAVLink library
 // [https://mavlink.io/en/getting_started/use_source.html]
-//#include "mavlink/common/mavlink.h"
+// (included by MavlinkLink)
 
 // JSON parser
 // [https://github.com/udp/json-parser and https://github.com/udp/json-builder]
 //#include "json/json-builder.h"
-#include "json/parson.h"
+// (messages are parsed and formatted by ProtocolParser)
 
 // C headers
 // (...)
@@ -37,6 +55,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <math.h>
+#include <stdint.h>
 // =========================================================
 //           DEFINES
 // =========================================================
@@ -49,15 +68,11 @@
 
 // ----- FAP MANAGEMENT PROTOCOL - MESSAGES ----- //
 
-// Protocol parameters
-#define PROTOCOL_PARAMETERS_USER_ID                     "userId"
-#define PROTOCOL_PARAMETERS_MSG_TYPE                    "msgType"
-#define PROTOCOL_PARAMETERS_GPS_COORDINATES             "gpsCoordinates"
-#define PROTOCOL_PARAMETERS_GPS_COORDINATES_LAT         "lat"
-#define PROTOCOL_PARAMETERS_GPS_COORDINATES_LON         "lon"
-#define PROTOCOL_PARAMETERS_GPS_COORDINATES_ALT         "alt"
-#define PROTOCOL_PARAMETERS_GPS_COORDINATES_TIMESTAMP   "timestamp"
-#define PROTOCOL_PARAMETERS_GPS_TIMESTAMP               "gpsTimestamp"
+// Protocol parameters: see ProtocolParser.h
+
+// Protocol "transport" values (for the GPS coordinates updates)
+#define PROTOCOL_TRANSPORT_TCP                          "tcp"
+#define PROTOCOL_TRANSPORT_UDP                          "udp"
 
 // Protocol "msgType" values
 typedef enum _ProtocolMsgType
@@ -77,6 +92,10 @@ typedef enum _ProtocolMsgType
 #define GPS_COORDINATES_UPDATE_PERIOD_SECONDS           10
 #define GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS          (2 * GPS_COORDINATES_UPDATE_PERIOD_SECONDS)
 
+// Bounds of the update period negotiated with each user, from its speed and distance to the coverage edge (in seconds)
+#define GPS_COORDINATES_UPDATE_PERIOD_MIN_SECONDS       2
+#define GPS_COORDINATES_UPDATE_PERIOD_MAX_SECONDS       30
+
 // Max allowed distance from the users to the FAP (in meters)
 #define MAX_ALLOWED_DISTANCE_FROM_FAP_METERS            300
 #define MAX_BUFFER                                      1024
@@ -86,28 +105,135 @@ typedef enum _ProtocolMsgType
 
 #define HEARTBEAT_INTERVAL_NS   500000000L
 
+// Longest log file path (see setFapLogFile() and setFapEventLogFile())
+#define LOG_FILE_PATH_SIZE      256
+
+// Periodic autopilot traffic: the emulator's position (as if streamed), the link's refresh (see refreshMavlinkLink())
+#define EMULATOR_TELEMETRY_INTERVAL_NS  (MAVLINK_LINK_POSITION_INTERVAL_US * 1000L)
+#define MAVLINK_LINK_REFRESH_INTERVAL_NS    1000000000L
+
 // ----- FAP MANAGEMENT PROTOCOL - SERVER ADDRESS ----- //
 #define SERVER_IP_ADDRESS       "127.0.0.1"
 #define SERVER_PORT_NUMBER      40123
 
+// Receive buffer of the GPS coordinates updates' UDP socket (in bytes)
+#define DATAGRAM_SOCKET_RCVBUF  (1 << 20)
+
+// Arena for the allocations of handling one message (in bytes)
+#define MESSAGE_ARENA_SIZE      (64 * 1024)
+
+// Speed of the FAP, to estimate when it gets over a user (in meters per second)
+#define FAP_CRUISE_SPEED_METERS_PER_SECOND  5
+
+// Period of the sweep for users left out of the FAP's coverage (in seconds)
+#define COVERAGE_SWEEP_PERIOD_SECONDS       5
+
 static GpsRawCoordinates fapOriginRawCoordinates = {0};
 
 
+// ----- FAP MANAGEMENT PROTOCOL - CONNECTIONS ----- //
+
+// Resolution of the connection timeouts (in milliseconds)
+#define CONNECTION_TIMEOUT_RESOLUTION_MS                1000
+
+// Time without any message before dropping a connection (in seconds)
+#define CONNECTION_IDLE_TIMEOUT_SECONDS                 (GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS * 3 / 2)
+
+// Connection states
+typedef enum _ConnectionState
+{
+    CONNECTION_STATE_FREE           = 0,
+    CONNECTION_STATE_CONNECTED      = 1,
+    CONNECTION_STATE_ASSOCIATED     = 2
+} ConnectionState;
+
+// Per-user connection, driven by the event loop
+typedef struct _client_connection
+{
+    EventLoopHandler handler;       // epoll registration (handler.fd is the socket)
+    ConnectionState  state;
+    int              user_id;
+    int              binary;        // Binary encoding negotiated for GPS coordinates updates
+    int              udp;           // UDP transport negotiated for GPS coordinates updates
+    struct in_addr   peer;          // Client's address (UDP updates must come from it)
+    int              update_period; // Negotiated GPS coordinates update period (in seconds)
+    TimerWheelTimer  timeout;       // Idle timeout, then GPS coordinates update timeout
+    StreamFramer     framer;        // Received bytes not yet handled
+    StreamOutput     outgoing;      // Sent bytes the socket couldn't take yet (flushed on EPOLLOUT)
+    char             output[MAX_BUFFER];    // Response being sent (formatted in place)
+} client_connection;
+
+// GPS coordinates updates of a batch of datagrams, converted together
+typedef struct _pending_updates
+{
+    int              count;
+    int              ids[DATAGRAM_BATCH_SIZE];          // Connection (user slot)
+    int              sources[DATAGRAM_BATCH_SIZE];      // Datagram (its address gets the ACK)
+    int              binary[DATAGRAM_BATCH_SIZE];       // Binary encoded update
+    int64_t          epoch_ns[DATAGRAM_BATCH_SIZE];
+    char             timestamps[DATAGRAM_BATCH_SIZE][TIMESTAMP_ISO8601_SIZE];   // Echoed by JSON ACKs
+    float            latitude[DATAGRAM_BATCH_SIZE];
+    float            longitude[DATAGRAM_BATCH_SIZE];
+    float            altitude[DATAGRAM_BATCH_SIZE];
+    float            x[DATAGRAM_BATCH_SIZE];
+    float            y[DATAGRAM_BATCH_SIZE];
+    float            z[DATAGRAM_BATCH_SIZE];
+} pending_updates;
+
+
 // ----- FAP MANAGEMENT PROTOCOL - GLOBAL VARIABLES ----- //
 
-GpsNedCoordinates clients[MAX_ASSOCIATED_USERS]; 
 int server_fd;
 struct sockaddr_in address;
-int alarm_flag = FALSE;
 int exit_flag = FALSE;
 int addrlen = sizeof(address);
-threads_clients threads[MAX_ASSOCIATED_USERS]; 
-pthread_mutex_t lock;
+UserRegistry users;
+int max_users = MAX_ASSOCIATED_USERS;
+int initialized = FALSE;
+EventLoop event_loop;
+EventLoopHandler server_handler;
+int datagram_fd = -1;
+EventLoopHandler datagram_handler;
+DatagramBatch datagram_requests;
+DatagramBatch datagram_responses;
+pending_updates datagram_updates;
+Arena message_arena;
+PositionTable positions;
+NedConverter ned_converter;
+SpatialIndex user_index;
+TimerWheelTimer coverage_sweep;
+int *out_of_coverage = NULL;
+int *in_coverage = NULL;
+TrajectoryPredictor trajectories;
+SpatialIndex predicted_index;
+FapPlacement fap_placement;
+int auto_placement = FALSE;
+TimerWheel timer_wheel;
 pthread_t t_main;
 int active_users = 0;
 
-pthread_t t_heartbeat;
-int alive = FALSE;
+// MAVLink link to a real autopilot (see setMavlinkLinkAddress()); the emulator is used otherwise
+MavlinkLink mavlink_link;
+char mavlink_link_address[INET_ADDRSTRLEN] = "";
+int mavlink_link_port = 0;
+int mavlink_link_enabled = FALSE;
+EventLoopHandler mavlink_link_handler;
+
+// Emulator's state, refreshed along with the heartbeats (as if streamed); writers take the lock, readers don't
+TelemetryCache emulator_telemetry;
+pthread_mutex_t emulator_telemetry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Log file (see setFapLogFile()); the standard output if empty
+char log_file[LOG_FILE_PATH_SIZE] = "";
+
+// Binary log of the protocol traffic, for replay (see setFapEventLogFile()); disabled if empty
+char event_log_file[LOG_FILE_PATH_SIZE] = "";
+EventLog event_log;
+int event_log_enabled = FALSE;
+
+// Heartbeats and the other periodic autopilot traffic, from a single thread
+PeriodicScheduler autopilot_scheduler;
+int heartbeat_task = RETURN_VALUE_ERROR;
 
 
 // =========================================================
@@ -119,282 +245,726 @@ double calculate_distance(GpsNedCoordinates x1, GpsNedCoordinates x2) {
 				pow((x1.z-x2.z), 2));
 }
 
-void *handler_alarm(void *id) {
-    int handler_id = *(int *) id;
-    time_t now, past_time;
-    struct tm now_t, past;
+client_connection *get_connection(int id) {
+    return (client_connection *) getUserSlot(&users, id);
+}
 
-    char *timestamp = NULL;
+void log_event(EventLogType type, int code, int id, int user_id, const void *payload, size_t length) {
+    if(event_log_enabled && appendEventLog(&event_log, type, code, id, user_id, payload, length) != RETURN_VALUE_OK)
+        FAP_SERVER_PRINT_ERROR("Error appending to event log %s.", event_log_file);
+}
 
-    while(threads[handler_id].alarm_flag == 0) {
-        if(exit_flag == 1)
-            break;
-        if(strcmp(clients[handler_id].timestamp, "") == 0)
-            continue;
-        
-        now = time(&now);
-        now_t = *gmtime(&now);
-        timestamp = clients[handler_id].timestamp;
-        strptime(timestamp, "%Y-%m-%dT%H:%M:%SZ", &past);
-        past.tm_isdst = now_t.tm_isdst;
-        past_time = mktime(&past);
-        if(difftime(now, past_time) > GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS) {
-            FAP_SERVER_PRINT_ERROR("Handler #%d: Too long without updating coordinates, exiting now.", handler_id);
-            threads[handler_id].alarm_flag = TRUE;
+// ----- AUTOPILOT (the MAVLink link if configured, the emulator otherwise) ----- //
+
+int refresh_emulator_telemetry() {
+    GpsNedCoordinates gpsNedCoordinates;
+    struct timespec now;
+
+    if(sendMavlinkMsg_localPositionNed(&gpsNedCoordinates) != RETURN_VALUE_OK)
+        return RETURN_VALUE_ERROR;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pthread_mutex_lock(&emulator_telemetry_lock);
+    publishLocalPositionNed(&emulator_telemetry, &gpsNedCoordinates, (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec);
+    pthread_mutex_unlock(&emulator_telemetry_lock);
+
+    return RETURN_VALUE_OK;
+}
+
+int autopilot_heartbeat() {
+    if(!mavlink_link_enabled)
+        return sendMavlinkMsg_heartbeat();
+
+    // Sent along with whatever else was queued since the last heartbeat
+    if(sendMavlinkLinkMsg_heartbeat(&mavlink_link) != RETURN_VALUE_OK)
+        return RETURN_VALUE_ERROR;
+    flushMavlinkLink(&mavlink_link);
+
+    return RETURN_VALUE_OK;
+}
+
+// A memory read: the autopilot's position is streamed into a telemetry cache
+int autopilot_local_position_ned(GpsNedCoordinates *gpsNedCoordinates) {
+    if(!mavlink_link_enabled)
+        return readLocalPositionNed(&emulator_telemetry, gpsNedCoordinates, NULL);
+
+    return sendMavlinkLinkMsg_localPositionNed(&mavlink_link, gpsNedCoordinates);
+}
+
+int autopilot_set_position_target(const GpsNedCoordinates *gpsNedCoordinates) {
+    float target[3] = {gpsNedCoordinates->x, gpsNedCoordinates->y, gpsNedCoordinates->z};
+
+    log_event(EVENT_LOG_MAVLINK_COMMAND, MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED, -1, -1, target, sizeof(target));
+
+    if(!mavlink_link_enabled) {
+        if(sendMavlinkMsg_setPositionTargetLocalNed(gpsNedCoordinates) != RETURN_VALUE_OK)
+            return RETURN_VALUE_ERROR;
+        return refresh_emulator_telemetry();
+    }
+
+    if(sendMavlinkLinkMsg_setPositionTargetLocalNed(&mavlink_link, gpsNedCoordinates) != RETURN_VALUE_OK)
+        return RETURN_VALUE_ERROR;
+    flushMavlinkLink(&mavlink_link);
+
+    return RETURN_VALUE_OK;
+}
+
+int count_users_in_coverage(const GpsNedCoordinates *position) {
+    return findUsersWithinRadius(&user_index, position->x, position->y, position->z,
+                                 MAX_ALLOWED_DISTANCE_FROM_FAP_METERS, in_coverage, max_users);
+}
+
+void refresh_fap_placement(int id) {
+    GpsNedCoordinates fapActualPosition = {0};
+
+    // The enclosing circle is only followed while the placement is enabled
+    if(!auto_placement) {
+        invalidateFapPlacement(&fap_placement);
+        return;
+    }
+
+    if(!refreshFapPlacement(&fap_placement, &predicted_index, id))
+        return;
+
+    // Not followed if it would leave more users out of coverage (at their last positions) than the FAP does now,
+    // as the coverage sweep would then drop them before they get there
+    autopilot_local_position_ned(&fapActualPosition);
+    if(count_users_in_coverage(&fap_placement.target) < count_users_in_coverage(&fapActualPosition)) {
+        FAP_SERVER_PRINT_DEBUG("Placement target covers fewer users than the FAP's position, not moving.");
+        return;
+    }
+
+    moveFapToGpsNedCoordinates(&fap_placement.target);
+}
+
+void arm_update_timeout(client_connection *connection) {
+    // Two of the user's negotiated periods, but never below GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS:
+    // a short period asks for faster updates, it doesn't drop users sooner on a late one
+    int period = connection->update_period > GPS_COORDINATES_UPDATE_PERIOD_SECONDS
+                 ? connection->update_period : GPS_COORDINATES_UPDATE_PERIOD_SECONDS;
+
+    armTimer(&timer_wheel, &connection->timeout, 2 * period * 1000);
+}
+
+void negotiate_update_period(int id, double distance) {
+    client_connection *connection = get_connection(id);
+    double margin = MAX_ALLOWED_DISTANCE_FROM_FAP_METERS - distance;
+    double period = GPS_COORDINATES_UPDATE_PERIOD_SECONDS;
+    float speed;
+
+    // The next update is due before the user could cover half of its way to the coverage edge
+    if(estimateSpeed(&trajectories, id, &speed) == RETURN_VALUE_OK)
+        period = (speed > 0) ? margin / (2 * speed) : GPS_COORDINATES_UPDATE_PERIOD_MAX_SECONDS;
+
+    if(period < GPS_COORDINATES_UPDATE_PERIOD_MIN_SECONDS)
+        period = GPS_COORDINATES_UPDATE_PERIOD_MIN_SECONDS;
+    if(period > GPS_COORDINATES_UPDATE_PERIOD_MAX_SECONDS)
+        period = GPS_COORDINATES_UPDATE_PERIOD_MAX_SECONDS;
+
+    connection->update_period = (int) period;
+}
+
+void close_connection(int id) {
+    client_connection *connection = get_connection(id);
+
+    if(connection->state == CONNECTION_STATE_FREE)
+        return;
+
+    cancelTimer(&timer_wheel, &connection->timeout);
+    removeEventLoopHandler(&event_loop, &connection->handler);
+    shutdown(connection->handler.fd, SHUT_RDWR);
+    close(connection->handler.fd);
+
+    connection->handler.fd = -1;
+    connection->state = CONNECTION_STATE_FREE;
+    clearPosition(&positions, id);
+    removeSpatialIndex(&user_index, id);
+    resetTrajectory(&trajectories, id);
+    removeSpatialIndex(&predicted_index, id);
+    refresh_fap_placement(id);
+    releaseUserSlot(&users, id, connection->user_id);
+
+    if(active_users > 0)
+        active_users--;
+
+    log_event(EVENT_LOG_CONNECTION_CLOSED, 0, id, connection->user_id, NULL, 0);
+    FAP_SERVER_PRINT("Connection #%d: Closed. Active Users: %d", id, active_users);
+}
+
+int send_message(int id, int length) {
+    client_connection *connection = get_connection(id);
+    int res = STREAM_OUTPUT_FAILED;
+
+    if(length >= 0)
+        res = sendStreamFrame(&connection->outgoing, connection->handler.fd, connection->output, length);
+
+    if(res == STREAM_OUTPUT_FAILED) {
+        FAP_SERVER_PRINT_ERROR("Handler #%d: Error sending message.", id);
+        return RETURN_VALUE_ERROR;
+    }
+
+    // A full socket buffer: the rest goes out once the socket is writable
+    if(res == STREAM_OUTPUT_PENDING
+            && modifyEventLoopHandler(&event_loop, &connection->handler, EPOLLIN | EPOLLRDHUP | EPOLLOUT) != RETURN_VALUE_OK)
+        return RETURN_VALUE_ERROR;
+
+    return RETURN_VALUE_OK;
+}
+
+void handle_gps_global_origin(const GpsRawCoordinates *origin) {
+    // A GPS_GLOBAL_ORIGIN from the autopilot: the origin frame is only rebuilt if the origin actually moved.
+    // Positions already published stay in the old frame until their users' next update.
+    copyGpsRawCoordinates(&fapOriginRawCoordinates, origin);
+    if(setNedConverterOrigin(&ned_converter, origin))
+        FAP_SERVER_PRINT("GPS global origin changed (frame #%u).", ned_converter.generation);
+}
+
+int update_user_position(int thread_id, const GpsNedCoordinates *fap_position, float x, float y, float z, int64_t epoch_ns) {
+    GpsNedCoordinates position = {0};
+
+    position.x = x;
+    position.y = y;
+    position.z = z;
+
+    if(calculate_distance(*fap_position, position)>MAX_ALLOWED_DISTANCE_FROM_FAP_METERS){
+        FAP_SERVER_PRINT_ERROR("Handler #%d: Distance longer than 300m.", thread_id);
+        return RETURN_VALUE_ERROR;
+    }
+
+    // Make the position visible to getAllUsersGpsNedCoordinates()
+    publishPosition(&positions, thread_id, get_connection(thread_id)->user_id, x, y, z, epoch_ns);
+    updateSpatialIndex(&user_index, thread_id, x, y, z);
+
+    // The coverage sweep only runs while there are users' positions
+    if(!coverage_sweep.armed)
+        armTimer(&timer_wheel, &coverage_sweep, COVERAGE_SWEEP_PERIOD_SECONDS * 1000);
+
+    return RETURN_VALUE_OK;
+}
+
+void predict_user_positions(const GpsNedCoordinates *fap_position, const int *ids, const float *x, const float *y, const float *z,
+                            const int64_t *epoch_ns, int n) {
+    GpsNedCoordinates position = {0};
+    float predicted_x, predicted_y, predicted_z;
+    double distance;
+    int64_t lead_ns;
+
+    updateTrajectories(&trajectories, ids, x, y, z, epoch_ns, n);
+
+    // The FAP is placed over where the users will be by the time it gets to them
+    for(int i = 0; i < n; i++) {
+        position.x = x[i];
+        position.y = y[i];
+        position.z = z[i];
+        distance = calculate_distance(*fap_position, position);
+        lead_ns = distance / FAP_CRUISE_SPEED_METERS_PER_SECOND * 1e9;
+
+        negotiate_update_period(ids[i], distance);
+
+        if(predictPosition(&trajectories, ids[i], epoch_ns[i] + lead_ns, &predicted_x, &predicted_y, &predicted_z) == RETURN_VALUE_OK) {
+            updateSpatialIndex(&predicted_index, ids[i], predicted_x, predicted_y, predicted_z);
+            refresh_fap_placement(ids[i]);
         }
     }
-    // shutdown(threads[handler_id].socket, SHUT_RDWR);
-    FAP_SERVER_PRINT("Exiting Alarm.");
-    clients[handler_id].x = clients[handler_id].y = clients[handler_id].z = 0;
-    memset(clients[handler_id].timestamp, '\0', TIMESTAMP_ISO8601_SIZE);
-    // strcpy(clients[handler_id].timestamp, "");
-    return NULL;
 }
 
-char *handle_gps_update(int thread_id, JSON_Value *root) {
-    char *string = NULL;
-    ProtocolMsgType response;
-    GpsRawCoordinates ClientRawCoordinates = {0};
+int convert_and_update_user_position(int thread_id, const GpsRawCoordinates *ClientRawCoordinates, int64_t epoch_ns) {
     GpsNedCoordinates fapActualPosition    = {0};
-    JSON_Object *object = json_value_get_object(root);
+    GpsNedCoordinates position;
 
-    // Handle Request
-    double latitude = json_object_dotget_number(
-        object, 
-        PROTOCOL_PARAMETERS_GPS_COORDINATES "." PROTOCOL_PARAMETERS_GPS_COORDINATES_LAT
-    );
-    double longitude = json_object_dotget_number(
-        object, 
-        PROTOCOL_PARAMETERS_GPS_COORDINATES "." PROTOCOL_PARAMETERS_GPS_COORDINATES_LON
-    );
-    double altitude = json_object_dotget_number(
-        object, 
-        PROTOCOL_PARAMETERS_GPS_COORDINATES "." PROTOCOL_PARAMETERS_GPS_COORDINATES_ALT
-    );
-    char *Time = json_object_dotget_string(
-        object, 
-        PROTOCOL_PARAMETERS_GPS_COORDINATES "." PROTOCOL_PARAMETERS_GPS_COORDINATES_TIMESTAMP
-    );
+    convertGpsRawCoordinates(&ned_converter, &position, ClientRawCoordinates);
 
-    initializeGpsRawCoordinates(
-        &ClientRawCoordinates, 
-        latitude, longitude, altitude, (time_t) NULL
-    );
-    strcpy(ClientRawCoordinates.timestamp, Time);
+    // Determine FAP's Actual Position
+    autopilot_local_position_ned(&fapActualPosition);
 
-    gpsRawCoordinates2gpsNedCoordinates(
-        &clients[thread_id], 
-        &ClientRawCoordinates, 
-        &fapOriginRawCoordinates
-    );
+    if(update_user_position(thread_id, &fapActualPosition, position.x, position.y, position.z, epoch_ns) != RETURN_VALUE_OK)
+        return RETURN_VALUE_ERROR;
 
-    // Determine FAP's Actual Position
-    sendMavlinkMsg_localPositionNed(&fapActualPosition);
-    if(calculate_distance(fapActualPosition, clients[thread_id])>MAX_ALLOWED_DISTANCE_FROM_FAP_METERS){
-        FAP_SERVER_PRINT_ERROR("Handler #%d: Distance longer than 300m.", thread_id);
-        return NULL;
+    predict_user_positions(&fapActualPosition, &thread_id, &position.x, &position.y, &position.z, &epoch_ns, 1);
+
+    return RETURN_VALUE_OK;
+}
+
+int64_t gps_update_epoch_ns(const char *timestamp) {
+    int64_t epoch_ns;
+
+    // Timestamps the server can't read are taken as the reception time
+    if(parseTimestampIso8601(timestamp, &epoch_ns) != RETURN_VALUE_OK) {
+        struct timespec now;
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        epoch_ns = (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec;
     }
 
-    // Create Response
-    response = GPS_COORDINATES_ACK; 
-    root = json_value_init_object();
-    object = json_value_get_object(root);
-    int id=threads[thread_id].user_id;
+    return epoch_ns;
+}
 
-    json_object_set_number(
-        object, 
-        PROTOCOL_PARAMETERS_USER_ID, 
-        id
-    ); 
-    json_object_set_number(object, PROTOCOL_PARAMETERS_MSG_TYPE, response);
-    strcpyTimestampIso8601(Time, time(NULL));
-    json_object_set_string(object, PROTOCOL_PARAMETERS_GPS_TIMESTAMP, Time);
+int handle_gps_update(int thread_id, const GpsRawCoordinates *ClientRawCoordinates) {
+    client_connection *connection = get_connection(thread_id);
 
-    string = json_serialize_to_string(root);
+    if(ClientRawCoordinates->timestamp[0] == '\0') {
+        FAP_SERVER_PRINT_ERROR("Handler #%d: Invalid timestamp.", thread_id);
+        return RETURN_VALUE_ERROR;
+    }
 
-    return string;
+    if(convert_and_update_user_position(thread_id, ClientRawCoordinates, gps_update_epoch_ns(ClientRawCoordinates->timestamp)) != RETURN_VALUE_OK)
+        return RETURN_VALUE_ERROR;
+
+    // Create Response (echoes the update's timestamp, with the period of the next updates)
+    return formatGpsCoordinatesAck(connection->output, sizeof(connection->output),
+                                   connection->user_id, GPS_COORDINATES_ACK, ClientRawCoordinates->timestamp,
+                                   connection->update_period);
 }
 
-char *handle_association(int id) {
-    char *string = NULL;
-    ProtocolMsgType response;
+int format_binary_gps_ack(int thread_id, int64_t timestamp) {
+    client_connection *connection = get_connection(thread_id);
+    ProtocolBinaryMsg ack = {0};
+
+    // Create Response (echoes the update's timestamp, with the period of the next updates)
+    ack.msgType = GPS_COORDINATES_ACK;
+    ack.userId = connection->user_id;
+    ack.updatePeriod = connection->update_period;
+    ack.timestamp = timestamp;
+
+    if(encodeProtocolBinaryMsg((unsigned char *) connection->output, &ack) != RETURN_VALUE_OK)
+        return RETURN_VALUE_ERROR;
+
+    return PROTOCOL_BINARY_MSG_SIZE;
+}
+
+int handle_binary_gps_update(int thread_id, const ProtocolBinaryMsg *request) {
+    GpsRawCoordinates ClientRawCoordinates = {0};
 
+    // The timestamp stays binary (no ISO8601 string)
+    ClientRawCoordinates.latitude = request->latitude;
+    ClientRawCoordinates.longitude = request->longitude;
+    ClientRawCoordinates.altitude = request->altitude;
 
-    pthread_mutex_lock(&lock);
-    if(active_users - 1 < MAX_ASSOCIATED_USERS) {
-        // active_users++;
-        response = USER_ASSOCIATION_ACCEPTED;
+    if(convert_and_update_user_position(thread_id, &ClientRawCoordinates, request->timestamp * 1000000000LL) != RETURN_VALUE_OK)
+        return RETURN_VALUE_ERROR;
+
+    return format_binary_gps_ack(thread_id, request->timestamp);
+}
+
+int handle_association(int id, ProtocolMsgType *response) {
+    client_connection *connection = get_connection(id);
+    int previous, accepted;
+
+    // The user limit is enforced when accepting connections. A user ID already associated is only
+    // taken over from the same address (the user re-associating, its old connection being stale);
+    // from another address, the request is rejected and the associated user is kept.
+    if((previous = findUserSlot(&users, connection->user_id)) >= 0 && previous != id
+            && get_connection(previous)->peer.s_addr == connection->peer.s_addr) {
+        FAP_SERVER_PRINT("Handler #%d: User ID %d re-associated, dropping handler #%d.", id, connection->user_id, previous);
+        log_event(EVENT_LOG_EVICTION, EVENT_LOG_EVICTION_REASSOCIATED, previous, connection->user_id, NULL, 0);
+        close_connection(previous);
+        previous = -1;
+    }
+
+    if(previous >= 0 && previous != id) {
+        FAP_SERVER_PRINT_ERROR("Handler #%d: User ID %d already associated by handler #%d.", id, connection->user_id, previous);
+        *response = USER_ASSOCIATION_REJECTED;
     } else
-        response = USER_ASSOCIATION_REJECTED;
-    pthread_mutex_unlock(&lock);
-    
-    JSON_Value *root_value;
-    JSON_Object *root_object;
-    root_value = json_value_init_object();
-    root_object = json_value_get_object(root_value);
- 
-    json_object_set_number(
-        root_object, 
-        PROTOCOL_PARAMETERS_USER_ID, 
-        id
-    ); 
-    json_object_set_number(
-        root_object, 
-        PROTOCOL_PARAMETERS_MSG_TYPE,
-        response
+        *response = USER_ASSOCIATION_ACCEPTED;
+
+    accepted = (*response == USER_ASSOCIATION_ACCEPTED);
+
+    // Until its speed is known, a new user updates at the default period
+    connection->update_period = GPS_COORDINATES_UPDATE_PERIOD_SECONDS;
+
+    return formatAssociationResponse(
+        connection->output, sizeof(connection->output),
+        connection->user_id, *response,
+        (accepted && connection->binary) ? PROTOCOL_ENCODING_BINARY : NULL,
+        (accepted && connection->udp) ? PROTOCOL_TRANSPORT_UDP : NULL,
+        accepted ? connection->update_period : 0
     );
-    string = json_serialize_to_string(root_value);
-    json_value_free(root_value);
+}
 
-    return string;
+int handle_desassociation(int id) {
+    client_connection *connection = get_connection(id);
+
+    return formatProtocolResponse(connection->output, sizeof(connection->output),
+                                  connection->user_id, USER_DESASSOCIATION_ACK);
 }
 
-char *handle_desassociation(int id) {
-    char *string = NULL;
-    ProtocolMsgType response;
+void handle_binary_message(int id, const char *buffer, size_t length) {
+    client_connection *connection = get_connection(id);
+    ProtocolBinaryMsg request;
 
-    response = USER_DESASSOCIATION_ACK;
+    if(!connection->binary || decodeProtocolBinaryMsg(&request, buffer, length) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Handler #%d: Unexpected binary message.", id);
+        close_connection(id);
+        return;
+    }
 
-    JSON_Value *root_value;
-    JSON_Object *root_object;
-    root_value = json_value_init_object();
-    root_object = json_value_get_object(root_value);
+    log_event(EVENT_LOG_PROTOCOL_MESSAGE, request.msgType, id, request.userId, buffer, length);
 
-    json_object_set_number(
-        root_object, 
-        PROTOCOL_PARAMETERS_USER_ID, 
-        id
-        ); 
-    json_object_set_number(root_object, PROTOCOL_PARAMETERS_MSG_TYPE, response);
+    if(request.msgType != GPS_COORDINATES_UPDATE || connection->state != CONNECTION_STATE_ASSOCIATED
+            || (int) request.userId != connection->user_id) {
+        FAP_SERVER_PRINT_ERROR("Handler #%d: Unexpected binary message type %d.", id, request.msgType);
+        close_connection(id);
+        return;
+    }
 
-    string = json_serialize_to_string(root_value);
-    json_value_free(root_value);
+    if(send_message(id, handle_binary_gps_update(id, &request)) != RETURN_VALUE_OK) {
+        close_connection(id);
+        return;
+    }
 
-    return string;
+    arm_update_timeout(connection);
+    FAP_SERVER_PRINT_DEBUG("Handler #%d: Gps Coordinates Updated [User ID - %d]", id, connection->user_id);
 }
 
-void *handler(void *thread_id) { 
-    int id = *((int *) thread_id);
-
-    FAP_SERVER_PRINT("Handler #%d: Starting", id);
+void handle_message(int id, const char *buffer, size_t length) {
+    client_connection *connection = get_connection(id);
     ProtocolMsgType response;
+    ProtocolMsg msg;
+    int keep_open = TRUE;
+
+    if(isProtocolBinaryMsg(buffer, length)) {
+        handle_binary_message(id, buffer, length);
+        return;
+    }
+
+    if(parseProtocolMsg(&msg, buffer, length) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Handler #%d: Invalid message.", id);
+        return;
+    }
 
-    // Set of socket descriptors
-    fd_set readfds;
-    int max_sd;
-    struct timeval timeout;
+    FAP_SERVER_PRINT_DEBUG("Handler #%d: New Message: %s", id, buffer);
+    log_event(EVENT_LOG_PROTOCOL_MESSAGE, msg.msgType, id, msg.userId, buffer, length);
 
-	int bad = 0;
-	int res = 0;
+    response = msg.msgType;
 
-    // JSON inicialization 
-    JSON_Value *root_value;
-    JSON_Object *root_object;
-    root_value = json_value_init_object();
+    if(response == USER_ASSOCIATION_REQUEST) {
+        unbindUserId(&users, connection->user_id, id);
+        connection->user_id = msg.userId;
 
-    // Waits for a response
-    pthread_t alarm;
+        connection->binary = (strcmp(msg.encoding, PROTOCOL_ENCODING_BINARY) == 0);
+        connection->udp = (strcmp(msg.transport, PROTOCOL_TRANSPORT_UDP) == 0 && datagram_fd >= 0);
+
+        int length = handle_association(id, &response);
+        FAP_SERVER_PRINT("Handler #%d: Active Users: %d", id, active_users);
+        if(send_message(id, length) != RETURN_VALUE_OK) {
+            keep_open = FALSE;
+        } else if(response == USER_ASSOCIATION_ACCEPTED && bindUserId(&users, connection->user_id, id) == RETURN_VALUE_OK) {
+            connection->state = CONNECTION_STATE_ASSOCIATED;
+            arm_update_timeout(connection);
+        } else {
+            keep_open = FALSE;
+        }
+    }
+    else if(response == GPS_COORDINATES_UPDATE) {
+        if(connection->state != CONNECTION_STATE_ASSOCIATED) {
+            FAP_SERVER_PRINT_ERROR("Handler #%d: GPS coordinates update before association.", id);
+            keep_open = FALSE;
+        } else if(send_message(id, handle_gps_update(id, &msg.gpsCoordinates)) != RETURN_VALUE_OK) {
+            keep_open = FALSE;
+        } else {
+            arm_update_timeout(connection);
+            FAP_SERVER_PRINT_DEBUG("Handler #%d: Gps Coordinates Updated [User ID - %d]", id, connection->user_id);
+        }
+    }
+    else if(response == USER_DESASSOCIATION_REQUEST) {
+        send_message(id, handle_desassociation(id));
+        keep_open = FALSE;
+    }
+
+    if(!keep_open)
+        close_connection(id);
+}
+
+void handler(EventLoopHandler *connection_handler, uint32_t events) { 
+    int id = (int) (intptr_t) connection_handler->context;
+    client_connection *connection = get_connection(id);
     char buffer[MAX_BUFFER]; 
-    char *serialized_string = NULL;
+    size_t length;
+    int res, frame;
 
-    if(pthread_create(&alarm, NULL, handler_alarm, (void *) &id) != 0) {
-		FAP_SERVER_PRINT_ERROR("Handler #%d: Error starting GPS Coordinates update handler thread", id);
-	}
+    if(connection->state == CONNECTION_STATE_FREE)
+        return;
 
-    while(threads[id].alarm_flag == 0) {
-
-		if(bad >= 1) {
-			// timed out
-			threads[id].alarm_flag = TRUE;
-			FAP_SERVER_PRINT("Handler #%d: Reached attempt limit. Ending connection.", id);
-			break;
-		}
-
-        memset(buffer, 0, strlen(buffer));
-        FD_ZERO(&readfds);
-        FD_SET(threads[id].socket, &readfds);
-        max_sd = threads[id].socket;
-        timeout.tv_sec = GPS_COORDINATES_UPDATE_TIMEOUT_SECONDS*1.5; 
-        timeout.tv_usec = 0;
-
-		res = select(max_sd + 1, &readfds, NULL, NULL, &timeout);
-		if(res == -1) {
-			threads[id].alarm_flag = TRUE;
-            FAP_SERVER_PRINT("Handler #%d: Error when using Select.", id);
-            break;
-		} else if(res == 0) {
-			bad++;
-			memset(buffer, 0, strlen(buffer));
-			FAP_SERVER_PRINT("Handler #%d: Timed-out. Trying again..", id);
-			continue;
-		} else if(FD_ISSET(threads[id].socket, &readfds)) {
-			// socket has data
-			if((res = recv(threads[id].socket, buffer, MAX_BUFFER, 0)) <= 0) {
-				threads[id].alarm_flag = TRUE;
-				FAP_SERVER_PRINT("Handler #%d: Ending Connection.", id);
-				break;
-			}
-		}
-
-        root_value = json_parse_string(buffer);
-        FAP_SERVER_PRINT("Handler #%d: New Message: \n%s\n", id, json_serialize_to_string_pretty(root_value));
-        root_object = json_value_get_object(root_value);
-        response = json_object_get_number(root_object, "msgType");
-
-        if(response == USER_ASSOCIATION_REQUEST) {
-            threads[id].user_id = json_object_get_number(root_object, PROTOCOL_PARAMETERS_USER_ID);
-            serialized_string = handle_association(threads[id].user_id);
-            FAP_SERVER_PRINT("Handler #%d: Active Users: %d", id, active_users);
-            send(threads[id].socket, serialized_string, strlen(serialized_string), 0);
+    // Writable again: send the queued responses, and stop watching once they're gone
+    if(events & EPOLLOUT) {
+        res = flushStreamOutput(&connection->outgoing, connection_handler->fd);
+
+        if(res == STREAM_OUTPUT_FAILED) {
+            FAP_SERVER_PRINT_ERROR("Handler #%d: Error sending message.", id);
+            close_connection(id);
+            return;
         }
-        else if(response == GPS_COORDINATES_UPDATE) {    
-            serialized_string = handle_gps_update(id, root_value);
-            if(serialized_string == NULL){
-                threads[id].alarm_flag = TRUE;
-                break;
-            }
-            FAP_SERVER_PRINT("Handler #%d: Gps Coordinates Updated [User ID - %d]", id, threads[id].user_id);
-            send(threads[id].socket, serialized_string, strlen(serialized_string),0);
+        if(res == STREAM_OUTPUT_SENT)
+            modifyEventLoopHandler(&event_loop, connection_handler, EPOLLIN | EPOLLRDHUP);
+    }
+
+    res = fillStreamFramer(&connection->framer, connection_handler->fd);
+
+    // Handle every complete message received so far
+    while((frame = nextStreamFrame(&connection->framer, buffer, MAX_BUFFER, &length)) == STREAM_FRAME_READY) {
+        handle_message(id, buffer, length);
+        resetArena(&message_arena);
+        if(connection->state == CONNECTION_STATE_FREE)
+            return;
+    }
+
+    if(frame == STREAM_FRAME_INVALID) {
+        FAP_SERVER_PRINT_ERROR("Handler #%d: Invalid message frame.", id);
+        close_connection(id);
+    } else if(res != STREAM_FRAMER_FILLED) {
+        FAP_SERVER_PRINT("Handler #%d: Ending Connection.", id);
+        close_connection(id);
+    }
+}
+
+void stage_datagram(const char *buffer, size_t length, int source) {
+    client_connection *connection;
+    ProtocolBinaryMsg request;
+    ProtocolMsg msg;
+    const GpsRawCoordinates *coordinates;
+    int binary, user_id, id, n = datagram_updates.count;
+
+    // Identify the user (binary or JSON GPS coordinates update)
+    if((binary = isProtocolBinaryMsg(buffer, length))) {
+        if(decodeProtocolBinaryMsg(&request, buffer, length) != RETURN_VALUE_OK || request.msgType != GPS_COORDINATES_UPDATE) {
+            FAP_SERVER_PRINT_ERROR("Unexpected datagram.");
+            return;
         }
-        else if((response == USER_DESASSOCIATION_REQUEST) && (active_users > 0)) {
-            serialized_string = handle_desassociation(threads[id].user_id);
-            send(threads[id].socket, serialized_string, strlen(serialized_string), 0);
-            threads[id].alarm_flag = TRUE;
-            break;
+        user_id = request.userId;
+    } else {
+        if(parseProtocolMsg(&msg, buffer, length) != RETURN_VALUE_OK || msg.msgType != GPS_COORDINATES_UPDATE) {
+            FAP_SERVER_PRINT_ERROR("Unexpected datagram.");
+            return;
         }
+        user_id = msg.userId;
     }
 
-    pthread_join(alarm, NULL);
-    threads[id].alarm_flag = FALSE;
-    threads[id].user_id = 0;
+    // Only users associated over TCP, with the UDP transport, from the same address
+    if((id = findUserSlot(&users, user_id)) < 0
+            || (connection = get_connection(id))->state != CONNECTION_STATE_ASSOCIATED
+            || !connection->udp || connection->peer.s_addr != datagram_requests.addresses[source].sin_addr.s_addr) {
+        FAP_SERVER_PRINT_ERROR("Datagram from unknown user ID %d.", user_id);
+        return;
+    }
 
-    shutdown(threads[id].socket, SHUT_RDWR);
-    close(threads[id].socket);
+    log_event(EVENT_LOG_PROTOCOL_MESSAGE, GPS_COORDINATES_UPDATE, id, user_id, buffer, length);
+
+    datagram_updates.ids[n] = id;
+    datagram_updates.sources[n] = source;
+
+    if((datagram_updates.binary[n] = binary)) {
+        datagram_updates.latitude[n] = request.latitude;
+        datagram_updates.longitude[n] = request.longitude;
+        datagram_updates.altitude[n] = request.altitude;
+        datagram_updates.epoch_ns[n] = request.timestamp * 1000000000LL;
+        datagram_updates.timestamps[n][0] = '\0';
+    } else {
+        coordinates = &msg.gpsCoordinates;
+        // Only this datagram is dropped: the TCP session stays (UDP datagrams are easily spoofed)
+        if(coordinates->timestamp[0] == '\0') {
+            FAP_SERVER_PRINT_ERROR("Handler #%d: Datagram with an invalid timestamp.", id);
+            return;
+        }
 
-    threads[id].status = 0;
+        datagram_updates.latitude[n] = coordinates->latitude;
+        datagram_updates.longitude[n] = coordinates->longitude;
+        datagram_updates.altitude[n] = coordinates->altitude;
+        datagram_updates.epoch_ns[n] = gps_update_epoch_ns(coordinates->timestamp);
+        strcpy(datagram_updates.timestamps[n], coordinates->timestamp);
+    }
 
-    pthread_mutex_lock(&lock);
-    if(active_users > 0){
-        active_users--;
+    datagram_updates.count++;
+}
+
+void handle_datagram_updates() {
+    pending_updates *updates = &datagram_updates;
+    GpsNedCoordinates fapActualPosition = {0};
+    client_connection *connection;
+    int accepted[DATAGRAM_BATCH_SIZE] = {0};
+    int ids[DATAGRAM_BATCH_SIZE];
+    float x[DATAGRAM_BATCH_SIZE], y[DATAGRAM_BATCH_SIZE], z[DATAGRAM_BATCH_SIZE];
+    int64_t epoch_ns[DATAGRAM_BATCH_SIZE];
+    int id, ack_length, n = 0;
+
+    if(updates->count == 0)
+        return;
+
+    // Convert the whole batch at once, against the FAP's position when it was received
+    convertGpsRawCoordinatesBatch(&ned_converter, updates->latitude, updates->longitude, updates->altitude,
+                                  updates->x, updates->y, updates->z, updates->count);
+    autopilot_local_position_ned(&fapActualPosition);
+
+    for(int i = 0; i < updates->count; i++) {
+        id = updates->ids[i];
+        connection = get_connection(id);
+
+        // Closed by an earlier update of the batch
+        if(connection->state != CONNECTION_STATE_ASSOCIATED)
+            continue;
+
+        if(update_user_position(id, &fapActualPosition, updates->x[i], updates->y[i], updates->z[i], updates->epoch_ns[i]) != RETURN_VALUE_OK) {
+            close_connection(id);
+            continue;
+        }
+        accepted[i] = TRUE;
     }
-    pthread_mutex_unlock(&lock);
 
-    FAP_SERVER_PRINT("Handler #%d: Active Users: %d", id, active_users);
+    // Feed the users' filters the whole batch at once (packed, without the users closed meanwhile)
+    for(int i = 0; i < updates->count; i++) {
+        if(!accepted[i] || get_connection(updates->ids[i])->state != CONNECTION_STATE_ASSOCIATED)
+            continue;
 
-    json_free_serialized_string(serialized_string);
-    json_value_free(root_value);
+        ids[n] = updates->ids[i];
+        x[n] = updates->x[i];
+        y[n] = updates->y[i];
+        z[n] = updates->z[i];
+        epoch_ns[n] = updates->epoch_ns[i];
+        n++;
+    }
+    predict_user_positions(&fapActualPosition, ids, x, y, z, epoch_ns, n);
 
-    FAP_SERVER_PRINT("Handler #%d: Closing.", id);
+    // ACK the updates, with the period negotiated from the filters
+    for(int i = 0; i < updates->count; i++) {
+        id = updates->ids[i];
+        connection = get_connection(id);
 
-    return (void *) RETURN_VALUE_OK;
+        if(!accepted[i] || connection->state != CONNECTION_STATE_ASSOCIATED)
+            continue;
+
+        if(updates->binary[i])
+            ack_length = format_binary_gps_ack(id, updates->epoch_ns[i] / 1000000000LL);
+        else
+            ack_length = formatGpsCoordinatesAck(connection->output, sizeof(connection->output),
+                                                 connection->user_id, GPS_COORDINATES_ACK, updates->timestamps[i],
+                                                 connection->update_period);
+
+        if(ack_length < 0) {
+            close_connection(id);
+            continue;
+        }
+
+        queueDatagram(&datagram_responses, &datagram_requests.addresses[updates->sources[i]], connection->output, ack_length);
+
+        arm_update_timeout(connection);
+        FAP_SERVER_PRINT_DEBUG("Handler #%d: Gps Coordinates Updated over UDP [User ID - %d]", id, connection->user_id);
+    }
+
+    updates->count = 0;
+}
+
+void datagram_handler_callback(EventLoopHandler *listener_handler, uint32_t events) {
+    int n;
+
+    // One recvmmsg() per batch of updates, one conversion and one sendmmsg() per batch of ACKs
+    do {
+        if((n = receiveDatagramBatch(&datagram_requests, listener_handler->fd)) < 0) {
+            FAP_SERVER_PRINT_ERROR("Error receiving datagrams.");
+            return;
+        }
+
+        for(int i = 0; i < n; i++) {
+            if(datagram_requests.lengths[i] > 0) {
+                stage_datagram(datagram_requests.payloads[i], datagram_requests.lengths[i], i);
+                resetArena(&message_arena);
+            }
+        }
+
+        handle_datagram_updates();
+        flushDatagramBatch(&datagram_responses, listener_handler->fd);
+    } while(n == DATAGRAM_BATCH_SIZE);
+}
+
+void mavlink_link_callback(EventLoopHandler *link_handler, uint32_t events) {
+    // Telemetry from the autopilot (a GPS_GLOBAL_ORIGIN calls handle_gps_global_origin() from here)
+    if(receiveMavlinkLink(&mavlink_link) < 0)
+        FAP_SERVER_PRINT_ERROR("Error receiving MAVLink frames.");
+}
+
+void handler_alarm(TimerWheelTimer *timer) {
+    int id = (int) (intptr_t) timer->context;
+
+    if(get_connection(id)->state == CONNECTION_STATE_ASSOCIATED) {
+        FAP_SERVER_PRINT_ERROR("Handler #%d: Too long without updating coordinates, exiting now.", id);
+    } else {
+        FAP_SERVER_PRINT("Handler #%d: Timed-out. Ending connection.", id);
+    }
+
+    log_event(EVENT_LOG_EVICTION, EVENT_LOG_EVICTION_TIMEOUT, id, get_connection(id)->user_id, NULL, 0);
+
+    close_connection(id);
 }
 
-void *wait_connection() {
+void coverage_sweep_alarm(TimerWheelTimer *timer) {
+    GpsNedCoordinates fapActualPosition = {0};
+    int n;
+
+    // Users left out of coverage since their last update (the FAP moved away from them) are dropped,
+    // as an update from where they are would be, instead of at their next update
+    autopilot_local_position_ned(&fapActualPosition);
+    n = findUsersOutsideRadius(&user_index, fapActualPosition.x, fapActualPosition.y, fapActualPosition.z,
+                               MAX_ALLOWED_DISTANCE_FROM_FAP_METERS, out_of_coverage, max_users);
+
+    for(int i = 0; i < n; i++) {
+        FAP_SERVER_PRINT_ERROR("Handler #%d: Out of the FAP's coverage, exiting now.", out_of_coverage[i]);
+        log_event(EVENT_LOG_EVICTION, EVENT_LOG_EVICTION_OUT_OF_COVERAGE, out_of_coverage[i], get_connection(out_of_coverage[i])->user_id, NULL, 0);
+        close_connection(out_of_coverage[i]);
+    }
+
+    if(user_index.count > 0)
+        armTimer(&timer_wheel, timer, COVERAGE_SWEEP_PERIOD_SECONDS * 1000);
+}
+
+void wait_connection(EventLoopHandler *listener_handler, uint32_t events) {
+    struct sockaddr_in peer;
+    socklen_t peer_length = sizeof(peer);
+    int new;
+
+    while((new = accept4(server_fd, (struct sockaddr *) &peer, &peer_length,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        int i = allocateUserSlot(&users);
+
+        if(i < 0) {
+            shutdown(new, SHUT_RDWR);
+            close(new);
+            FAP_SERVER_PRINT_ERROR("Reached user limit. Dropping incoming connection.");
+            continue;
+        }
+
+        client_connection *connection = get_connection(i);
+        connection->handler.fd = new;
+        connection->handler.callback = handler;
+        connection->handler.context = (void *) (intptr_t) i;
+        connection->user_id = 0;
+        connection->peer = peer.sin_addr;
+        initializeStreamFramer(&connection->framer);
+        initializeStreamOutput(&connection->outgoing);
+        initializeTimer(&connection->timeout, handler_alarm, (void *) (intptr_t) i);
+
+        if(addEventLoopHandler(&event_loop, &connection->handler, EPOLLIN | EPOLLRDHUP) != RETURN_VALUE_OK) {
+            FAP_SERVER_PRINT_ERROR("Error registering connection #%d.", i);
+            releaseUserSlot(&users, i, 0);
+            close(new);
+            continue;
+        }
+
+        connection->state = CONNECTION_STATE_CONNECTED;
+        armTimer(&timer_wheel, &connection->timeout, CONNECTION_IDLE_TIMEOUT_SECONDS * 1000);
+        active_users++;
+
+        FAP_SERVER_PRINT("Connection #%d: Accepted. Active Users: %d", i, active_users);
+        peer_length = sizeof(peer);
+    }
+
+    if(errno != EAGAIN && errno != EWOULDBLOCK && exit_flag == FALSE)
+        FAP_SERVER_PRINT_ERROR("Error accepting connection.");
+}
+
+int open_server_socket() {
     int opt = 1;
 
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    if ((server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
         FAP_SERVER_PRINT_ERROR("socket failed.");
-        return (void *) RETURN_VALUE_ERROR;
+        return RETURN_VALUE_ERROR;
     }
 
     if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt)) < 0)
@@ -411,98 +981,77 @@ void *wait_connection() {
 
     if (bind(server_fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
         FAP_SERVER_PRINT_ERROR("bind.");
-        return (void *) RETURN_VALUE_ERROR;
+        close(server_fd);
+        return RETURN_VALUE_ERROR;
     }
 
     if (listen(server_fd, SO_MAX_CONN) < 0) {
         FAP_SERVER_PRINT_ERROR("listen.");
-        return (void *) RETURN_VALUE_ERROR;
+        close(server_fd);
+        return RETURN_VALUE_ERROR;
     }
 
-    while(exit_flag == FALSE) {
-		int new = accept(server_fd, (struct sockaddr *) &address, (socklen_t *) &addrlen);
-        if((new < 0) && exit_flag == FALSE) {
-            FAP_SERVER_PRINT_ERROR("Error accepting connection.");
-            return (void *) RETURN_VALUE_ERROR;
-        }
+    return RETURN_VALUE_OK;
+}
 
-		if(exit_flag == TRUE) {
-			break;
-		}
+int open_datagram_socket() {
+    int size = DATAGRAM_SOCKET_RCVBUF;
 
-        pthread_mutex_lock(&lock);
+    if ((datagram_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+        FAP_SERVER_PRINT_ERROR("datagram socket failed.");
+        return RETURN_VALUE_ERROR;
+    }
 
-        int free = FALSE;
-        int i;
-        for(i = 0; i < MAX_ASSOCIATED_USERS; i++) {
-            if(!threads[i].status) {
-                free = TRUE;
-                break;
-            }
-        }
+    // Absorb bursts of updates between two event loop iterations
+    if (setsockopt(datagram_fd, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size)) < 0)
+        perror("setsockopt(SO_RCVBUF) failed");
 
-        if(!free) {
-            shutdown(new, SHUT_RDWR);
-            close(new);
-            FAP_SERVER_PRINT_ERROR("Reached user limit. Dropping incoming connection.");
-            pthread_mutex_unlock(&lock);
-            continue;
-        }
+    // Same address and port as the TCP server socket
+    if (bind(datagram_fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
+        FAP_SERVER_PRINT_ERROR("datagram bind.");
+        close(datagram_fd);
+        datagram_fd = -1;
+        return RETURN_VALUE_ERROR;
+    }
 
-        threads[i].status = 1;
-        active_users++;
+    return RETURN_VALUE_OK;
+}
 
-        pthread_mutex_unlock(&lock);
+void *server_loop() {
+    int res;
 
-        int *value = malloc(sizeof(*value));
-        *value = i;
+    // JSON parser allocations (if any) come from the message arena, reset after each message
+    setJsonArena(&message_arena);
+    res = runEventLoop(&event_loop);
+    setJsonArena(NULL);
 
-        threads[i].socket = new;
-        if(pthread_create(&threads[i].tid, NULL, handler, (void *) value) != 0) {
-            FAP_SERVER_PRINT_ERROR("Error starting handler thread #%d.", i);
-            return (void *) RETURN_VALUE_ERROR;
-        }
+    if(res != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Event loop failed.");
+        return (void *) RETURN_VALUE_ERROR;
     }
 
     return (void *) RETURN_VALUE_OK;
 }
 
-void *send_heartbeat() {
-
-    struct timespec start, stop, remaining;
-
-    while(alive) {
-        if(clock_gettime(CLOCK_MONOTONIC, &start) < 0) {
-           FAP_SERVER_PRINT("Error clocking heartbeat.");
-            alive = FALSE;
-            return (void *) RETURN_VALUE_ERROR;
-        }
-
-        // send Mavlink message - HEARTBEAT
-        if(sendMavlinkMsg_heartbeat() != RETURN_VALUE_OK) {
-            FAP_SERVER_PRINT("Error sending Heartbeat message.");
-            alive = FALSE;
-            return (void *) RETURN_VALUE_ERROR;
-        }
+int heartbeat_task_callback(void *context) {
+    // send Mavlink message - HEARTBEAT
+    if(autopilot_heartbeat() != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT("Error sending Heartbeat message.");
+        return RETURN_VALUE_ERROR;
+    }
 
-        if(clock_gettime(CLOCK_MONOTONIC, &stop) < 0) {
-            FAP_SERVER_PRINT("Error clocking heartbeat.");
-            alive = FALSE;
-            return (void *) RETURN_VALUE_ERROR;
-        }
+    return RETURN_VALUE_OK;
+}
 
-        if(stop.tv_nsec < start.tv_nsec)
-            remaining.tv_nsec = HEARTBEAT_INTERVAL_NS - (1000000000L - start.tv_nsec + stop.tv_nsec);
-        else
-            remaining.tv_nsec = HEARTBEAT_INTERVAL_NS - (stop.tv_nsec - start.tv_nsec);
-        remaining.tv_sec = stop.tv_sec - start.tv_sec;
+int telemetry_task_callback(void *context) {
+    if(!mavlink_link_enabled)
+        return refresh_emulator_telemetry();
 
-        if(remaining.tv_sec < 0 || remaining.tv_nsec < 0)
-            continue;
-        nanosleep(&remaining, NULL);
-    }
+    if(refreshMavlinkLink(&mavlink_link) != RETURN_VALUE_OK)
+        return RETURN_VALUE_ERROR;
+    flushMavlinkLink(&mavlink_link);
 
-    return (void *) RETURN_VALUE_OK;
+    return RETURN_VALUE_OK;
 }
 
 // =========================================================
@@ -511,29 +1060,131 @@ void *send_heartbeat() {
 
 int initializeFapManagementProtocol()
 {
-    memset(clients, 0, sizeof(clients));
-    memset(&threads, 0 , MAX_ASSOCIATED_USERS * sizeof(threads_clients)); 
+    active_users = 0;
 	exit_flag = FALSE;
 
+    // Server messages are written by the logger's thread from here on
+    terminateLogger();
+    if(initializeLogger(log_file[0] != '\0' ? log_file : NULL, LOGGER_DEFAULT_CAPACITY) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Error opening log file %s.", log_file);
+        return RETURN_VALUE_ERROR;
+    }
+
+    if(event_log_file[0] != '\0') {
+        if(openEventLog(&event_log, event_log_file) != RETURN_VALUE_OK) {
+            FAP_SERVER_PRINT_ERROR("Error opening event log %s.", event_log_file);
+            return RETURN_VALUE_ERROR;
+        }
+        event_log_enabled = TRUE;
+    }
+
     if(initializeMavlink() != RETURN_VALUE_OK 
-            || sendMavlinkMsg_gpsGlobalOrigin(&fapOriginRawCoordinates) != RETURN_VALUE_OK)
+            || sendMavlinkMsg_gpsGlobalOrigin(&fapOriginRawCoordinates) != RETURN_VALUE_OK
+            || initializeNedConverter(&ned_converter, &fapOriginRawCoordinates) != RETURN_VALUE_OK)
         return RETURN_VALUE_ERROR;
 
-    if (pthread_mutex_init(&lock, NULL) != 0) {
-        FAP_SERVER_PRINT_ERROR("Error starting lock.");
+    initializeTelemetryCache(&emulator_telemetry);
+    if(refresh_emulator_telemetry() != RETURN_VALUE_OK)
         return RETURN_VALUE_ERROR;
 
+    datagram_updates.count = 0;
+
+    if(initializeUserRegistry(&users, sizeof(client_connection), max_users) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Error starting user registry.");
+        return RETURN_VALUE_ERROR;
     }
 
-    if(pthread_create(&t_main, NULL, wait_connection, (void *) &server_fd) != 0){
-        FAP_SERVER_PRINT_ERROR("Error starting main thread.");
+    if(initializePositionTable(&positions, max_users) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Error starting position table.");
         return RETURN_VALUE_ERROR;
     }
 
-    // Start heartbeat
-    alive = TRUE;
+    if(initializeSpatialIndex(&user_index, max_users, SPATIAL_INDEX_CELL_SIZE) != RETURN_VALUE_OK
+            || (out_of_coverage = malloc(max_users * sizeof(int))) == NULL
+            || (in_coverage = malloc(max_users * sizeof(int))) == NULL
+            || initializeTrajectoryPredictor(&trajectories, max_users, TRAJECTORY_ACCELERATION_NOISE, TRAJECTORY_MEASUREMENT_NOISE) != RETURN_VALUE_OK
+            || initializeSpatialIndex(&predicted_index, max_users, SPATIAL_INDEX_CELL_SIZE) != RETURN_VALUE_OK
+            || initializeFapPlacement(&fap_placement, max_users, FAP_PLACEMENT_HYSTERESIS_METERS, FAP_PLACEMENT_REBUILD_PERIOD_MS) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Error starting spatial index, trajectory predictor and FAP placement.");
+        return RETURN_VALUE_ERROR;
+    }
+
+    if(initializeEventLoop(&event_loop) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Error starting event loop.");
+        return RETURN_VALUE_ERROR;
+    }
 
-    if(pthread_create(&t_heartbeat, NULL, send_heartbeat, NULL) != 0) {
+    if(initializeArena(&message_arena, MESSAGE_ARENA_SIZE) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Error allocating message arena.");
+        return RETURN_VALUE_ERROR;
+    }
+
+    if(open_server_socket() != RETURN_VALUE_OK)
+        return RETURN_VALUE_ERROR;
+
+    server_handler.fd = server_fd;
+    server_handler.callback = wait_connection;
+    server_handler.context = NULL;
+
+    if(addEventLoopHandler(&event_loop, &server_handler, EPOLLIN) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Error registering server socket.");
+        return RETURN_VALUE_ERROR;
+    }
+
+    // GPS coordinates updates over UDP are optional: TCP keeps working without them
+    initializeDatagramBatch(&datagram_requests);
+    initializeDatagramBatch(&datagram_responses);
+    if(open_datagram_socket() == RETURN_VALUE_OK) {
+        datagram_handler.fd = datagram_fd;
+        datagram_handler.callback = datagram_handler_callback;
+        datagram_handler.context = NULL;
+
+        if(addEventLoopHandler(&event_loop, &datagram_handler, EPOLLIN) != RETURN_VALUE_OK) {
+            FAP_SERVER_PRINT_ERROR("Error registering datagram socket.");
+            close(datagram_fd);
+            datagram_fd = -1;
+        }
+    }
+
+    // Real autopilot link, if configured: its telemetry is received by the event loop
+    if(mavlink_link_port > 0) {
+        if(initializeMavlinkLink(&mavlink_link, mavlink_link_address, mavlink_link_port, 0) != RETURN_VALUE_OK) {
+            FAP_SERVER_PRINT_ERROR("Error opening MAVLink link to %s:%d.", mavlink_link_address, mavlink_link_port);
+            return RETURN_VALUE_ERROR;
+        }
+        mavlink_link.gpsGlobalOriginCallback = handle_gps_global_origin;
+
+        mavlink_link_handler.fd = mavlink_link.fd;
+        mavlink_link_handler.callback = mavlink_link_callback;
+        mavlink_link_handler.context = NULL;
+
+        if(addEventLoopHandler(&event_loop, &mavlink_link_handler, EPOLLIN) != RETURN_VALUE_OK) {
+            FAP_SERVER_PRINT_ERROR("Error registering MAVLink link.");
+            terminateMavlinkLink(&mavlink_link);
+            return RETURN_VALUE_ERROR;
+        }
+        flushMavlinkLink(&mavlink_link);
+        mavlink_link_enabled = TRUE;
+    }
+
+    if(initializeTimerWheel(&timer_wheel, &event_loop, CONNECTION_TIMEOUT_RESOLUTION_MS) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Error starting timer wheel.");
+        return RETURN_VALUE_ERROR;
+    }
+    initializeTimer(&coverage_sweep, coverage_sweep_alarm, NULL);
+
+    if(pthread_create(&t_main, NULL, server_loop, NULL) != 0){
+        FAP_SERVER_PRINT_ERROR("Error starting main thread.");
+        return RETURN_VALUE_ERROR;
+    }
+    initialized = TRUE;
+
+    // Start heartbeat (and the other periodic autopilot traffic)
+    if(initializePeriodicScheduler(&autopilot_scheduler) != RETURN_VALUE_OK
+            || (heartbeat_task = addPeriodicTask(&autopilot_scheduler, HEARTBEAT_INTERVAL_NS, heartbeat_task_callback, NULL)) < 0
+            || addPeriodicTask(&autopilot_scheduler, mavlink_link_enabled ? MAVLINK_LINK_REFRESH_INTERVAL_NS : EMULATOR_TELEMETRY_INTERVAL_NS,
+                               telemetry_task_callback, NULL) < 0
+            || startPeriodicScheduler(&autopilot_scheduler) != RETURN_VALUE_OK) {
         FAP_SERVER_PRINT_ERROR("Error starting heartbeat.");
         return RETURN_VALUE_ERROR;
     }
@@ -546,42 +1197,75 @@ int terminateFapManagementProtocol()
 {
     exit_flag = 1;
     void *retval;
+    int res;
 
-    for(int i = 0; i < (MAX_ASSOCIATED_USERS); i++) {
-        if(threads[i].status == 1) {
-            shutdown(threads[i].socket, SHUT_RDWR);
-             if(pthread_join(threads[i].tid, &retval) != 0 || ((intptr_t) retval != RETURN_VALUE_OK)) {
-                FAP_SERVER_PRINT_ERROR("Error exiting thread #%d: %s", i, strerror(errno));
-            }
-            else
-                FAP_SERVER_PRINT("Ending thread's id: %d", i);
-        }
-    }
-
-    shutdown(server_fd, SHUT_RDWR);
-    close(server_fd);
+    // Stop the event loop; from here on this thread owns the connections
+    stopEventLoop(&event_loop);
 
     if(pthread_join(t_main, &retval) != 0 || ((intptr_t) retval != RETURN_VALUE_OK)) {
 		FAP_SERVER_PRINT_ERROR("Error exiting server thread.");
 		return RETURN_VALUE_ERROR;
     }
 
-    // KILL HEARTBEAT
-    
-    if(pthread_mutex_destroy(&lock) != 0){
-        FAP_SERVER_PRINT_ERROR("Error destroying lock.");
+    for(int i = 0; i < (int) getUserRegistrySize(&users); i++) {
+        if(get_connection(i)->state != CONNECTION_STATE_FREE) {
+            close_connection(i);
+            FAP_SERVER_PRINT("Ending connection's id: %d", i);
+        }
+    }
+
+    shutdown(server_fd, SHUT_RDWR);
+    close(server_fd);
+    if(datagram_fd >= 0) {
+        close(datagram_fd);
+        datagram_fd = -1;
+    }
+    terminateTimerWheel(&timer_wheel);
+    initialized = FALSE;
+    terminateUserRegistry(&users);
+    terminatePositionTable(&positions);
+    terminateSpatialIndex(&user_index);
+    free(out_of_coverage);
+    out_of_coverage = NULL;
+    free(in_coverage);
+    in_coverage = NULL;
+    terminateTrajectoryPredictor(&trajectories);
+    terminateSpatialIndex(&predicted_index);
+    terminateFapPlacement(&fap_placement);
+    terminateArena(&message_arena);
+
+    if(terminateEventLoop(&event_loop) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Error terminating event loop.");
         return RETURN_VALUE_ERROR;
     }
+
+    // KILL HEARTBEAT
     
-    alive = FALSE;
-    if((pthread_join(t_heartbeat, &retval) != 0) || ((intptr_t) retval != RETURN_VALUE_OK)) {
+    res = stopPeriodicScheduler(&autopilot_scheduler);
+    terminatePeriodicScheduler(&autopilot_scheduler);
+    heartbeat_task = RETURN_VALUE_ERROR;
+    if(res != RETURN_VALUE_OK) {
         FAP_SERVER_PRINT_ERROR("Error stopping heartbeat.");
         return RETURN_VALUE_ERROR;
     }
 
+    if(mavlink_link_enabled) {
+        mavlink_link_enabled = FALSE;
+        terminateMavlinkLink(&mavlink_link);
+    }
+
 	if(terminateMavlink() != RETURN_VALUE_OK)
 		return RETURN_VALUE_ERROR;
 
+    if(event_log_enabled) {
+        event_log_enabled = FALSE;
+        if(closeEventLog(&event_log) != RETURN_VALUE_OK)
+            FAP_SERVER_PRINT_ERROR("Error closing event log %s.", event_log_file);
+    }
+
+    // Every message logged so far is written
+    terminateLogger();
+
     return RETURN_VALUE_OK;
 }
 
@@ -595,14 +1279,13 @@ int moveFapToGpsNedCoordinates(const GpsNedCoordinates *gpsNedCoordinates)
     }
 
     // send Mavlink message - SET_POSITION_TARGET_LOCAL_NED
-    if(sendMavlinkMsg_setPositionTargetLocalNed(gpsNedCoordinates) != RETURN_VALUE_OK) {
+    if(autopilot_set_position_target(gpsNedCoordinates) != RETURN_VALUE_OK) {
         FAP_SERVER_PRINT_ERROR("Can't move FAP to target NED coordinates: Error sending Mavlink message.");
         return RETURN_VALUE_ERROR;
     }
 
     // print status message
-    FAP_SERVER_PRINT("Moving FAP to NED coordinates: ");
-    PRINT_GPS_NED_COORDINATES((*gpsNedCoordinates));
+    FAP_SERVER_PRINT("Moving FAP to NED coordinates: (%f, %f, %f)", gpsNedCoordinates->x, gpsNedCoordinates->y, gpsNedCoordinates->z);
 
     return RETURN_VALUE_OK;
 }
@@ -619,14 +1302,39 @@ int getFapGpsNedCoordinates(GpsNedCoordinates *gpsNedCoordinates)
         return RETURN_VALUE_ERROR;
         
     // send Mavlink message - LOCAL_POSITION_NED
-    if(sendMavlinkMsg_localPositionNed(gpsNedCoordinates) != RETURN_VALUE_OK) {
+    if(autopilot_local_position_ned(gpsNedCoordinates) != RETURN_VALUE_OK) {
         FAP_SERVER_PRINT_ERROR("Can't obtain FAP NED coordinates: Error sending Mavlink message.");
         return RETURN_VALUE_ERROR;
     }
 
     // print status message
-    FAP_SERVER_PRINT("FAP is at NED coordinates: ");
-    PRINT_GPS_NED_COORDINATES((*gpsNedCoordinates));
+    FAP_SERVER_PRINT_DEBUG("FAP is at NED coordinates: (%f, %f, %f)", gpsNedCoordinates->x, gpsNedCoordinates->y, gpsNedCoordinates->z);
+
+    return RETURN_VALUE_OK;
+}
+
+
+int getFapGpsRawCoordinates(GpsRawCoordinates *gpsRawCoordinates)
+{
+    GpsNedCoordinates fapNedCoordinates = {0};
+
+    if(gpsRawCoordinates == NULL) {
+        FAP_SERVER_PRINT_ERROR("Invalid coordinates pointer.");
+        return RETURN_VALUE_ERROR;
+    }
+
+    if(autopilot_local_position_ned(&fapNedCoordinates) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Can't obtain FAP NED coordinates: Error sending Mavlink message.");
+        return RETURN_VALUE_ERROR;
+    }
+
+    // NED back to RAW, through the origin frame the users' positions are converted with
+    if(convertGpsNedCoordinates(&ned_converter, gpsRawCoordinates, &fapNedCoordinates) != RETURN_VALUE_OK) {
+        FAP_SERVER_PRINT_ERROR("Can't convert FAP NED coordinates to RAW.");
+        return RETURN_VALUE_ERROR;
+    }
+
+    FAP_SERVER_PRINT_DEBUG("FAP is at RAW coordinates: (%f, %f, %f)", gpsRawCoordinates->latitude, gpsRawCoordinates->longitude, gpsRawCoordinates->altitude);
 
     return RETURN_VALUE_OK;
 }
@@ -645,12 +1353,128 @@ int getAllUsersGpsNedCoordinates(GpsNedCoordinates *gpsNedCoordinates, int *n)
 
     (*n) = 0;
 
-    for(int i = 0; i < MAX_ASSOCIATED_USERS; i++) { 
-        if(strcmp(clients[i].timestamp, "") != 0) {
-            gpsNedCoordinates[(*n)] = clients[i];
-            (*n)++;
-        }
+    if(!initialized)
+        return RETURN_VALUE_OK;
+
+    // Consistent copy of the positions, without blocking the event loop
+    (*n) = snapshotPositions(&positions, gpsNedCoordinates, max_users);
+
+    return RETURN_VALUE_OK;
+}
+
+
+int setMaxAssociatedUsers(int maxUsers)
+{
+    if(initialized) {
+        FAP_SERVER_PRINT_ERROR("Can't change the user limit while the FAP Management Protocol is running.");
+        return RETURN_VALUE_ERROR;
     }
+    if(maxUsers <= 0) {
+        FAP_SERVER_PRINT_ERROR("Invalid user limit: %d.", maxUsers);
+        return RETURN_VALUE_ERROR;
+    }
+
+    max_users = maxUsers;
 
     return RETURN_VALUE_OK;
 }
+
+
+int setMavlinkLinkAddress(const char *ipAddress, int port)
+{
+    struct in_addr parsed;
+
+    if(initialized) {
+        FAP_SERVER_PRINT_ERROR("Can't change the MAVLink link while the FAP Management Protocol is running.");
+        return RETURN_VALUE_ERROR;
+    }
+
+    // No address: back to the emulator
+    if(ipAddress == NULL) {
+        mavlink_link_port = 0;
+        return RETURN_VALUE_OK;
+    }
+
+    if(port <= 0 || port > 65535 || inet_pton(AF_INET, ipAddress, &parsed) != 1) {
+        FAP_SERVER_PRINT_ERROR("Invalid MAVLink link address: %s:%d.", ipAddress, port);
+        return RETURN_VALUE_ERROR;
+    }
+
+    inet_ntop(AF_INET, &parsed, mavlink_link_address, sizeof(mavlink_link_address));
+    mavlink_link_port = port;
+
+    return RETURN_VALUE_OK;
+}
+
+
+int setFapLogFile(const char *path)
+{
+    if(initialized) {
+        FAP_SERVER_PRINT_ERROR("Can't change the log file while the FAP Management Protocol is running.");
+        return RETURN_VALUE_ERROR;
+    }
+
+    // No path: back to the standard output
+    if(path == NULL) {
+        log_file[0] = '\0';
+        return RETURN_VALUE_OK;
+    }
+
+    if(strlen(path) == 0 || strlen(path) >= sizeof(log_file)) {
+        FAP_SERVER_PRINT_ERROR("Invalid log file: %s.", path);
+        return RETURN_VALUE_ERROR;
+    }
+
+    strcpy(log_file, path);
+
+    return RETURN_VALUE_OK;
+}
+
+
+int setFapEventLogFile(const char *path)
+{
+    if(initialized) {
+        FAP_SERVER_PRINT_ERROR("Can't change the event log while the FAP Management Protocol is running.");
+        return RETURN_VALUE_ERROR;
+    }
+
+    // No path: disabled
+    if(path == NULL) {
+        event_log_file[0] = '\0';
+        return RETURN_VALUE_OK;
+    }
+
+    if(strlen(path) == 0 || strlen(path) >= sizeof(event_log_file)) {
+        FAP_SERVER_PRINT_ERROR("Invalid event log: %s.", path);
+        return RETURN_VALUE_ERROR;
+    }
+
+    strcpy(event_log_file, path);
+
+    return RETURN_VALUE_OK;
+}
+
+
+int setFapAutoPlacement(int enabled)
+{
+    auto_placement = enabled ? TRUE : FALSE;
+
+    FAP_SERVER_PRINT("FAP placement %s.", auto_placement ? "enabled" : "disabled");
+
+    return RETURN_VALUE_OK;
+}
+
+
+int getMaxAssociatedUsers()
+{
+    return max_users;
+}
+
+
+int getHeartbeatStats(PeriodicTaskStats *stats)
+{
+    if(heartbeat_task < 0)
+        return RETURN_VALUE_ERROR;
+
+    return getPeriodicTaskStats(&autopilot_scheduler, heartbeat_task, stats);
+}
@@ -10,32 +10,18 @@
 #pragma once
 // Module headers
 #include "GpsCoordinates.h"
+#include "PeriodicScheduler.h"
+#include "Logger.h"
 
 
 
 // =========================================================
 //           DEFINES
 
-#define RED		"\x1B[31m"
-#define YEL		"\x1B[33m"
-#define BLUE	"\x1B[34m"
-#define RESET	"\x1B[0m"
-
-#define FAP_SERVER_PRINT(...)                                             \
-	do                                                                    \
-	{                                                                     \
-		printf(BLUE ">> FapManagementProtocol_Server::%s(): ", __func__); \
-		printf(BLUE __VA_ARGS__);                                         \
-		printf(RESET "\n");                                               \
-	} while (0);
-
-#define FAP_SERVER_PRINT_ERROR(...)                                       \
-	do                                                                    \
-	{                                                                     \
-		printf(RED ">> FapManagementProtocol_Server::%s(): ", __func__);  \
-		printf(RED __VA_ARGS__);                                          \
-		printf(RESET "\n");                                               \
-	} while (0);
+// Server messages, through the asynchronous logger (see Logger.h); debug ones (per message) are compiled out by default
+#define FAP_SERVER_PRINT(...)			LOGGER_INFO("FapManagementProtocol_Server", __VA_ARGS__);
+#define FAP_SERVER_PRINT_DEBUG(...)		LOGGER_DEBUG("FapManagementProtocol_Server", __VA_ARGS__);
+#define FAP_SERVER_PRINT_ERROR(...)		LOGGER_ERROR("FapManagementProtocol_Server", __VA_ARGS__);
 
 
 // =========================================================
@@ -46,28 +32,11 @@
 #define RETURN_VALUE_OK				0
 #define RETURN_VALUE_ERROR			(-1)
 
-// Maximum simultaneously associated users
+// Default maximum of simultaneously associated users (see setMaxAssociatedUsers())
 #define MAX_ASSOCIATED_USERS		10
 #define SO_MAX_CONN					32
 
 
-// =========================================================
-
-typedef struct _threads_clients
-{
-	pthread_t tid;
-	int       socket;
-	int 	  status;
-	int 	  user_id;
-	int 	  alarm_flag;
-} threads_clients;
-
-//           STRUCTS
-// =========================================================
-
-/**
- * GPS coordinates in RAW format (lat, lon, alt).
- */
 
 
 // =========================================================
@@ -117,6 +86,17 @@ int moveFapToGpsNedCoordinates(const GpsNedCoordinates *gpsNedCoordinates);
  */
 int getFapGpsNedCoordinates(GpsNedCoordinates *gpsNedCoordinates);
 
+/**
+ * Get the FAP's current GPS coordinates (in RAW format), converted back
+ * from its NED coordinates through the current origin frame.
+ *
+ * @param gpsRawCoordinates 	Pointer to the GPS coordinates to be initialized
+ * 								with the FAP's GPS coordinates.
+ * @return int 					Return RETURN_VALUE_OK if there are no errors;
+ * 								otherwise, return RETURN_VALUE_ERROR.
+ */
+int getFapGpsRawCoordinates(GpsRawCoordinates *gpsRawCoordinates);
+
 /**
  * Get the GPS coordinates (in NED format) of all associated users.
  *
@@ -124,9 +104,12 @@ int getFapGpsNedCoordinates(GpsNedCoordinates *gpsNedCoordinates);
  * This function needs to convert them to NED format.
  *
  * Note 2: The array pointed by the gpsNedCoordinates pointer must be able to
- * accommodate the maximum number of associated users (i.e., MAX_ASSOCIATED_USERS).
+ * accommodate the maximum number of associated users (i.e., getMaxAssociatedUsers(),
+ * MAX_ASSOCIATED_USERS by default).
  * The function will return the number of associated users (i.e., the number of elements
  * in the array) through the pointer *n.
+ * It can be called from any thread: each user's coordinates are copied consistently,
+ * without blocking the protocol's operation.
  *
  * @param gpsNedCoordinates 	Pointer to an array of GpsNedCoordinates to be
  * 								initialized with the users' GPS coordinates.
@@ -135,4 +118,86 @@ int getFapGpsNedCoordinates(GpsNedCoordinates *gpsNedCoordinates);
  * @return int 					Return RETURN_VALUE_OK if there are no errors;
  * 								otherwise, return RETURN_VALUE_ERROR.
  */
-int getAllUsersGpsNedCoordinates(GpsNedCoordinates *gpsNedCoordinates, int *n);
\ No newline at end of file
+int getAllUsersGpsNedCoordinates(GpsNedCoordinates *gpsNedCoordinates, int *n);
+
+/**
+ * Set the maximum number of simultaneously associated users.
+ * Must be called before initializeFapManagementProtocol(); the user table
+ * grows on demand up to this limit.
+ *
+ * @param maxUsers 				Maximum number of associated users.
+ * @return int 					Return RETURN_VALUE_OK if there are no errors;
+ * 								otherwise, return RETURN_VALUE_ERROR.
+ */
+int setMaxAssociatedUsers(int maxUsers);
+
+/**
+ * Talk to a real autopilot (e.g. a SITL simulator) over a MAVLink (v2) UDP
+ * link, instead of the MAVLink emulator: the FAP is moved with
+ * SET_POSITION_TARGET_LOCAL_NED frames, and its position is the last
+ * LOCAL_POSITION_NED streamed by the autopilot (a GPS_GLOBAL_ORIGIN moves
+ * the origin of the users' NED coordinates).
+ * Must be called before initializeFapManagementProtocol().
+ *
+ * @param ipAddress 			Autopilot's IPv4 address (NULL to use the emulator).
+ * @param port 					Autopilot's UDP port.
+ * @return int 					Return RETURN_VALUE_OK if there are no errors;
+ * 								otherwise, return RETURN_VALUE_ERROR.
+ */
+int setMavlinkLinkAddress(const char *ipAddress, int port);
+
+/**
+ * Set the file the server's messages are logged to (appended, by a background
+ * thread, while the FAP Management Protocol is running).
+ * Must be called before initializeFapManagementProtocol().
+ *
+ * @param path 					Log file (NULL for the standard output).
+ * @return int 					Return RETURN_VALUE_OK if there are no errors;
+ * 								otherwise, return RETURN_VALUE_ERROR.
+ */
+int setFapLogFile(const char *path);
+
+/**
+ * Set the file every protocol message, MAVLink command and eviction is
+ * recorded to, in binary (see EventLog.h; read it with bin/EventLogReader).
+ * Must be called before initializeFapManagementProtocol().
+ *
+ * @param path 					Event log (truncated; NULL to disable it).
+ * @return int 					Return RETURN_VALUE_OK if there are no errors;
+ * 								otherwise, return RETURN_VALUE_ERROR.
+ */
+int setFapEventLogFile(const char *path);
+
+/**
+ * Enable (or disable) the automatic placement of the FAP: while enabled, the
+ * server moves the FAP (as moveFapToGpsNedCoordinates()) over the center of
+ * the associated users' minimum enclosing circle, at a height that covers
+ * them, whenever that optimum moves beyond FAP_PLACEMENT_HYSTERESIS_METERS.
+ * The optimum is refreshed on every users' GPS update and disconnection, from
+ * the users' positions extrapolated (constant velocity) to when the FAP
+ * gets to them. A move that covers fewer users (at their last positions)
+ * than the FAP's current position is not taken.
+ * Disabled by default.
+ *
+ * @param enabled 				True (1) to enable; False (0) to disable.
+ * @return int 					Return RETURN_VALUE_OK if there are no errors;
+ * 								otherwise, return RETURN_VALUE_ERROR.
+ */
+int setFapAutoPlacement(int enabled);
+
+/**
+ * Get the maximum number of simultaneously associated users.
+ *
+ * @return int 					Maximum number of associated users.
+ */
+int getMaxAssociatedUsers();
+
+/**
+ * Get the timing statistics of the heartbeats sent to the autopilot (every
+ * 500 ms, at absolute deadlines): how late they were sent.
+ *
+ * @param stats 				Pointer to the PeriodicTaskStats to be initialized.
+ * @return int 					Return RETURN_VALUE_OK if there are no errors;
+ * 								otherwise (not initialized), return RETURN_VALUE_ERROR.
+ */
+int getHeartbeatStats(PeriodicTaskStats *stats);
\ No newline at end of file
@@ -0,0 +1,417 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "FapPlacement.h"
+
+// C headers
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+#define DEGREES_TO_RADIANS		(M_PI / 180)
+
+// Relative tolerance of the "point inside the circle" tests
+#define CIRCLE_EPSILON			1e-9
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+typedef struct _Circle
+{
+	double x;
+	double y;
+	double r2;									// Squared radius
+} Circle;
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Monotonic time (in ns).
+ */
+static int64_t monotonicNs()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static inline uint32_t nextRandom(uint32_t *state)
+{
+	// xorshift32
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+
+	return *state;
+}
+
+static inline int isInside(const Circle *circle, double x, double y)
+{
+	double dx = x - circle->x, dy = y - circle->y;
+
+	return dx * dx + dy * dy <= circle->r2 * (1 + CIRCLE_EPSILON) + CIRCLE_EPSILON;
+}
+
+static inline Circle circleOf2(double ax, double ay, double bx, double by)
+{
+	Circle circle = {(ax + bx) / 2, (ay + by) / 2, 0};
+
+	circle.r2 = ((ax - bx) * (ax - bx) + (ay - by) * (ay - by)) / 4;
+
+	return circle;
+}
+
+/**
+ * Circle through three points (or, if collinear, the circle of the farthest two).
+ */
+static Circle circleOf3(double ax, double ay, double bx, double by, double cx, double cy)
+{
+	double bxr = bx - ax, byr = by - ay, cxr = cx - ax, cyr = cy - ay;
+	double d = 2 * (bxr * cyr - byr * cxr);
+	double b2 = bxr * bxr + byr * byr, c2 = cxr * cxr + cyr * cyr;
+	Circle circle, other;
+
+	if (fabs(d) < 1e-12 * (b2 + c2))
+	{
+		circle = circleOf2(ax, ay, bx, by);
+		other = circleOf2(ax, ay, cx, cy);
+		if (other.r2 > circle.r2)
+			circle = other;
+		other = circleOf2(bx, by, cx, cy);
+		if (other.r2 > circle.r2)
+			circle = other;
+		return circle;
+	}
+
+	circle.x = (cyr * b2 - byr * c2) / d;
+	circle.y = (bxr * c2 - cxr * b2) / d;
+	circle.r2 = circle.x * circle.x + circle.y * circle.y;
+	circle.x += ax;
+	circle.y += ay;
+
+	return circle;
+}
+
+
+/**
+ * Copy points into the work copies, in random order (Welzl's algorithm runs
+ * in expected linear time on a random order).
+ */
+static void loadPoints(FapPlacement *placement, const float *x, const float *y, const int *ids, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t j = nextRandom(&placement->random) % (i + 1);
+
+		placement->x[i] = placement->x[j];
+		placement->y[i] = placement->y[j];
+		placement->ids[i] = placement->ids[j];
+		placement->x[j] = x[i];
+		placement->y[j] = y[i];
+		placement->ids[j] = (ids != NULL) ? ids[i] : (int) i;
+	}
+}
+
+/**
+ * Minimum enclosing circle of the first n work points with a point q on its
+ * boundary (recording the circle's support).
+ */
+static Circle circleWithPoint(FapPlacement *placement, size_t n, double qx, double qy, int q)
+{
+	const double *px = placement->x, *py = placement->y;
+	Circle circle = {qx, qy, 0};
+
+	placement->support[0] = q;
+	placement->supportSize = 1;
+
+	for (size_t j = 0; j < n; j++)
+	{
+		if (isInside(&circle, px[j], py[j]))
+			continue;
+
+		// q and p[j] are on the boundary of the circle of p[0..j]
+		circle = circleOf2(qx, qy, px[j], py[j]);
+		placement->support[1] = placement->ids[j];
+		placement->supportSize = 2;
+
+		for (size_t k = 0; k < j; k++)
+		{
+			if (!isInside(&circle, px[k], py[k]))
+			{
+				circle = circleOf3(qx, qy, px[j], py[j], px[k], py[k]);
+				placement->support[2] = placement->ids[k];
+				placement->supportSize = 3;
+			}
+		}
+	}
+
+	return circle;
+}
+
+/**
+ * Minimum enclosing circle of the n work points (recording its support).
+ */
+static Circle minimumCircle(FapPlacement *placement, size_t n)
+{
+	const double *px = placement->x, *py = placement->y;
+	Circle circle = {px[0], py[0], 0};
+
+	placement->support[0] = placement->ids[0];
+	placement->supportSize = 1;
+
+	for (size_t i = 1; i < n; i++)
+	{
+		// p[i] is on the boundary of the circle of p[0..i]
+		if (!isInside(&circle, px[i], py[i]))
+			circle = circleWithPoint(placement, i, px[i], py[i], placement->ids[i]);
+	}
+
+	return circle;
+}
+
+static void setCircle(FapPlacement *placement, const Circle *circle)
+{
+	placement->centerX = circle->x;
+	placement->centerY = circle->y;
+	placement->radius = sqrt(circle->r2);
+}
+
+/**
+ * Record where the support users are, after rebuilding the circle from a spatial index.
+ */
+static void setSupport(FapPlacement *placement, const SpatialIndex *index)
+{
+	for (int i = 0; i < placement->supportSize; i++)
+	{
+		int position = index->entries[placement->support[i]].position;
+
+		placement->supportX[i] = index->x[position];
+		placement->supportY[i] = index->y[position];
+	}
+
+	placement->rebuiltNs = monotonicNs();
+	placement->deferred = 0;
+	placement->rebuilds++;
+}
+
+static inline int isRebuildDue(const FapPlacement *placement)
+{
+	return monotonicNs() - placement->rebuiltNs >= placement->rebuildPeriod * 1000000LL;
+}
+
+/**
+ * A support user still within the hysteresis of where it was at the last
+ * rebuild, within the rebuild period: its rebuild can wait.
+ */
+static int canDeferRebuild(const FapPlacement *placement, const SpatialIndex *index, int support)
+{
+	const SpatialIndexEntry *entry = &index->entries[placement->support[support]];
+	double dx, dy;
+
+	if (entry->cell < 0 || isRebuildDue(placement))
+		return 0;
+
+	dx = index->x[entry->position] - placement->supportX[support];
+	dy = index->y[entry->position] - placement->supportY[support];
+
+	return dx * dx + dy * dy < (double) placement->hysteresis * placement->hysteresis;
+}
+
+/**
+ * Issue the target over the circle, unless within the hysteresis of the last one.
+ */
+static int issueTarget(FapPlacement *placement, double usersAltitude)
+{
+	float targetZ = usersAltitude + computePlacementHeight(placement->radius);
+	float dx = placement->centerX - placement->target.x;
+	float dy = placement->centerY - placement->target.y;
+	float dz = targetZ - placement->target.z;
+
+	// Hysteresis: keep the current target while the optimum stays near it
+	if (placement->hasTarget && dx * dx + dy * dy + dz * dz <= placement->hysteresis * placement->hysteresis)
+		return 0;
+
+	placement->target.x = placement->centerX;
+	placement->target.y = placement->centerY;
+	placement->target.z = targetZ;
+	strcpyTimestampIso8601(placement->target.timestamp, time(NULL));
+	placement->hasTarget = 1;
+
+	return 1;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeFapPlacement(FapPlacement *placement, size_t capacity, float hysteresis, int rebuildPeriod)
+{
+	// Check arguments
+	if (placement == NULL || capacity == 0 || hysteresis < 0 || rebuildPeriod < 0)
+		return RETURN_VALUE_ERROR;
+
+	memset(placement, 0, sizeof(*placement));
+	placement->hysteresis = hysteresis;
+	placement->rebuildPeriod = rebuildPeriod;
+	placement->capacity = capacity;
+	placement->random = 2463534242u;
+	placement->x = malloc(capacity * sizeof(double));
+	placement->y = malloc(capacity * sizeof(double));
+	placement->ids = malloc(capacity * sizeof(int));
+
+	if (placement->x == NULL || placement->y == NULL || placement->ids == NULL)
+	{
+		terminateFapPlacement(placement);
+		return RETURN_VALUE_ERROR;
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+
+void terminateFapPlacement(FapPlacement *placement)
+{
+	free(placement->x);
+	free(placement->y);
+	free(placement->ids);
+	placement->x = placement->y = NULL;
+	placement->ids = NULL;
+	placement->capacity = 0;
+	placement->valid = 0;
+}
+
+
+int computeEnclosingCircle(FapPlacement *placement, const float *x, const float *y, size_t n,
+							float *centerX, float *centerY, float *radius)
+{
+	Circle circle;
+
+	// Check arguments
+	if (n == 0 || n > placement->capacity)
+		return RETURN_VALUE_ERROR;
+
+	loadPoints(placement, x, y, NULL, n);
+	circle = minimumCircle(placement, n);
+
+	*centerX = circle.x;
+	*centerY = circle.y;
+	*radius = sqrt(circle.r2);
+
+	return RETURN_VALUE_OK;
+}
+
+
+float computePlacementHeight(float radius)
+{
+	float height = radius / tan(FAP_PLACEMENT_BEAM_HALF_ANGLE * DEGREES_TO_RADIANS);
+
+	if (height < FAP_PLACEMENT_MIN_HEIGHT)
+		return FAP_PLACEMENT_MIN_HEIGHT;
+	if (height > FAP_PLACEMENT_MAX_HEIGHT)
+		return FAP_PLACEMENT_MAX_HEIGHT;
+
+	return height;
+}
+
+
+int updateFapPlacement(FapPlacement *placement, const float *x, const float *y, const float *z, size_t n)
+{
+	double altitude = 0;
+	Circle circle;
+
+	if (n == 0 || n > placement->capacity)
+		return 0;
+
+	loadPoints(placement, x, y, NULL, n);
+	circle = minimumCircle(placement, n);
+	setCircle(placement, &circle);
+
+	// The support is made of array indexes, not user slots
+	placement->valid = 0;
+
+	for (size_t i = 0; i < n; i++)
+		altitude += z[i];
+
+	return issueTarget(placement, altitude / n);
+}
+
+
+int refreshFapPlacement(FapPlacement *placement, const SpatialIndex *index, int slot)
+{
+	const SpatialIndexEntry *entry;
+	float centroidX, centroidY, centroidZ;
+	int support = -1, inside;
+	Circle circle;
+
+	if (index->count > placement->capacity || slot < 0 || (size_t) slot >= index->capacity
+			|| getSpatialIndexCentroid(index, &centroidX, &centroidY, &centroidZ) != RETURN_VALUE_OK)
+	{
+		placement->valid = 0;
+		return 0;
+	}
+
+	entry = &index->entries[slot];
+	for (int i = 0; i < placement->supportSize; i++)
+	{
+		if (placement->support[i] == slot)
+			support = i;
+	}
+
+	// A support user jittering: keep the circle (off by less than the hysteresis) until the next period
+	if (placement->valid && support >= 0 && canDeferRebuild(placement, index, support))
+	{
+		placement->deferred = 1;
+		return issueTarget(placement, centroidZ);
+	}
+
+	circle = (Circle) {placement->centerX, placement->centerY, placement->radius * placement->radius};
+	inside = (entry->cell < 0 || isInside(&circle, index->x[entry->position], index->y[entry->position]));
+
+	// Moved within the circle (or left) without being on its boundary: same circle (a deferred rebuild waits for its period)
+	if (placement->valid && support < 0 && inside && !(placement->deferred && isRebuildDue(placement)))
+		return issueTarget(placement, centroidZ);
+
+	if (!placement->valid || support >= 0 || placement->deferred)
+	{
+		// The circle may shrink (or is off): rebuild it
+		loadPoints(placement, index->x, index->y, index->slots, index->count);
+		circle = minimumCircle(placement, index->count);
+	}
+	else
+	{
+		// Moved out of the circle: it is on the new circle's boundary
+		loadPoints(placement, index->x, index->y, index->slots, index->count);
+		circle = circleWithPoint(placement, index->count, index->x[entry->position], index->y[entry->position], slot);
+	}
+
+	setCircle(placement, &circle);
+	setSupport(placement, index);
+	placement->valid = 1;
+
+	return issueTarget(placement, centroidZ);
+}
+
+
+void invalidateFapPlacement(FapPlacement *placement)
+{
+	placement->valid = 0;
+}
@@ -0,0 +1,177 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// Module headers
+#include "GpsCoordinates.h"
+#include "SpatialIndex.h"
+
+// C headers
+#include <stddef.h>
+#include <stdint.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK					0
+#define RETURN_VALUE_ERROR				(-1)
+
+// Distance the optimal position must move before the FAP is sent there (in meters)
+#define FAP_PLACEMENT_HYSTERESIS_METERS	10.0f
+
+// Minimum time between two rebuilds of the enclosing circle for support users moving within the hysteresis (in ms)
+#define FAP_PLACEMENT_REBUILD_PERIOD_MS	1000
+
+// Altitude model: the FAP's antenna covers a cone of this half angle (in degrees),
+// flying between these heights above the users' mean altitude (in meters)
+#define FAP_PLACEMENT_BEAM_HALF_ANGLE	60.0
+#define FAP_PLACEMENT_MIN_HEIGHT		20.0f
+#define FAP_PLACEMENT_MAX_HEIGHT		120.0f
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * FAP placement engine: the FAP is placed over the center of the users'
+ * minimum enclosing circle (minimizing the maximum horizontal distance to a
+ * user), high enough for its antenna's cone to cover the circle.
+ * A new target is only issued when it moves beyond the hysteresis.
+ *
+ * The circle is kept up to date user by user (refreshFapPlacement()): it is
+ * defined by the two or three users on its boundary (its support), so it
+ * only changes when a support user moves or leaves, or a user moves out of
+ * it.
+ *
+ * Those changes rerun Welzl's algorithm over every user (expected O(n);
+ * about 0.9 ms with 10000 users, against about 2 us for any other move).
+ * With users moving at random, a given update touches a support user with
+ * probability 3/n, so the expected cost per update stays O(1).
+ * The worst case, a support user moving on every update, is throttled: while
+ * the support users stay within the hysteresis of where they were at the
+ * last rebuild, the circle is off by less than the hysteresis (moving points
+ * by up to d moves their minimum enclosing circle by up to d), so it is only
+ * rebuilt once per rebuild period.
+ */
+typedef struct _FapPlacement
+{
+	float hysteresis;							// Minimum move of the target (in meters)
+	double *x;									// Users' X (work copy, shuffled)
+	double *y;									// Users' Y (work copy, shuffled)
+	int *ids;									// Users' slots (work copy, shuffled)
+	size_t capacity;							// Size of the work copies
+	uint32_t random;							// State of the shuffle's generator
+	int valid;									// The circle and its support are up to date
+	double centerX;								// Enclosing circle's center X (in meters)
+	double centerY;								// Enclosing circle's center Y (in meters)
+	double radius;								// Enclosing circle's radius (in meters)
+	int support[3];								// Users on the circle's boundary
+	int supportSize;							// Number of users on the circle's boundary
+	double supportX[3];							// Support users' X at the last rebuild
+	double supportY[3];							// Support users' Y at the last rebuild
+	int rebuildPeriod;							// Minimum time between throttled rebuilds (in ms)
+	int64_t rebuiltNs;							// Monotonic time of the last rebuild (in ns)
+	int deferred;								// A support user's move is waiting for a rebuild
+	size_t rebuilds;							// Number of O(n) rebuilds (statistics)
+	int hasTarget;								// A target was issued
+	GpsNedCoordinates target;					// Last target issued
+} FapPlacement;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize a FAP placement engine.
+ *
+ * @param placement		Pointer to the FapPlacement to be initialized.
+ * @param capacity		Maximum number of users.
+ * @param hysteresis	Minimum move of the target (in meters).
+ * @param rebuildPeriod	Minimum time between two rebuilds for support users
+ *						moving within the hysteresis (in ms; 0 to always
+ *						rebuild).
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeFapPlacement(FapPlacement *placement, size_t capacity, float hysteresis, int rebuildPeriod);
+
+/**
+ * Terminate a FAP placement engine, releasing its work copies.
+ *
+ * @param placement		Pointer to the FapPlacement.
+ */
+void terminateFapPlacement(FapPlacement *placement);
+
+/**
+ * Compute the minimum enclosing circle of a set of points (Welzl's
+ * algorithm, expected O(n)).
+ *
+ * @param placement		Pointer to the FapPlacement (work copies).
+ * @param x				Points' X.
+ * @param y				Points' Y.
+ * @param n				Number of points (at most the placement's capacity).
+ * @param centerX		Pointer to be initialized with the circle's center X.
+ * @param centerY		Pointer to be initialized with the circle's center Y.
+ * @param radius		Pointer to be initialized with the circle's radius.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int computeEnclosingCircle(FapPlacement *placement, const float *x, const float *y, size_t n,
+							float *centerX, float *centerY, float *radius);
+
+/**
+ * Height of the FAP above the users covering a circle (altitude model).
+ *
+ * @param radius		Circle's radius (in meters).
+ * @return				Height (in meters).
+ */
+float computePlacementHeight(float radius);
+
+/**
+ * Compute the optimal FAP position for the users' positions.
+ *
+ * @param placement		Pointer to the FapPlacement.
+ * @param x				Users' X (NED, in meters).
+ * @param y				Users' Y (NED, in meters).
+ * @param z				Users' Z (NED, in meters).
+ * @param n				Number of users.
+ * @return				True (1) if the optimal position moved beyond the
+ *						hysteresis (the new target is placement->target);
+ *						return False (0) otherwise.
+ */
+int updateFapPlacement(FapPlacement *placement, const float *x, const float *y, const float *z, size_t n);
+
+/**
+ * Refresh the optimal FAP position after a user slot was moved in (or
+ * removed from) a spatial index: O(1) unless the user was on the enclosing
+ * circle's boundary or moved out of it (then expected O(n)). A support user
+ * moving within the hysteresis only rebuilds the circle once per rebuild
+ * period.
+ *
+ * @param placement		Pointer to the FapPlacement.
+ * @param index			Pointer to the SpatialIndex of the users' positions.
+ * @param slot			User slot that was moved or removed.
+ * @return				True (1) if the optimal position moved beyond the
+ *						hysteresis (the new target is placement->target);
+ *						return False (0) otherwise.
+ */
+int refreshFapPlacement(FapPlacement *placement, const SpatialIndex *index, int slot);
+
+/**
+ * Invalidate the enclosing circle (rebuilt by the next refreshFapPlacement()),
+ * e.g. while the users' positions are not being followed.
+ *
+ * @param placement		Pointer to the FapPlacement.
+ */
+void invalidateFapPlacement(FapPlacement *placement);
@@ -0,0 +1,232 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "Geodesy.h"
+
+// C headers
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+#define DEGREES_TO_RADIANS		(M_PI / 180)
+#define RADIANS_TO_DEGREES		(180 / M_PI)
+
+// WGS-84 derived constants
+#define WGS84_SEMI_MINOR_AXIS	(WGS84_SEMI_MAJOR_AXIS * (1 - WGS84_FLATTENING))
+#define WGS84_EP2				(WGS84_E2 / (1 - WGS84_E2))						// Second eccentricity squared
+
+// Entries of the sine table per turn, and per quarter turn (cos(x) = sin(x + 90))
+#define TABLE_TURN				(360 * GEODESY_TABLE_STEPS_PER_DEGREE)
+#define TABLE_QUARTER			(TABLE_TURN / 4)
+
+
+// =========================================================
+//           GLOBAL VARIABLES
+// =========================================================
+
+// Sine of every table step, for one and a quarter turns
+static double sineTable[TABLE_TURN + TABLE_QUARTER];
+
+static pthread_once_t sineTableOnce = PTHREAD_ONCE_INIT;
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+static void initializeSineTable(void)
+{
+	for (int i = 0; i < TABLE_TURN + TABLE_QUARTER; i++)
+		sineTable[i] = sin((double) i / GEODESY_TABLE_STEPS_PER_DEGREE * DEGREES_TO_RADIANS);
+}
+
+/**
+ * Sine and cosine of an angle (in degrees), from the nearest table step a:
+ * sin(a + d) and cos(a + d), with |d| at most half a step.
+ */
+static inline void sinCosTable(double degrees, double *sinX, double *cosX)
+{
+	double steps = floor(degrees * GEODESY_TABLE_STEPS_PER_DEGREE + 0.5);
+	double d = (degrees - steps / GEODESY_TABLE_STEPS_PER_DEGREE) * DEGREES_TO_RADIANS, z = d * d;
+	double sinD = d * (1 + z * (-1.0 / 6 + z * (1.0 / 120)));
+	double cosD = 1 + z * (-1.0 / 2 + z * (1.0 / 24 + z * (-1.0 / 720)));
+	int i = (int) fmod(steps, TABLE_TURN);
+	double sinA, cosA;
+
+	if (i < 0)
+		i += TABLE_TURN;
+	sinA = sineTable[i];
+	cosA = sineTable[i + TABLE_QUARTER];
+
+	*sinX = sinA * cosD + cosA * sinD;
+	*cosX = cosA * cosD - sinA * sinD;
+}
+
+/**
+ * ECEF position from the latitude's and longitude's sines and cosines.
+ */
+static inline void toEcef(double sinLatitude, double cosLatitude, double sinLongitude, double cosLongitude,
+							double altitude, EcefCoordinates *ecef)
+{
+	// Prime vertical radius of curvature
+	double n = WGS84_SEMI_MAJOR_AXIS / sqrt(1 - WGS84_E2 * sinLatitude * sinLatitude);
+
+	ecef->x = (n + altitude) * cosLatitude * cosLongitude;
+	ecef->y = (n + altitude) * cosLatitude * sinLongitude;
+	ecef->z = (n * (1 - WGS84_E2) + altitude) * sinLatitude;
+}
+
+/**
+ * Rotate an ECEF offset from the origin into the local NED frame.
+ */
+static inline void toNed(const GeodesyFrame *frame, const EcefCoordinates *ecef, LocalNedCoordinates *ned)
+{
+	double dx = ecef->x - frame->originEcef.x;
+	double dy = ecef->y - frame->originEcef.y;
+	double dz = ecef->z - frame->originEcef.z;
+	double t = frame->cosLongitude * dx + frame->sinLongitude * dy;
+
+	ned->north = -frame->sinLatitude * t + frame->cosLatitude * dz;
+	ned->east = -frame->sinLongitude * dx + frame->cosLongitude * dy;
+	ned->down = -frame->cosLatitude * t - frame->sinLatitude * dz;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int geodeticToEcef(const GeodeticCoordinates *geodetic, EcefCoordinates *ecef)
+{
+	double latitude, longitude;
+
+	// Check arguments
+	if (geodetic == NULL || ecef == NULL)
+		return RETURN_VALUE_ERROR;
+
+	latitude = geodetic->latitude * DEGREES_TO_RADIANS;
+	longitude = geodetic->longitude * DEGREES_TO_RADIANS;
+	toEcef(sin(latitude), cos(latitude), sin(longitude), cos(longitude), geodetic->altitude, ecef);
+
+	return RETURN_VALUE_OK;
+}
+
+
+int ecefToGeodetic(const EcefCoordinates *ecef, GeodeticCoordinates *geodetic)
+{
+	const double a = WGS84_SEMI_MAJOR_AXIS, b = WGS84_SEMI_MINOR_AXIS, e2 = WGS84_E2;
+	double p, f, g, c, s, k, pp, q, r0, u, v, z0, w;
+
+	// Check arguments
+	if (ecef == NULL || geodetic == NULL)
+		return RETURN_VALUE_ERROR;
+
+	p = sqrt(ecef->x * ecef->x + ecef->y * ecef->y);
+	geodetic->longitude = atan2(ecef->y, ecef->x) * RADIANS_TO_DEGREES;
+
+	// On the polar axis
+	if (p < 1e-9)
+	{
+		geodetic->latitude = (ecef->z >= 0) ? 90 : -90;
+		geodetic->altitude = fabs(ecef->z) - b;
+		return RETURN_VALUE_OK;
+	}
+
+	f = 54 * b * b * ecef->z * ecef->z;
+	g = p * p + (1 - e2) * ecef->z * ecef->z - e2 * (a * a - b * b);
+	c = e2 * e2 * f * p * p / (g * g * g);
+	s = cbrt(1 + c + sqrt(c * c + 2 * c));
+	k = s + 1 + 1 / s;
+	pp = f / (3 * k * k * g * g);
+	q = sqrt(1 + 2 * e2 * e2 * pp);
+	w = 0.5 * a * a * (1 + 1 / q) - pp * (1 - e2) * ecef->z * ecef->z / (q * (1 + q)) - 0.5 * pp * p * p;
+	r0 = -(pp * e2 * p) / (1 + q) + sqrt(w > 0 ? w : 0);
+	u = sqrt((p - e2 * r0) * (p - e2 * r0) + ecef->z * ecef->z);
+	v = sqrt((p - e2 * r0) * (p - e2 * r0) + (1 - e2) * ecef->z * ecef->z);
+	z0 = b * b * ecef->z / (a * v);
+
+	geodetic->latitude = atan2(ecef->z + WGS84_EP2 * z0, p) * RADIANS_TO_DEGREES;
+	geodetic->altitude = u * (1 - b * b / (a * v));
+
+	return RETURN_VALUE_OK;
+}
+
+
+int initializeGeodesyFrame(GeodesyFrame *frame, const GeodeticCoordinates *origin)
+{
+	// Check arguments
+	if (frame == NULL || origin == NULL)
+		return RETURN_VALUE_ERROR;
+
+	pthread_once(&sineTableOnce, initializeSineTable);
+
+	frame->origin = *origin;
+	frame->sinLatitude = sin(origin->latitude * DEGREES_TO_RADIANS);
+	frame->cosLatitude = cos(origin->latitude * DEGREES_TO_RADIANS);
+	frame->sinLongitude = sin(origin->longitude * DEGREES_TO_RADIANS);
+	frame->cosLongitude = cos(origin->longitude * DEGREES_TO_RADIANS);
+	toEcef(frame->sinLatitude, frame->cosLatitude, frame->sinLongitude, frame->cosLongitude, origin->altitude, &frame->originEcef);
+
+	return RETURN_VALUE_OK;
+}
+
+
+int geodeticToNed(const GeodesyFrame *frame, const GeodeticCoordinates *geodetic, LocalNedCoordinates *ned)
+{
+	EcefCoordinates ecef;
+
+	// Check arguments
+	if (frame == NULL || ned == NULL || geodeticToEcef(geodetic, &ecef) != RETURN_VALUE_OK)
+		return RETURN_VALUE_ERROR;
+
+	toNed(frame, &ecef, ned);
+
+	return RETURN_VALUE_OK;
+}
+
+
+int geodeticToNedFast(const GeodesyFrame *frame, const GeodeticCoordinates *geodetic, LocalNedCoordinates *ned)
+{
+	double sinLatitude, cosLatitude, sinLongitude, cosLongitude;
+	EcefCoordinates ecef;
+
+	// Check arguments
+	if (frame == NULL || geodetic == NULL || ned == NULL)
+		return RETURN_VALUE_ERROR;
+
+	sinCosTable(geodetic->latitude, &sinLatitude, &cosLatitude);
+	sinCosTable(geodetic->longitude, &sinLongitude, &cosLongitude);
+	toEcef(sinLatitude, cosLatitude, sinLongitude, cosLongitude, geodetic->altitude, &ecef);
+	toNed(frame, &ecef, ned);
+
+	return RETURN_VALUE_OK;
+}
+
+
+int nedToGeodetic(const GeodesyFrame *frame, const LocalNedCoordinates *ned, GeodeticCoordinates *geodetic)
+{
+	EcefCoordinates ecef;
+	double t;
+
+	// Check arguments
+	if (frame == NULL || ned == NULL || geodetic == NULL)
+		return RETURN_VALUE_ERROR;
+
+	// Rotate back (the transpose of toNed()) and offset by the origin
+	t = -frame->sinLatitude * ned->north - frame->cosLatitude * ned->down;
+	ecef.x = frame->originEcef.x + frame->cosLongitude * t - frame->sinLongitude * ned->east;
+	ecef.y = frame->originEcef.y + frame->sinLongitude * t + frame->cosLongitude * ned->east;
+	ecef.z = frame->originEcef.z + frame->cosLatitude * ned->north - frame->sinLatitude * ned->down;
+
+	return ecefToGeodetic(&ecef, geodetic);
+}
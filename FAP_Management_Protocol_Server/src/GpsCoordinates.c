@@ -14,21 +14,12 @@
 
 // #define _GNU_SOURCE
 // Module headers
+#include "Geodesy.h"
 #include "GpsCoordinates.h"
 
 // C headers
 #include <string.h>
 #include <time.h>
-#include <math.h>
-
-
-// =========================================================
-//           DEFINES
-// =========================================================
-
-// Earth's semi-axis
-#define EARTH_SEMI_MAJOR_AXIS	6378137.0f
-#define EARTH_SEMI_MINOR_AXIS	6356752.314245f
 
 
 // =========================================================
@@ -36,43 +27,22 @@
 // =========================================================
 
 /**
- * Determine the Earth's radius at a given latitude.
- * 
- * @param latRadians 	Latitude (in radians).
- * @return				Earth's radius at the given latitude.
- */
-float earthRadiusAtLatitude(float latRadians)
-{
-	return sqrt((pow(EARTH_SEMI_MAJOR_AXIS * EARTH_SEMI_MAJOR_AXIS * cos(latRadians), 2) +
-					pow(EARTH_SEMI_MINOR_AXIS * EARTH_SEMI_MINOR_AXIS * sin(latRadians), 2)) /
-				(pow(EARTH_SEMI_MAJOR_AXIS * cos(latRadians), 2) +
-					pow(EARTH_SEMI_MINOR_AXIS * sin(latRadians), 2)));
-}
-
-
-/**
- * Convert a set of GPS RAW coordinates to NED, considering the Earth's center as the origin.
+ * Initialize the local frame at the origin coordinates.
  * 
- * @param gpsNedCoordinates		Pointer to the GpsNedCoordinates to be initialized with the converted
- * 								GpsRawCoordinates.
- * @param gpsRawCoordinates		Pointer to the source GpsRawCoordinates to be converted.
- * @param earthRadius			Earth's radius at the given latitude.
+ * @param frame					Pointer to the GeodesyFrame to be initialized.
+ * @param originRawCoordinates	Pointer to the origin coordinates corresponding to (0,0,0).
  * @return						Return RETURN_VALUE_OK if there are no errors;
  *								otherwise, return RETURN_VALUE_ERROR.
  */
-int gpsRawCoordinates2gpsNedCoordinates_EarthOrigin(GpsNedCoordinates *gpsNedCoordinates, const GpsRawCoordinates *gpsRawCoordinates, float earthRadius)
+static int initializeOriginFrame(GeodesyFrame *frame, const GpsRawCoordinates *originRawCoordinates)
 {
-	// Check arguments
-	if (gpsNedCoordinates == NULL || gpsRawCoordinates == NULL)
-		return RETURN_VALUE_ERROR;
+	GeodeticCoordinates origin;
 
-	// Convert RAW coordinates to NED
-	gpsNedCoordinates->x = earthRadius * sin(gpsRawCoordinates->latitude * M_PI / 180) * cos(gpsRawCoordinates->longitude * M_PI / 180);
-	gpsNedCoordinates->y = earthRadius * sin(gpsRawCoordinates->latitude * M_PI / 180) * sin(gpsRawCoordinates->longitude * M_PI / 180);
-	gpsNedCoordinates->z = gpsRawCoordinates->altitude;
-	strcpy(gpsNedCoordinates->timestamp, gpsRawCoordinates->timestamp);
+	origin.latitude = originRawCoordinates->latitude;
+	origin.longitude = originRawCoordinates->longitude;
+	origin.altitude = originRawCoordinates->altitude;
 
-	return RETURN_VALUE_OK;
+	return initializeGeodesyFrame(frame, &origin);
 }
 
 
@@ -162,36 +132,59 @@ int areGpsNedCoordinatesEqual(const GpsNedCoordinates *gnc1, const GpsNedCoordin
 
 int gpsRawCoordinates2gpsNedCoordinates(GpsNedCoordinates *gpsNedCoordinates, const GpsRawCoordinates *gpsRawCoordinates, const GpsRawCoordinates *originRawCoordinates)
 {
+	GeodesyFrame frame;
+	GeodeticCoordinates target;
+	LocalNedCoordinates ned;
+
 	// Check arguments
 	if (gpsNedCoordinates == NULL || gpsRawCoordinates == NULL || originRawCoordinates == NULL)
 		return RETURN_VALUE_ERROR;
 
-	// Obtain Earth's radius at the origin's latitude
-	float earthRadius = earthRadiusAtLatitude(originRawCoordinates->latitude);
-
-	// Convert origin RAW coordinates to NED
-	GpsNedCoordinates originNedCoordinates;
-	gpsRawCoordinates2gpsNedCoordinates_EarthOrigin(&originNedCoordinates, originRawCoordinates, earthRadius);
+	// WGS-84 local frame at the origin
+	initializeOriginFrame(&frame, originRawCoordinates);
 
-	// Convert target RAW coordinates to NED
-	GpsNedCoordinates targetNedCoordinates;
-	gpsRawCoordinates2gpsNedCoordinates_EarthOrigin(&targetNedCoordinates, gpsRawCoordinates, earthRadius);
-
-	// Convert absolute NED coordinates to relative (considering the origin coordinates)
-	gpsNedCoordinates->x = targetNedCoordinates.x - originNedCoordinates.x;
-	gpsNedCoordinates->y = targetNedCoordinates.y - originNedCoordinates.y;
-	gpsNedCoordinates->z = targetNedCoordinates.z - originNedCoordinates.z;
-	strcpy(gpsNedCoordinates->timestamp, targetNedCoordinates.timestamp);
+	// Convert target RAW coordinates to the local frame (z up)
+	target.latitude = gpsRawCoordinates->latitude;
+	target.longitude = gpsRawCoordinates->longitude;
+	target.altitude = gpsRawCoordinates->altitude;
+	geodeticToNed(&frame, &target, &ned);
 
+	gpsNedCoordinates->x = ned.north;
+	gpsNedCoordinates->y = ned.east;
+	gpsNedCoordinates->z = -ned.down;
+	strcpy(gpsNedCoordinates->timestamp, gpsRawCoordinates->timestamp);
 
 	return RETURN_VALUE_OK;
 }
 
 
-//int gpsNedCoordinates2gpsRawCoordinates(GpsRawCoordinates *gpsRawCoordinates, const GpsNedCoordinates *gpsNedCoordinates, const GpsRawCoordinates *originRawCoordinates)
-//{
-//	return RETURN_VALUE_OK;
-//}
+int gpsNedCoordinates2gpsRawCoordinates(GpsRawCoordinates *gpsRawCoordinates, const GpsNedCoordinates *gpsNedCoordinates, const GpsRawCoordinates *originRawCoordinates)
+{
+	GeodesyFrame frame;
+	GeodeticCoordinates target;
+	LocalNedCoordinates ned;
+
+	// Check arguments
+	if (gpsRawCoordinates == NULL || gpsNedCoordinates == NULL || originRawCoordinates == NULL)
+		return RETURN_VALUE_ERROR;
+
+	// WGS-84 local frame at the origin
+	initializeOriginFrame(&frame, originRawCoordinates);
+
+	// Convert the local coordinates (z up) back to RAW
+	ned.north = gpsNedCoordinates->x;
+	ned.east = gpsNedCoordinates->y;
+	ned.down = -gpsNedCoordinates->z;
+	if (nedToGeodetic(&frame, &ned, &target) != RETURN_VALUE_OK)
+		return RETURN_VALUE_ERROR;
+
+	gpsRawCoordinates->latitude = target.latitude;
+	gpsRawCoordinates->longitude = target.longitude;
+	gpsRawCoordinates->altitude = target.altitude;
+	strcpy(gpsRawCoordinates->timestamp, gpsNedCoordinates->timestamp);
+
+	return RETURN_VALUE_OK;
+}
 
 
 int strcpyTimestampIso8601(char *destStr, time_t timestamp)
@@ -14,6 +14,9 @@
 
 #pragma once
 
+// Module headers
+#include "Logger.h"
+
 // C headers
 #include <time.h>
 
@@ -48,13 +51,14 @@ typedef struct _GpsRawCoordinates
 
 /**
  * GPS coordinates in NED format (x, y, z), relative to a given
- * origin coordinates.
+ * origin coordinates: the WGS-84 local frame at the origin, with
+ * z pointing up (i.e. minus the frame's down).
  */
 typedef struct _GpsNedCoordinates
 {
-	float x;									// X relative to origin coordinates (in meters)
-	float y;									// Y relative to origin coordinates (in meters)
-	float z;									// Z relative to origin coordinates (in meters)
+	float x;									// North of the origin coordinates (in meters)
+	float y;									// East of the origin coordinates (in meters)
+	float z;									// Above the origin coordinates (in meters)
 	char timestamp[TIMESTAMP_ISO8601_SIZE];		// Timestamp in ISO8601 format
 } GpsNedCoordinates;
 
@@ -63,23 +67,31 @@ typedef struct _GpsNedCoordinates
 //           PUBLIC MACROS
 // =========================================================
 
+// printf() format (and arguments) of GPS RAW coordinates, on one line
+#define GPS_RAW_COORDINATES_FORMAT		"lat: %f, lon: %f, alt: %f, timestamp: %s"
+#define GPS_RAW_COORDINATES_ARGS(gpsRawCoordinates)	\
+	(gpsRawCoordinates).latitude, (gpsRawCoordinates).longitude, (gpsRawCoordinates).altitude, (gpsRawCoordinates).timestamp
+
+// printf() format (and arguments) of GPS NED coordinates, on one line
+#define GPS_NED_COORDINATES_FORMAT		"x: %f, y: %f, z: %f, timestamp: %s"
+#define GPS_NED_COORDINATES_ARGS(gpsNedCoordinates)	\
+	(gpsNedCoordinates).x, (gpsNedCoordinates).y, (gpsNedCoordinates).z, (gpsNedCoordinates).timestamp
+
 /**
- * Print GPS RAW coordinates.
+ * Log GPS RAW coordinates (as one message, through the Logger).
  * 
  * @param gpsRawCoordinates		GPS RAW coordinates.
  */
 #define PRINT_GPS_RAW_COORDINATES(gpsRawCoordinates)	\
-	printf("\tlat: %f\n\tlon: %f\n\talt: %f\n\ttimestamp: %s\n\n",	\
-		   gpsRawCoordinates.latitude, gpsRawCoordinates.longitude, gpsRawCoordinates.altitude, gpsRawCoordinates.timestamp);
+	LOGGER_INFO("GpsCoordinates", GPS_RAW_COORDINATES_FORMAT, GPS_RAW_COORDINATES_ARGS(gpsRawCoordinates))
 
 /**
- * Print GPS NED coordinates.
+ * Log GPS NED coordinates (as one message, through the Logger).
  * 
  * @param gpsNedCoordinates		GPS NED coordinates.
  */
 #define PRINT_GPS_NED_COORDINATES(gpsNedCoordinates)	\
-	printf("\tx: %f\n\ty: %f\n\tz: %f\n\ttimestamp: %s\n\n",	\
-		   gpsNedCoordinates.x, gpsNedCoordinates.y, gpsNedCoordinates.z, gpsNedCoordinates.timestamp);
+	LOGGER_INFO("GpsCoordinates", GPS_NED_COORDINATES_FORMAT, GPS_NED_COORDINATES_ARGS(gpsNedCoordinates))
 
 
 // =========================================================
@@ -174,7 +186,7 @@ int gpsRawCoordinates2gpsNedCoordinates(GpsNedCoordinates *gpsNedCoordinates, co
  * @return						Return RETURN_VALUE_OK if there are no errors;
  *								otherwise, return RETURN_VALUE_ERROR.
  */
-//int gpsNedCoordinates2gpsRawCoordinates(GpsRawCoordinates *gpsRawCoordinates, const GpsNedCoordinates *gpsNedCoordinates, const GpsRawCoordinates *originRawCoordinates);
+int gpsNedCoordinates2gpsRawCoordinates(GpsRawCoordinates *gpsRawCoordinates, const GpsNedCoordinates *gpsNedCoordinates, const GpsRawCoordinates *originRawCoordinates);
 
 /**
  * Format a string with a given timestamp in ISO8601 format
@@ -0,0 +1,282 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "Logger.h"
+
+// C headers
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+#define RED		"\x1B[31m"
+#define YEL		"\x1B[33m"
+#define BLUE	"\x1B[34m"
+#define RESET	"\x1B[0m"
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Message in the ring. Its sequence tells who owns it: a producer may fill
+ * it when it equals the producer's position, the drain thread may write it
+ * when it equals that position + 1.
+ */
+typedef struct _LogRecord
+{
+	atomic_size_t sequence;						// Owner (see above)
+	int level;									// Level
+	struct timespec time;						// When it was logged (real time)
+	const char *module;							// Module's name
+	const char *function;						// Function's name
+	char message[LOGGER_MESSAGE_SIZE];			// Formatted message
+} LogRecord;
+
+/**
+ * Asynchronous logger: a bounded multi-producer ring of records, drained
+ * by a single thread.
+ */
+typedef struct _Logger
+{
+	LogRecord *records;							// Ring
+	size_t mask;								// Capacity - 1
+	atomic_size_t head;							// Next position to be filled
+	size_t tail;								// Next position to be written (drain thread only)
+	atomic_ulong dropped;						// Messages dropped (the ring was full)
+	FILE *file;									// Destination
+	int colors;									// The destination is a terminal
+	pthread_t thread;							// Drain thread
+	atomic_int running;							// The drain thread is running
+	atomic_int started;							// Messages go through the ring
+	atomic_int producers;						// Threads logging into the ring
+} Logger;
+
+
+// =========================================================
+//           GLOBAL VARIABLES
+// =========================================================
+
+static Logger logger;
+
+static const char *levelNames[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+static const char *levelColors[] = {RESET, BLUE, YEL, RED};
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Write a message.
+ */
+static void writeMessage(FILE *file, int colors, int level, const struct timespec *time, const char *module,
+						 const char *function, const char *message)
+{
+	struct tm date;
+
+	localtime_r(&time->tv_sec, &date);
+	fprintf(file, "%s%02d:%02d:%02d.%06ld %-7s >> %s::%s(): %s%s\n", colors ? levelColors[level] : "",
+			date.tm_hour, date.tm_min, date.tm_sec, time->tv_nsec / 1000, levelNames[level], module, function, message,
+			colors ? RESET : "");
+}
+
+/**
+ * Write the messages in the ring, in order.
+ *
+ * @return		Number of messages written.
+ */
+static int drainRecords()
+{
+	int n = 0;
+
+	for (;;)
+	{
+		LogRecord *record = &logger.records[logger.tail & logger.mask];
+
+		if (atomic_load_explicit(&record->sequence, memory_order_acquire) != logger.tail + 1)
+			return n;		// Empty (or still being filled)
+
+		writeMessage(logger.file, logger.colors, record->level, &record->time, record->module, record->function, record->message);
+
+		// Hand the record back to the producers, one lap ahead
+		atomic_store_explicit(&record->sequence, logger.tail + logger.mask + 1, memory_order_release);
+		logger.tail++;
+		n++;
+	}
+}
+
+/**
+ * Drain thread.
+ */
+static void *runLogger(void *arg)
+{
+	struct timespec interval = {0, LOGGER_DRAIN_INTERVAL_MS * 1000000L};
+
+	while (atomic_load(&logger.running))
+	{
+		if (drainRecords() == 0)
+		{
+			fflush(logger.file);
+			nanosleep(&interval, NULL);
+		}
+	}
+
+	drainRecords();
+	fflush(logger.file);
+
+	return NULL;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeLogger(const char *path, size_t capacity)
+{
+	if (capacity == 0)
+		capacity = LOGGER_DEFAULT_CAPACITY;
+
+	// Check arguments
+	if ((capacity & (capacity - 1)) != 0 || atomic_load(&logger.started))
+		return RETURN_VALUE_ERROR;
+
+	if ((logger.records = malloc(capacity * sizeof(LogRecord))) == NULL)
+		return RETURN_VALUE_ERROR;
+
+	if ((logger.file = (path != NULL) ? fopen(path, "a") : stdout) == NULL)
+	{
+		free(logger.records);
+		logger.records = NULL;
+		return RETURN_VALUE_ERROR;
+	}
+
+	for (size_t i = 0; i < capacity; i++)
+		atomic_init(&logger.records[i].sequence, i);
+	logger.mask = capacity - 1;
+	logger.tail = 0;
+	logger.colors = (path == NULL && isatty(STDOUT_FILENO));
+	atomic_store(&logger.head, 0);
+	atomic_store(&logger.dropped, 0);
+
+	atomic_store(&logger.running, 1);
+	if (pthread_create(&logger.thread, NULL, runLogger, NULL) != 0)
+	{
+		if (path != NULL)
+			fclose(logger.file);
+		free(logger.records);
+		logger.records = NULL;
+		return RETURN_VALUE_ERROR;
+	}
+	atomic_store(&logger.started, 1);
+
+	return RETURN_VALUE_OK;
+}
+
+
+void terminateLogger()
+{
+	if (!atomic_exchange(&logger.started, 0))
+		return;
+
+	// Messages logged from now on are written synchronously; the ring is drained first
+	while (atomic_load(&logger.producers) > 0)
+		sched_yield();
+	atomic_store(&logger.running, 0);
+	pthread_join(logger.thread, NULL);
+
+	if (logger.file != stdout)
+		fclose(logger.file);
+	free(logger.records);
+	logger.records = NULL;
+}
+
+
+void logMessage(int level, const char *module, const char *function, const char *format, ...)
+{
+	LogRecord *record;
+	struct timespec now;
+	size_t position;
+	va_list args;
+
+	if (level < LOGGER_LEVEL_DEBUG || level > LOGGER_LEVEL_ERROR)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	// Not started: synchronously, to the standard output
+	atomic_fetch_add(&logger.producers, 1);
+	if (!atomic_load(&logger.started))
+	{
+		char message[LOGGER_MESSAGE_SIZE];
+
+		atomic_fetch_sub(&logger.producers, 1);
+
+		va_start(args, format);
+		vsnprintf(message, sizeof(message), format, args);
+		va_end(args);
+		writeMessage(stdout, 0, level, &now, module, function, message);
+		return;
+	}
+
+	// Claim a record (a free one: its sequence equals the position)
+	position = atomic_load_explicit(&logger.head, memory_order_relaxed);
+	for (;;)
+	{
+		intptr_t difference;
+
+		record = &logger.records[position & logger.mask];
+		difference = (intptr_t) atomic_load_explicit(&record->sequence, memory_order_acquire) - (intptr_t) position;
+
+		if (difference == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&logger.head, &position, position + 1,
+													  memory_order_relaxed, memory_order_relaxed))
+				break;
+		}
+		else if (difference < 0)
+		{
+			// Full: drop rather than block
+			atomic_fetch_add_explicit(&logger.dropped, 1, memory_order_relaxed);
+			atomic_fetch_sub(&logger.producers, 1);
+			return;
+		}
+		else
+			position = atomic_load_explicit(&logger.head, memory_order_relaxed);
+	}
+
+	record->level = level;
+	record->time = now;
+	record->module = module;
+	record->function = function;
+	va_start(args, format);
+	vsnprintf(record->message, sizeof(record->message), format, args);
+	va_end(args);
+
+	// Hand the record to the drain thread
+	atomic_store_explicit(&record->sequence, position + 1, memory_order_release);
+	atomic_fetch_sub(&logger.producers, 1);
+}
+
+
+unsigned long getLoggerDropped()
+{
+	return atomic_load(&logger.dropped);
+}
@@ -0,0 +1,113 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <stddef.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK						0
+#define RETURN_VALUE_ERROR					(-1)
+
+// Levels
+#define LOGGER_LEVEL_DEBUG					0
+#define LOGGER_LEVEL_INFO					1
+#define LOGGER_LEVEL_WARNING				2
+#define LOGGER_LEVEL_ERROR					3
+#define LOGGER_LEVEL_NONE					4
+
+// Messages below this level are compiled out (e.g. -DLOGGER_COMPILE_LEVEL=LOGGER_LEVEL_DEBUG)
+#ifndef LOGGER_COMPILE_LEVEL
+#define LOGGER_COMPILE_LEVEL				LOGGER_LEVEL_INFO
+#endif
+
+// Records in the ring (a power of 2)
+#define LOGGER_DEFAULT_CAPACITY				4096
+
+// Longest message (longer ones are truncated)
+#define LOGGER_MESSAGE_SIZE					224
+
+// Time the drain thread sleeps when the ring is empty (in ms)
+#define LOGGER_DRAIN_INTERVAL_MS			10
+
+
+// =========================================================
+//           MACROS
+// =========================================================
+
+/**
+ * Log a message (printf() format) from a module, if its level is compiled
+ * in. Compiled-out messages still have their format checked, but cost
+ * nothing (not even the evaluation of their arguments).
+ *
+ * @param level		Level.
+ * @param module	Module's name.
+ * @param ...		Format and arguments.
+ */
+#define LOGGER_LOG(level, module, ...)									\
+	do																	\
+	{																	\
+		if ((level) >= LOGGER_COMPILE_LEVEL)							\
+			logMessage((level), (module), __func__, __VA_ARGS__);		\
+	} while (0)
+
+#define LOGGER_DEBUG(module, ...)			LOGGER_LOG(LOGGER_LEVEL_DEBUG, module, __VA_ARGS__)
+#define LOGGER_INFO(module, ...)			LOGGER_LOG(LOGGER_LEVEL_INFO, module, __VA_ARGS__)
+#define LOGGER_WARNING(module, ...)			LOGGER_LOG(LOGGER_LEVEL_WARNING, module, __VA_ARGS__)
+#define LOGGER_ERROR(module, ...)			LOGGER_LOG(LOGGER_LEVEL_ERROR, module, __VA_ARGS__)
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Start the (process-wide) asynchronous logger: messages are formatted into
+ * a lock-free ring, and written by a background thread, so logging never
+ * blocks (when the ring is full, messages are dropped and counted).
+ * Until it is started (and after it is terminated), messages are written
+ * synchronously to the standard output.
+ *
+ * @param path				File the messages are appended to (NULL for the
+ *							standard output, colored if a terminal).
+ * @param capacity			Records in the ring (a power of 2; 0 for the default).
+ * @return					Return RETURN_VALUE_OK if there are no errors;
+ *							otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeLogger(const char *path, size_t capacity);
+
+/**
+ * Stop the asynchronous logger, once every logged message is written.
+ */
+void terminateLogger();
+
+/**
+ * Log a message (use the LOGGER_* macros instead, which compile out the
+ * levels below LOGGER_COMPILE_LEVEL). Safe to call from any thread.
+ *
+ * @param level				Level.
+ * @param module			Module's name (a string literal).
+ * @param function			Function's name (a string literal).
+ * @param format			printf() format.
+ * @param ...				Arguments.
+ */
+void logMessage(int level, const char *module, const char *function, const char *format, ...)
+	__attribute__((format(printf, 4, 5)));
+
+/**
+ * Number of messages dropped because the ring was full.
+ *
+ * @return					Dropped messages.
+ */
+unsigned long getLoggerDropped();
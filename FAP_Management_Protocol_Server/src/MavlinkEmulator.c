@@ -9,12 +9,14 @@
 // =========================================================
 // IMPORTANT NOTE:
 //
-// These files should not be modified.
+// The API of the default emulator (initializeMavlink() and the
+// sendMavlinkMsg_*() functions) should not be modified.
 // =========================================================
 
 // Module headers
 #include "MavlinkEmulator.h"
 #include "GpsCoordinates.h"
+#include "Logger.h"
 
 // C headers
 #include <stdio.h>
@@ -36,14 +38,8 @@
 //           GLOBAL VARIABLES
 // =========================================================
 
-// Flag indicating if the MAVLink emulator was initialized
-static int mavlinkEmulatorInitialized = 0;
-
-// Origin GPS RAW coordinates, cooresponding to (0,0,0)
-static GpsRawCoordinates fapOriginRawCoordinates = {0};
-
-// FAP's GPS NED coordinates
-static GpsNedCoordinates fapGpsNedCoordinates = {0};
+// Emulator driven by initializeMavlink() and the sendMavlinkMsg_*() functions
+static MavlinkEmulator defaultMavlinkEmulator = {0};
 
 
 // =========================================================
@@ -51,90 +47,81 @@ static GpsNedCoordinates fapGpsNedCoordinates = {0};
 // =========================================================
 
 /**
- * Helper function to print a message inside the MAVLink emulator library.
+ * Helper functions to log a message of a FAP's MAVLink emulator.
  * 
- * @param ...	Variable arguments to be passed to the printf().
+ * @param emulator	Pointer to the MavlinkEmulator.
+ * @param format	printf() format.
+ * @param ...		Variable arguments to be passed to the printf().
  */
-#define MAVLINK_EMULATOR_PRINT(...)                     \
-	do                                                  \
-	{                                                   \
-		printf(">> MavlinkEmulator::%s(): ", __func__); \
-		printf(__VA_ARGS__);                            \
-		printf("\n");                                   \
-	} while (0);
+#define MAVLINK_EMULATOR_PRINT(emulator, format, ...)		\
+	LOGGER_INFO("MavlinkEmulator", "#%d: " format, (emulator)->id, ##__VA_ARGS__)
+
+#define MAVLINK_EMULATOR_PRINT_DEBUG(emulator, format, ...)	\
+	LOGGER_DEBUG("MavlinkEmulator", "#%d: " format, (emulator)->id, ##__VA_ARGS__)
+
+#define MAVLINK_EMULATOR_PRINT_ERROR(emulator, format, ...)	\
+	LOGGER_ERROR("MavlinkEmulator", "#%d: " format, (emulator)->id, ##__VA_ARGS__)
 
 
 
 // =========================================================
 //           PUBLIC API
 // =========================================================
-int initializeMavlink()
+int initializeMavlinkEmulator(MavlinkEmulator *emulator, int id, const GpsRawCoordinates *originRawCoordinates)
 {
-	// Check if the MAVLink emulator was already initialized
-	if (mavlinkEmulatorInitialized)
-	{
-		MAVLINK_EMULATOR_PRINT("ERROR: MAVLink emulator was already initialized");
+	// Check arguments
+	if (emulator == NULL)
 		return RETURN_VALUE_ERROR;
-	}
 
-	// Initialize the FAP's coordinates
-	initializeGpsRawCoordinates(&fapOriginRawCoordinates,
-								ORIGIN_DEFAULT_RAW_COORDINATES_LATITUDE,
-								ORIGIN_DEFAULT_RAW_COORDINATES_LONGITUDE,
-								ORIGIN_DEFAULT_RAW_COORDINATES_ALTITUDE,
-								time(NULL));
+	emulator->id = id;
 
-	initializeGpsNedCoordinates(&fapGpsNedCoordinates,
+	// Initialize the FAP's coordinates
+	if (originRawCoordinates != NULL)
+		copyGpsRawCoordinates(&emulator->originRawCoordinates, originRawCoordinates);
+	else
+		initializeGpsRawCoordinates(&emulator->originRawCoordinates,
+									ORIGIN_DEFAULT_RAW_COORDINATES_LATITUDE,
+									ORIGIN_DEFAULT_RAW_COORDINATES_LONGITUDE,
+									ORIGIN_DEFAULT_RAW_COORDINATES_ALTITUDE,
+									time(NULL));
+
+	initializeGpsNedCoordinates(&emulator->gpsNedCoordinates,
 								0,
 								0,
 								0,
 								time(NULL));
 
-	
 	// Initialize MAVLink emulator
-	mavlinkEmulatorInitialized = 1;
-	MAVLINK_EMULATOR_PRINT("MAVLink emulator initialized");
+	emulator->initialized = 1;
+	MAVLINK_EMULATOR_PRINT(emulator, "MAVLink emulator initialized");
 
 	return RETURN_VALUE_OK;
 }
 
 
-int terminateMavlink()
+int terminateMavlinkEmulator(MavlinkEmulator *emulator)
 {
 	// Check if the MAVLink emulator is intialized
-	if (!mavlinkEmulatorInitialized)
+	if (!emulator->initialized)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: Trying to terminate MAVLink emulator, but it is not yet initialized");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "Trying to terminate MAVLink emulator, but it is not yet initialized");
 		return RETURN_VALUE_ERROR;
 	}
 
-	// Reset the FAP's coordinates
-	initializeGpsRawCoordinates(&fapOriginRawCoordinates,
-								ORIGIN_DEFAULT_RAW_COORDINATES_LATITUDE,
-								ORIGIN_DEFAULT_RAW_COORDINATES_LONGITUDE,
-								ORIGIN_DEFAULT_RAW_COORDINATES_ALTITUDE,
-								time(NULL));
-
-	initializeGpsNedCoordinates(&fapGpsNedCoordinates,
-								0,
-								0,
-								0,
-								time(NULL));
-
 	// Terminate MAVLink emulator
-	mavlinkEmulatorInitialized = 0;
-	MAVLINK_EMULATOR_PRINT("MAVLink emulator terminated");
+	emulator->initialized = 0;
+	MAVLINK_EMULATOR_PRINT(emulator, "MAVLink emulator terminated");
 
 	return RETURN_VALUE_OK;
 }
 
 
-int sendMavlinkMsg_heartbeat()
+int sendMavlinkEmulatorMsg_heartbeat(MavlinkEmulator *emulator)
 {
 	// Check if the MAVLink emulator is initialized
-	if (!mavlinkEmulatorInitialized)
+	if (!emulator->initialized)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: MAVLink emulator was not yet initialized");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "MAVLink emulator was not yet initialized");
 		return RETURN_VALUE_ERROR;
 	}
 
@@ -142,101 +129,146 @@ int sendMavlinkMsg_heartbeat()
 	char timeStr[TIMESTAMP_ISO8601_SIZE];
 	strcpyTimestampIso8601(timeStr, time(NULL));
 
-	// Print
-	MAVLINK_EMULATOR_PRINT("Heartbeat received on %s", timeStr);
+	// Print (debug: sent every heartbeat period)
+	MAVLINK_EMULATOR_PRINT_DEBUG(emulator, "Heartbeat received on %s", timeStr);
 
 	return RETURN_VALUE_OK;
 }
 
 
-int sendMavlinkMsg_localPositionNed(GpsNedCoordinates *gpsNedCoordinates)
+int sendMavlinkEmulatorMsg_localPositionNed(MavlinkEmulator *emulator, GpsNedCoordinates *gpsNedCoordinates)
 {
 	// Check arguments
 	if (gpsNedCoordinates == NULL)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: Invalid pointer");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "Invalid pointer");
 		return RETURN_VALUE_ERROR;
 	}
 
 	// Check if the MAVLink emulator is initialized
-	if (!mavlinkEmulatorInitialized)
+	if (!emulator->initialized)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: MAVLink emulator was not yet initialized");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "MAVLink emulator was not yet initialized");
 		return RETURN_VALUE_ERROR;
 	}
 
 	// Initialize gpsNedCoordinates with the FAP's current coordinates
-	if (copyGpsNedCoordinates(gpsNedCoordinates, &fapGpsNedCoordinates) != RETURN_VALUE_OK)
+	if (copyGpsNedCoordinates(gpsNedCoordinates, &emulator->gpsNedCoordinates) != RETURN_VALUE_OK)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: Copying GPS NED Coordinates");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "Copying GPS NED Coordinates");
 		return RETURN_VALUE_ERROR;
 	}
 
-	// Print
-	MAVLINK_EMULATOR_PRINT("Local position NED:");
-	PRINT_GPS_NED_COORDINATES(fapGpsNedCoordinates);
+	// Print (debug: polled along with the heartbeats)
+	MAVLINK_EMULATOR_PRINT_DEBUG(emulator, "Local position NED: " GPS_NED_COORDINATES_FORMAT,
+								 GPS_NED_COORDINATES_ARGS(emulator->gpsNedCoordinates));
 
 	return RETURN_VALUE_OK;
 }
 
 
-int sendMavlinkMsg_gpsGlobalOrigin(GpsRawCoordinates *originRawCoordinates)
+int sendMavlinkEmulatorMsg_gpsGlobalOrigin(MavlinkEmulator *emulator, GpsRawCoordinates *originRawCoordinates)
 {
 	// Check arguments
 	if (originRawCoordinates == NULL)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: Invalid pointer");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "Invalid pointer");
 		return RETURN_VALUE_ERROR;
 	}
 
 	// Check if the MAVLink emulator is initialized
-	if (!mavlinkEmulatorInitialized)
+	if (!emulator->initialized)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: MAVLink emulator was not yet initialized");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "MAVLink emulator was not yet initialized");
 		return RETURN_VALUE_ERROR;
 	}
 
 	// Initialize origin coordinates
-	if (copyGpsRawCoordinates(originRawCoordinates, &fapOriginRawCoordinates) != RETURN_VALUE_OK)
+	if (copyGpsRawCoordinates(originRawCoordinates, &emulator->originRawCoordinates) != RETURN_VALUE_OK)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: Copying GPS RAW Coordinates");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "Copying GPS RAW Coordinates");
 		return RETURN_VALUE_ERROR;
 	}
 
 	// Print
-	MAVLINK_EMULATOR_PRINT("GPS global origin:");
-	PRINT_GPS_RAW_COORDINATES(fapOriginRawCoordinates);
+	MAVLINK_EMULATOR_PRINT(emulator, "GPS global origin: " GPS_RAW_COORDINATES_FORMAT,
+						   GPS_RAW_COORDINATES_ARGS(emulator->originRawCoordinates));
 
 	return RETURN_VALUE_OK;
 }
 
 
-int sendMavlinkMsg_setPositionTargetLocalNed(const GpsNedCoordinates *gpsNedCoordinates)
+int sendMavlinkEmulatorMsg_setPositionTargetLocalNed(MavlinkEmulator *emulator, const GpsNedCoordinates *gpsNedCoordinates)
 {
 	// Check arguments
 	if (gpsNedCoordinates == NULL)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: Invalid pointer");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "Invalid pointer");
 		return RETURN_VALUE_ERROR;
 	}
 
 	// Check if the MAVLink emulator is initialized
-	if (!mavlinkEmulatorInitialized)
+	if (!emulator->initialized)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: MAVLink emulator was not yet initialized");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "MAVLink emulator was not yet initialized");
 		return RETURN_VALUE_ERROR;
 	}
 
-	// Update fapGpsNedCoordinates with the provided coordinates
-	if (copyGpsNedCoordinates(&fapGpsNedCoordinates, gpsNedCoordinates) != RETURN_VALUE_OK)
+	// Update the FAP's coordinates with the provided coordinates
+	if (copyGpsNedCoordinates(&emulator->gpsNedCoordinates, gpsNedCoordinates) != RETURN_VALUE_OK)
 	{
-		MAVLINK_EMULATOR_PRINT("ERROR: Copying GPS NED Coordinates");
+		MAVLINK_EMULATOR_PRINT_ERROR(emulator, "Copying GPS NED Coordinates");
 		return RETURN_VALUE_ERROR;
 	}
 
 	// Print
-	MAVLINK_EMULATOR_PRINT("Set position target local NED:");
-	PRINT_GPS_NED_COORDINATES(fapGpsNedCoordinates);
+	MAVLINK_EMULATOR_PRINT(emulator, "Set position target local NED: " GPS_NED_COORDINATES_FORMAT,
+						   GPS_NED_COORDINATES_ARGS(emulator->gpsNedCoordinates));
 
 	return RETURN_VALUE_OK;
-}
\ No newline at end of file
+}
+
+
+// ----- Default instance ----- //
+
+int initializeMavlink()
+{
+	// Check if the MAVLink emulator was already initialized
+	if (defaultMavlinkEmulator.initialized)
+	{
+		MAVLINK_EMULATOR_PRINT_ERROR(&defaultMavlinkEmulator, "MAVLink emulator was already initialized");
+		return RETURN_VALUE_ERROR;
+	}
+
+	return initializeMavlinkEmulator(&defaultMavlinkEmulator, 0, NULL);
+}
+
+
+int terminateMavlink()
+{
+	return terminateMavlinkEmulator(&defaultMavlinkEmulator);
+}
+
+
+int sendMavlinkMsg_heartbeat()
+{
+	return sendMavlinkEmulatorMsg_heartbeat(&defaultMavlinkEmulator);
+}
+
+
+int sendMavlinkMsg_localPositionNed(GpsNedCoordinates *gpsNedCoordinates)
+{
+	return sendMavlinkEmulatorMsg_localPositionNed(&defaultMavlinkEmulator, gpsNedCoordinates);
+}
+
+
+int sendMavlinkMsg_gpsGlobalOrigin(GpsRawCoordinates *originRawCoordinates)
+{
+	return sendMavlinkEmulatorMsg_gpsGlobalOrigin(&defaultMavlinkEmulator, originRawCoordinates);
+}
+
+
+int sendMavlinkMsg_setPositionTargetLocalNed(const GpsNedCoordinates *gpsNedCoordinates)
+{
+	return sendMavlinkEmulatorMsg_setPositionTargetLocalNed(&defaultMavlinkEmulator, gpsNedCoordinates);
+}
@@ -9,7 +9,8 @@
 // =========================================================
 // IMPORTANT NOTE:
 //
-// These files should not be modified.
+// The API of the default emulator (initializeMavlink() and the
+// sendMavlinkMsg_*() functions) should not be modified.
 // =========================================================
 
 #pragma once
@@ -27,12 +28,93 @@
 #define RETURN_VALUE_ERROR			(-1)
 
 
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * MAVLink protocol emulator of one FAP. Any number of instances may be
+ * driven at once, one per FAP; initializeMavlink() and the sendMavlinkMsg_*()
+ * functions drive a default instance.
+ */
+typedef struct _MavlinkEmulator
+{
+	int id;										// FAP number (system ID)
+	int initialized;							// True (1) while initialized
+	GpsRawCoordinates originRawCoordinates;		// Origin GPS RAW coordinates, corresponding to (0,0,0)
+	GpsNedCoordinates gpsNedCoordinates;		// FAP's GPS NED coordinates
+} MavlinkEmulator;
+
+
 // =========================================================
 //           PUBLIC API
 // =========================================================
 
 /**
- * Initialize the MAVLink protocol emulator.
+ * Initialize the MAVLink protocol emulator of a FAP.
+ *
+ * @param emulator				Pointer to the MavlinkEmulator to be initialized.
+ * @param id					FAP number.
+ * @param originRawCoordinates	Pointer to the GPS RAW coordinates of the origin (0,0,0);
+ *								NULL for the default origin.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeMavlinkEmulator(MavlinkEmulator *emulator, int id, const GpsRawCoordinates *originRawCoordinates);
+
+/**
+ * Terminate the MAVLink protocol emulator of a FAP.
+ *
+ * @param emulator				Pointer to the MavlinkEmulator.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int terminateMavlinkEmulator(MavlinkEmulator *emulator);
+
+/**
+ * Send a MAVLink message to the FAP's Autopilot (emulated) - HEARTBEAT.
+ *
+ * @param emulator				Pointer to the MavlinkEmulator.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int sendMavlinkEmulatorMsg_heartbeat(MavlinkEmulator *emulator);
+
+/**
+ * Send a MAVLink message to the FAP's Autopilot (emulated) - LOCAL_POSITION_NED.
+ *
+ * @param emulator				Pointer to the MavlinkEmulator.
+ * @param gpsNedCoordinates		Pointer to the GPS NED coordinates to be initialized
+ *								with the FAP's GPS NED coordinates.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int sendMavlinkEmulatorMsg_localPositionNed(MavlinkEmulator *emulator, GpsNedCoordinates *gpsNedCoordinates);
+
+/**
+ * Send a MAVLink message to the FAP's Autopilot (emulated) - GPS_GLOBAL_ORIGIN.
+ *
+ * @param emulator				Pointer to the MavlinkEmulator.
+ * @param originRawCoordinates	Pointer to the GPS RAW coordinates to be initialized
+ *								with the coordinates corresponding to the origin (0,0,0).
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int sendMavlinkEmulatorMsg_gpsGlobalOrigin(MavlinkEmulator *emulator, GpsRawCoordinates *originRawCoordinates);
+
+/**
+ * Send a MAVLink message to the FAP's Autopilot (emulated) - SET_POSITION_TARGET_LOCAL_NED.
+ *
+ * @param emulator				Pointer to the MavlinkEmulator.
+ * @param gpsNedCoordinates		Pointer to the target GPS NED coordinates.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int sendMavlinkEmulatorMsg_setPositionTargetLocalNed(MavlinkEmulator *emulator, const GpsNedCoordinates *gpsNedCoordinates);
+
+
+/**
+ * Initialize the MAVLink protocol emulator (default instance).
  * 
  * @return		Return RETURN_VALUE_OK if there are no errors;
  * 				otherwise, return RETURN_VALUE_ERROR.
@@ -40,7 +122,7 @@
 int initializeMavlink();
 
 /**
- * Terminate the MAVLink protocol emulator.
+ * Terminate the MAVLink protocol emulator (default instance).
  * 
  * @return		Return RETURN_VALUE_OK if there are no errors;
  * 				otherwise, return RETURN_VALUE_ERROR.
@@ -0,0 +1,196 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "MavlinkIngest.h"
+
+// C headers
+#include <string.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Offsets in a MAVLink v2 frame
+#define FRAME_LEN_OFFSET				1
+#define FRAME_INCOMPAT_FLAGS_OFFSET		2
+#define FRAME_COMPAT_FLAGS_OFFSET		3
+#define FRAME_SEQ_OFFSET				4
+#define FRAME_SYSID_OFFSET				5
+#define FRAME_COMPID_OFFSET				6
+#define FRAME_MSGID_OFFSET				7
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Call the subscribers of a message.
+ */
+static void dispatchMessage(const MavlinkIngest *ingest, const mavlink_message_t *msg)
+{
+	for (int s = 0; s < ingest->nSubscriptions; s++)
+	{
+		const MavlinkSubscription *subscription = &ingest->subscriptions[s];
+
+		if (subscription->msgid == msg->msgid || subscription->msgid == MAVLINK_INGEST_ANY_MESSAGE)
+			subscription->callback(msg, subscription->context);
+	}
+}
+
+/**
+ * Check and decode the frame starting at an STX.
+ *
+ * @return		Length of the frame if it is valid; 0 otherwise.
+ */
+static size_t decodeFrame(MavlinkIngest *ingest, const uint8_t *frame, size_t available, mavlink_message_t *msg)
+{
+	const mavlink_msg_entry_t *entry;
+	uint8_t payloadLength, incompatFlags;
+	uint32_t msgid;
+	size_t length;
+	uint16_t crc;
+
+	if (available < MAVLINK_NUM_HEADER_BYTES + MAVLINK_NUM_CHECKSUM_BYTES)
+		return 0;
+
+	payloadLength = frame[FRAME_LEN_OFFSET];
+	incompatFlags = frame[FRAME_INCOMPAT_FLAGS_OFFSET];
+	if (incompatFlags & ~MAVLINK_IFLAG_MASK)
+		return 0;
+
+	length = MAVLINK_NUM_HEADER_BYTES + payloadLength + MAVLINK_NUM_CHECKSUM_BYTES
+			 + ((incompatFlags & MAVLINK_IFLAG_SIGNED) ? MAVLINK_SIGNATURE_BLOCK_LEN : 0);
+	if (length > available)
+		return 0;
+
+	msgid = frame[FRAME_MSGID_OFFSET] | (frame[FRAME_MSGID_OFFSET + 1] << 8) | ((uint32_t) frame[FRAME_MSGID_OFFSET + 2] << 16);
+	if ((entry = mavlink_get_msg_entry(msgid)) == NULL)
+	{
+		ingest->unknown++;
+		return 0;
+	}
+
+	// The CRC covers the header (but the STX) and the payload, then the CRC extra
+	crc = crc_calculate(frame + 1, MAVLINK_NUM_HEADER_BYTES - 1 + payloadLength);
+	crc_accumulate(entry->crc_extra, &crc);
+	if ((crc & 0xFF) != frame[MAVLINK_NUM_HEADER_BYTES + payloadLength]
+			|| (crc >> 8) != frame[MAVLINK_NUM_HEADER_BYTES + payloadLength + 1])
+	{
+		ingest->badCrc++;
+		return 0;
+	}
+
+	msg->checksum = crc;
+	msg->magic = MAVLINK_STX;
+	msg->len = payloadLength;
+	msg->incompat_flags = incompatFlags;
+	msg->compat_flags = frame[FRAME_COMPAT_FLAGS_OFFSET];
+	msg->seq = frame[FRAME_SEQ_OFFSET];
+	msg->sysid = frame[FRAME_SYSID_OFFSET];
+	msg->compid = frame[FRAME_COMPID_OFFSET];
+	msg->msgid = msgid;
+	memcpy(_MAV_PAYLOAD_NON_CONST(msg), frame + MAVLINK_NUM_HEADER_BYTES, payloadLength);
+
+	// Trailing zeros of the payload are trimmed by the sender
+	if (payloadLength < entry->msg_len)
+		memset(_MAV_PAYLOAD_NON_CONST(msg) + payloadLength, 0, entry->msg_len - payloadLength);
+
+	msg->ck[0] = crc & 0xFF;
+	msg->ck[1] = crc >> 8;
+	if (incompatFlags & MAVLINK_IFLAG_SIGNED)
+		memcpy(msg->signature, frame + length - MAVLINK_SIGNATURE_BLOCK_LEN, MAVLINK_SIGNATURE_BLOCK_LEN);
+
+	return length;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+void initializeMavlinkIngest(MavlinkIngest *ingest)
+{
+	memset(ingest, 0, sizeof(*ingest));
+	initializeDatagramBatch(&ingest->datagrams);
+}
+
+
+int subscribeMavlinkIngest(MavlinkIngest *ingest, uint32_t msgid, MavlinkSubscriber callback, void *context)
+{
+	// Check arguments
+	if (callback == NULL || ingest->nSubscriptions == MAVLINK_INGEST_MAX_SUBSCRIPTIONS)
+		return RETURN_VALUE_ERROR;
+
+	ingest->subscriptions[ingest->nSubscriptions].msgid = msgid;
+	ingest->subscriptions[ingest->nSubscriptions].callback = callback;
+	ingest->subscriptions[ingest->nSubscriptions].context = context;
+	ingest->nSubscriptions++;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int parseMavlinkFrames(MavlinkIngest *ingest, const uint8_t *buffer, size_t length)
+{
+	const uint8_t *cursor = buffer, *end = buffer + length;
+	mavlink_message_t msg;
+	int frames = 0;
+
+	while (cursor < end)
+	{
+		const uint8_t *stx = memchr(cursor, MAVLINK_STX, end - cursor);
+		size_t frameLength;
+
+		if (stx == NULL)
+		{
+			ingest->skippedBytes += end - cursor;
+			break;
+		}
+		ingest->skippedBytes += stx - cursor;
+
+		// Not a frame (or a corrupted one): resume at the next byte
+		if ((frameLength = decodeFrame(ingest, stx, end - stx, &msg)) == 0)
+		{
+			ingest->skippedBytes++;
+			cursor = stx + 1;
+			continue;
+		}
+
+		ingest->frames++;
+		frames++;
+		dispatchMessage(ingest, &msg);
+		cursor = stx + frameLength;
+	}
+
+	return frames;
+}
+
+
+int receiveMavlinkIngest(MavlinkIngest *ingest, int fd, const struct in_addr *source)
+{
+	DatagramBatch *datagrams = &ingest->datagrams;
+	int n, frames = 0;
+
+	do
+	{
+		if ((n = receiveDatagramBatch(datagrams, fd)) < 0)
+			return RETURN_VALUE_ERROR;
+
+		for (int i = 0; i < n; i++)
+		{
+			if (source != NULL && datagrams->addresses[i].sin_addr.s_addr != source->s_addr)
+				continue;
+
+			frames += parseMavlinkFrames(ingest, (const uint8_t *) datagrams->payloads[i], datagrams->lengths[i]);
+		}
+	} while (n == DATAGRAM_BATCH_SIZE);
+
+	return frames;
+}
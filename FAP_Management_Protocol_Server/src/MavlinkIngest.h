@@ -0,0 +1,131 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// Module headers
+#include "DatagramBatch.h"
+
+// C headers
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// MAVLink library (its packed structs trip -Waddress-of-packed-member)
+// [https://mavlink.io/en/getting_started/use_source.html]
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Waddress-of-packed-member"
+#include "mavlink/common/mavlink.h"
+#pragma GCC diagnostic pop
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK						0
+#define RETURN_VALUE_ERROR					(-1)
+
+// Maximum number of subscriptions
+#define MAVLINK_INGEST_MAX_SUBSCRIPTIONS	16
+
+// Message ID of a subscription to every message
+#define MAVLINK_INGEST_ANY_MESSAGE			UINT32_MAX
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Subscriber of decoded MAVLink messages.
+ *
+ * @param msg			Decoded message (its payload is zero-extended to the
+ *						message's full length).
+ * @param context		Context given on subscription.
+ */
+typedef void (*MavlinkSubscriber)(const mavlink_message_t *msg, void *context);
+
+/**
+ * Subscription to a MAVLink message.
+ */
+typedef struct _MavlinkSubscription
+{
+	uint32_t msgid;								// Message ID (or MAVLINK_INGEST_ANY_MESSAGE)
+	MavlinkSubscriber callback;					// Subscriber
+	void *context;								// Subscriber's context
+} MavlinkSubscription;
+
+/**
+ * MAVLink ingest pipeline: datagrams are received in batches (one
+ * recvmmsg()), framed a whole buffer at a time (jumping to each STX with
+ * memchr(), instead of feeding the bytes one by one to a state machine),
+ * checked against their CRC (with the message's CRC extra), and dispatched
+ * to the subscribers of their message ID.
+ *
+ * Only MAVLink v2 frames are framed; MAVLink v1 frames and unknown messages
+ * (whose CRC can't be checked) are skipped. Each buffer holds whole frames
+ * (as UDP datagrams do). Signatures are not checked.
+ */
+typedef struct _MavlinkIngest
+{
+	DatagramBatch datagrams;					// Datagrams being framed
+	MavlinkSubscription subscriptions[MAVLINK_INGEST_MAX_SUBSCRIPTIONS];
+	int nSubscriptions;							// Number of subscriptions
+	unsigned long frames;						// Valid frames
+	unsigned long badCrc;						// Frames with a wrong CRC
+	unsigned long unknown;						// Frames of unknown messages
+	unsigned long skippedBytes;					// Bytes outside of valid frames
+} MavlinkIngest;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize a MAVLink ingest pipeline (without subscriptions).
+ *
+ * @param ingest				Pointer to the MavlinkIngest to be initialized.
+ */
+void initializeMavlinkIngest(MavlinkIngest *ingest);
+
+/**
+ * Subscribe to a MAVLink message. Subscribers are called in subscription
+ * order, from the thread framing the messages.
+ *
+ * @param ingest				Pointer to the MavlinkIngest.
+ * @param msgid					Message ID (MAVLINK_INGEST_ANY_MESSAGE for every message).
+ * @param callback				Subscriber.
+ * @param context				Subscriber's context.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise (too many subscriptions), return RETURN_VALUE_ERROR.
+ */
+int subscribeMavlinkIngest(MavlinkIngest *ingest, uint32_t msgid, MavlinkSubscriber callback, void *context);
+
+/**
+ * Frame the MAVLink frames of a buffer, dispatching each valid one.
+ *
+ * @param ingest				Pointer to the MavlinkIngest.
+ * @param buffer				Buffer (whole frames).
+ * @param length				Buffer's length.
+ * @return						Number of valid frames.
+ */
+int parseMavlinkFrames(MavlinkIngest *ingest, const uint8_t *buffer, size_t length);
+
+/**
+ * Receive and frame every datagram available on a non-blocking socket.
+ *
+ * @param ingest				Pointer to the MavlinkIngest.
+ * @param fd					Socket.
+ * @param source				Only frame datagrams from this address (NULL for any).
+ * @return						Number of valid frames; or RETURN_VALUE_ERROR on
+ *								socket errors.
+ */
+int receiveMavlinkIngest(MavlinkIngest *ingest, int fd, const struct in_addr *source);
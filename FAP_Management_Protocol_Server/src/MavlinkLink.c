@@ -0,0 +1,330 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "MavlinkLink.h"
+
+// C headers
+#include <arpa/inet.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// SET_POSITION_TARGET_LOCAL_NED.type_mask: use the position only (ignore
+// the velocity, acceleration, yaw and yaw rate)
+#define POSITION_TARGET_TYPE_MASK		0x0DF8
+
+#define NS_PER_MS						1000000LL
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Monotonic time (in ns).
+ */
+static int64_t monotonicNs()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Milliseconds since the link was initialized (MAVLink's time_boot_ms).
+ */
+static uint32_t timeBootMs(const MavlinkLink *link)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint32_t) ((now.tv_sec - link->boot.tv_sec) * 1000 + (now.tv_nsec - link->boot.tv_nsec) / NS_PER_MS);
+}
+
+/**
+ * Serialize a packed message and queue it (called with the lock held).
+ */
+static int queueMessage(MavlinkLink *link, const mavlink_message_t *msg)
+{
+	uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+	uint16_t length = mavlink_msg_to_send_buffer(frame, msg);
+
+	// A full queue is sent right away
+	if (link->outgoing.count == DATAGRAM_BATCH_SIZE)
+		link->framesSent += flushDatagramBatch(&link->outgoing, link->fd);
+
+	if (queueDatagram(&link->outgoing, &link->autopilot, frame, length) != RETURN_VALUE_OK)
+	{
+		link->framesDropped++;
+		return RETURN_VALUE_ERROR;
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+/**
+ * Queue a request of the autopilot's LOCAL_POSITION_NED stream (called
+ * with the lock held).
+ */
+static int queuePositionRequest(MavlinkLink *link)
+{
+	mavlink_message_t msg;
+
+	mavlink_msg_command_long_pack(MAVLINK_LINK_SYSTEM_ID, MAVLINK_LINK_COMPONENT_ID, &msg,
+								  link->targetSystem, link->targetComponent, MAV_CMD_SET_MESSAGE_INTERVAL, 0,
+								  MAVLINK_MSG_ID_LOCAL_POSITION_NED, MAVLINK_LINK_POSITION_INTERVAL_US, 0, 0, 0, 0, 0);
+	link->positionRequestNs = monotonicNs();
+
+	return queueMessage(link, &msg);
+}
+
+/**
+ * Queue a position target (called with the lock held). MAVLink's z points
+ * down: the server's (up) is negated.
+ */
+static int queuePositionTarget(MavlinkLink *link, const GpsNedCoordinates *gpsNedCoordinates)
+{
+	mavlink_message_t msg;
+
+	mavlink_msg_set_position_target_local_ned_pack(MAVLINK_LINK_SYSTEM_ID, MAVLINK_LINK_COMPONENT_ID, &msg,
+												   timeBootMs(link), link->targetSystem, link->targetComponent,
+												   MAV_FRAME_LOCAL_NED, POSITION_TARGET_TYPE_MASK,
+												   gpsNedCoordinates->x, gpsNedCoordinates->y, -gpsNedCoordinates->z,
+												   0, 0, 0, 0, 0, 0, 0, 0);
+
+	return queueMessage(link, &msg);
+}
+
+/**
+ * HEARTBEAT subscriber (called with the lock held).
+ */
+static void handleHeartbeat(const mavlink_message_t *msg, void *context)
+{
+	MavlinkLink *link = context;
+
+	// Address the autopilot that actually answers (not other GCSs)
+	if (mavlink_msg_heartbeat_get_type(msg) != MAV_TYPE_GCS
+			&& mavlink_msg_heartbeat_get_autopilot(msg) != MAV_AUTOPILOT_INVALID)
+	{
+		link->targetSystem = msg->sysid;
+		link->targetComponent = msg->compid;
+	}
+}
+
+/**
+ * LOCAL_POSITION_NED subscriber (called with the lock held). MAVLink's z
+ * points down: it is negated into the server's (up).
+ */
+static void handleLocalPositionNed(const mavlink_message_t *msg, void *context)
+{
+	MavlinkLink *link = context;
+	mavlink_local_position_ned_t position;
+	GpsNedCoordinates gpsNedCoordinates;
+
+	mavlink_msg_local_position_ned_decode(msg, &position);
+	initializeGpsNedCoordinates(&gpsNedCoordinates, position.x, position.y, -position.z, time(NULL));
+	publishLocalPositionNed(&link->telemetry, &gpsNedCoordinates, monotonicNs());
+}
+
+/**
+ * GPS_GLOBAL_ORIGIN subscriber (called with the lock held).
+ */
+static void handleGpsGlobalOrigin(const mavlink_message_t *msg, void *context)
+{
+	MavlinkLink *link = context;
+	mavlink_gps_global_origin_t origin;
+
+	mavlink_msg_gps_global_origin_decode(msg, &origin);
+	initializeGpsRawCoordinates(&link->originRawCoordinates, origin.latitude / 1e7, origin.longitude / 1e7,
+								origin.altitude / 1e3, time(NULL));
+	link->hasOrigin = 1;
+	link->originsReceived++;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeMavlinkLink(MavlinkLink *link, const char *address, int port, int localPort)
+{
+	struct sockaddr_in local = {0};
+
+	// Check arguments
+	if (link == NULL || address == NULL || port <= 0 || port > 65535 || localPort < 0 || localPort > 65535)
+		return RETURN_VALUE_ERROR;
+
+	memset(link, 0, sizeof(*link));
+	link->fd = -1;
+	link->autopilot.sin_family = AF_INET;
+	link->autopilot.sin_port = htons(port);
+	if (inet_pton(AF_INET, address, &link->autopilot.sin_addr) != 1)
+		return RETURN_VALUE_ERROR;
+
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(localPort);
+
+	if ((link->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+		return RETURN_VALUE_ERROR;
+
+	if (bind(link->fd, (struct sockaddr *) &local, sizeof(local)) < 0 || pthread_mutex_init(&link->lock, NULL) != 0)
+	{
+		close(link->fd);
+		link->fd = -1;
+		return RETURN_VALUE_ERROR;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &link->boot);
+	link->targetSystem = MAVLINK_LINK_TARGET_SYSTEM_ID;
+	link->targetComponent = MAVLINK_LINK_TARGET_COMPONENT_ID;
+	initializeDatagramBatch(&link->outgoing);
+	initializeTelemetryCache(&link->telemetry);
+	initializeMavlinkIngest(&link->ingest);
+	subscribeMavlinkIngest(&link->ingest, MAVLINK_MSG_ID_HEARTBEAT, handleHeartbeat, link);
+	subscribeMavlinkIngest(&link->ingest, MAVLINK_MSG_ID_LOCAL_POSITION_NED, handleLocalPositionNed, link);
+	subscribeMavlinkIngest(&link->ingest, MAVLINK_MSG_ID_GPS_GLOBAL_ORIGIN, handleGpsGlobalOrigin, link);
+
+	queuePositionRequest(link);
+
+	return RETURN_VALUE_OK;
+}
+
+
+void terminateMavlinkLink(MavlinkLink *link)
+{
+	if (link->fd < 0)
+		return;
+
+	close(link->fd);
+	link->fd = -1;
+	pthread_mutex_destroy(&link->lock);
+}
+
+
+int flushMavlinkLink(MavlinkLink *link)
+{
+	int sent;
+
+	pthread_mutex_lock(&link->lock);
+	sent = flushDatagramBatch(&link->outgoing, link->fd);
+	link->framesSent += sent;
+	pthread_mutex_unlock(&link->lock);
+
+	return sent;
+}
+
+
+int receiveMavlinkLink(MavlinkLink *link)
+{
+	GpsRawCoordinates origin;
+	unsigned long origins;
+	int frames;
+
+	// Only this thread reads the socket; the subscribers update the shared state
+	pthread_mutex_lock(&link->lock);
+	origins = link->originsReceived;
+	frames = receiveMavlinkIngest(&link->ingest, link->fd, &link->autopilot.sin_addr);
+	copyGpsRawCoordinates(&origin, &link->originRawCoordinates);
+	origins = link->originsReceived - origins;
+	pthread_mutex_unlock(&link->lock);
+
+	// Outside the lock: the callback may use the link
+	if (origins > 0 && link->gpsGlobalOriginCallback != NULL)
+		link->gpsGlobalOriginCallback(&origin);
+
+	return frames;
+}
+
+
+int refreshMavlinkLink(MavlinkLink *link)
+{
+	GpsNedCoordinates gpsNedCoordinates;
+	int64_t now = monotonicNs(), positionNs = 0;
+	int res = RETURN_VALUE_OK;
+
+	pthread_mutex_lock(&link->lock);
+
+	if (link->hasPositionTarget)
+		res = queuePositionTarget(link, &link->positionTarget);
+
+	// The stream stopped (or never started): request it again, at most once per timeout
+	readLocalPositionNed(&link->telemetry, &gpsNedCoordinates, &positionNs);
+	if (now - positionNs > MAVLINK_LINK_POSITION_TIMEOUT_MS * NS_PER_MS
+			&& now - link->positionRequestNs > MAVLINK_LINK_POSITION_TIMEOUT_MS * NS_PER_MS)
+		res |= queuePositionRequest(link);
+
+	pthread_mutex_unlock(&link->lock);
+
+	return res == RETURN_VALUE_OK ? RETURN_VALUE_OK : RETURN_VALUE_ERROR;
+}
+
+
+int sendMavlinkLinkMsg_heartbeat(MavlinkLink *link)
+{
+	mavlink_message_t msg;
+	int res;
+
+	// Packed with the lock held: packing takes the next sequence number
+	pthread_mutex_lock(&link->lock);
+	mavlink_msg_heartbeat_pack(MAVLINK_LINK_SYSTEM_ID, MAVLINK_LINK_COMPONENT_ID, &msg,
+							   MAV_TYPE_GCS, MAV_AUTOPILOT_INVALID, 0, 0, MAV_STATE_ACTIVE);
+	res = queueMessage(link, &msg);
+	pthread_mutex_unlock(&link->lock);
+
+	return res;
+}
+
+
+int sendMavlinkLinkMsg_localPositionNed(MavlinkLink *link, GpsNedCoordinates *gpsNedCoordinates)
+{
+	return readLocalPositionNed(&link->telemetry, gpsNedCoordinates, NULL);
+}
+
+
+int sendMavlinkLinkMsg_gpsGlobalOrigin(MavlinkLink *link, GpsRawCoordinates *originRawCoordinates)
+{
+	int res = RETURN_VALUE_ERROR;
+
+	// Check arguments
+	if (originRawCoordinates == NULL)
+		return RETURN_VALUE_ERROR;
+
+	pthread_mutex_lock(&link->lock);
+	if (link->hasOrigin)
+		res = copyGpsRawCoordinates(originRawCoordinates, &link->originRawCoordinates);
+	pthread_mutex_unlock(&link->lock);
+
+	return res;
+}
+
+
+int sendMavlinkLinkMsg_setPositionTargetLocalNed(MavlinkLink *link, const GpsNedCoordinates *gpsNedCoordinates)
+{
+	int res;
+
+	// Check arguments
+	if (gpsNedCoordinates == NULL)
+		return RETURN_VALUE_ERROR;
+
+	pthread_mutex_lock(&link->lock);
+	copyGpsNedCoordinates(&link->positionTarget, gpsNedCoordinates);
+	link->hasPositionTarget = 1;
+	res = queuePositionTarget(link, gpsNedCoordinates);
+	pthread_mutex_unlock(&link->lock);
+
+	return res;
+}
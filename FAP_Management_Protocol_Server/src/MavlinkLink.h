@@ -0,0 +1,190 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// Module headers
+#include "DatagramBatch.h"
+#include "GpsCoordinates.h"
+#include "MavlinkIngest.h"
+#include "TelemetryCache.h"
+
+// C headers
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+
+// MAVLink library (its packed structs trip -Waddress-of-packed-member)
+// [https://mavlink.io/en/getting_started/use_source.html]
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Waddress-of-packed-member"
+#include "mavlink/common/mavlink.h"
+#pragma GCC diagnostic pop
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK						0
+#define RETURN_VALUE_ERROR					(-1)
+
+// Our MAVLink identity (a ground control station)
+#define MAVLINK_LINK_SYSTEM_ID				255
+#define MAVLINK_LINK_COMPONENT_ID			MAV_COMP_ID_MISSIONPLANNER
+
+// Autopilot addressed until its HEARTBEAT is received
+#define MAVLINK_LINK_TARGET_SYSTEM_ID		1
+#define MAVLINK_LINK_TARGET_COMPONENT_ID	MAV_COMP_ID_AUTOPILOT1
+
+// Interval of the LOCAL_POSITION_NED stream requested from the autopilot (in us)
+#define MAVLINK_LINK_POSITION_INTERVAL_US	200000
+
+// Time without a LOCAL_POSITION_NED before requesting the stream again (in ms)
+#define MAVLINK_LINK_POSITION_TIMEOUT_MS	2000
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * MAVLink (v2) link to an autopilot over UDP (e.g. a SITL simulator),
+ * an alternative to the MAVLink emulator with the same set of messages.
+ *
+ * Outgoing frames are queued, and sent together (one sendmmsg()) by
+ * flushMavlinkLink(). Incoming frames are read from the non-blocking
+ * socket by receiveMavlinkLink() (e.g. when an event loop reports it
+ * readable), through a MAVLink ingest pipeline whose subscribers update
+ * the autopilot's last reported state. The autopilot streams its
+ * LOCAL_POSITION_NED (requested with MAV_CMD_SET_MESSAGE_INTERVAL) into
+ * a telemetry cache, read without locks.
+ *
+ * The server's NED coordinates have z pointing up (see GpsCoordinates.h),
+ * while MAVLink's MAV_FRAME_LOCAL_NED has it pointing down: z is negated
+ * in the position targets sent and the positions received.
+ */
+typedef struct _MavlinkLink
+{
+	int fd;										// UDP socket
+	struct sockaddr_in autopilot;				// Autopilot's address
+	pthread_mutex_t lock;						// Protects the outgoing frames and the autopilot's state (but the telemetry)
+	DatagramBatch outgoing;						// Frames waiting for flushMavlinkLink()
+	MavlinkIngest ingest;						// Incoming frames (and their statistics)
+	struct timespec boot;						// Initialization time (time_boot_ms reference)
+	uint8_t targetSystem;						// Autopilot's system ID
+	uint8_t targetComponent;					// Autopilot's component ID
+	TelemetryCache telemetry;					// Last LOCAL_POSITION_NED (written by receiveMavlinkLink())
+	int64_t positionRequestNs;					// Last LOCAL_POSITION_NED stream request (monotonic ns)
+	GpsNedCoordinates positionTarget;			// Last SET_POSITION_TARGET_LOCAL_NED (re-sent by refreshMavlinkLink())
+	int hasPositionTarget;						// A position target was sent
+	GpsRawCoordinates originRawCoordinates;		// Last GPS_GLOBAL_ORIGIN
+	int hasOrigin;								// A GPS_GLOBAL_ORIGIN was received
+	void (*gpsGlobalOriginCallback)(const GpsRawCoordinates *originRawCoordinates);	// Called on each GPS_GLOBAL_ORIGIN (may be NULL)
+	unsigned long framesSent;					// Frames sent
+	unsigned long originsReceived;				// GPS_GLOBAL_ORIGINs received
+	unsigned long framesDropped;				// Outgoing frames dropped (the queue was full)
+} MavlinkLink;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize a MAVLink link: open its (non-blocking) UDP socket and
+ * request the autopilot's LOCAL_POSITION_NED stream.
+ *
+ * @param link					Pointer to the MavlinkLink to be initialized.
+ * @param address				Autopilot's IPv4 address.
+ * @param port					Autopilot's UDP port.
+ * @param localPort				Local UDP port (0 for any).
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeMavlinkLink(MavlinkLink *link, const char *address, int port, int localPort);
+
+/**
+ * Terminate a MAVLink link, closing its socket (queued frames are dropped).
+ *
+ * @param link					Pointer to the MavlinkLink.
+ */
+void terminateMavlinkLink(MavlinkLink *link);
+
+/**
+ * Send every queued frame (one system call).
+ *
+ * @param link					Pointer to the MavlinkLink.
+ * @return						Number of frames sent.
+ */
+int flushMavlinkLink(MavlinkLink *link);
+
+/**
+ * Read and parse every datagram available on the link's socket, without
+ * blocking. Only datagrams from the autopilot's address are parsed.
+ *
+ * @param link					Pointer to the MavlinkLink.
+ * @return						Number of frames handled; or RETURN_VALUE_ERROR
+ *								on socket errors.
+ */
+int receiveMavlinkLink(MavlinkLink *link);
+
+/**
+ * Queue the link's periodic traffic (e.g. every second): the last position
+ * target again (in case it was lost), and a new LOCAL_POSITION_NED stream
+ * request if the autopilot stopped streaming it.
+ *
+ * @param link					Pointer to the MavlinkLink.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int refreshMavlinkLink(MavlinkLink *link);
+
+/**
+ * Queue a MAVLink message to the Autopilot - HEARTBEAT.
+ *
+ * @param link					Pointer to the MavlinkLink.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int sendMavlinkLinkMsg_heartbeat(MavlinkLink *link);
+
+/**
+ * Get the last LOCAL_POSITION_NED streamed by the Autopilot (from the
+ * telemetry cache: without locks, nor MAVLink messages).
+ *
+ * @param link					Pointer to the MavlinkLink.
+ * @param gpsNedCoordinates		Pointer to the GPS NED coordinates to be initialized
+ *								with the FAP's GPS NED coordinates.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise (none reported yet), return RETURN_VALUE_ERROR.
+ */
+int sendMavlinkLinkMsg_localPositionNed(MavlinkLink *link, GpsNedCoordinates *gpsNedCoordinates);
+
+/**
+ * Get the last GPS_GLOBAL_ORIGIN reported by the Autopilot.
+ *
+ * @param link					Pointer to the MavlinkLink.
+ * @param originRawCoordinates	Pointer to the GPS RAW coordinates to be initialized
+ *								with the coordinates corresponding to the origin (0,0,0).
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise (none reported yet), return RETURN_VALUE_ERROR.
+ */
+int sendMavlinkLinkMsg_gpsGlobalOrigin(MavlinkLink *link, GpsRawCoordinates *originRawCoordinates);
+
+/**
+ * Queue a MAVLink message to the Autopilot - SET_POSITION_TARGET_LOCAL_NED
+ * (position only).
+ *
+ * @param link					Pointer to the MavlinkLink.
+ * @param gpsNedCoordinates		Pointer to the target GPS NED coordinates.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int sendMavlinkLinkMsg_setPositionTargetLocalNed(MavlinkLink *link, const GpsNedCoordinates *gpsNedCoordinates);
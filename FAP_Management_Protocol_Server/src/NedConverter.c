@@ -0,0 +1,303 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "NedConverter.h"
+
+// C headers
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+#define DEGREES_TO_RADIANS		(M_PI / 180)
+
+// pi/2 split in three parts (Cody-Waite argument reduction)
+#define PI_2_HIGH				1.57079632673412561417e+00
+#define PI_2_MIDDLE				6.07710050630396597660e-11
+#define PI_2_LOW				2.02226624879595063154e-21
+
+// Rounds a double to an integer when added and subtracted (|x| < 2^51);
+// the integer is then in the low bits of the sum
+#define ROUNDING_CONSTANT		0x1.8p52
+
+// Minimax polynomials of sin(r) and cos(r) for |r| <= pi/4 (fdlibm)
+#define SIN_1					-1.66666666666666324348e-01
+#define SIN_2					8.33333333332248946124e-03
+#define SIN_3					-1.98412698298579493134e-04
+#define SIN_4					2.75573137070700676789e-06
+#define SIN_5					-2.50507602534068634195e-08
+#define SIN_6					1.58969099521155010221e-10
+#define COS_1					4.16666666666666019037e-02
+#define COS_2					-1.38888888888741095749e-03
+#define COS_3					2.48015872894767294178e-05
+#define COS_4					-2.75573143513906633035e-07
+#define COS_5					2.08757232129817482790e-09
+#define COS_6					-1.13596475577881948265e-11
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+// Vector types (GCC vector extensions): one block of coordinates.
+// Compiled for AVX2 a block is one register; for SSE2, two.
+typedef double Doubles __attribute__((vector_size(NED_CONVERTER_BLOCK_SIZE * sizeof(double))));
+typedef int64_t Integers __attribute__((vector_size(NED_CONVERTER_BLOCK_SIZE * sizeof(int64_t))));
+typedef float Floats __attribute__((vector_size(NED_CONVERTER_BLOCK_SIZE * sizeof(float))));
+
+typedef void (*ConvertBatchFunction)(const NedConverter *, const float *, const float *, const float *, float *, float *, float *, size_t);
+
+
+// =========================================================
+//           GLOBAL VARIABLES
+// =========================================================
+
+static ConvertBatchFunction convertBatch = NULL;
+static const char *instructionSet = NULL;
+
+static pthread_once_t selectInstructionSetOnce = PTHREAD_ONCE_INIT;
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Sine and cosine of a block of angles (in radians, |x| < 2^50).
+ */
+static inline __attribute__((always_inline)) void sinCosBlock(const Doubles *x, Doubles *sinX, Doubles *cosX)
+{
+	// x = q * pi/2 + r, |r| <= pi/4
+	Doubles rounded = *x * M_2_PI + ROUNDING_CONSTANT;
+	Doubles q = rounded - ROUNDING_CONSTANT;
+	Integers quadrant = (Integers) rounded & 3;
+	Doubles r = *x - q * PI_2_HIGH - q * PI_2_MIDDLE - q * PI_2_LOW;
+
+	Doubles z = r * r;
+	Doubles s = r + r * z * (SIN_1 + z * (SIN_2 + z * (SIN_3 + z * (SIN_4 + z * (SIN_5 + z * SIN_6)))));
+	Doubles c = 1.0 - 0.5 * z + z * z * (COS_1 + z * (COS_2 + z * (COS_3 + z * (COS_4 + z * (COS_5 + z * COS_6)))));
+
+	// Quadrant 1 and 3 swap sine and cosine; the sign bit follows the quadrant
+	Integers swap = -(quadrant & 1);
+	Integers sinBits = ((Integers) s & ~swap) | ((Integers) c & swap);
+	Integers cosBits = ((Integers) c & ~swap) | ((Integers) s & swap);
+
+	sinBits ^= (quadrant & 2) << 62;
+	cosBits ^= ((quadrant + 1) & 2) << 62;
+
+	*sinX = (Doubles) sinBits;
+	*cosX = (Doubles) cosBits;
+}
+
+/**
+ * Convert one block of coordinates.
+ */
+static inline __attribute__((always_inline)) void convertBlock(const NedConverter *converter, const float *latitude,
+									const float *longitude, const float *altitude, float *x, float *y, float *z)
+{
+	const GeodesyFrame *frame = &converter->frame;
+	Floats block;
+	Doubles lat, lon, alt, sinLat, cosLat, sinLon, cosLon, u, n, horizontal, dx, dy, dz, t;
+
+	memcpy(&block, latitude, sizeof(block));
+	lat = __builtin_convertvector(block, Doubles) * DEGREES_TO_RADIANS;
+	memcpy(&block, longitude, sizeof(block));
+	lon = __builtin_convertvector(block, Doubles) * DEGREES_TO_RADIANS;
+	memcpy(&block, altitude, sizeof(block));
+	alt = __builtin_convertvector(block, Doubles);
+
+	sinCosBlock(&lat, &sinLat, &cosLat);
+	sinCosBlock(&lon, &sinLon, &cosLon);
+
+	// Prime vertical radius of curvature, a / sqrt(1 - u) as a series of u
+	// (u is below 0.0067: the error is under a micrometer)
+	u = WGS84_E2 * sinLat * sinLat;
+	n = WGS84_SEMI_MAJOR_AXIS * (1 + u * (1.0 / 2 + u * (3.0 / 8 + u * (5.0 / 16 + u * (35.0 / 128
+			+ u * (63.0 / 256 + u * (231.0 / 1024)))))));
+
+	// ECEF offset from the origin, rotated into the local frame (z up)
+	horizontal = (n + alt) * cosLat;
+	dx = horizontal * cosLon - frame->originEcef.x;
+	dy = horizontal * sinLon - frame->originEcef.y;
+	dz = (n * (1 - WGS84_E2) + alt) * sinLat - frame->originEcef.z;
+	t = frame->cosLongitude * dx + frame->sinLongitude * dy;
+
+	block = __builtin_convertvector(frame->cosLatitude * dz - frame->sinLatitude * t, Floats);
+	memcpy(x, &block, sizeof(block));
+	block = __builtin_convertvector(frame->cosLongitude * dy - frame->sinLongitude * dx, Floats);
+	memcpy(y, &block, sizeof(block));
+	block = __builtin_convertvector(frame->cosLatitude * t + frame->sinLatitude * dz, Floats);
+	memcpy(z, &block, sizeof(block));
+}
+
+/**
+ * Convert every block, then the last (partial) block through a padded copy.
+ */
+static inline __attribute__((always_inline)) void convertBlocks(const NedConverter *converter, const float *latitude,
+									const float *longitude, const float *altitude, float *x, float *y, float *z, size_t n)
+{
+	float in[3][NED_CONVERTER_BLOCK_SIZE] = {{0}}, out[3][NED_CONVERTER_BLOCK_SIZE];
+	size_t i, tail;
+
+	for (i = 0; i + NED_CONVERTER_BLOCK_SIZE <= n; i += NED_CONVERTER_BLOCK_SIZE)
+		convertBlock(converter, latitude + i, longitude + i, altitude + i, x + i, y + i, z + i);
+
+	if ((tail = n - i) == 0)
+		return;
+
+	memcpy(in[0], latitude + i, tail * sizeof(float));
+	memcpy(in[1], longitude + i, tail * sizeof(float));
+	memcpy(in[2], altitude + i, tail * sizeof(float));
+	convertBlock(converter, in[0], in[1], in[2], out[0], out[1], out[2]);
+	memcpy(x + i, out[0], tail * sizeof(float));
+	memcpy(y + i, out[1], tail * sizeof(float));
+	memcpy(z + i, out[2], tail * sizeof(float));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+static void convertBatchAvx2(const NedConverter *converter, const float *latitude, const float *longitude,
+								const float *altitude, float *x, float *y, float *z, size_t n)
+{
+	convertBlocks(converter, latitude, longitude, altitude, x, y, z, n);
+}
+#endif
+
+static void convertBatchDefault(const NedConverter *converter, const float *latitude, const float *longitude,
+								const float *altitude, float *x, float *y, float *z, size_t n)
+{
+	convertBlocks(converter, latitude, longitude, altitude, x, y, z, n);
+}
+
+/**
+ * Select the conversion for the CPU running the server.
+ */
+static void selectInstructionSet(void)
+{
+	convertBatch = convertBatchDefault;
+#if defined(__x86_64__)
+	instructionSet = "sse2";
+#else
+	instructionSet = "generic";
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+	{
+		convertBatch = convertBatchAvx2;
+		instructionSet = "avx2";
+	}
+#endif
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeNedConverter(NedConverter *converter, const GpsRawCoordinates *origin)
+{
+	// Check arguments
+	if (converter == NULL || origin == NULL)
+		return RETURN_VALUE_ERROR;
+
+	pthread_once(&selectInstructionSetOnce, selectInstructionSet);
+
+	memset(converter, 0, sizeof(*converter));
+	converter->generation = (unsigned int) -1;
+	setNedConverterOrigin(converter, origin);
+
+	return RETURN_VALUE_OK;
+}
+
+
+int setNedConverterOrigin(NedConverter *converter, const GpsRawCoordinates *origin)
+{
+	GeodeticCoordinates geodetic;
+
+	if (converter->generation != (unsigned int) -1 && converter->origin.latitude == origin->latitude
+			&& converter->origin.longitude == origin->longitude && converter->origin.altitude == origin->altitude)
+		return 0;
+
+	converter->origin = *origin;
+	converter->generation++;
+	geodetic.latitude = origin->latitude;
+	geodetic.longitude = origin->longitude;
+	geodetic.altitude = origin->altitude;
+	initializeGeodesyFrame(&converter->frame, &geodetic);
+
+	return 1;
+}
+
+
+void convertGpsRawCoordinatesBatch(const NedConverter *converter, const float *latitude, const float *longitude,
+									const float *altitude, float *x, float *y, float *z, size_t n)
+{
+	convertBatch(converter, latitude, longitude, altitude, x, y, z, n);
+}
+
+
+int convertGpsRawCoordinates(const NedConverter *converter, GpsNedCoordinates *gpsNedCoordinates, const GpsRawCoordinates *gpsRawCoordinates)
+{
+	GeodeticCoordinates geodetic;
+	LocalNedCoordinates ned;
+
+	// Check arguments
+	if (converter == NULL || gpsNedCoordinates == NULL || gpsRawCoordinates == NULL)
+		return RETURN_VALUE_ERROR;
+
+	geodetic.latitude = gpsRawCoordinates->latitude;
+	geodetic.longitude = gpsRawCoordinates->longitude;
+	geodetic.altitude = gpsRawCoordinates->altitude;
+	geodeticToNedFast(&converter->frame, &geodetic, &ned);
+
+	gpsNedCoordinates->x = ned.north;
+	gpsNedCoordinates->y = ned.east;
+	gpsNedCoordinates->z = -ned.down;
+	strcpy(gpsNedCoordinates->timestamp, gpsRawCoordinates->timestamp);
+
+	return RETURN_VALUE_OK;
+}
+
+
+int convertGpsNedCoordinates(const NedConverter *converter, GpsRawCoordinates *gpsRawCoordinates, const GpsNedCoordinates *gpsNedCoordinates)
+{
+	GeodeticCoordinates geodetic;
+	LocalNedCoordinates ned;
+
+	// Check arguments
+	if (converter == NULL || gpsRawCoordinates == NULL || gpsNedCoordinates == NULL)
+		return RETURN_VALUE_ERROR;
+
+	ned.north = gpsNedCoordinates->x;
+	ned.east = gpsNedCoordinates->y;
+	ned.down = -gpsNedCoordinates->z;
+	if (nedToGeodetic(&converter->frame, &ned, &geodetic) != RETURN_VALUE_OK)
+		return RETURN_VALUE_ERROR;
+
+	gpsRawCoordinates->latitude = geodetic.latitude;
+	gpsRawCoordinates->longitude = geodetic.longitude;
+	gpsRawCoordinates->altitude = geodetic.altitude;
+	strcpy(gpsRawCoordinates->timestamp, gpsNedCoordinates->timestamp);
+
+	return RETURN_VALUE_OK;
+}
+
+
+const char *getNedConverterInstructionSet(void)
+{
+	pthread_once(&selectInstructionSetOnce, selectInstructionSet);
+
+	return instructionSet;
+}
@@ -0,0 +1,128 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// Module headers
+#include "Geodesy.h"
+#include "GpsCoordinates.h"
+
+// C headers
+#include <stddef.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Coordinates converted per vector block (the batch is processed in blocks)
+#define NED_CONVERTER_BLOCK_SIZE	4
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Origin frame of a RAW to NED conversion: the WGS-84 local frame at the
+ * origin (see Geodesy.h), computed once and only rebuilt when a new origin
+ * (GPS_GLOBAL_ORIGIN) is set.
+ *
+ * The server's NED coordinates are x north, y east and z up (the altitude
+ * above the origin, i.e. minus the local frame's down).
+ */
+typedef struct _NedConverter
+{
+	GpsRawCoordinates origin;					// Origin coordinates corresponding to (0,0,0)
+	unsigned int generation;					// Incremented every time the origin changes
+	GeodesyFrame frame;							// Local frame at the origin
+} NedConverter;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize a RAW to NED converter.
+ *
+ * @param converter		Pointer to the NedConverter to be initialized.
+ * @param origin		Pointer to the origin coordinates corresponding to (0,0,0).
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeNedConverter(NedConverter *converter, const GpsRawCoordinates *origin);
+
+/**
+ * Set the origin of a RAW to NED converter (a new GPS_GLOBAL_ORIGIN),
+ * rebuilding the origin frame only if the origin changed.
+ *
+ * @param converter		Pointer to the NedConverter.
+ * @param origin		Pointer to the origin coordinates corresponding to (0,0,0).
+ * @return				True (1) if the origin changed (conversions made
+ *						before are relative to the old origin);
+ *						return False (0) otherwise.
+ */
+int setNedConverterOrigin(NedConverter *converter, const GpsRawCoordinates *origin);
+
+/**
+ * Convert n coordinates from RAW to NED format, as
+ * gpsRawCoordinates2gpsNedCoordinates() would, in vector blocks.
+ *
+ * The sine and cosine, and the Earth's radius of curvature, are polynomial
+ * approximations (under a micrometer once scaled by the Earth's radius);
+ * the result is computed in double precision, so it is within the float
+ * rounding of gpsRawCoordinates2gpsNedCoordinates().
+ *
+ * @param converter		Pointer to the NedConverter.
+ * @param latitude		Latitudes (in degrees).
+ * @param longitude		Longitudes (in degrees).
+ * @param altitude		Altitudes (in meters).
+ * @param x				Destination X (in meters).
+ * @param y				Destination Y (in meters).
+ * @param z				Destination Z (in meters).
+ * @param n				Number of coordinates.
+ */
+void convertGpsRawCoordinatesBatch(const NedConverter *converter, const float *latitude, const float *longitude,
+									const float *altitude, float *x, float *y, float *z, size_t n);
+
+/**
+ * Convert one set of coordinates from RAW to NED format (see
+ * convertGpsRawCoordinatesBatch()), through geodeticToNedFast().
+ *
+ * @param converter			Pointer to the NedConverter.
+ * @param gpsNedCoordinates	Pointer to the GpsNedCoordinates to be initialized.
+ * @param gpsRawCoordinates	Pointer to the source GpsRawCoordinates.
+ * @return					Return RETURN_VALUE_OK if there are no errors;
+ *							otherwise, return RETURN_VALUE_ERROR.
+ */
+int convertGpsRawCoordinates(const NedConverter *converter, GpsNedCoordinates *gpsNedCoordinates, const GpsRawCoordinates *gpsRawCoordinates);
+
+/**
+ * Convert one set of coordinates from NED back to RAW format (e.g. to send
+ * a waypoint as latitude and longitude), through nedToGeodetic().
+ *
+ * @param converter			Pointer to the NedConverter.
+ * @param gpsRawCoordinates	Pointer to the GpsRawCoordinates to be initialized.
+ * @param gpsNedCoordinates	Pointer to the source GpsNedCoordinates.
+ * @return					Return RETURN_VALUE_OK if there are no errors;
+ *							otherwise, return RETURN_VALUE_ERROR.
+ */
+int convertGpsNedCoordinates(const NedConverter *converter, GpsRawCoordinates *gpsRawCoordinates, const GpsNedCoordinates *gpsNedCoordinates);
+
+/**
+ * Name of the instruction set the conversions use on this CPU
+ * ("avx2", "sse2" or "generic").
+ *
+ * @return				Instruction set.
+ */
+const char *getNedConverterInstructionSet(void);
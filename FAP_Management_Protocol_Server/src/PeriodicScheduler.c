@@ -0,0 +1,207 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "PeriodicScheduler.h"
+
+// C headers
+#include <string.h>
+#include <time.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+#define NS_PER_SECOND		1000000000LL
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Monotonic time (in ns).
+ */
+static int64_t monotonicNs()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t) now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+/**
+ * Task with the earliest deadline.
+ */
+static PeriodicTask *nextTask(PeriodicScheduler *scheduler)
+{
+	PeriodicTask *next = &scheduler->tasks[0];
+
+	for (int t = 1; t < scheduler->nTasks; t++)
+	{
+		if (scheduler->tasks[t].deadlineNs < next->deadlineNs)
+			next = &scheduler->tasks[t];
+	}
+
+	return next;
+}
+
+/**
+ * Scheduler's thread: sleep until the earliest deadline, run its task, and
+ * move its deadline one period ahead.
+ */
+static void *runPeriodicScheduler(void *arg)
+{
+	PeriodicScheduler *scheduler = arg;
+	int64_t start = monotonicNs();
+	intptr_t status = RETURN_VALUE_OK;
+
+	for (int t = 0; t < scheduler->nTasks; t++)
+		scheduler->tasks[t].deadlineNs = start + scheduler->tasks[t].periodNs;
+
+	while (atomic_load(&scheduler->running) && scheduler->nTasks > 0)
+	{
+		PeriodicTask *task = nextTask(scheduler);
+		struct timespec deadline = {task->deadlineNs / NS_PER_SECOND, task->deadlineNs % NS_PER_SECOND};
+		int64_t now, lateness;
+		unsigned long skipped = 0;
+		int res;
+
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) != 0)
+			continue;		// Interrupted (EINTR): sleep again
+		if (!atomic_load(&scheduler->running))
+			break;
+
+		lateness = monotonicNs() - task->deadlineNs;
+		res = task->callback(task->context);
+		now = monotonicNs();
+
+		// Absolute deadlines (no drift); those already missed are skipped
+		task->deadlineNs += task->periodNs;
+		if (task->deadlineNs <= now)
+		{
+			skipped = (now - task->deadlineNs) / task->periodNs + 1;
+			task->deadlineNs += skipped * task->periodNs;
+		}
+
+		pthread_mutex_lock(&scheduler->statsLock);
+		task->runs++;
+		task->overruns += skipped;
+		task->sumLatenessNs += lateness;
+		if (lateness > task->maxLatenessNs)
+			task->maxLatenessNs = lateness;
+		pthread_mutex_unlock(&scheduler->statsLock);
+
+		if (res != RETURN_VALUE_OK)
+		{
+			status = RETURN_VALUE_ERROR;
+			break;
+		}
+	}
+
+	atomic_store(&scheduler->running, 0);
+
+	return (void *) status;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializePeriodicScheduler(PeriodicScheduler *scheduler)
+{
+	memset(scheduler, 0, sizeof(*scheduler));
+	atomic_init(&scheduler->running, 0);
+
+	if (pthread_mutex_init(&scheduler->statsLock, NULL) != 0)
+		return RETURN_VALUE_ERROR;
+
+	return RETURN_VALUE_OK;
+}
+
+
+void terminatePeriodicScheduler(PeriodicScheduler *scheduler)
+{
+	stopPeriodicScheduler(scheduler);
+	pthread_mutex_destroy(&scheduler->statsLock);
+	scheduler->nTasks = 0;
+}
+
+
+int addPeriodicTask(PeriodicScheduler *scheduler, int64_t periodNs, int (*callback)(void *context), void *context)
+{
+	PeriodicTask *task;
+
+	// Check arguments
+	if (periodNs <= 0 || callback == NULL || scheduler->nTasks == PERIODIC_SCHEDULER_MAX_TASKS || scheduler->started)
+		return RETURN_VALUE_ERROR;
+
+	task = &scheduler->tasks[scheduler->nTasks];
+	memset(task, 0, sizeof(*task));
+	task->callback = callback;
+	task->context = context;
+	task->periodNs = periodNs;
+
+	return scheduler->nTasks++;
+}
+
+
+int startPeriodicScheduler(PeriodicScheduler *scheduler)
+{
+	if (scheduler->started)
+		return RETURN_VALUE_ERROR;
+
+	atomic_store(&scheduler->running, 1);
+	if (pthread_create(&scheduler->thread, NULL, runPeriodicScheduler, scheduler) != 0)
+	{
+		atomic_store(&scheduler->running, 0);
+		return RETURN_VALUE_ERROR;
+	}
+	scheduler->started = 1;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int stopPeriodicScheduler(PeriodicScheduler *scheduler)
+{
+	void *status;
+
+	if (!scheduler->started)
+		return RETURN_VALUE_OK;
+
+	atomic_store(&scheduler->running, 0);
+	scheduler->started = 0;
+	if (pthread_join(scheduler->thread, &status) != 0)
+		return RETURN_VALUE_ERROR;
+
+	return (intptr_t) status == RETURN_VALUE_OK ? RETURN_VALUE_OK : RETURN_VALUE_ERROR;
+}
+
+
+int getPeriodicTaskStats(PeriodicScheduler *scheduler, int task, PeriodicTaskStats *stats)
+{
+	const PeriodicTask *periodicTask;
+
+	// Check arguments
+	if (task < 0 || task >= scheduler->nTasks || stats == NULL)
+		return RETURN_VALUE_ERROR;
+
+	periodicTask = &scheduler->tasks[task];
+
+	pthread_mutex_lock(&scheduler->statsLock);
+	stats->runs = periodicTask->runs;
+	stats->overruns = periodicTask->overruns;
+	stats->meanLatenessNs = periodicTask->runs > 0 ? (double) periodicTask->sumLatenessNs / periodicTask->runs : 0;
+	stats->maxLatenessNs = periodicTask->maxLatenessNs;
+	pthread_mutex_unlock(&scheduler->statsLock);
+
+	return RETURN_VALUE_OK;
+}
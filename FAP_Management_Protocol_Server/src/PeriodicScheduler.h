@@ -0,0 +1,140 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK						0
+#define RETURN_VALUE_ERROR					(-1)
+
+// Maximum number of tasks of a scheduler
+#define PERIODIC_SCHEDULER_MAX_TASKS		8
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Timing statistics of a periodic task. The lateness of a run is how long
+ * after its deadline it started.
+ */
+typedef struct _PeriodicTaskStats
+{
+	unsigned long runs;							// Runs
+	unsigned long overruns;						// Deadlines skipped (a run took longer than the period)
+	double meanLatenessNs;						// Mean lateness (in ns)
+	int64_t maxLatenessNs;						// Maximum lateness (in ns)
+} PeriodicTaskStats;
+
+/**
+ * Periodic task.
+ */
+typedef struct _PeriodicTask
+{
+	int (*callback)(void *context);				// Task (RETURN_VALUE_ERROR stops the scheduler)
+	void *context;								// Task's context
+	int64_t periodNs;							// Period (in ns)
+	int64_t deadlineNs;							// Next run (monotonic ns)
+	unsigned long runs;							// Runs
+	unsigned long overruns;						// Deadlines skipped
+	int64_t sumLatenessNs;						// Sum of the lateness of the runs (in ns)
+	int64_t maxLatenessNs;						// Maximum lateness (in ns)
+} PeriodicTask;
+
+/**
+ * Scheduler of periodic tasks, all run from a single thread.
+ *
+ * Each task runs at absolute deadlines (start + k * period), slept until
+ * with clock_nanosleep(TIMER_ABSTIME) on the monotonic clock, so its rate
+ * doesn't drift with the time its runs take. A run that takes longer than
+ * its period skips the deadlines it missed (counted as overruns) instead
+ * of running back to back.
+ */
+typedef struct _PeriodicScheduler
+{
+	PeriodicTask tasks[PERIODIC_SCHEDULER_MAX_TASKS];
+	int nTasks;									// Number of tasks
+	pthread_mutex_t statsLock;					// Protects the tasks' statistics
+	pthread_t thread;							// Scheduler's thread
+	atomic_int running;							// The scheduler's thread is running
+	int started;								// The scheduler's thread was started
+} PeriodicScheduler;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize (without tasks) a periodic scheduler.
+ *
+ * @param scheduler			Pointer to the PeriodicScheduler to be initialized.
+ * @return					Return RETURN_VALUE_OK if there are no errors;
+ *							otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializePeriodicScheduler(PeriodicScheduler *scheduler);
+
+/**
+ * Terminate a periodic scheduler (stopping it, if started).
+ *
+ * @param scheduler			Pointer to the PeriodicScheduler.
+ */
+void terminatePeriodicScheduler(PeriodicScheduler *scheduler);
+
+/**
+ * Add a periodic task (before the scheduler is started). Its first run is
+ * one period after the start.
+ *
+ * @param scheduler			Pointer to the PeriodicScheduler.
+ * @param periodNs			Period (in ns).
+ * @param callback			Task.
+ * @param context			Task's context.
+ * @return					Task's index; or RETURN_VALUE_ERROR on errors
+ *							(invalid period, too many tasks, already started).
+ */
+int addPeriodicTask(PeriodicScheduler *scheduler, int64_t periodNs, int (*callback)(void *context), void *context);
+
+/**
+ * Start running the tasks, from a new thread.
+ *
+ * @param scheduler			Pointer to the PeriodicScheduler.
+ * @return					Return RETURN_VALUE_OK if there are no errors;
+ *							otherwise, return RETURN_VALUE_ERROR.
+ */
+int startPeriodicScheduler(PeriodicScheduler *scheduler);
+
+/**
+ * Stop running the tasks (returns after the next deadline, at the latest).
+ *
+ * @param scheduler			Pointer to the PeriodicScheduler.
+ * @return					Return RETURN_VALUE_OK if there are no errors;
+ *							otherwise (a task failed), return RETURN_VALUE_ERROR.
+ */
+int stopPeriodicScheduler(PeriodicScheduler *scheduler);
+
+/**
+ * Get the timing statistics of a task (from any thread).
+ *
+ * @param scheduler			Pointer to the PeriodicScheduler.
+ * @param task				Task's index.
+ * @param stats				Pointer to the PeriodicTaskStats to be initialized.
+ * @return					Return RETURN_VALUE_OK if there are no errors;
+ *							otherwise, return RETURN_VALUE_ERROR.
+ */
+int getPeriodicTaskStats(PeriodicScheduler *scheduler, int task, PeriodicTaskStats *stats);
@@ -0,0 +1,355 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "PositionTable.h"
+
+// C headers
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+#define NANOSECONDS_PER_SECOND		1000000000LL
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Allocate a cache-line aligned array.
+ */
+static void *allocateArray(size_t capacity, size_t elementSize)
+{
+	size_t size = capacity * elementSize;
+
+	size = (size + POSITION_ARRAYS_ALIGNMENT - 1) & ~(size_t) (POSITION_ARRAYS_ALIGNMENT - 1);
+
+	return aligned_alloc(POSITION_ARRAYS_ALIGNMENT, size);
+}
+
+/**
+ * Start writing a slot (the sequence becomes odd).
+ */
+static inline void beginWrite(PositionTable *table, int slot)
+{
+	atomic_uint *sequence = &table->sequences[slot];
+
+	atomic_store_explicit(sequence, atomic_load_explicit(sequence, memory_order_relaxed) + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Finish writing a slot (the sequence becomes even again).
+ */
+static inline void endWrite(PositionTable *table, int slot)
+{
+	atomic_uint *sequence = &table->sequences[slot];
+
+	atomic_store_explicit(sequence, atomic_load_explicit(sequence, memory_order_relaxed) + 1, memory_order_release);
+}
+
+/**
+ * Copy a slot consistently into snapshot arrays.
+ *
+ * @param table			Pointer to the PositionTable.
+ * @param slot			User slot.
+ * @param snapshot		Destination arrays.
+ * @param index			Destination index.
+ * @return				True (1) if the slot holds a position (copied);
+ *						return False (0) otherwise.
+ */
+static int readSlot(PositionTable *table, size_t slot, PositionArrays *snapshot, size_t index)
+{
+	const PositionArrays *positions = &table->positions;
+	unsigned int before, after;
+	int active;
+
+	for (;;)
+	{
+		before = atomic_load_explicit(&table->sequences[slot], memory_order_acquire);
+		if (before & 1)
+			continue;		// Being written
+
+		active = table->active[slot];
+		if (active)
+		{
+			snapshot->x[index] = positions->x[slot];
+			snapshot->y[index] = positions->y[slot];
+			snapshot->z[index] = positions->z[slot];
+			snapshot->epochNs[index] = positions->epochNs[slot];
+			snapshot->userId[index] = positions->userId[slot];
+		}
+
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&table->sequences[slot], memory_order_relaxed);
+
+		if (before == after)
+			return active;
+	}
+}
+
+/**
+ * Read a fixed number of decimal digits.
+ */
+static int readDigits(const char **p, int n, int *value)
+{
+	*value = 0;
+
+	for (int i = 0; i < n; i++, (*p)++)
+	{
+		if (**p < '0' || **p > '9')
+			return RETURN_VALUE_ERROR;
+		*value = *value * 10 + (**p - '0');
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+/**
+ * Days since the Unix epoch of a civil (proleptic Gregorian) date.
+ */
+static int64_t daysFromCivil(int year, int month, int day)
+{
+	int64_t y = year - (month <= 2);
+	int64_t era = (y >= 0 ? y : y - 399) / 400;
+	int64_t yoe = y - era * 400;
+	int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializePositionArrays(PositionArrays *arrays, size_t capacity)
+{
+	// Check arguments
+	if (arrays == NULL || capacity == 0)
+		return RETURN_VALUE_ERROR;
+
+	arrays->x = allocateArray(capacity, sizeof(float));
+	arrays->y = allocateArray(capacity, sizeof(float));
+	arrays->z = allocateArray(capacity, sizeof(float));
+	arrays->epochNs = allocateArray(capacity, sizeof(int64_t));
+	arrays->userId = allocateArray(capacity, sizeof(int32_t));
+	arrays->capacity = capacity;
+	arrays->count = 0;
+
+	if (arrays->x == NULL || arrays->y == NULL || arrays->z == NULL || arrays->epochNs == NULL || arrays->userId == NULL)
+	{
+		terminatePositionArrays(arrays);
+		return RETURN_VALUE_ERROR;
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+
+void terminatePositionArrays(PositionArrays *arrays)
+{
+	free(arrays->x);
+	free(arrays->y);
+	free(arrays->z);
+	free(arrays->epochNs);
+	free(arrays->userId);
+	memset(arrays, 0, sizeof(*arrays));
+}
+
+
+int initializePositionTable(PositionTable *table, size_t capacity)
+{
+	// Check arguments
+	if (table == NULL || capacity == 0)
+		return RETURN_VALUE_ERROR;
+
+	if (initializePositionArrays(&table->positions, capacity) != RETURN_VALUE_OK)
+		return RETURN_VALUE_ERROR;
+
+	table->sequences = calloc(capacity, sizeof(atomic_uint));
+	table->active = calloc(capacity, sizeof(uint8_t));
+	atomic_init(&table->used, 0);
+
+	if (table->sequences == NULL || table->active == NULL)
+	{
+		terminatePositionTable(table);
+		return RETURN_VALUE_ERROR;
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+
+void terminatePositionTable(PositionTable *table)
+{
+	terminatePositionArrays(&table->positions);
+	free(table->sequences);
+	free(table->active);
+	table->sequences = NULL;
+	table->active = NULL;
+	atomic_store(&table->used, 0);
+}
+
+
+int publishPosition(PositionTable *table, int slot, int userId, float x, float y, float z, int64_t epochNs)
+{
+	PositionArrays *positions = &table->positions;
+
+	// Check arguments
+	if (slot < 0 || (size_t) slot >= positions->capacity)
+		return RETURN_VALUE_ERROR;
+
+	beginWrite(table, slot);
+	positions->x[slot] = x;
+	positions->y[slot] = y;
+	positions->z[slot] = z;
+	positions->epochNs[slot] = epochNs;
+	positions->userId[slot] = userId;
+	table->active[slot] = 1;
+	endWrite(table, slot);
+
+	if ((size_t) slot >= atomic_load_explicit(&table->used, memory_order_relaxed))
+		atomic_store_explicit(&table->used, slot + 1, memory_order_release);
+
+	return RETURN_VALUE_OK;
+}
+
+
+void clearPosition(PositionTable *table, int slot)
+{
+	if (slot < 0 || (size_t) slot >= table->positions.capacity || !table->active[slot])
+		return;
+
+	beginWrite(table, slot);
+	table->active[slot] = 0;
+	endWrite(table, slot);
+}
+
+
+int snapshotPositionArrays(PositionTable *table, PositionArrays *snapshot)
+{
+	size_t used = atomic_load_explicit(&table->used, memory_order_acquire);
+	size_t n = 0;
+
+	for (size_t slot = 0; slot < used && n < snapshot->capacity; slot++)
+	{
+		if (readSlot(table, slot, snapshot, n))
+			n++;
+	}
+	snapshot->count = n;
+
+	return n;
+}
+
+
+int snapshotPositions(PositionTable *table, GpsNedCoordinates *positions, int maxPositions)
+{
+	size_t used = atomic_load_explicit(&table->used, memory_order_acquire);
+	float x, y, z;
+	int64_t epochNs;
+	int32_t userId;
+	PositionArrays one = {&x, &y, &z, &epochNs, &userId, 1, 0};
+	int n = 0;
+
+	for (size_t slot = 0; slot < used && n < maxPositions; slot++)
+	{
+		if (!readSlot(table, slot, &one, 0))
+			continue;
+
+		positions[n].x = x;
+		positions[n].y = y;
+		positions[n].z = z;
+		formatTimestampIso8601(positions[n].timestamp, epochNs);
+		n++;
+	}
+
+	return n;
+}
+
+
+int parseTimestampIso8601(const char *timestamp, int64_t *epochNs)
+{
+	const char *p = timestamp;
+	int year, month, day, hour, minute, second = 0, offset = 0;
+	int64_t fraction = 0, scale = NANOSECONDS_PER_SECOND;
+
+	// Check arguments
+	if (timestamp == NULL || epochNs == NULL)
+		return RETURN_VALUE_ERROR;
+
+	// YYYY-MM-DDTHH:MM
+	if (readDigits(&p, 4, &year) != RETURN_VALUE_OK || *p++ != '-'
+			|| readDigits(&p, 2, &month) != RETURN_VALUE_OK || *p++ != '-'
+			|| readDigits(&p, 2, &day) != RETURN_VALUE_OK || (*p != 'T' && *p != 't' && *p != ' ')
+			|| (++p, readDigits(&p, 2, &hour)) != RETURN_VALUE_OK || *p++ != ':'
+			|| readDigits(&p, 2, &minute) != RETURN_VALUE_OK)
+		return RETURN_VALUE_ERROR;
+
+	// [:SS[.fff]]
+	if (*p == ':')
+	{
+		p++;
+		if (readDigits(&p, 2, &second) != RETURN_VALUE_OK)
+			return RETURN_VALUE_ERROR;
+
+		if (*p == '.')
+		{
+			for (p++; *p >= '0' && *p <= '9'; p++)
+			{
+				if (scale > 1)
+				{
+					scale /= 10;
+					fraction += (*p - '0') * scale;
+				}
+			}
+		}
+	}
+
+	// Z or +HH:MM / -HH:MM
+	if (*p == 'Z' || *p == 'z')
+		p++;
+	else if (*p == '+' || *p == '-')
+	{
+		int sign = (*p++ == '-') ? -1 : 1, offsetHours, offsetMinutes;
+
+		if (readDigits(&p, 2, &offsetHours) != RETURN_VALUE_OK || *p++ != ':'
+				|| readDigits(&p, 2, &offsetMinutes) != RETURN_VALUE_OK)
+			return RETURN_VALUE_ERROR;
+		offset = sign * (offsetHours * 3600 + offsetMinutes * 60);
+	}
+	else
+		return RETURN_VALUE_ERROR;
+
+	if (*p != '\0' || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+		return RETURN_VALUE_ERROR;
+
+	*epochNs = ((daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset)
+				* NANOSECONDS_PER_SECOND) + fraction;
+
+	return RETURN_VALUE_OK;
+}
+
+
+void formatTimestampIso8601(char *timestamp, int64_t epochNs)
+{
+	time_t seconds = epochNs / NANOSECONDS_PER_SECOND;
+	struct tm tm;
+
+	if (epochNs % NANOSECONDS_PER_SECOND < 0)
+		seconds--;
+
+	if (gmtime_r(&seconds, &tm) == NULL || strftime(timestamp, TIMESTAMP_ISO8601_SIZE, "%Y-%m-%dT%H:%M:%SZ", &tm) == 0)
+		timestamp[0] = '\0';
+}
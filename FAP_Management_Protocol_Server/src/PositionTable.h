@@ -0,0 +1,169 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// Module headers
+#include "GpsCoordinates.h"
+
+// C headers
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Alignment of the position arrays (a cache line, for vectorized scans)
+#define POSITION_ARRAYS_ALIGNMENT	64
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Users' positions as a structure of arrays: scans over all users only
+ * touch the fields they need, in dense (vectorizable) arrays.
+ * Timestamps are kept in binary (nanoseconds since the Unix epoch).
+ */
+typedef struct _PositionArrays
+{
+	float *x;									// X (NED, in meters)
+	float *y;									// Y (NED, in meters)
+	float *z;									// Z (NED, in meters)
+	int64_t *epochNs;							// Timestamp (ns since the Unix epoch)
+	int32_t *userId;							// User ID
+	size_t capacity;							// Size of the arrays
+	size_t count;								// Positions in the arrays (snapshots)
+} PositionArrays;
+
+/**
+ * Table of the users' last positions, indexed by user slot.
+ *
+ * A single writer (the event loop) publishes positions without blocking;
+ * any other thread can take a consistent snapshot at any time, without
+ * locks and without blocking the writer. Each slot is guarded by a
+ * sequence lock: the sequence is odd while the slot is being written,
+ * and readers retry if it changed while they copied the slot.
+ */
+typedef struct _PositionTable
+{
+	PositionArrays positions;					// Positions, indexed by user slot
+	atomic_uint *sequences;						// Sequence lock of each slot
+	uint8_t *active;							// The slot holds a position
+	atomic_size_t used;							// Slots ever written (highest slot + 1)
+} PositionTable;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize (allocate) position arrays.
+ *
+ * @param arrays		Pointer to the PositionArrays to be initialized.
+ * @param capacity		Size of the arrays.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializePositionArrays(PositionArrays *arrays, size_t capacity);
+
+/**
+ * Terminate position arrays, releasing them.
+ *
+ * @param arrays		Pointer to the PositionArrays.
+ */
+void terminatePositionArrays(PositionArrays *arrays);
+
+/**
+ * Initialize (empty) a position table.
+ *
+ * @param table			Pointer to the PositionTable to be initialized.
+ * @param capacity		Number of user slots.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializePositionTable(PositionTable *table, size_t capacity);
+
+/**
+ * Terminate a position table, releasing its arrays.
+ *
+ * @param table			Pointer to the PositionTable.
+ */
+void terminatePositionTable(PositionTable *table);
+
+/**
+ * Publish the position of a user slot (writer only).
+ *
+ * @param table			Pointer to the PositionTable.
+ * @param slot			User slot.
+ * @param userId		User ID.
+ * @param x				X (NED, in meters).
+ * @param y				Y (NED, in meters).
+ * @param z				Z (NED, in meters).
+ * @param epochNs		Timestamp (ns since the Unix epoch).
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int publishPosition(PositionTable *table, int slot, int userId, float x, float y, float z, int64_t epochNs);
+
+/**
+ * Clear the position of a user slot (writer only).
+ *
+ * @param table			Pointer to the PositionTable.
+ * @param slot			User slot.
+ */
+void clearPosition(PositionTable *table, int slot);
+
+/**
+ * Copy every published position (from any thread) into position arrays,
+ * packed from index 0 (snapshot->count positions).
+ * Each copied position is consistent (never a mix of two updates).
+ *
+ * @param table			Pointer to the PositionTable.
+ * @param snapshot		Destination arrays.
+ * @return				Number of positions copied.
+ */
+int snapshotPositionArrays(PositionTable *table, PositionArrays *snapshot);
+
+/**
+ * Copy every published position (from any thread), as GpsNedCoordinates.
+ *
+ * @param table			Pointer to the PositionTable.
+ * @param positions		Destination array.
+ * @param maxPositions	Size of the destination array.
+ * @return				Number of positions copied.
+ */
+int snapshotPositions(PositionTable *table, GpsNedCoordinates *positions, int maxPositions);
+
+/**
+ * Parse an ISO8601 timestamp (YYYY-MM-DDTHH:MM[:SS[.fff]] followed by Z or
+ * a UTC offset), without strptime()/mktime().
+ *
+ * @param timestamp		ISO8601 timestamp.
+ * @param epochNs		Pointer to be initialized with the ns since the Unix epoch.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int parseTimestampIso8601(const char *timestamp, int64_t *epochNs);
+
+/**
+ * Format a timestamp as ISO8601 (YYYY-MM-DDTHH:MM:SSZ).
+ *
+ * @param timestamp		Destination (at least TIMESTAMP_ISO8601_SIZE bytes).
+ * @param epochNs		Nanoseconds since the Unix epoch.
+ */
+void formatTimestampIso8601(char *timestamp, int64_t epochNs);
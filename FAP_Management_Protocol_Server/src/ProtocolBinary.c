@@ -0,0 +1,123 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "ProtocolBinary.h"
+
+// C headers
+#include <stdint.h>
+#include <string.h>
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+static inline void putUint16(unsigned char *p, uint16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static inline void putUint32(unsigned char *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static inline void putUint64(unsigned char *p, uint64_t v)
+{
+	putUint32(p, v >> 32);
+	putUint32(p + 4, (uint32_t) v);
+}
+
+static inline void putFloat(unsigned char *p, float v)
+{
+	uint32_t bits;
+
+	memcpy(&bits, &v, sizeof(bits));
+	putUint32(p, bits);
+}
+
+static inline uint16_t getUint16(const unsigned char *p)
+{
+	return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t getUint32(const unsigned char *p)
+{
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline uint64_t getUint64(const unsigned char *p)
+{
+	return ((uint64_t) getUint32(p) << 32) | getUint32(p + 4);
+}
+
+static inline float getFloat(const unsigned char *p)
+{
+	uint32_t bits = getUint32(p);
+	float v;
+
+	memcpy(&v, &bits, sizeof(v));
+	return v;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int isProtocolBinaryMsg(const void *payload, size_t length)
+{
+	const unsigned char *p = payload;
+
+	return (length == PROTOCOL_BINARY_MSG_SIZE && p[1] == PROTOCOL_BINARY_VERSION && p[0] < ' ');
+}
+
+
+int encodeProtocolBinaryMsg(void *buffer, const ProtocolBinaryMsg *msg)
+{
+	unsigned char *p = buffer;
+
+	// Check arguments
+	if (buffer == NULL || msg == NULL)
+		return RETURN_VALUE_ERROR;
+
+	p[0] = msg->msgType;
+	p[1] = PROTOCOL_BINARY_VERSION;
+	putUint16(p + 2, msg->updatePeriod);
+	putUint32(p + 4, msg->userId);
+	putFloat(p + 8, msg->latitude);
+	putFloat(p + 12, msg->longitude);
+	putFloat(p + 16, msg->altitude);
+	putUint64(p + 20, (uint64_t) msg->timestamp);
+
+	return RETURN_VALUE_OK;
+}
+
+
+int decodeProtocolBinaryMsg(ProtocolBinaryMsg *msg, const void *payload, size_t length)
+{
+	const unsigned char *p = payload;
+
+	// Check arguments
+	if (msg == NULL || payload == NULL || !isProtocolBinaryMsg(payload, length))
+		return RETURN_VALUE_ERROR;
+
+	msg->msgType = p[0];
+	msg->updatePeriod = getUint16(p + 2);
+	msg->userId = getUint32(p + 4);
+	msg->latitude = getFloat(p + 8);
+	msg->longitude = getFloat(p + 12);
+	msg->altitude = getFloat(p + 16);
+	msg->timestamp = (int64_t) getUint64(p + 20);
+
+	return RETURN_VALUE_OK;
+}
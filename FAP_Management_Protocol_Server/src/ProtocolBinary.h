@@ -0,0 +1,104 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <stddef.h>
+#include <stdint.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Version of the binary message layout
+#define PROTOCOL_BINARY_VERSION		1
+
+// Size of a binary message (in bytes)
+#define PROTOCOL_BINARY_MSG_SIZE	28
+
+// Values of the "encoding" parameter negotiated on association
+#define PROTOCOL_ENCODING_JSON		"json"
+#define PROTOCOL_ENCODING_BINARY	"binary"
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Binary FAP Management Protocol message.
+ *
+ * Wire layout (PROTOCOL_BINARY_MSG_SIZE bytes, network byte order):
+ *
+ *	offset	size	field
+ *	0		1		msgType
+ *	1		1		version (PROTOCOL_BINARY_VERSION)
+ *	2		2		updatePeriod (in seconds)
+ *	4		4		userId
+ *	8		4		latitude (IEEE 754 float, in degrees)
+ *	12		4		longitude (IEEE 754 float, in degrees)
+ *	16		4		altitude (IEEE 754 float, in meters)
+ *	20		8		timestamp (seconds since the Unix epoch, UTC)
+ *
+ * A GPS_COORDINATES_ACK carries the acknowledged update's timestamp,
+ * the period of the user's next updates and zeroed coordinates; the
+ * update period is 0 in the other messages.
+ */
+typedef struct _ProtocolBinaryMsg
+{
+	uint8_t msgType;							// Protocol "msgType" value
+	uint16_t updatePeriod;						// Next GPS coordinates update period (in seconds)
+	uint32_t userId;							// User ID
+	float latitude;								// Latitude (in degrees)
+	float longitude;							// Longitude (in degrees)
+	float altitude;								// Altitude (in meters)
+	int64_t timestamp;							// Seconds since the Unix epoch (UTC)
+} ProtocolBinaryMsg;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Check if a message payload uses the binary encoding (JSON payloads
+ * always start with '{' or whitespace).
+ *
+ * @param payload		Message payload.
+ * @param length		Payload's length.
+ * @return				True (1) if the payload is a binary message;
+ *						return False (0) otherwise.
+ */
+int isProtocolBinaryMsg(const void *payload, size_t length);
+
+/**
+ * Encode a binary message.
+ *
+ * @param buffer		Destination buffer (at least PROTOCOL_BINARY_MSG_SIZE bytes).
+ * @param msg			Message to be encoded.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int encodeProtocolBinaryMsg(void *buffer, const ProtocolBinaryMsg *msg);
+
+/**
+ * Decode a binary message.
+ *
+ * @param msg			Pointer to the ProtocolBinaryMsg to be initialized.
+ * @param payload		Message payload.
+ * @param length		Payload's length.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int decodeProtocolBinaryMsg(ProtocolBinaryMsg *msg, const void *payload, size_t length);
@@ -0,0 +1,613 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "ProtocolParser.h"
+
+// JSON parser (fallback)
+#include "json/parson.h"
+
+// C headers
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Valid JSON the in-place tokenizer doesn't handle (parsed with parson instead)
+#define PROTOCOL_PARSER_UNSUPPORTED		1
+
+// Maximum nesting of skipped values handled in place
+#define PROTOCOL_PARSER_MAX_DEPTH		16
+
+// Length of a string literal
+#define LITERAL_LENGTH(literal)			(sizeof(literal) - 1)
+
+// Size of the "updatePeriod" member of a response
+#define UPDATE_PERIOD_MEMBER_SIZE		32
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Position of the tokenizer in the message.
+ */
+typedef struct _JsonCursor
+{
+	const char *p;			// Next character
+	const char *end;		// End of the message
+} JsonCursor;
+
+/**
+ * Handler of an object's member: consumes the member's value.
+ */
+typedef int (*JsonMemberHandler)(JsonCursor *cursor, const char *key, size_t keyLength, void *context, int depth);
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+static inline void skipWhitespace(JsonCursor *cursor)
+{
+	while (cursor->p < cursor->end && (*cursor->p == ' ' || *cursor->p == '\t' || *cursor->p == '\n' || *cursor->p == '\r'))
+		cursor->p++;
+}
+
+static inline int matchKey(const char *key, size_t keyLength, const char *name, size_t nameLength)
+{
+	return keyLength == nameLength && memcmp(key, name, nameLength) == 0;
+}
+
+/**
+ * Scan a string, without unescaping it.
+ *
+ * @param cursor		Cursor (on the opening quote).
+ * @param start			Pointer to be initialized with the string's first character.
+ * @param length		Pointer to be initialized with the string's (raw) length.
+ * @param escaped		Pointer to be initialized with True (1) if the string has escapes.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+static int scanString(JsonCursor *cursor, const char **start, size_t *length, int *escaped)
+{
+	if (cursor->p >= cursor->end || *cursor->p != '"')
+		return RETURN_VALUE_ERROR;
+
+	*start = ++cursor->p;
+	*escaped = 0;
+
+	while (cursor->p < cursor->end)
+	{
+		unsigned char c = *cursor->p;
+
+		if (c == '"')
+		{
+			*length = cursor->p - *start;
+			cursor->p++;
+			return RETURN_VALUE_OK;
+		}
+		if (c < 0x20)
+			return RETURN_VALUE_ERROR;
+		if (c == '\\')
+		{
+			*escaped = 1;
+			if (++cursor->p >= cursor->end)
+				return RETURN_VALUE_ERROR;
+		}
+		cursor->p++;
+	}
+
+	return RETURN_VALUE_ERROR;
+}
+
+/**
+ * Skip the digits at the cursor.
+ *
+ * @return				Number of digits skipped.
+ */
+static inline size_t skipDigits(JsonCursor *cursor)
+{
+	const char *start = cursor->p;
+
+	while (cursor->p < cursor->end && isdigit((unsigned char) *cursor->p))
+		cursor->p++;
+
+	return cursor->p - start;
+}
+
+/**
+ * Scan a number: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?, as in JSON
+ * (strtod() alone also takes "0x1F", "inf", "nan" or a leading '+').
+ *
+ * @param cursor		Cursor (on the number's first character).
+ * @param value			Pointer to be initialized with the number.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+static int scanNumber(JsonCursor *cursor, double *value)
+{
+	JsonCursor number = *cursor;
+	char *end;
+
+	if (number.p < number.end && *number.p == '-')
+		number.p++;
+
+	// No leading zeros
+	if (number.p < number.end && *number.p == '0')
+		number.p++;
+	else if (skipDigits(&number) == 0)
+		return RETURN_VALUE_ERROR;
+
+	if (number.p < number.end && *number.p == '.')
+	{
+		number.p++;
+		if (skipDigits(&number) == 0)
+			return RETURN_VALUE_ERROR;
+	}
+
+	if (number.p < number.end && (*number.p == 'e' || *number.p == 'E'))
+	{
+		number.p++;
+		if (number.p < number.end && (*number.p == '+' || *number.p == '-'))
+			number.p++;
+		if (skipDigits(&number) == 0)
+			return RETURN_VALUE_ERROR;
+	}
+
+	// The message is NUL-terminated, so strtod() stops in it (where the grammar did)
+	*value = strtod(cursor->p, &end);
+	if (end != number.p || !isfinite(*value))
+		return RETURN_VALUE_ERROR;
+
+	cursor->p = end;
+
+	return RETURN_VALUE_OK;
+}
+
+/**
+ * Convert a number to an int, if it is one.
+ *
+ * @param value			Number.
+ * @param integer		Pointer to be initialized with the int.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise (a fraction, or out of range), return RETURN_VALUE_ERROR.
+ */
+static int toInt(double value, int *integer)
+{
+	if (!(value >= INT_MIN && value <= INT_MAX) || value != floor(value))
+		return RETURN_VALUE_ERROR;
+
+	*integer = (int) value;
+
+	return RETURN_VALUE_OK;
+}
+
+/**
+ * Scan a short string value into a buffer (empty if it doesn't fit).
+ */
+static int scanToken(JsonCursor *cursor, char *token, size_t size)
+{
+	const char *start;
+	size_t length;
+	int escaped;
+
+	if (scanString(cursor, &start, &length, &escaped) != RETURN_VALUE_OK)
+		return RETURN_VALUE_ERROR;
+	if (escaped)
+		return PROTOCOL_PARSER_UNSUPPORTED;
+
+	if (length >= size)
+		length = 0;
+	memcpy(token, start, length);
+	token[length] = '\0';
+
+	return RETURN_VALUE_OK;
+}
+
+/**
+ * Scan a literal (true, false or null).
+ */
+static int scanLiteral(JsonCursor *cursor, const char *literal)
+{
+	size_t length = strlen(literal);
+
+	if ((size_t) (cursor->end - cursor->p) < length || memcmp(cursor->p, literal, length) != 0)
+		return RETURN_VALUE_ERROR;
+
+	cursor->p += length;
+
+	return RETURN_VALUE_OK;
+}
+
+static int skipValue(JsonCursor *cursor, int depth);
+
+/**
+ * Parse an object, handing each member to a handler.
+ *
+ * @param cursor		Cursor (on the opening brace).
+ * @param handler		Member handler.
+ * @param context		Handler's context.
+ * @param depth			Nesting depth of the object.
+ * @return				RETURN_VALUE_OK, RETURN_VALUE_ERROR or PROTOCOL_PARSER_UNSUPPORTED.
+ */
+static int parseObject(JsonCursor *cursor, JsonMemberHandler handler, void *context, int depth)
+{
+	if (depth > PROTOCOL_PARSER_MAX_DEPTH)
+		return PROTOCOL_PARSER_UNSUPPORTED;
+	if (cursor->p >= cursor->end || *cursor->p != '{')
+		return RETURN_VALUE_ERROR;
+
+	cursor->p++;
+	skipWhitespace(cursor);
+	if (cursor->p < cursor->end && *cursor->p == '}')
+	{
+		cursor->p++;
+		return RETURN_VALUE_OK;
+	}
+
+	for (;;)
+	{
+		const char *key;
+		size_t keyLength;
+		int escaped, res;
+
+		if (scanString(cursor, &key, &keyLength, &escaped) != RETURN_VALUE_OK)
+			return RETURN_VALUE_ERROR;
+		if (escaped)
+			return PROTOCOL_PARSER_UNSUPPORTED;
+
+		skipWhitespace(cursor);
+		if (cursor->p >= cursor->end || *cursor->p != ':')
+			return RETURN_VALUE_ERROR;
+		cursor->p++;
+		skipWhitespace(cursor);
+
+		if ((res = handler(cursor, key, keyLength, context, depth)) != RETURN_VALUE_OK)
+			return res;
+
+		skipWhitespace(cursor);
+		if (cursor->p >= cursor->end)
+			return RETURN_VALUE_ERROR;
+		if (*cursor->p == '}')
+		{
+			cursor->p++;
+			return RETURN_VALUE_OK;
+		}
+		if (*cursor->p != ',')
+			return RETURN_VALUE_ERROR;
+		cursor->p++;
+		skipWhitespace(cursor);
+	}
+}
+
+static int skipMember(JsonCursor *cursor, const char *key, size_t keyLength, void *context, int depth)
+{
+	return skipValue(cursor, depth + 1);
+}
+
+/**
+ * Skip any value.
+ *
+ * @param cursor		Cursor (on the value's first character).
+ * @param depth			Nesting depth of the value.
+ * @return				RETURN_VALUE_OK, RETURN_VALUE_ERROR or PROTOCOL_PARSER_UNSUPPORTED.
+ */
+static int skipValue(JsonCursor *cursor, int depth)
+{
+	const char *start;
+	size_t length;
+	int escaped, res;
+	double number;
+
+	if (cursor->p >= cursor->end)
+		return RETURN_VALUE_ERROR;
+
+	switch (*cursor->p)
+	{
+		case '"':
+			return scanString(cursor, &start, &length, &escaped);
+
+		case '{':
+			return parseObject(cursor, skipMember, NULL, depth);
+
+		case '[':
+			if (depth > PROTOCOL_PARSER_MAX_DEPTH)
+				return PROTOCOL_PARSER_UNSUPPORTED;
+
+			cursor->p++;
+			skipWhitespace(cursor);
+			if (cursor->p < cursor->end && *cursor->p == ']')
+			{
+				cursor->p++;
+				return RETURN_VALUE_OK;
+			}
+
+			for (;;)
+			{
+				if ((res = skipValue(cursor, depth + 1)) != RETURN_VALUE_OK)
+					return res;
+
+				skipWhitespace(cursor);
+				if (cursor->p >= cursor->end)
+					return RETURN_VALUE_ERROR;
+				if (*cursor->p == ']')
+				{
+					cursor->p++;
+					return RETURN_VALUE_OK;
+				}
+				if (*cursor->p != ',')
+					return RETURN_VALUE_ERROR;
+				cursor->p++;
+				skipWhitespace(cursor);
+			}
+
+		case 't':
+			return scanLiteral(cursor, "true");
+
+		case 'f':
+			return scanLiteral(cursor, "false");
+
+		case 'n':
+			return scanLiteral(cursor, "null");
+
+		default:
+			return scanNumber(cursor, &number);
+	}
+}
+
+/**
+ * Read a number member (values of other types read as 0, like parson's getters).
+ */
+static int parseNumberMember(JsonCursor *cursor, double *value, int depth)
+{
+	*value = 0;
+
+	if (cursor->p < cursor->end && (*cursor->p == '-' || isdigit((unsigned char) *cursor->p)))
+		return scanNumber(cursor, value);
+
+	return skipValue(cursor, depth + 1);
+}
+
+/**
+ * Read a string member into a buffer (values of other types read as "").
+ */
+static int parseTokenMember(JsonCursor *cursor, char *token, size_t size, int depth)
+{
+	token[0] = '\0';
+
+	if (cursor->p < cursor->end && *cursor->p == '"')
+		return scanToken(cursor, token, size);
+
+	return skipValue(cursor, depth + 1);
+}
+
+static int gpsCoordinatesMember(JsonCursor *cursor, const char *key, size_t keyLength, void *context, int depth)
+{
+	GpsRawCoordinates *gpsCoordinates = context;
+	double value;
+	int res;
+
+	if (matchKey(key, keyLength, PROTOCOL_PARAMETERS_GPS_COORDINATES_TIMESTAMP, LITERAL_LENGTH(PROTOCOL_PARAMETERS_GPS_COORDINATES_TIMESTAMP)))
+		return parseTokenMember(cursor, gpsCoordinates->timestamp, sizeof(gpsCoordinates->timestamp), depth);
+
+	if (matchKey(key, keyLength, PROTOCOL_PARAMETERS_GPS_COORDINATES_LAT, LITERAL_LENGTH(PROTOCOL_PARAMETERS_GPS_COORDINATES_LAT)))
+	{
+		res = parseNumberMember(cursor, &value, depth);
+		gpsCoordinates->latitude = value;
+		return res;
+	}
+	if (matchKey(key, keyLength, PROTOCOL_PARAMETERS_GPS_COORDINATES_LON, LITERAL_LENGTH(PROTOCOL_PARAMETERS_GPS_COORDINATES_LON)))
+	{
+		res = parseNumberMember(cursor, &value, depth);
+		gpsCoordinates->longitude = value;
+		return res;
+	}
+	if (matchKey(key, keyLength, PROTOCOL_PARAMETERS_GPS_COORDINATES_ALT, LITERAL_LENGTH(PROTOCOL_PARAMETERS_GPS_COORDINATES_ALT)))
+	{
+		res = parseNumberMember(cursor, &value, depth);
+		gpsCoordinates->altitude = value;
+		return res;
+	}
+
+	return skipValue(cursor, depth + 1);
+}
+
+static int protocolMsgMember(JsonCursor *cursor, const char *key, size_t keyLength, void *context, int depth)
+{
+	ProtocolMsg *msg = context;
+	double value;
+	int res;
+
+	if (matchKey(key, keyLength, PROTOCOL_PARAMETERS_MSG_TYPE, LITERAL_LENGTH(PROTOCOL_PARAMETERS_MSG_TYPE)))
+	{
+		if ((res = parseNumberMember(cursor, &value, depth)) != RETURN_VALUE_OK)
+			return res;
+		return toInt(value, &msg->msgType);
+	}
+	if (matchKey(key, keyLength, PROTOCOL_PARAMETERS_USER_ID, LITERAL_LENGTH(PROTOCOL_PARAMETERS_USER_ID)))
+	{
+		if ((res = parseNumberMember(cursor, &value, depth)) != RETURN_VALUE_OK)
+			return res;
+		return toInt(value, &msg->userId);
+	}
+	if (matchKey(key, keyLength, PROTOCOL_PARAMETERS_GPS_COORDINATES, LITERAL_LENGTH(PROTOCOL_PARAMETERS_GPS_COORDINATES)))
+	{
+		if (cursor->p >= cursor->end || *cursor->p != '{')
+			return skipValue(cursor, depth + 1);
+
+		memset(&msg->gpsCoordinates, 0, sizeof(msg->gpsCoordinates));
+		msg->hasGpsCoordinates = 1;
+		return parseObject(cursor, gpsCoordinatesMember, &msg->gpsCoordinates, depth + 1);
+	}
+	if (matchKey(key, keyLength, PROTOCOL_PARAMETERS_ENCODING, LITERAL_LENGTH(PROTOCOL_PARAMETERS_ENCODING)))
+		return parseTokenMember(cursor, msg->encoding, sizeof(msg->encoding), depth);
+	if (matchKey(key, keyLength, PROTOCOL_PARAMETERS_TRANSPORT, LITERAL_LENGTH(PROTOCOL_PARAMETERS_TRANSPORT)))
+		return parseTokenMember(cursor, msg->transport, sizeof(msg->transport), depth);
+
+	return skipValue(cursor, depth + 1);
+}
+
+/**
+ * Copy a parson string into a buffer (empty if it's missing or doesn't fit).
+ */
+static void copyToken(char *token, size_t size, const char *value)
+{
+	if (value == NULL || strlen(value) >= size)
+		value = "";
+
+	strcpy(token, value);
+}
+
+/**
+ * Parse a message with parson (messages the in-place tokenizer doesn't handle).
+ *
+ * @param msg			Pointer to the ProtocolMsg to be initialized.
+ * @param json			JSON message (NUL-terminated).
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+static int parseProtocolMsgWithParson(ProtocolMsg *msg, const char *json)
+{
+	JSON_Value *root = json_parse_string(json);
+	JSON_Object *object = json_value_get_object(root);
+	JSON_Object *gpsCoordinates;
+
+	memset(msg, 0, sizeof(*msg));
+	if (object == NULL)
+	{
+		json_value_free(root);
+		return RETURN_VALUE_ERROR;
+	}
+
+	if (toInt(json_object_get_number(object, PROTOCOL_PARAMETERS_MSG_TYPE), &msg->msgType) != RETURN_VALUE_OK
+			|| toInt(json_object_get_number(object, PROTOCOL_PARAMETERS_USER_ID), &msg->userId) != RETURN_VALUE_OK)
+	{
+		json_value_free(root);
+		return RETURN_VALUE_ERROR;
+	}
+	copyToken(msg->encoding, sizeof(msg->encoding), json_object_get_string(object, PROTOCOL_PARAMETERS_ENCODING));
+	copyToken(msg->transport, sizeof(msg->transport), json_object_get_string(object, PROTOCOL_PARAMETERS_TRANSPORT));
+
+	if ((gpsCoordinates = json_object_get_object(object, PROTOCOL_PARAMETERS_GPS_COORDINATES)) != NULL)
+	{
+		msg->hasGpsCoordinates = 1;
+		msg->gpsCoordinates.latitude = json_object_get_number(gpsCoordinates, PROTOCOL_PARAMETERS_GPS_COORDINATES_LAT);
+		msg->gpsCoordinates.longitude = json_object_get_number(gpsCoordinates, PROTOCOL_PARAMETERS_GPS_COORDINATES_LON);
+		msg->gpsCoordinates.altitude = json_object_get_number(gpsCoordinates, PROTOCOL_PARAMETERS_GPS_COORDINATES_ALT);
+		copyToken(msg->gpsCoordinates.timestamp, sizeof(msg->gpsCoordinates.timestamp),
+				  json_object_get_string(gpsCoordinates, PROTOCOL_PARAMETERS_GPS_COORDINATES_TIMESTAMP));
+	}
+
+	json_value_free(root);
+
+	return RETURN_VALUE_OK;
+}
+
+/**
+ * Write the optional "updatePeriod" member of a response (nothing if the
+ * period is not positive).
+ */
+static inline void formatUpdatePeriod(char period[UPDATE_PERIOD_MEMBER_SIZE], int updatePeriod)
+{
+	period[0] = '\0';
+	if (updatePeriod > 0)
+		snprintf(period, UPDATE_PERIOD_MEMBER_SIZE, ",\"" PROTOCOL_PARAMETERS_UPDATE_PERIOD "\":%d", updatePeriod);
+}
+
+/**
+ * Check the result of snprintf().
+ */
+static inline int formatted(int length, size_t size)
+{
+	return (length < 0 || (size_t) length >= size) ? RETURN_VALUE_ERROR : length;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int parseProtocolMsg(ProtocolMsg *msg, const char *json, size_t length)
+{
+	JsonCursor cursor = {json, json + length};
+	int res;
+
+	// Check arguments
+	if (msg == NULL || json == NULL)
+		return RETURN_VALUE_ERROR;
+
+	memset(msg, 0, sizeof(*msg));
+
+	skipWhitespace(&cursor);
+	res = parseObject(&cursor, protocolMsgMember, msg, 0);
+	if (res == PROTOCOL_PARSER_UNSUPPORTED)
+		return parseProtocolMsgWithParson(msg, json);
+	if (res != RETURN_VALUE_OK)
+		return RETURN_VALUE_ERROR;
+
+	// Nothing but whitespace may follow the message
+	skipWhitespace(&cursor);
+	if (cursor.p != cursor.end)
+		return RETURN_VALUE_ERROR;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int formatProtocolResponse(char *buffer, size_t size, int userId, int msgType)
+{
+	return formatted(snprintf(buffer, size,
+							  "{\"" PROTOCOL_PARAMETERS_USER_ID "\":%d,\"" PROTOCOL_PARAMETERS_MSG_TYPE "\":%d}",
+							  userId, msgType),
+					 size);
+}
+
+
+int formatAssociationResponse(char *buffer, size_t size, int userId, int msgType,
+							  const char *encoding, const char *transport, int updatePeriod)
+{
+	char period[UPDATE_PERIOD_MEMBER_SIZE];
+
+	formatUpdatePeriod(period, updatePeriod);
+
+	return formatted(snprintf(buffer, size,
+							  "{\"" PROTOCOL_PARAMETERS_USER_ID "\":%d,\"" PROTOCOL_PARAMETERS_MSG_TYPE "\":%d%s%s%s%s%s%s%s}",
+							  userId, msgType,
+							  encoding ? ",\"" PROTOCOL_PARAMETERS_ENCODING "\":\"" : "", encoding ? encoding : "", encoding ? "\"" : "",
+							  transport ? ",\"" PROTOCOL_PARAMETERS_TRANSPORT "\":\"" : "", transport ? transport : "", transport ? "\"" : "",
+							  period),
+					 size);
+}
+
+
+int formatGpsCoordinatesAck(char *buffer, size_t size, int userId, int msgType, const char *timestamp, int updatePeriod)
+{
+	char period[UPDATE_PERIOD_MEMBER_SIZE];
+
+	// The timestamp is echoed as is: it must not need escaping
+	for (const char *c = timestamp; *c != '\0'; c++)
+	{
+		if (*c == '"' || *c == '\\' || (unsigned char) *c < 0x20)
+			return RETURN_VALUE_ERROR;
+	}
+
+	formatUpdatePeriod(period, updatePeriod);
+
+	return formatted(snprintf(buffer, size,
+							  "{\"" PROTOCOL_PARAMETERS_USER_ID "\":%d,\"" PROTOCOL_PARAMETERS_MSG_TYPE "\":%d,\"" PROTOCOL_PARAMETERS_GPS_TIMESTAMP "\":\"%s\"%s}",
+							  userId, msgType, timestamp, period),
+					 size);
+}
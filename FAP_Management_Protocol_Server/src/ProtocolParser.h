@@ -0,0 +1,119 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// Module headers
+#include "GpsCoordinates.h"
+
+// C headers
+#include <stddef.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Protocol parameters
+#define PROTOCOL_PARAMETERS_USER_ID                     "userId"
+#define PROTOCOL_PARAMETERS_MSG_TYPE                    "msgType"
+#define PROTOCOL_PARAMETERS_GPS_COORDINATES             "gpsCoordinates"
+#define PROTOCOL_PARAMETERS_GPS_COORDINATES_LAT         "lat"
+#define PROTOCOL_PARAMETERS_GPS_COORDINATES_LON         "lon"
+#define PROTOCOL_PARAMETERS_GPS_COORDINATES_ALT         "alt"
+#define PROTOCOL_PARAMETERS_GPS_COORDINATES_TIMESTAMP   "timestamp"
+#define PROTOCOL_PARAMETERS_GPS_TIMESTAMP               "gpsTimestamp"
+#define PROTOCOL_PARAMETERS_ENCODING                    "encoding"
+#define PROTOCOL_PARAMETERS_TRANSPORT                   "transport"
+#define PROTOCOL_PARAMETERS_UPDATE_PERIOD               "updatePeriod"
+
+// Size of the short string parameters ("encoding", "transport"), including '\0'
+#define PROTOCOL_MSG_TOKEN_SIZE		16
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Parameters of a JSON FAP Management Protocol message.
+ * Missing parameters are zeroed (empty strings), as with parson's getters.
+ */
+typedef struct _ProtocolMsg
+{
+	int msgType;									// "msgType"
+	int userId;										// "userId"
+	int hasGpsCoordinates;							// "gpsCoordinates" is present
+	GpsRawCoordinates gpsCoordinates;				// "gpsCoordinates.{lat,lon,alt,timestamp}"
+	char encoding[PROTOCOL_MSG_TOKEN_SIZE];			// "encoding"
+	char transport[PROTOCOL_MSG_TOKEN_SIZE];		// "transport"
+} ProtocolMsg;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Parse a JSON message in place, without allocating memory.
+ * Only the parameters above are extracted; any other one is skipped.
+ * Messages the in-place tokenizer doesn't handle (escaped strings in the
+ * extracted parameters) are parsed with parson instead.
+ *
+ * @param msg			Pointer to the ProtocolMsg to be initialized.
+ * @param json			JSON message (NUL-terminated).
+ * @param length		Message's length.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise (invalid JSON), return RETURN_VALUE_ERROR.
+ */
+int parseProtocolMsg(ProtocolMsg *msg, const char *json, size_t length);
+
+/**
+ * Write a response carrying only the user ID and the message type
+ * (e.g. USER_DESASSOCIATION_ACK).
+ *
+ * @param buffer		Destination buffer.
+ * @param size			Buffer's size.
+ * @param userId		User ID.
+ * @param msgType		Message type.
+ * @return				Response's length; RETURN_VALUE_ERROR if it doesn't fit.
+ */
+int formatProtocolResponse(char *buffer, size_t size, int userId, int msgType);
+
+/**
+ * Write a user association response (USER_ASSOCIATION_ACCEPTED/REJECTED).
+ *
+ * @param buffer		Destination buffer.
+ * @param size			Buffer's size.
+ * @param userId		User ID.
+ * @param msgType		Message type.
+ * @param encoding		Accepted "encoding" (NULL to leave it out).
+ * @param transport		Accepted "transport" (NULL to leave it out).
+ * @param updatePeriod	GPS coordinates update period, in seconds (0 to leave it out).
+ * @return				Response's length; RETURN_VALUE_ERROR if it doesn't fit.
+ */
+int formatAssociationResponse(char *buffer, size_t size, int userId, int msgType,
+							  const char *encoding, const char *transport, int updatePeriod);
+
+/**
+ * Write a GPS coordinates acknowledgement (GPS_COORDINATES_ACK).
+ *
+ * @param buffer		Destination buffer.
+ * @param size			Buffer's size.
+ * @param userId		User ID.
+ * @param msgType		Message type.
+ * @param timestamp		Timestamp of the acknowledged update.
+ * @param updatePeriod	Next GPS coordinates update period, in seconds (0 to leave it out).
+ * @return				Response's length; RETURN_VALUE_ERROR if it doesn't fit
+ *						or the timestamp would need escaping.
+ */
+int formatGpsCoordinatesAck(char *buffer, size_t size, int userId, int msgType, const char *timestamp, int updatePeriod);
@@ -0,0 +1,485 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "SpatialIndex.h"
+
+// C headers
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+static inline int cellOf(const SpatialIndex *index, float v)
+{
+	return (int) floorf(v / index->cellSize);
+}
+
+static inline size_t bucketOf(const SpatialIndex *index, int cellX, int cellY)
+{
+	return ((uint32_t) cellX * 73856093u ^ (uint32_t) cellY * 19349663u) & index->bucketMask;
+}
+
+static inline float squaredDistance(const SpatialIndex *index, int position, float x, float y, float z)
+{
+	float dx = index->x[position] - x, dy = index->y[position] - y, dz = index->z[position] - z;
+
+	return dx * dx + dy * dy + dz * dz;
+}
+
+/**
+ * Find an occupied cell.
+ *
+ * @return				Cell; -1 if the cell is empty.
+ */
+static int findCell(const SpatialIndex *index, int cellX, int cellY)
+{
+	int cell = index->buckets[bucketOf(index, cellX, cellY)];
+
+	while (cell >= 0 && (index->cells[cell].cellX != cellX || index->cells[cell].cellY != cellY))
+		cell = index->cells[cell].next;
+
+	return cell;
+}
+
+/**
+ * Replace a cell in its bucket's chain (by another cell, or by the next one
+ * of the chain to unlink it).
+ */
+static void replaceCellLink(SpatialIndex *index, int cell, int replacement)
+{
+	const SpatialIndexCell *c = &index->cells[cell];
+	int *link = &index->buckets[bucketOf(index, c->cellX, c->cellY)];
+
+	while (*link != cell)
+		link = &index->cells[*link].next;
+	*link = replacement;
+}
+
+/**
+ * Link a slot at the head of the list of its cell (the cell is created if
+ * it was empty).
+ */
+static void linkEntry(SpatialIndex *index, int slot, int cellX, int cellY)
+{
+	SpatialIndexEntry *entry = &index->entries[slot];
+	SpatialIndexCell *c;
+	int cell = findCell(index, cellX, cellY);
+
+	if (cell < 0)
+	{
+		size_t bucket = bucketOf(index, cellX, cellY);
+
+		cell = index->nCells++;
+		c = &index->cells[cell];
+		c->cellX = cellX;
+		c->cellY = cellY;
+		c->head = -1;
+		c->count = 0;
+		c->next = index->buckets[bucket];
+		index->buckets[bucket] = cell;
+	}
+
+	c = &index->cells[cell];
+	entry->cell = cell;
+	entry->prev = -1;
+	entry->next = c->head;
+	if (entry->next >= 0)
+		index->entries[entry->next].prev = slot;
+	c->head = slot;
+	c->count++;
+}
+
+/**
+ * Unlink a slot from the list of its cell (the cell is dropped once empty).
+ */
+static void unlinkEntry(SpatialIndex *index, int slot)
+{
+	SpatialIndexEntry *entry = &index->entries[slot];
+	SpatialIndexCell *c = &index->cells[entry->cell];
+	int cell = entry->cell, last;
+
+	if (entry->prev >= 0)
+		index->entries[entry->prev].next = entry->next;
+	else
+		c->head = entry->next;
+
+	if (entry->next >= 0)
+		index->entries[entry->next].prev = entry->prev;
+
+	entry->cell = -1;
+	if (--c->count > 0)
+		return;
+
+	// Empty: unlink the cell, and move the last occupied cell into its hole
+	replaceCellLink(index, cell, c->next);
+	last = --index->nCells;
+	if (cell != last)
+	{
+		replaceCellLink(index, last, cell);
+		index->cells[cell] = index->cells[last];
+		for (int s = index->cells[cell].head; s >= 0; s = index->entries[s].next)
+			index->entries[s].cell = cell;
+	}
+}
+
+/**
+ * Squared horizontal distances from a point to the nearest and the farthest
+ * points of a cell.
+ */
+static inline void cellDistances(const SpatialIndex *index, const SpatialIndexCell *c, float x, float y,
+								 float *nearest, float *farthest)
+{
+	float minX = c->cellX * index->cellSize - x, maxX = minX + index->cellSize;
+	float minY = c->cellY * index->cellSize - y, maxY = minY + index->cellSize;
+	float nearX = (minX > 0) ? minX : (maxX < 0) ? -maxX : 0;
+	float nearY = (minY > 0) ? minY : (maxY < 0) ? -maxY : 0;
+	float farX = fmaxf(fabsf(minX), fabsf(maxX)), farY = fmaxf(fabsf(minY), fabsf(maxY));
+
+	*nearest = nearX * nearX + nearY * nearY;
+	*farthest = farX * farX + farY * farY;
+}
+
+/**
+ * Number of cells of the square of cells around a point (as a float, it
+ * may not fit an int).
+ */
+static inline float cellsAround(const SpatialIndex *index, float x, float y, float radius)
+{
+	float columns = floorf((x + radius) / index->cellSize) - floorf((x - radius) / index->cellSize) + 1;
+	float rows = floorf((y + radius) / index->cellSize) - floorf((y - radius) / index->cellSize) + 1;
+
+	return columns * rows;
+}
+
+/**
+ * Append the users of a cell within a distance of a point to findUsersWithinRadius()'s results.
+ *
+ * @return				False (0) once the destination is full; True (1) otherwise.
+ */
+static int visitWithinCell(const SpatialIndex *index, int cell, float x, float y, float z, float radius2,
+						   int *slots, int *n, int maxSlots)
+{
+	for (int slot = index->cells[cell].head; slot >= 0; slot = index->entries[slot].next)
+	{
+		if (squaredDistance(index, index->entries[slot].position, x, y, z) <= radius2)
+		{
+			if (*n == maxSlots)
+				return 0;
+			slots[(*n)++] = slot;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Insert a user in the k nearest found so far (sorted by squared distance).
+ */
+static inline void insertNearest(int *slots, float *distances, int *found, int k, int slot, float distance)
+{
+	int i;
+
+	if (*found == k && distance >= distances[k - 1])
+		return;
+
+	i = (*found < k) ? (*found)++ : k - 1;
+	for (; i > 0 && distances[i - 1] > distance; i--)
+	{
+		slots[i] = slots[i - 1];
+		distances[i] = distances[i - 1];
+	}
+	slots[i] = slot;
+	distances[i] = distance;
+}
+
+/**
+ * Visit the users of a cell for findNearestUsers().
+ *
+ * @return				Number of users of the cell.
+ */
+static int visitNearestCell(const SpatialIndex *index, int cellX, int cellY, float x, float y, float z,
+							int *slots, float *distances, int *found, int k)
+{
+	int cell = findCell(index, cellX, cellY);
+
+	if (cell < 0)
+		return 0;
+
+	for (int slot = index->cells[cell].head; slot >= 0; slot = index->entries[slot].next)
+		insertNearest(slots, distances, found, k, slot, squaredDistance(index, index->entries[slot].position, x, y, z));
+
+	return index->cells[cell].count;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeSpatialIndex(SpatialIndex *index, size_t capacity, float cellSize)
+{
+	size_t buckets = 1;
+
+	// Check arguments
+	if (index == NULL || capacity == 0 || !(cellSize > 0))
+		return RETURN_VALUE_ERROR;
+
+	// About two buckets per slot (there are at most as many occupied cells as slots)
+	while (buckets < 2 * capacity)
+		buckets <<= 1;
+
+	memset(index, 0, sizeof(*index));
+	index->cellSize = cellSize;
+	index->capacity = capacity;
+	index->bucketMask = buckets - 1;
+	index->buckets = malloc(buckets * sizeof(int));
+	index->cells = malloc(capacity * sizeof(SpatialIndexCell));
+	index->entries = malloc(capacity * sizeof(SpatialIndexEntry));
+	index->x = malloc(capacity * sizeof(float));
+	index->y = malloc(capacity * sizeof(float));
+	index->z = malloc(capacity * sizeof(float));
+	index->slots = malloc(capacity * sizeof(int));
+
+	if (index->buckets == NULL || index->cells == NULL || index->entries == NULL || index->x == NULL
+			|| index->y == NULL || index->z == NULL || index->slots == NULL)
+	{
+		terminateSpatialIndex(index);
+		return RETURN_VALUE_ERROR;
+	}
+
+	memset(index->buckets, 0xff, buckets * sizeof(int));
+	for (size_t slot = 0; slot < capacity; slot++)
+		index->entries[slot].cell = -1;
+
+	return RETURN_VALUE_OK;
+}
+
+
+void terminateSpatialIndex(SpatialIndex *index)
+{
+	free(index->buckets);
+	free(index->cells);
+	free(index->entries);
+	free(index->x);
+	free(index->y);
+	free(index->z);
+	free(index->slots);
+	memset(index, 0, sizeof(*index));
+}
+
+
+int updateSpatialIndex(SpatialIndex *index, int slot, float x, float y, float z)
+{
+	SpatialIndexEntry *entry;
+	int cellX, cellY;
+
+	// Check arguments
+	if (slot < 0 || (size_t) slot >= index->capacity)
+		return RETURN_VALUE_ERROR;
+
+	entry = &index->entries[slot];
+	cellX = cellOf(index, x);
+	cellY = cellOf(index, y);
+
+	if (entry->cell < 0)
+	{
+		// New slot: append it to the dense arrays
+		entry->position = index->count++;
+		index->slots[entry->position] = slot;
+		linkEntry(index, slot, cellX, cellY);
+	}
+	else
+	{
+		const SpatialIndexCell *c = &index->cells[entry->cell];
+
+		index->sumX -= index->x[entry->position];
+		index->sumY -= index->y[entry->position];
+		index->sumZ -= index->z[entry->position];
+
+		// Moved to another cell
+		if (c->cellX != cellX || c->cellY != cellY)
+		{
+			unlinkEntry(index, slot);
+			linkEntry(index, slot, cellX, cellY);
+		}
+	}
+
+	if (index->count == 1 || z < index->minZ)
+		index->minZ = z;
+	if (index->count == 1 || z > index->maxZ)
+		index->maxZ = z;
+
+	index->sumX += x;
+	index->sumY += y;
+	index->sumZ += z;
+	index->x[entry->position] = x;
+	index->y[entry->position] = y;
+	index->z[entry->position] = z;
+
+	return RETURN_VALUE_OK;
+}
+
+
+void removeSpatialIndex(SpatialIndex *index, int slot)
+{
+	SpatialIndexEntry *entry;
+	int last;
+
+	if (slot < 0 || (size_t) slot >= index->capacity || index->entries[slot].cell < 0)
+		return;
+
+	entry = &index->entries[slot];
+	unlinkEntry(index, slot);
+
+	index->sumX -= index->x[entry->position];
+	index->sumY -= index->y[entry->position];
+	index->sumZ -= index->z[entry->position];
+
+	// Move the last position of the dense arrays into the hole
+	last = --index->count;
+	if (entry->position != last)
+	{
+		index->x[entry->position] = index->x[last];
+		index->y[entry->position] = index->y[last];
+		index->z[entry->position] = index->z[last];
+		index->slots[entry->position] = index->slots[last];
+		index->entries[index->slots[last]].position = entry->position;
+	}
+
+	// Don't carry rounding errors over
+	if (index->count == 0)
+		index->sumX = index->sumY = index->sumZ = 0;
+}
+
+
+int getSpatialIndexCentroid(const SpatialIndex *index, float *x, float *y, float *z)
+{
+	if (index->count == 0)
+		return RETURN_VALUE_ERROR;
+
+	*x = index->sumX / index->count;
+	*y = index->sumY / index->count;
+	*z = index->sumZ / index->count;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int findUsersWithinRadius(const SpatialIndex *index, float x, float y, float z, float radius, int *slots, int maxSlots)
+{
+	float radius2 = radius * radius, nearest, farthest;
+	int n = 0;
+
+	// A large radius covers more cells than there are occupied ones: visit these instead
+	if (cellsAround(index, x, y, radius) > index->nCells)
+	{
+		for (size_t cell = 0; cell < index->nCells; cell++)
+		{
+			cellDistances(index, &index->cells[cell], x, y, &nearest, &farthest);
+			if (nearest <= radius2 && !visitWithinCell(index, cell, x, y, z, radius2, slots, &n, maxSlots))
+				break;
+		}
+		return n;
+	}
+
+	for (int cellX = cellOf(index, x - radius); cellX <= cellOf(index, x + radius); cellX++)
+	{
+		for (int cellY = cellOf(index, y - radius); cellY <= cellOf(index, y + radius); cellY++)
+		{
+			int cell = findCell(index, cellX, cellY);
+
+			if (cell >= 0 && !visitWithinCell(index, cell, x, y, z, radius2, slots, &n, maxSlots))
+				return n;
+		}
+	}
+
+	return n;
+}
+
+
+int findUsersOutsideRadius(const SpatialIndex *index, float x, float y, float z, float radius, int *slots, int maxSlots)
+{
+	float radius2 = radius * radius, nearest, farthest;
+	float dz = fmaxf(fabsf(index->minZ - z), fabsf(index->maxZ - z));
+	int n = 0;
+
+	// Whole cells are within the distance (even at the farthest Z), or beyond it (even at the same Z)
+	for (size_t cell = 0; cell < index->nCells && n < maxSlots; cell++)
+	{
+		const SpatialIndexCell *c = &index->cells[cell];
+
+		cellDistances(index, c, x, y, &nearest, &farthest);
+		if (farthest + dz * dz <= radius2)
+			continue;
+
+		for (int slot = c->head; slot >= 0 && n < maxSlots; slot = index->entries[slot].next)
+		{
+			if (nearest > radius2 || squaredDistance(index, index->entries[slot].position, x, y, z) > radius2)
+				slots[n++] = slot;
+		}
+	}
+
+	return n;
+}
+
+
+int findNearestUsers(const SpatialIndex *index, float x, float y, float z, int k, int *slots, float *distances)
+{
+	int centerX = cellOf(index, x), centerY = cellOf(index, y);
+	size_t visited = 0;
+	int found = 0;
+
+	if (k <= 0)
+		return 0;
+
+	// Rings of cells around the point's cell, until no unvisited cell can hold a nearer user
+	for (int ring = 0; visited < index->count; ring++)
+	{
+		// Users not visited yet are at least (ring - 1) cells away
+		float ringDistance = (ring - 1) * index->cellSize;
+
+		if (ring > 0 && found == k && distances[k - 1] <= ringDistance * ringDistance)
+			break;
+
+		// The rings are too sparse: scan the users instead
+		if ((float) (2 * ring + 1) * (2 * ring + 1) > 4.0f * index->nCells)
+		{
+			found = 0;
+			for (size_t i = 0; i < index->count; i++)
+				insertNearest(slots, distances, &found, k, index->slots[i], squaredDistance(index, i, x, y, z));
+			break;
+		}
+
+		if (ring == 0)
+		{
+			visited += visitNearestCell(index, centerX, centerY, x, y, z, slots, distances, &found, k);
+			continue;
+		}
+
+		for (int i = -ring; i <= ring; i++)
+		{
+			visited += visitNearestCell(index, centerX + i, centerY - ring, x, y, z, slots, distances, &found, k);
+			visited += visitNearestCell(index, centerX + i, centerY + ring, x, y, z, slots, distances, &found, k);
+		}
+		for (int i = -ring + 1; i <= ring - 1; i++)
+		{
+			visited += visitNearestCell(index, centerX - ring, centerY + i, x, y, z, slots, distances, &found, k);
+			visited += visitNearestCell(index, centerX + ring, centerY + i, x, y, z, slots, distances, &found, k);
+		}
+	}
+
+	for (int i = 0; i < found; i++)
+		distances[i] = sqrtf(distances[i]);
+
+	return found;
+}
@@ -0,0 +1,183 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <stddef.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Default side of the grid's cells (in meters)
+#define SPATIAL_INDEX_CELL_SIZE		50.0f
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Cell and cell links of an indexed user slot.
+ */
+typedef struct _SpatialIndexEntry
+{
+	int cell;									// Cell (-1 if the slot is not indexed)
+	int next;									// Next slot of the cell (-1 if none)
+	int prev;									// Previous slot of the cell (-1 if none)
+	int position;								// Index in the dense arrays
+} SpatialIndexEntry;
+
+/**
+ * Occupied cell of the grid.
+ */
+typedef struct _SpatialIndexCell
+{
+	int cellX;									// Cell column
+	int cellY;									// Cell row
+	int head;									// First slot of the cell
+	int count;									// Slots of the cell
+	int next;									// Next cell of the bucket (-1 if none)
+} SpatialIndexCell;
+
+/**
+ * Index of the users' NED positions (by user slot), on a uniform grid of
+ * horizontal cells hashed into buckets: moving a user is O(1), and range and
+ * nearest-user queries only visit the cells around the query point.
+ *
+ * Only occupied cells exist, packed in an array, so the out of range query
+ * visits them instead of the users: whole cells are taken or skipped, and
+ * only the users of the cells crossing the range's edge are looked at.
+ * The indexed positions are also kept in dense arrays (packed, in no
+ * particular order), and their running sums give the users' centroid in O(1).
+ */
+typedef struct _SpatialIndex
+{
+	float cellSize;								// Side of the cells (in meters)
+	size_t capacity;							// Number of user slots
+	size_t bucketMask;							// Number of buckets - 1 (a power of 2)
+	int *buckets;								// First cell of each bucket (-1 if empty)
+	SpatialIndexCell *cells;					// Occupied cells (dense)
+	size_t nCells;								// Occupied cells
+	SpatialIndexEntry *entries;					// Entry of each slot
+	float *x;									// X of the indexed positions (dense)
+	float *y;									// Y of the indexed positions (dense)
+	float *z;									// Z of the indexed positions (dense)
+	int *slots;									// Slot of the indexed positions (dense)
+	size_t count;								// Indexed slots
+	double sumX;								// Sum of the indexed X (centroid)
+	double sumY;								// Sum of the indexed Y (centroid)
+	double sumZ;								// Sum of the indexed Z (centroid)
+	float minZ;									// Bounds of the indexed Z (only widened,
+	float maxZ;									// until the index is emptied)
+} SpatialIndex;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize (empty) a spatial index.
+ *
+ * @param index			Pointer to the SpatialIndex to be initialized.
+ * @param capacity		Number of user slots.
+ * @param cellSize		Side of the grid's cells (in meters).
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeSpatialIndex(SpatialIndex *index, size_t capacity, float cellSize);
+
+/**
+ * Terminate a spatial index, releasing its arrays.
+ *
+ * @param index			Pointer to the SpatialIndex.
+ */
+void terminateSpatialIndex(SpatialIndex *index);
+
+/**
+ * Index (or move) the position of a user slot.
+ *
+ * @param index			Pointer to the SpatialIndex.
+ * @param slot			User slot.
+ * @param x				X (NED, in meters).
+ * @param y				Y (NED, in meters).
+ * @param z				Z (NED, in meters).
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int updateSpatialIndex(SpatialIndex *index, int slot, float x, float y, float z);
+
+/**
+ * Remove a user slot from the index (if indexed).
+ *
+ * @param index			Pointer to the SpatialIndex.
+ * @param slot			User slot.
+ */
+void removeSpatialIndex(SpatialIndex *index, int slot);
+
+/**
+ * Get the centroid of the indexed positions.
+ *
+ * @param index			Pointer to the SpatialIndex.
+ * @param x				Pointer to be initialized with the centroid's X.
+ * @param y				Pointer to be initialized with the centroid's Y.
+ * @param z				Pointer to be initialized with the centroid's Z.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise (no positions), return RETURN_VALUE_ERROR.
+ */
+int getSpatialIndexCentroid(const SpatialIndex *index, float *x, float *y, float *z);
+
+/**
+ * Find the users within a distance of a point.
+ *
+ * @param index			Pointer to the SpatialIndex.
+ * @param x				Point's X (NED, in meters).
+ * @param y				Point's Y (NED, in meters).
+ * @param z				Point's Z (NED, in meters).
+ * @param radius		Distance (in meters).
+ * @param slots			Destination of the users' slots.
+ * @param maxSlots		Size of the destination.
+ * @return				Number of users found (at most maxSlots).
+ */
+int findUsersWithinRadius(const SpatialIndex *index, float x, float y, float z, float radius, int *slots, int maxSlots);
+
+/**
+ * Find the users farther than a distance from a point (e.g. out of the FAP's
+ * range).
+ *
+ * @param index			Pointer to the SpatialIndex.
+ * @param x				Point's X (NED, in meters).
+ * @param y				Point's Y (NED, in meters).
+ * @param z				Point's Z (NED, in meters).
+ * @param radius		Distance (in meters).
+ * @param slots			Destination of the users' slots.
+ * @param maxSlots		Size of the destination.
+ * @return				Number of users found (at most maxSlots).
+ */
+int findUsersOutsideRadius(const SpatialIndex *index, float x, float y, float z, float radius, int *slots, int maxSlots);
+
+/**
+ * Find the k users nearest to a point, nearest first.
+ *
+ * @param index			Pointer to the SpatialIndex.
+ * @param x				Point's X (NED, in meters).
+ * @param y				Point's Y (NED, in meters).
+ * @param z				Point's Z (NED, in meters).
+ * @param k				Number of users to find.
+ * @param slots			Destination of the users' slots (k entries).
+ * @param distances		Destination of the users' distances (k entries).
+ * @return				Number of users found (at most k).
+ */
+int findNearestUsers(const SpatialIndex *index, float x, float y, float z, int k, int *slots, float *distances);
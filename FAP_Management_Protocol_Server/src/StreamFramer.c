@@ -0,0 +1,203 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "StreamFramer.h"
+
+// C headers
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+#define STREAM_FRAMER_MASK			(STREAM_FRAMER_BUFFER_SIZE - 1)
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Copy bytes out of the ring buffer, without consuming them.
+ *
+ * @param framer		Pointer to the StreamFramer.
+ * @param offset		Offset from the head.
+ * @param dst			Destination.
+ * @param length		Number of bytes.
+ */
+static void peekStreamFramer(const StreamFramer *framer, size_t offset, void *dst, size_t length)
+{
+	size_t start = (framer->head + offset) & STREAM_FRAMER_MASK;
+	size_t first = STREAM_FRAMER_BUFFER_SIZE - start;
+
+	if (first > length)
+		first = length;
+
+	memcpy(dst, framer->buffer + start, first);
+	memcpy((unsigned char *) dst + first, framer->buffer, length - first);
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+void initializeStreamFramer(StreamFramer *framer)
+{
+	framer->head = framer->tail = 0;
+}
+
+
+int fillStreamFramer(StreamFramer *framer, int fd)
+{
+	for (;;)
+	{
+		size_t used = framer->tail - framer->head;
+
+		if (used == STREAM_FRAMER_BUFFER_SIZE)
+			return STREAM_FRAMER_FILLED;
+
+		// Free space may wrap around the end of the buffer
+		size_t start = framer->tail & STREAM_FRAMER_MASK;
+		size_t free = STREAM_FRAMER_BUFFER_SIZE - used;
+		size_t first = STREAM_FRAMER_BUFFER_SIZE - start;
+		struct iovec iov[2];
+		int iovcnt = 1;
+
+		iov[0].iov_base = framer->buffer + start;
+		iov[0].iov_len = (first < free) ? first : free;
+		if (first < free)
+		{
+			iov[1].iov_base = framer->buffer;
+			iov[1].iov_len = free - first;
+			iovcnt = 2;
+		}
+
+		ssize_t n = readv(fd, iov, iovcnt);
+
+		if (n > 0)
+		{
+			framer->tail += n;
+			continue;
+		}
+		if (n == 0)
+			return STREAM_FRAMER_CLOSED;
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return STREAM_FRAMER_FILLED;
+
+		return STREAM_FRAMER_FAILED;
+	}
+}
+
+
+int nextStreamFrame(StreamFramer *framer, char *payload, size_t payloadSize, size_t *length)
+{
+	size_t used = framer->tail - framer->head;
+	uint32_t header;
+
+	if (used < STREAM_FRAME_HEADER_SIZE)
+		return STREAM_FRAME_INCOMPLETE;
+
+	peekStreamFramer(framer, 0, &header, STREAM_FRAME_HEADER_SIZE);
+	header = ntohl(header);
+
+	if (header > STREAM_FRAME_MAX_PAYLOAD || header >= payloadSize)
+		return STREAM_FRAME_INVALID;
+
+	if (used < STREAM_FRAME_HEADER_SIZE + header)
+		return STREAM_FRAME_INCOMPLETE;
+
+	peekStreamFramer(framer, STREAM_FRAME_HEADER_SIZE, payload, header);
+	payload[header] = '\0';
+	*length = header;
+	framer->head += STREAM_FRAME_HEADER_SIZE + header;
+
+	return STREAM_FRAME_READY;
+}
+
+
+void initializeStreamOutput(StreamOutput *output)
+{
+	output->length = 0;
+}
+
+
+int sendStreamFrame(StreamOutput *output, int fd, const void *payload, size_t length)
+{
+	uint32_t header = htonl((uint32_t) length);
+	struct iovec iov[2] = {
+		{.iov_base = &header, .iov_len = STREAM_FRAME_HEADER_SIZE},
+		{.iov_base = (void *) payload, .iov_len = length}
+	};
+	struct msghdr msg = {.msg_iov = iov, .msg_iovlen = 2};
+	size_t sent = 0;
+	ssize_t n;
+
+	// Behind queued bytes: queue the whole frame, in order
+	if (output->length == 0)
+	{
+		do
+			n = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		while (n < 0 && errno == EINTR);
+
+		if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+			return STREAM_OUTPUT_FAILED;
+		if (n == (ssize_t) (STREAM_FRAME_HEADER_SIZE + length))
+			return STREAM_OUTPUT_SENT;
+		if (n > 0)
+			sent = n;
+	}
+
+	if (output->length + STREAM_FRAME_HEADER_SIZE + length - sent > STREAM_OUTPUT_BUFFER_SIZE)
+		return STREAM_OUTPUT_FAILED;
+
+	// Queue the rest of the frame (which may start within the header)
+	for (int i = 0; i < 2; i++)
+	{
+		size_t skip = (sent < iov[i].iov_len) ? sent : iov[i].iov_len;
+
+		memcpy(output->buffer + output->length, (unsigned char *) iov[i].iov_base + skip, iov[i].iov_len - skip);
+		output->length += iov[i].iov_len - skip;
+		sent -= skip;
+	}
+
+	return STREAM_OUTPUT_PENDING;
+}
+
+
+int flushStreamOutput(StreamOutput *output, int fd)
+{
+	size_t sent = 0;
+
+	while (sent < output->length)
+	{
+		ssize_t n = send(fd, output->buffer + sent, output->length - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+		if (n > 0)
+			sent += n;
+		else if (n < 0 && errno == EINTR)
+			continue;
+		else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		else
+			return STREAM_OUTPUT_FAILED;
+	}
+
+	memmove(output->buffer, output->buffer + sent, output->length - sent);
+	output->length -= sent;
+
+	return (output->length == 0) ? STREAM_OUTPUT_SENT : STREAM_OUTPUT_PENDING;
+}
@@ -0,0 +1,142 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Size of the frame header: payload length (uint32, network byte order)
+#define STREAM_FRAME_HEADER_SIZE	4
+
+// Size of the per-connection receive ring buffer (must be a power of 2)
+#define STREAM_FRAMER_BUFFER_SIZE	4096
+
+// Maximum payload of a frame (in bytes)
+#define STREAM_FRAME_MAX_PAYLOAD	(STREAM_FRAMER_BUFFER_SIZE - STREAM_FRAME_HEADER_SIZE)
+
+// Results of fillStreamFramer()
+#define STREAM_FRAMER_FILLED		0			// Socket drained (or buffer full)
+#define STREAM_FRAMER_CLOSED		1			// Peer closed the connection
+#define STREAM_FRAMER_FAILED		(-1)		// Socket error
+
+// Results of nextStreamFrame()
+#define STREAM_FRAME_READY			1			// A frame was extracted
+#define STREAM_FRAME_INCOMPLETE		0			// More bytes are needed
+#define STREAM_FRAME_INVALID		(-1)		// Frame larger than the allowed size
+
+// Size of the per-connection send queue (bytes the socket couldn't take yet)
+#define STREAM_OUTPUT_BUFFER_SIZE	4096
+
+// Results of sendStreamFrame() and flushStreamOutput()
+#define STREAM_OUTPUT_SENT			0			// Everything was sent
+#define STREAM_OUTPUT_PENDING		1			// Bytes are queued (flush them when the socket is writable)
+#define STREAM_OUTPUT_FAILED		(-1)		// Socket error, or the queue is full
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Receive side of a FAP Management Protocol stream.
+ *
+ * Every message on the stream is a frame: a 4-byte payload length
+ * (network byte order) followed by the payload. Incoming bytes are
+ * accumulated in a ring buffer, so a single read can yield several
+ * messages and a message can span several reads.
+ */
+typedef struct _StreamFramer
+{
+	unsigned char buffer[STREAM_FRAMER_BUFFER_SIZE];	// Ring buffer
+	size_t head;										// Total bytes consumed
+	size_t tail;										// Total bytes received
+} StreamFramer;
+
+/**
+ * Send side of a FAP Management Protocol stream: the bytes of the frames
+ * a non-blocking socket couldn't take right away, in order.
+ */
+typedef struct _StreamOutput
+{
+	unsigned char buffer[STREAM_OUTPUT_BUFFER_SIZE];	// Queued bytes
+	size_t length;										// Number of queued bytes
+} StreamOutput;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize (empty) a stream framer.
+ *
+ * @param framer		Pointer to the StreamFramer to be initialized.
+ */
+void initializeStreamFramer(StreamFramer *framer);
+
+/**
+ * Read from a non-blocking socket into the framer, until the socket would
+ * block or the ring buffer is full.
+ *
+ * @param framer		Pointer to the StreamFramer.
+ * @param fd			Socket.
+ * @return				STREAM_FRAMER_FILLED, STREAM_FRAMER_CLOSED or STREAM_FRAMER_FAILED.
+ */
+int fillStreamFramer(StreamFramer *framer, int fd);
+
+/**
+ * Extract the next complete frame's payload from the framer.
+ *
+ * @param framer		Pointer to the StreamFramer.
+ * @param payload		Destination of the payload (NUL-terminated).
+ * @param payloadSize	Size of the destination (must be greater than the payload).
+ * @param length		Pointer to be initialized with the payload's length.
+ * @return				STREAM_FRAME_READY, STREAM_FRAME_INCOMPLETE or STREAM_FRAME_INVALID.
+ */
+int nextStreamFrame(StreamFramer *framer, char *payload, size_t payloadSize, size_t *length);
+
+/**
+ * Initialize (empty) a stream's send queue.
+ *
+ * @param output		Pointer to the StreamOutput to be initialized.
+ */
+void initializeStreamOutput(StreamOutput *output);
+
+/**
+ * Send a payload as a single frame (header and payload in one system call).
+ * Whatever the socket can't take right away (or everything, if bytes are
+ * already queued) is queued, to be sent by flushStreamOutput().
+ *
+ * @param output		Pointer to the stream's StreamOutput.
+ * @param fd			Socket.
+ * @param payload		Payload.
+ * @param length		Payload's length.
+ * @return				STREAM_OUTPUT_SENT, STREAM_OUTPUT_PENDING or STREAM_OUTPUT_FAILED.
+ */
+int sendStreamFrame(StreamOutput *output, int fd, const void *payload, size_t length);
+
+/**
+ * Send the queued bytes (e.g. once the socket is writable again).
+ *
+ * @param output		Pointer to the stream's StreamOutput.
+ * @param fd			Socket.
+ * @return				STREAM_OUTPUT_SENT, STREAM_OUTPUT_PENDING or STREAM_OUTPUT_FAILED.
+ */
+int flushStreamOutput(StreamOutput *output, int fd);
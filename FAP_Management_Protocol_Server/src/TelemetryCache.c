@@ -0,0 +1,76 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "TelemetryCache.h"
+
+// C headers
+#include <string.h>
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+void initializeTelemetryCache(TelemetryCache *cache)
+{
+	memset(&cache->localPositionNed, 0, sizeof(cache->localPositionNed));
+	cache->localPositionNs = 0;
+	atomic_init(&cache->sequence, 0);
+}
+
+
+void publishLocalPositionNed(TelemetryCache *cache, const GpsNedCoordinates *gpsNedCoordinates, int64_t receivedNs)
+{
+	unsigned int sequence = atomic_load_explicit(&cache->sequence, memory_order_relaxed);
+
+	// The sequence is odd while the state is being written
+	atomic_store_explicit(&cache->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	cache->localPositionNed = *gpsNedCoordinates;
+	cache->localPositionNs = receivedNs;
+
+	atomic_store_explicit(&cache->sequence, sequence + 2, memory_order_release);
+}
+
+
+int readLocalPositionNed(TelemetryCache *cache, GpsNedCoordinates *gpsNedCoordinates, int64_t *receivedNs)
+{
+	GpsNedCoordinates position;
+	unsigned int before, after;
+	int64_t positionNs;
+
+	// Check arguments
+	if (gpsNedCoordinates == NULL)
+		return RETURN_VALUE_ERROR;
+
+	for (;;)
+	{
+		before = atomic_load_explicit(&cache->sequence, memory_order_acquire);
+		if (before & 1)
+			continue;		// Being written
+
+		position = cache->localPositionNed;
+		positionNs = cache->localPositionNs;
+
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&cache->sequence, memory_order_relaxed);
+
+		if (before == after)
+			break;
+	}
+
+	if (positionNs == 0)
+		return RETURN_VALUE_ERROR;
+
+	*gpsNedCoordinates = position;
+	if (receivedNs != NULL)
+		*receivedNs = positionNs;
+
+	return RETURN_VALUE_OK;
+}
@@ -0,0 +1,82 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// Module headers
+#include "GpsCoordinates.h"
+
+// C headers
+#include <stdatomic.h>
+#include <stdint.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Last state reported by the autopilot (e.g. its streamed
+ * LOCAL_POSITION_NED), so that handlers read it from memory instead of
+ * asking the autopilot for it.
+ *
+ * A single writer (whoever receives the autopilot's messages) publishes
+ * the state; any thread reads it without locks, guarded by a sequence
+ * lock (odd while being written; readers retry if it changed while they
+ * copied the state).
+ */
+typedef struct _TelemetryCache
+{
+	atomic_uint sequence;						// Sequence lock
+	GpsNedCoordinates localPositionNed;			// Last LOCAL_POSITION_NED
+	int64_t localPositionNs;					// Its reception (monotonic ns, 0 if none)
+} TelemetryCache;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize (empty) a telemetry cache.
+ *
+ * @param cache					Pointer to the TelemetryCache to be initialized.
+ */
+void initializeTelemetryCache(TelemetryCache *cache);
+
+/**
+ * Publish the autopilot's local position (writer only).
+ *
+ * @param cache					Pointer to the TelemetryCache.
+ * @param gpsNedCoordinates		Autopilot's GPS NED coordinates.
+ * @param receivedNs			Reception time (monotonic ns).
+ */
+void publishLocalPositionNed(TelemetryCache *cache, const GpsNedCoordinates *gpsNedCoordinates, int64_t receivedNs);
+
+/**
+ * Read the autopilot's last local position (from any thread, without
+ * blocking the writer).
+ *
+ * @param cache					Pointer to the TelemetryCache.
+ * @param gpsNedCoordinates		Pointer to the GPS NED coordinates to be initialized
+ *								with the autopilot's GPS NED coordinates.
+ * @param receivedNs			Pointer to be initialized with its reception time
+ *								(monotonic ns; may be NULL).
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise (none published yet), return RETURN_VALUE_ERROR.
+ */
+int readLocalPositionNed(TelemetryCache *cache, GpsNedCoordinates *gpsNedCoordinates, int64_t *receivedNs);
@@ -0,0 +1,285 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "TimerWheel.h"
+#include "EventLoop.h"
+
+// C headers
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Get the monotonic time (in milliseconds).
+ *
+ * @return		Monotonic time (in milliseconds).
+ */
+static uint64_t monotonicMs()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Get the current tick of a timer wheel.
+ *
+ * @param timerWheel	Pointer to the TimerWheel.
+ * @return				Current tick.
+ */
+static uint64_t currentTick(const TimerWheel *timerWheel)
+{
+	return (monotonicMs() - timerWheel->startMs) / timerWheel->tickMs;
+}
+
+/**
+ * Start or stop the wheel's timerfd (ticking on the ticks' boundaries).
+ *
+ * @param timerWheel	Pointer to the TimerWheel.
+ * @param enable		True (1) to tick periodically; False (0) to stop ticking.
+ */
+static void setTicking(TimerWheel *timerWheel, int enable)
+{
+	struct itimerspec period = {{0, 0}, {0, 0}};
+
+	if (enable)
+	{
+		uint64_t untilNextTickMs = timerWheel->tickMs - (monotonicMs() - timerWheel->startMs) % timerWheel->tickMs;
+
+		period.it_interval.tv_sec = timerWheel->tickMs / 1000;
+		period.it_interval.tv_nsec = (timerWheel->tickMs % 1000) * 1000000;
+		period.it_value.tv_sec = untilNextTickMs / 1000;
+		period.it_value.tv_nsec = (untilNextTickMs % 1000) * 1000000;
+	}
+
+	timerfd_settime(timerWheel->handler.fd, 0, &period, NULL);
+}
+
+/**
+ * Link a timer in the slot corresponding to its expiry tick.
+ *
+ * @param timerWheel	Pointer to the TimerWheel.
+ * @param timer			Pointer to the timer.
+ */
+static void linkTimer(TimerWheel *timerWheel, TimerWheelTimer *timer)
+{
+	TimerWheelTimer *head = &timerWheel->slots[timer->expiryTick & (TIMER_WHEEL_SLOTS - 1)];
+
+	timer->next = head->next;
+	timer->prev = head;
+	head->next->prev = timer;
+	head->next = timer;
+}
+
+/**
+ * Unlink a timer from its slot.
+ *
+ * @param timer			Pointer to the timer.
+ */
+static void unlinkTimer(TimerWheelTimer *timer)
+{
+	timer->prev->next = timer->next;
+	timer->next->prev = timer->prev;
+	timer->next = timer->prev = NULL;
+}
+
+/**
+ * Process the timers of one slot, firing the expired ones.
+ *
+ * @param timerWheel	Pointer to the TimerWheel.
+ * @param slot			Slot index.
+ * @param nowTick		Current tick.
+ */
+static void processSlot(TimerWheel *timerWheel, size_t slot, uint64_t nowTick)
+{
+	TimerWheelTimer *head = &timerWheel->slots[slot];
+	TimerWheelTimer pending;
+
+	// Detach the slot's list, so callbacks can safely (re-)arm timers
+	if (head->next == head)
+		return;
+
+	pending.next = head->next;
+	pending.prev = head->prev;
+	pending.next->prev = &pending;
+	pending.prev->next = &pending;
+	head->next = head->prev = head;
+
+	while (pending.next != &pending)
+	{
+		TimerWheelTimer *timer = pending.next;
+		unlinkTimer(timer);
+
+		if (timer->expiryTick > nowTick)
+		{
+			// Expires on a later turn of the wheel
+			linkTimer(timerWheel, timer);
+			continue;
+		}
+
+		timer->armed = 0;
+		timerWheel->nArmed--;
+		timer->callback(timer);
+	}
+}
+
+/**
+ * Advance the wheel up to the current tick (timerfd callback).
+ *
+ * @param handler	Registration of the timerfd.
+ * @param events	Ready events.
+ */
+static void onTick(EventLoopHandler *handler, uint32_t events)
+{
+	TimerWheel *timerWheel = handler->context;
+	uint64_t expirations;
+
+	(void) events;
+	if (read(handler->fd, &expirations, sizeof(expirations)) < 0)
+		return;
+
+	uint64_t nowTick = currentTick(timerWheel);
+
+	// Visit each slot at most once, even after a long stall
+	if (nowTick - timerWheel->currentTick > TIMER_WHEEL_SLOTS)
+		timerWheel->currentTick = nowTick - TIMER_WHEEL_SLOTS;
+
+	while (timerWheel->currentTick < nowTick)
+	{
+		timerWheel->currentTick++;
+		processSlot(timerWheel, timerWheel->currentTick & (TIMER_WHEEL_SLOTS - 1), nowTick);
+	}
+
+	if (timerWheel->nArmed == 0)
+		setTicking(timerWheel, 0);
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeTimerWheel(TimerWheel *timerWheel, EventLoop *eventLoop, uint64_t tickMs)
+{
+	// Check arguments
+	if (timerWheel == NULL || eventLoop == NULL || tickMs == 0)
+		return RETURN_VALUE_ERROR;
+
+	for (size_t i = 0; i < TIMER_WHEEL_SLOTS; i++)
+		timerWheel->slots[i].next = timerWheel->slots[i].prev = &timerWheel->slots[i];
+
+	timerWheel->tickMs = tickMs;
+	timerWheel->startMs = monotonicMs();
+	timerWheel->currentTick = 0;
+	timerWheel->nArmed = 0;
+	timerWheel->eventLoop = eventLoop;
+
+	// Create the (disarmed) timerfd and register it
+	if ((timerWheel->handler.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		return RETURN_VALUE_ERROR;
+
+	timerWheel->handler.callback = onTick;
+	timerWheel->handler.context = timerWheel;
+
+	if (addEventLoopHandler(eventLoop, &timerWheel->handler, EPOLLIN) != RETURN_VALUE_OK)
+	{
+		close(timerWheel->handler.fd);
+		return RETURN_VALUE_ERROR;
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+
+int terminateTimerWheel(TimerWheel *timerWheel)
+{
+	// Check arguments
+	if (timerWheel == NULL)
+		return RETURN_VALUE_ERROR;
+
+	// Drop armed timers
+	for (size_t i = 0; i < TIMER_WHEEL_SLOTS; i++)
+	{
+		TimerWheelTimer *head = &timerWheel->slots[i];
+
+		while (head->next != head)
+		{
+			TimerWheelTimer *timer = head->next;
+			unlinkTimer(timer);
+			timer->armed = 0;
+		}
+	}
+	timerWheel->nArmed = 0;
+
+	removeEventLoopHandler(timerWheel->eventLoop, &timerWheel->handler);
+	close(timerWheel->handler.fd);
+
+	return RETURN_VALUE_OK;
+}
+
+
+void initializeTimer(TimerWheelTimer *timer, TimerWheelCallback callback, void *context)
+{
+	timer->next = timer->prev = NULL;
+	timer->expiryTick = 0;
+	timer->callback = callback;
+	timer->context = context;
+	timer->armed = 0;
+}
+
+
+int armTimer(TimerWheel *timerWheel, TimerWheelTimer *timer, uint64_t delayMs)
+{
+	// Check arguments
+	if (timerWheel == NULL || timer == NULL || timer->callback == NULL)
+		return RETURN_VALUE_ERROR;
+
+	cancelTimer(timerWheel, timer);
+
+	// Round up, and count from the end of the current (partly elapsed) tick,
+	// so a timer never fires early
+	uint64_t ticks = (delayMs + timerWheel->tickMs - 1) / timerWheel->tickMs;
+	uint64_t nowTick = currentTick(timerWheel);
+
+	if (nowTick < timerWheel->currentTick)
+		nowTick = timerWheel->currentTick;
+
+	timer->expiryTick = nowTick + ticks + 1;
+	timer->armed = 1;
+	linkTimer(timerWheel, timer);
+
+	if (timerWheel->nArmed++ == 0)
+	{
+		// Resume ticking from the current tick
+		timerWheel->currentTick = nowTick;
+		setTicking(timerWheel, 1);
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+
+void cancelTimer(TimerWheel *timerWheel, TimerWheelTimer *timer)
+{
+	if (timerWheel == NULL || timer == NULL || !timer->armed)
+		return;
+
+	unlinkTimer(timer);
+	timer->armed = 0;
+
+	if (--timerWheel->nArmed == 0)
+		setTicking(timerWheel, 0);
+}
@@ -0,0 +1,127 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// Module headers
+#include "EventLoop.h"
+
+// C headers
+#include <stddef.h>
+#include <stdint.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Number of slots of the wheel (must be a power of 2)
+#define TIMER_WHEEL_SLOTS			64
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+struct _TimerWheelTimer;
+
+/**
+ * Callback invoked (on the event loop's thread) when a timer expires.
+ * The timer is already disarmed and may be re-armed from the callback.
+ *
+ * @param timer		Expired timer.
+ */
+typedef void (*TimerWheelCallback)(struct _TimerWheelTimer *timer);
+
+/**
+ * Timer entry. The memory is owned by the caller (usually embedded in a
+ * larger structure) and must remain valid while the timer is armed.
+ */
+typedef struct _TimerWheelTimer
+{
+	struct _TimerWheelTimer *next;				// Next timer in the slot
+	struct _TimerWheelTimer *prev;				// Previous timer in the slot
+	uint64_t expiryTick;						// Tick at which the timer expires
+	TimerWheelCallback callback;				// Expiry callback
+	void *context;								// User data
+	int armed;									// True (1) while the timer is scheduled
+} TimerWheelTimer;
+
+/**
+ * Hashed timing wheel driven by a timerfd registered in an event loop.
+ * The timerfd only ticks while there are armed timers.
+ */
+typedef struct _TimerWheel
+{
+	TimerWheelTimer slots[TIMER_WHEEL_SLOTS];	// Sentinel heads of each slot's list
+	uint64_t tickMs;							// Tick duration (in milliseconds)
+	uint64_t startMs;							// Monotonic time of tick 0 (in milliseconds)
+	uint64_t currentTick;						// Last processed tick
+	size_t nArmed;								// Number of armed timers
+	EventLoop *eventLoop;						// Event loop driving the wheel
+	EventLoopHandler handler;					// Registration of the timerfd
+} TimerWheel;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize a timer wheel and register it in an event loop.
+ *
+ * @param timerWheel	Pointer to the TimerWheel to be initialized.
+ * @param eventLoop		Event loop that will fire the timers.
+ * @param tickMs		Tick duration (in milliseconds), i.e. the timers' resolution.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeTimerWheel(TimerWheel *timerWheel, EventLoop *eventLoop, uint64_t tickMs);
+
+/**
+ * Terminate a timer wheel, unregistering it from its event loop.
+ * Armed timers are dropped without firing.
+ *
+ * @param timerWheel	Pointer to the TimerWheel to be terminated.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int terminateTimerWheel(TimerWheel *timerWheel);
+
+/**
+ * Initialize a (disarmed) timer.
+ *
+ * @param timer			Pointer to the TimerWheelTimer to be initialized.
+ * @param callback		Expiry callback.
+ * @param context		User data.
+ */
+void initializeTimer(TimerWheelTimer *timer, TimerWheelCallback callback, void *context);
+
+/**
+ * Arm (or re-arm) a timer to expire after a given delay. O(1).
+ * It never fires early, but up to one tick late.
+ *
+ * @param timerWheel	Pointer to the TimerWheel.
+ * @param timer			Pointer to the timer.
+ * @param delayMs		Delay (in milliseconds), rounded up to the wheel's tick.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int armTimer(TimerWheel *timerWheel, TimerWheelTimer *timer, uint64_t delayMs);
+
+/**
+ * Cancel a timer. Cancelling a disarmed timer has no effect. O(1).
+ *
+ * @param timerWheel	Pointer to the TimerWheel.
+ * @param timer			Pointer to the timer.
+ */
+void cancelTimer(TimerWheel *timerWheel, TimerWheelTimer *timer);
@@ -0,0 +1,283 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "TrajectoryPredictor.h"
+
+// C headers
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Filters gathered per chunk of a batch (a multiple of the block size)
+#define CHUNK_SIZE				64
+#define CHUNK_BLOCKS			(CHUNK_SIZE / TRAJECTORY_BLOCK_SIZE)
+
+#define NS_PER_SECOND			1e9
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+// Vector type (GCC vector extensions): one block of filters
+typedef float Floats __attribute__((vector_size(TRAJECTORY_BLOCK_SIZE * sizeof(float))));
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Predict and update a block of filters of one axis: x' = x + v*dt, with
+ * white-noise accelerations, then the measurement z.
+ */
+static inline void filterBlock(Floats *position, Floats *velocity, Floats *p00, Floats *p01, Floats *p11,
+								Floats dt, Floats measured, float accelerationNoise, float measurementNoise)
+{
+	Floats q = dt * accelerationNoise, dt2 = dt * dt;
+	Floats a00, a01, a11, s, k0, k1, innovation;
+
+	// Predict: P = F P F' + Q
+	*position += *velocity * dt;
+	a00 = *p00 + dt * (2 * *p01 + dt * *p11) + q * dt2 / 3;
+	a01 = *p01 + dt * *p11 + q * dt / 2;
+	a11 = *p11 + q;
+
+	// Update with the measured position
+	s = a00 + measurementNoise;
+	k0 = a00 / s;
+	k1 = a01 / s;
+	innovation = measured - *position;
+	*position += k0 * innovation;
+	*velocity += k1 * innovation;
+	*p00 = a00 - k0 * a00;
+	*p01 = a01 - k0 * a01;
+	*p11 = a11 - k1 * a01;
+}
+
+/**
+ * Update the filters of a chunk of a batch (no slot twice): gather each
+ * axis' state, update it block by block, and scatter it back.
+ */
+static void filterChunk(TrajectoryPredictor *predictor, const int *slots, const float *coordinates[3],
+						const int64_t *epochNs, const int *lanes, int count)
+{
+	Floats dt[CHUNK_BLOCKS] = {0}, measured[CHUNK_BLOCKS] = {0};
+	Floats position[CHUNK_BLOCKS] = {0}, velocity[CHUNK_BLOCKS] = {0};
+	Floats p00[CHUNK_BLOCKS] = {0}, p01[CHUNK_BLOCKS] = {0}, p11[CHUNK_BLOCKS] = {0};
+	uint8_t fresh[CHUNK_SIZE];
+	int blocks = (count + TRAJECTORY_BLOCK_SIZE - 1) / TRAJECTORY_BLOCK_SIZE;
+
+	// Time since each filter's last update (new and stale tracks restart)
+	for (int l = 0; l < count; l++)
+	{
+		int slot = slots[lanes[l]];
+		double elapsed = (epochNs[lanes[l]] - predictor->epochNs[slot]) / NS_PER_SECOND;
+
+		fresh[l] = !predictor->tracked[slot] || elapsed > TRAJECTORY_RESET_SECONDS;
+		((float *) dt)[l] = (elapsed > 0 && !fresh[l]) ? elapsed : 0;
+
+		// Out of order positions don't move the track back in time
+		if (fresh[l] || elapsed > 0)
+			predictor->epochNs[slot] = epochNs[lanes[l]];
+		predictor->tracked[slot] = 1;
+	}
+
+	for (int a = 0; a < 3; a++)
+	{
+		TrajectoryAxis *axis = &predictor->axes[a];
+
+		for (int l = 0; l < count; l++)
+		{
+			int slot = slots[lanes[l]];
+
+			((float *) measured)[l] = coordinates[a][lanes[l]];
+			((float *) position)[l] = axis->position[slot];
+			((float *) velocity)[l] = axis->velocity[slot];
+			((float *) p00)[l] = axis->p00[slot];
+			((float *) p01)[l] = axis->p01[slot];
+			((float *) p11)[l] = axis->p11[slot];
+		}
+
+		for (int b = 0; b < blocks; b++)
+		{
+			filterBlock(&position[b], &velocity[b], &p00[b], &p01[b], &p11[b], dt[b], measured[b],
+						predictor->accelerationNoise, predictor->measurementNoise);
+		}
+
+		for (int l = 0; l < count; l++)
+		{
+			int slot = slots[lanes[l]];
+
+			if (fresh[l])
+			{
+				// A new track: at the measured position, standing still (uncertain)
+				axis->position[slot] = ((float *) measured)[l];
+				axis->velocity[slot] = 0;
+				axis->p00[slot] = predictor->measurementNoise;
+				axis->p01[slot] = 0;
+				axis->p11[slot] = TRAJECTORY_INITIAL_VELOCITY_VARIANCE;
+				continue;
+			}
+
+			axis->position[slot] = ((float *) position)[l];
+			axis->velocity[slot] = ((float *) velocity)[l];
+			axis->p00[slot] = ((float *) p00)[l];
+			axis->p01[slot] = ((float *) p01)[l];
+			axis->p11[slot] = ((float *) p11)[l];
+		}
+	}
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeTrajectoryPredictor(TrajectoryPredictor *predictor, size_t capacity, float accelerationNoise, float measurementNoise)
+{
+	int failed = 0;
+
+	// Check arguments
+	if (predictor == NULL || capacity == 0 || accelerationNoise < 0 || !(measurementNoise > 0))
+		return RETURN_VALUE_ERROR;
+
+	memset(predictor, 0, sizeof(*predictor));
+	predictor->capacity = capacity;
+	predictor->accelerationNoise = accelerationNoise;
+	predictor->measurementNoise = measurementNoise;
+
+	for (int a = 0; a < 3; a++)
+	{
+		TrajectoryAxis *axis = &predictor->axes[a];
+
+		axis->position = malloc(capacity * sizeof(float));
+		axis->velocity = malloc(capacity * sizeof(float));
+		axis->p00 = malloc(capacity * sizeof(float));
+		axis->p01 = malloc(capacity * sizeof(float));
+		axis->p11 = malloc(capacity * sizeof(float));
+		failed |= (axis->position == NULL || axis->velocity == NULL || axis->p00 == NULL || axis->p01 == NULL || axis->p11 == NULL);
+	}
+	predictor->epochNs = malloc(capacity * sizeof(int64_t));
+	predictor->tracked = calloc(capacity, sizeof(uint8_t));
+	predictor->batch = calloc(capacity, sizeof(unsigned int));
+
+	if (failed || predictor->epochNs == NULL || predictor->tracked == NULL || predictor->batch == NULL)
+	{
+		terminateTrajectoryPredictor(predictor);
+		return RETURN_VALUE_ERROR;
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+
+void terminateTrajectoryPredictor(TrajectoryPredictor *predictor)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		free(predictor->axes[a].position);
+		free(predictor->axes[a].velocity);
+		free(predictor->axes[a].p00);
+		free(predictor->axes[a].p01);
+		free(predictor->axes[a].p11);
+	}
+	free(predictor->epochNs);
+	free(predictor->tracked);
+	free(predictor->batch);
+	memset(predictor, 0, sizeof(*predictor));
+}
+
+
+void resetTrajectory(TrajectoryPredictor *predictor, int slot)
+{
+	if (slot >= 0 && (size_t) slot < predictor->capacity)
+		predictor->tracked[slot] = 0;
+}
+
+
+int updateTrajectories(TrajectoryPredictor *predictor, const int *slots, const float *x, const float *y, const float *z,
+						const int64_t *epochNs, size_t n)
+{
+	const float *coordinates[3] = {x, y, z};
+	int lanes[CHUNK_SIZE];
+	int count = 0, status = RETURN_VALUE_OK;
+
+	predictor->batchId++;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		int slot = slots[i];
+
+		if (slot < 0 || (size_t) slot >= predictor->capacity)
+		{
+			status = RETURN_VALUE_ERROR;
+			continue;
+		}
+
+		// A full chunk, or a slot already in it: update the chunk first
+		if (count == CHUNK_SIZE || predictor->batch[slot] == predictor->batchId)
+		{
+			filterChunk(predictor, slots, coordinates, epochNs, lanes, count);
+			count = 0;
+			predictor->batchId++;
+		}
+
+		predictor->batch[slot] = predictor->batchId;
+		lanes[count++] = i;
+	}
+
+	if (count > 0)
+		filterChunk(predictor, slots, coordinates, epochNs, lanes, count);
+
+	return status;
+}
+
+
+int predictPosition(const TrajectoryPredictor *predictor, int slot, int64_t epochNs, float *x, float *y, float *z)
+{
+	float *coordinates[3] = {x, y, z};
+	double horizon;
+
+	if (slot < 0 || (size_t) slot >= predictor->capacity || !predictor->tracked[slot])
+		return RETURN_VALUE_ERROR;
+
+	horizon = (epochNs - predictor->epochNs[slot]) / NS_PER_SECOND;
+	if (horizon < 0)
+		horizon = 0;
+	if (horizon > TRAJECTORY_MAX_HORIZON_SECONDS)
+		horizon = TRAJECTORY_MAX_HORIZON_SECONDS;
+
+	for (int a = 0; a < 3; a++)
+		*coordinates[a] = predictor->axes[a].position[slot] + predictor->axes[a].velocity[slot] * horizon;
+
+	return RETURN_VALUE_OK;
+}
+
+
+int estimateSpeed(const TrajectoryPredictor *predictor, int slot, float *speed)
+{
+	float squared = 0, variance = 0;
+
+	if (slot < 0 || (size_t) slot >= predictor->capacity || !predictor->tracked[slot])
+		return RETURN_VALUE_ERROR;
+
+	for (int a = 0; a < 3; a++)
+	{
+		squared += predictor->axes[a].velocity[slot] * predictor->axes[a].velocity[slot];
+		variance += predictor->axes[a].p11[slot];
+	}
+	*speed = sqrtf(squared) + sqrtf(variance);
+
+	return RETURN_VALUE_OK;
+}
@@ -0,0 +1,155 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <stddef.h>
+#include <stdint.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK						0
+#define RETURN_VALUE_ERROR					(-1)
+
+// Filters updated per vector block (the batch is processed in blocks)
+#define TRAJECTORY_BLOCK_SIZE				4
+
+// Default noises: random accelerations (in m^2/s^3) and GPS errors (in m^2)
+#define TRAJECTORY_ACCELERATION_NOISE		0.05f
+#define TRAJECTORY_MEASUREMENT_NOISE		25.0f
+
+// Variance of the velocity of a new track (in m^2/s^2)
+#define TRAJECTORY_INITIAL_VELOCITY_VARIANCE	4.0f
+
+// A track without updates for this long restarts (in seconds)
+#define TRAJECTORY_RESET_SECONDS			60
+
+// Longest extrapolation (in seconds)
+#define TRAJECTORY_MAX_HORIZON_SECONDS		30
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * State of one axis of every user's filter (structure of arrays, by user
+ * slot): position, velocity and the symmetric 2x2 covariance.
+ */
+typedef struct _TrajectoryAxis
+{
+	float *position;							// Position (NED, in meters)
+	float *velocity;							// Velocity (in m/s)
+	float *p00;									// Position variance
+	float *p01;									// Position/velocity covariance
+	float *p11;									// Velocity variance
+} TrajectoryAxis;
+
+/**
+ * Trajectory predictor of the users: a constant-velocity Kalman filter per
+ * user, one independent filter per axis, fed by the users' successive
+ * positions. It extrapolates where a user will be at a later time (e.g.
+ * when the FAP gets there), rather than where it was at its last update.
+ *
+ * The state is kept in compact float arrays, and updates are applied in
+ * batches, gathered into blocks of TRAJECTORY_BLOCK_SIZE filters that are
+ * updated in vector registers.
+ */
+typedef struct _TrajectoryPredictor
+{
+	TrajectoryAxis axes[3];						// X, Y and Z filters
+	int64_t *epochNs;							// Time of the last update (ns since the Unix epoch)
+	uint8_t *tracked;							// The slot has a track
+	unsigned int *batch;						// Last batch chunk that updated the slot
+	unsigned int batchId;						// Current batch chunk
+	size_t capacity;							// Number of user slots
+	float accelerationNoise;					// Random accelerations (in m^2/s^3)
+	float measurementNoise;						// GPS errors (in m^2)
+} TrajectoryPredictor;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize (empty) a trajectory predictor.
+ *
+ * @param predictor				Pointer to the TrajectoryPredictor to be initialized.
+ * @param capacity				Number of user slots.
+ * @param accelerationNoise		Random accelerations (in m^2/s^3).
+ * @param measurementNoise		GPS errors (in m^2).
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeTrajectoryPredictor(TrajectoryPredictor *predictor, size_t capacity, float accelerationNoise, float measurementNoise);
+
+/**
+ * Terminate a trajectory predictor, releasing its arrays.
+ *
+ * @param predictor				Pointer to the TrajectoryPredictor.
+ */
+void terminateTrajectoryPredictor(TrajectoryPredictor *predictor);
+
+/**
+ * Forget the track of a user slot (e.g. the user left).
+ *
+ * @param predictor				Pointer to the TrajectoryPredictor.
+ * @param slot					User slot.
+ */
+void resetTrajectory(TrajectoryPredictor *predictor, int slot);
+
+/**
+ * Feed a batch of positions to the users' filters (a slot may appear more
+ * than once; its positions are applied in order).
+ *
+ * @param predictor				Pointer to the TrajectoryPredictor.
+ * @param slots					User slots.
+ * @param x						Positions' X (NED, in meters).
+ * @param y						Positions' Y (NED, in meters).
+ * @param z						Positions' Z (NED, in meters).
+ * @param epochNs				Positions' timestamps (ns since the Unix epoch).
+ * @param n						Number of positions.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise (invalid slots are skipped), return RETURN_VALUE_ERROR.
+ */
+int updateTrajectories(TrajectoryPredictor *predictor, const int *slots, const float *x, const float *y, const float *z,
+						const int64_t *epochNs, size_t n);
+
+/**
+ * Extrapolate the position of a user at a given time (at most
+ * TRAJECTORY_MAX_HORIZON_SECONDS after its last update).
+ *
+ * @param predictor				Pointer to the TrajectoryPredictor.
+ * @param slot					User slot.
+ * @param epochNs				Time (ns since the Unix epoch).
+ * @param x						Pointer to be initialized with the predicted X.
+ * @param y						Pointer to be initialized with the predicted Y.
+ * @param z						Pointer to be initialized with the predicted Z.
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise (no track), return RETURN_VALUE_ERROR.
+ */
+int predictPosition(const TrajectoryPredictor *predictor, int slot, int64_t epochNs, float *x, float *y, float *z);
+
+/**
+ * Estimate the speed of a user, pessimistically: the estimated speed plus
+ * one standard deviation of it (so a new track isn't taken as standing
+ * still).
+ *
+ * @param predictor				Pointer to the TrajectoryPredictor.
+ * @param slot					User slot.
+ * @param speed					Pointer to be initialized with the speed (in m/s).
+ * @return						Return RETURN_VALUE_OK if there are no errors;
+ *								otherwise (no track), return RETURN_VALUE_ERROR.
+ */
+int estimateSpeed(const TrajectoryPredictor *predictor, int slot, float *speed);
@@ -0,0 +1,285 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+// Module headers
+#include "UserRegistry.h"
+
+// C headers
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Initial number of buckets of the hash table (must be a power of 2)
+#define USER_REGISTRY_INITIAL_BUCKETS	16
+
+// Marker of an empty bucket
+#define USER_REGISTRY_EMPTY_SLOT		(-1)
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Hash a user ID.
+ *
+ * @param userId	User ID.
+ * @return			Hash value.
+ */
+static inline uint32_t hashUserId(int userId)
+{
+	uint32_t h = (uint32_t) userId * 2654435761u;
+
+	return h ^ (h >> 16);
+}
+
+/**
+ * Find the bucket holding a user ID, or the empty bucket where it would be inserted.
+ *
+ * @param buckets		Hash table.
+ * @param nBuckets		Number of buckets (power of 2).
+ * @param userId		User ID.
+ * @return				Bucket index.
+ */
+static size_t probeBucket(const UserRegistryBucket *buckets, size_t nBuckets, int userId)
+{
+	size_t mask = nBuckets - 1;
+	size_t i = hashUserId(userId) & mask;
+
+	while (buckets[i].slot != USER_REGISTRY_EMPTY_SLOT && buckets[i].userId != userId)
+		i = (i + 1) & mask;
+
+	return i;
+}
+
+/**
+ * Resize the hash table.
+ *
+ * @param userRegistry	Pointer to the UserRegistry.
+ * @param nBuckets		New number of buckets (power of 2).
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+static int resizeBuckets(UserRegistry *userRegistry, size_t nBuckets)
+{
+	UserRegistryBucket *buckets = malloc(nBuckets * sizeof(UserRegistryBucket));
+
+	if (buckets == NULL)
+		return RETURN_VALUE_ERROR;
+
+	for (size_t i = 0; i < nBuckets; i++)
+		buckets[i].slot = USER_REGISTRY_EMPTY_SLOT;
+
+	// Re-insert the bound user IDs
+	for (size_t i = 0; i < userRegistry->nBuckets; i++)
+	{
+		if (userRegistry->buckets[i].slot != USER_REGISTRY_EMPTY_SLOT)
+			buckets[probeBucket(buckets, nBuckets, userRegistry->buckets[i].userId)] = userRegistry->buckets[i];
+	}
+
+	free(userRegistry->buckets);
+	userRegistry->buckets = buckets;
+	userRegistry->nBuckets = nBuckets;
+
+	return RETURN_VALUE_OK;
+}
+
+/**
+ * Allocate a new chunk of slots and push them to the free stack.
+ *
+ * @param userRegistry	Pointer to the UserRegistry.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+static int growSlots(UserRegistry *userRegistry)
+{
+	size_t nNew = userRegistry->maxSlots - userRegistry->nSlots;
+
+	if (nNew == 0)
+		return RETURN_VALUE_ERROR;
+	if (nNew > USER_REGISTRY_CHUNK_SLOTS)
+		nNew = USER_REGISTRY_CHUNK_SLOTS;
+
+	unsigned char *chunk = calloc(USER_REGISTRY_CHUNK_SLOTS, userRegistry->elementSize);
+	int *freeSlots = realloc(userRegistry->freeSlots, (userRegistry->nSlots + nNew) * sizeof(int));
+
+	if (chunk == NULL || freeSlots == NULL)
+	{
+		free(chunk);
+		if (freeSlots != NULL)
+			userRegistry->freeSlots = freeSlots;
+		return RETURN_VALUE_ERROR;
+	}
+
+	userRegistry->chunks[userRegistry->nSlots / USER_REGISTRY_CHUNK_SLOTS] = chunk;
+	userRegistry->freeSlots = freeSlots;
+
+	// Push in reverse order, so lower slots are handed out first
+	for (size_t i = nNew; i > 0; i--)
+		userRegistry->freeSlots[userRegistry->nFree++] = (int) (userRegistry->nSlots + i - 1);
+
+	userRegistry->nSlots += nNew;
+
+	return RETURN_VALUE_OK;
+}
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+int initializeUserRegistry(UserRegistry *userRegistry, size_t elementSize, size_t maxSlots)
+{
+	// Check arguments
+	if (userRegistry == NULL || elementSize == 0 || maxSlots == 0 || maxSlots > INT32_MAX)
+		return RETURN_VALUE_ERROR;
+
+	memset(userRegistry, 0, sizeof(UserRegistry));
+	userRegistry->elementSize = elementSize;
+	userRegistry->maxSlots = maxSlots;
+
+	// The chunk table never moves, so slots can be read from other threads
+	userRegistry->chunks = calloc((maxSlots + USER_REGISTRY_CHUNK_SLOTS - 1) / USER_REGISTRY_CHUNK_SLOTS,
+								  sizeof(unsigned char *));
+
+	if (userRegistry->chunks == NULL || resizeBuckets(userRegistry, USER_REGISTRY_INITIAL_BUCKETS) != RETURN_VALUE_OK)
+	{
+		terminateUserRegistry(userRegistry);
+		return RETURN_VALUE_ERROR;
+	}
+
+	return RETURN_VALUE_OK;
+}
+
+
+int terminateUserRegistry(UserRegistry *userRegistry)
+{
+	// Check arguments
+	if (userRegistry == NULL)
+		return RETURN_VALUE_ERROR;
+
+	if (userRegistry->chunks != NULL)
+	{
+		for (size_t i = 0; i * USER_REGISTRY_CHUNK_SLOTS < userRegistry->nSlots; i++)
+			free(userRegistry->chunks[i]);
+	}
+
+	free(userRegistry->chunks);
+	free(userRegistry->freeSlots);
+	free(userRegistry->buckets);
+	memset(userRegistry, 0, sizeof(UserRegistry));
+
+	return RETURN_VALUE_OK;
+}
+
+
+int allocateUserSlot(UserRegistry *userRegistry)
+{
+	if (userRegistry->nFree == 0 && growSlots(userRegistry) != RETURN_VALUE_OK)
+		return RETURN_VALUE_ERROR;
+
+	int slot = userRegistry->freeSlots[--userRegistry->nFree];
+
+	memset(getUserSlot(userRegistry, slot), 0, userRegistry->elementSize);
+	userRegistry->nUsed++;
+
+	return slot;
+}
+
+
+void releaseUserSlot(UserRegistry *userRegistry, int slot, int userId)
+{
+	unbindUserId(userRegistry, userId, slot);
+
+	userRegistry->freeSlots[userRegistry->nFree++] = slot;
+	userRegistry->nUsed--;
+}
+
+
+void *getUserSlot(const UserRegistry *userRegistry, int slot)
+{
+	return userRegistry->chunks[slot / USER_REGISTRY_CHUNK_SLOTS]
+		   + (size_t) (slot % USER_REGISTRY_CHUNK_SLOTS) * userRegistry->elementSize;
+}
+
+
+size_t getUserRegistrySize(const UserRegistry *userRegistry)
+{
+	return userRegistry->nSlots;
+}
+
+
+int bindUserId(UserRegistry *userRegistry, int userId, int slot)
+{
+	// Keep the load factor at or below 1/2
+	if (2 * (userRegistry->nBound + 1) > userRegistry->nBuckets
+			&& resizeBuckets(userRegistry, 2 * userRegistry->nBuckets) != RETURN_VALUE_OK)
+		return RETURN_VALUE_ERROR;
+
+	size_t i = probeBucket(userRegistry->buckets, userRegistry->nBuckets, userId);
+
+	if (userRegistry->buckets[i].slot == USER_REGISTRY_EMPTY_SLOT)
+		userRegistry->nBound++;
+
+	userRegistry->buckets[i].userId = userId;
+	userRegistry->buckets[i].slot = slot;
+
+	return RETURN_VALUE_OK;
+}
+
+
+void unbindUserId(UserRegistry *userRegistry, int userId, int slot)
+{
+	size_t mask = userRegistry->nBuckets - 1;
+	size_t i = probeBucket(userRegistry->buckets, userRegistry->nBuckets, userId);
+
+	if (userRegistry->buckets[i].slot != slot)
+		return;
+
+	// Backward-shift deletion keeps the probe sequences intact without tombstones
+	size_t j = i;
+	for (;;)
+	{
+		userRegistry->buckets[i].slot = USER_REGISTRY_EMPTY_SLOT;
+
+		for (;;)
+		{
+			j = (j + 1) & mask;
+			if (userRegistry->buckets[j].slot == USER_REGISTRY_EMPTY_SLOT)
+			{
+				userRegistry->nBound--;
+				return;
+			}
+
+			// Move the entry back unless its home bucket lies cyclically in (i, j]
+			size_t home = hashUserId(userRegistry->buckets[j].userId) & mask;
+			if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j))
+				continue;
+
+			break;
+		}
+
+		userRegistry->buckets[i] = userRegistry->buckets[j];
+		i = j;
+	}
+}
+
+
+int findUserSlot(const UserRegistry *userRegistry, int userId)
+{
+	size_t i = probeBucket(userRegistry->buckets, userRegistry->nBuckets, userId);
+
+	if (userRegistry->buckets[i].slot == USER_REGISTRY_EMPTY_SLOT)
+		return RETURN_VALUE_ERROR;
+
+	return userRegistry->buckets[i].slot;
+}
@@ -0,0 +1,150 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+#pragma once
+
+// C headers
+#include <stddef.h>
+#include <stdint.h>
+
+
+// =========================================================
+//           DEFINES
+// =========================================================
+
+// Return codes
+#define RETURN_VALUE_OK				0
+#define RETURN_VALUE_ERROR			(-1)
+
+// Number of slots allocated at once when the registry grows
+#define USER_REGISTRY_CHUNK_SLOTS	64
+
+
+// =========================================================
+//           STRUCTS
+// =========================================================
+
+/**
+ * Entry of the userId -> slot hash table.
+ */
+typedef struct _UserRegistryBucket
+{
+	int userId;									// User ID
+	int slot;									// Slot bound to the user ID (-1 if the bucket is empty)
+} UserRegistryBucket;
+
+/**
+ * Growable table of fixed-size user slots.
+ *
+ * Slots are allocated in chunks, so the address of a slot never changes
+ * while the registry is alive (slots can be registered in the event loop
+ * or linked in timer lists). Free slots are kept in a stack and user IDs
+ * are mapped to slots by an open addressing hash table, so allocating,
+ * releasing and looking up a user are O(1).
+ */
+typedef struct _UserRegistry
+{
+	size_t elementSize;							// Size of each slot (in bytes)
+	size_t maxSlots;							// Maximum number of slots
+	size_t nSlots;								// Number of allocated slots
+	size_t nUsed;								// Number of slots in use
+	unsigned char **chunks;						// Chunks of USER_REGISTRY_CHUNK_SLOTS slots
+	int *freeSlots;								// Stack of free slots
+	size_t nFree;								// Number of free slots in the stack
+	UserRegistryBucket *buckets;				// userId -> slot hash table
+	size_t nBuckets;							// Number of buckets (power of 2)
+	size_t nBound;								// Number of bound user IDs
+} UserRegistry;
+
+
+// =========================================================
+//           PUBLIC API
+// =========================================================
+
+/**
+ * Initialize a user registry. No slots are allocated until needed.
+ *
+ * @param userRegistry	Pointer to the UserRegistry to be initialized.
+ * @param elementSize	Size of each slot (in bytes).
+ * @param maxSlots		Maximum number of slots.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int initializeUserRegistry(UserRegistry *userRegistry, size_t elementSize, size_t maxSlots);
+
+/**
+ * Terminate a user registry, freeing all its slots.
+ *
+ * @param userRegistry	Pointer to the UserRegistry to be terminated.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int terminateUserRegistry(UserRegistry *userRegistry);
+
+/**
+ * Allocate a zero-initialized slot, growing the registry if needed.
+ *
+ * @param userRegistry	Pointer to the UserRegistry.
+ * @return				Slot index; RETURN_VALUE_ERROR if the registry is full.
+ */
+int allocateUserSlot(UserRegistry *userRegistry);
+
+/**
+ * Release a slot (and its user ID binding, if any).
+ *
+ * @param userRegistry	Pointer to the UserRegistry.
+ * @param slot			Slot index.
+ * @param userId		User ID bound to the slot; ignored if not bound to it.
+ */
+void releaseUserSlot(UserRegistry *userRegistry, int slot, int userId);
+
+/**
+ * Get the memory of a slot.
+ *
+ * @param userRegistry	Pointer to the UserRegistry.
+ * @param slot			Slot index (must be lower than getUserRegistrySize()).
+ * @return				Pointer to the slot.
+ */
+void *getUserSlot(const UserRegistry *userRegistry, int slot);
+
+/**
+ * Get the number of allocated slots (used or free).
+ *
+ * @param userRegistry	Pointer to the UserRegistry.
+ * @return				Number of allocated slots.
+ */
+size_t getUserRegistrySize(const UserRegistry *userRegistry);
+
+/**
+ * Bind a user ID to a slot, replacing any previous binding of the user ID.
+ *
+ * @param userRegistry	Pointer to the UserRegistry.
+ * @param userId		User ID.
+ * @param slot			Slot index.
+ * @return				Return RETURN_VALUE_OK if there are no errors;
+ *						otherwise, return RETURN_VALUE_ERROR.
+ */
+int bindUserId(UserRegistry *userRegistry, int userId, int slot);
+
+/**
+ * Remove the binding of a user ID, if it is bound to the given slot.
+ *
+ * @param userRegistry	Pointer to the UserRegistry.
+ * @param userId		User ID.
+ * @param slot			Slot index.
+ */
+void unbindUserId(UserRegistry *userRegistry, int userId, int slot);
+
+/**
+ * Find the slot bound to a user ID.
+ *
+ * @param userRegistry	Pointer to the UserRegistry.
+ * @param userId		User ID.
+ * @return				Slot index; RETURN_VALUE_ERROR if the user ID is not bound.
+ */
+int findUserSlot(const UserRegistry *userRegistry, int userId);
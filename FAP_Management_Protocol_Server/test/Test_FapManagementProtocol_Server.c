@@ -8,10 +8,39 @@
 
 // Module headers
 #include "FapManagementProtocol_Server.h"
+#include "UserRegistry.h"
+#include "EventLoop.h"
+#include "TimerWheel.h"
+#include "StreamFramer.h"
+#include "ProtocolBinary.h"
+#include "DatagramBatch.h"
+#include "ProtocolParser.h"
+#include "Arena.h"
+#include "PositionTable.h"
+#include "NedConverter.h"
+#include "Geodesy.h"
+#include "SpatialIndex.h"
+#include "FapPlacement.h"
+#include "FapCoordinator.h"
+#include "TrajectoryPredictor.h"
+#include "MavlinkIngest.h"
+#include "MavlinkLink.h"
+#include "TelemetryCache.h"
+#include "PeriodicScheduler.h"
+#include "Logger.h"
+#include "EventLog.h"
 
 // C headers
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
 #include <time.h>
+#include <unistd.h>
 
 
 // =========================================================
@@ -124,6 +153,13 @@ int runTest_fapManagementProtocol()
 	PRINT_TEST_HEADER();
 
 	int nErrors = 0;
+	char eventLogPath[] = "/tmp/Test_FapManagementProtocol_Server_XXXXXX";
+
+	// Record the traffic
+	close(mkstemp(eventLogPath));
+	ASSERT_CONDITION(setFapEventLogFile(eventLogPath) == RETURN_VALUE_OK,
+					 "Setting the event log",
+					 nErrors);
 
 	// Initialize FAP Management Protocol
 	ASSERT_CONDITION(initializeFapManagementProtocol() == RETURN_VALUE_OK,
@@ -155,11 +191,41 @@ int runTest_fapManagementProtocol()
 	// Terminate FAP Management Protocol
 	sleepProgram(1); // Let some time pass
 
+	PeriodicTaskStats heartbeatStats;
+	ASSERT_CONDITION(getHeartbeatStats(&heartbeatStats) == RETURN_VALUE_OK && heartbeatStats.runs >= 3
+					 && heartbeatStats.overruns == 0,
+					 "Sending heartbeats every 500 ms",
+					 nErrors);
+	TEST_PRINT("Heartbeats: %lu (lateness: mean %.0f us, max %.0f us)",
+			   heartbeatStats.runs, heartbeatStats.meanLatenessNs / 1e3, heartbeatStats.maxLatenessNs / 1e3);
+
 	ASSERT_CONDITION(terminateFapManagementProtocol() == RETURN_VALUE_OK,
 					 "Terminating the FAP Management Protocol",
 					 nErrors);
 
 
+	// The FAP's move was recorded
+	EventLogReader reader;
+	EventLogRecord record;
+	float target[3] = {0};
+
+	if (openEventLogReader(&reader, eventLogPath) == RETURN_VALUE_OK)
+	{
+		while (readEventLog(&reader, &record) == RETURN_VALUE_OK)
+		{
+			if (record.header.type == EVENT_LOG_MAVLINK_COMMAND && record.header.payloadLength == sizeof(target))
+				memcpy(target, record.payload, sizeof(target));
+		}
+		closeEventLogReader(&reader);
+	}
+	setFapEventLogFile(NULL);
+	unlink(eventLogPath);
+
+	ASSERT_CONDITION(target[0] == 15 && target[1] == 20 && target[2] == 10,
+					 "Recording the FAP's move in the event log",
+					 nErrors);
+
+
 	// Finish test
 	PRINT_TEST_SUMMARY(nErrors);
 
@@ -216,6 +282,2510 @@ int runTest_getAllUsersGpsNedCoordinates()
 	return nErrors;
 }
 
+/**
+ * Test - User registry (slot allocation and userId lookup).
+ * 
+ * @return		The number of errors detected.
+ */
+int runTest_userRegistry()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	const int nUsers = 1000;
+	UserRegistry userRegistry;
+
+	ASSERT_CONDITION(initializeUserRegistry(&userRegistry, sizeof(int), nUsers) == RETURN_VALUE_OK,
+					 "Initializing the user registry",
+					 nErrors);
+
+	// Fill the registry, binding user IDs to their slots
+	for (int i = 0; i < nUsers; i++)
+	{
+		int slot = allocateUserSlot(&userRegistry);
+
+		ASSERT_CONDITION(slot >= 0, "Allocating a user slot", nErrors);
+		if (slot < 0)
+			break;
+
+		*(int *) getUserSlot(&userRegistry, slot) = i;
+		bindUserId(&userRegistry, 100 + i, slot);
+	}
+
+	ASSERT_CONDITION(allocateUserSlot(&userRegistry) == RETURN_VALUE_ERROR,
+					 "Allocating beyond the user limit",
+					 nErrors);
+
+	// Release every other user and check the lookups of the remaining ones
+	for (int i = 0; i < nUsers; i += 2)
+		releaseUserSlot(&userRegistry, findUserSlot(&userRegistry, 100 + i), 100 + i);
+
+	for (int i = 0; i < nUsers; i++)
+	{
+		int slot = findUserSlot(&userRegistry, 100 + i);
+
+		if (i % 2 == 0)
+		{
+			ASSERT_CONDITION(slot == RETURN_VALUE_ERROR, "Released user ID still bound", nErrors);
+		}
+		else
+		{
+			ASSERT_CONDITION(slot >= 0 && *(int *) getUserSlot(&userRegistry, slot) == i,
+							 "Looking up a user ID", nErrors);
+		}
+	}
+
+	// Released slots are reused
+	ASSERT_CONDITION(allocateUserSlot(&userRegistry) >= 0,
+					 "Reusing a released slot",
+					 nErrors);
+
+	terminateUserRegistry(&userRegistry);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Callback of runTest_eventLoop(): drains its pipe, counting the bytes.
+ */
+void eventLoopReader(EventLoopHandler *handler, uint32_t events)
+{
+	char byte;
+
+	while (read(handler->fd, &byte, 1) == 1)
+		(*(int *) handler->context)++;
+}
+
+/**
+ * Stopper of runTest_eventLoop(): stops the (blocked) loop from another thread.
+ */
+void *eventLoopStopper(void *arg)
+{
+	struct timespec delay = {0, 50000000L};
+
+	nanosleep(&delay, NULL);
+	stopEventLoop(arg);
+
+	return NULL;
+}
+
+/**
+ * Test - Event loop (dispatch of ready handlers, removal and stop from another thread).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_eventLoop()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	int registered[2], removed[2], nRegistered = 0, nRemoved = 0;
+	EventLoop eventLoop;
+	EventLoopHandler registeredHandler, removedHandler;
+	pthread_t stopper;
+
+	pipe2(registered, O_NONBLOCK);
+	pipe2(removed, O_NONBLOCK);
+
+	ASSERT_CONDITION(initializeEventLoop(&eventLoop) == RETURN_VALUE_OK,
+					 "Initializing the event loop",
+					 nErrors);
+
+	registeredHandler = (EventLoopHandler) {registered[0], eventLoopReader, &nRegistered};
+	removedHandler = (EventLoopHandler) {removed[0], eventLoopReader, &nRemoved};
+	ASSERT_CONDITION(addEventLoopHandler(&eventLoop, &registeredHandler, EPOLLIN) == RETURN_VALUE_OK
+					 && addEventLoopHandler(&eventLoop, &removedHandler, EPOLLIN) == RETURN_VALUE_OK
+					 && addEventLoopHandler(&eventLoop, &registeredHandler, EPOLLIN) == RETURN_VALUE_ERROR,
+					 "Registering handlers (once each)",
+					 nErrors);
+	ASSERT_CONDITION(removeEventLoopHandler(&eventLoop, &removedHandler) == RETURN_VALUE_OK,
+					 "Removing a handler",
+					 nErrors);
+
+	// Both pipes are readable, only the registered one is dispatched
+	write(registered[1], "abc", 3);
+	write(removed[1], "abc", 3);
+
+	pthread_create(&stopper, NULL, eventLoopStopper, &eventLoop);
+	ASSERT_CONDITION(runEventLoop(&eventLoop) == RETURN_VALUE_OK,
+					 "Running the event loop until stopped from another thread",
+					 nErrors);
+	pthread_join(stopper, NULL);
+
+	ASSERT_CONDITION(nRegistered == 3 && nRemoved == 0,
+					 "Dispatching the registered handlers only",
+					 nErrors);
+
+	terminateEventLoop(&eventLoop);
+	for (int i = 0; i < 2; i++)
+	{
+		close(registered[i]);
+		close(removed[i]);
+	}
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+// Timers fired by runTest_timerWheel(), in order
+int timerWheelFired[8], nTimerWheelFired;
+int64_t timerWheelFiredMs[8];
+
+/**
+ * Monotonic time (in ms).
+ */
+int64_t testMonotonicMs()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Callback of runTest_timerWheel(): records the timer (its context is its
+ * number); the last one stops the loop.
+ */
+void timerWheelCallback(TimerWheelTimer *timer)
+{
+	int number = (int) (intptr_t) timer->context;
+
+	if (nTimerWheelFired < 8)
+	{
+		timerWheelFired[nTimerWheelFired] = number;
+		timerWheelFiredMs[nTimerWheelFired++] = testMonotonicMs();
+	}
+}
+
+/**
+ * Last timer of runTest_timerWheel(): stops the loop.
+ */
+void timerWheelStop(TimerWheelTimer *timer)
+{
+	stopEventLoop(timer->context);
+}
+
+/**
+ * Test - Timer wheel (arm, cancel, re-arm and expiry order across the slots' wrap).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_timerWheel()
+{
+	PRINT_TEST_HEADER();
+
+	// 5 ms ticks: the 64 slots wrap every 320 ms
+	const uint64_t tickMs = 5;
+	int nErrors = 0, inOrder;
+	int expected[] = {1, 2, 3};
+	EventLoop eventLoop;
+	TimerWheel timerWheel;
+	TimerWheelTimer timers[5], stop;
+	int64_t start;
+
+	initializeEventLoop(&eventLoop);
+	ASSERT_CONDITION(initializeTimerWheel(&timerWheel, &eventLoop, tickMs) == RETURN_VALUE_OK,
+					 "Initializing the timer wheel",
+					 nErrors);
+
+	for (int i = 0; i < 5; i++)
+		initializeTimer(&timers[i], timerWheelCallback, (void *) (intptr_t) i);
+	initializeTimer(&stop, timerWheelStop, &eventLoop);
+	nTimerWheelFired = 0;
+	start = testMonotonicMs();
+
+	// Timer 3 (after the wrap) shares its slot with timer 1 (before it)
+	armTimer(&timerWheel, &timers[1], 80);
+	armTimer(&timerWheel, &timers[3], 80 + TIMER_WHEEL_SLOTS * tickMs);
+	armTimer(&timerWheel, &timers[4], 200);
+	armTimer(&timerWheel, &timers[2], 300);
+	armTimer(&timerWheel, &stop, 500);
+
+	// Cancelled (twice: no effect), and re-armed earlier
+	cancelTimer(&timerWheel, &timers[4]);
+	cancelTimer(&timerWheel, &timers[4]);
+	armTimer(&timerWheel, &timers[2], 120);
+	ASSERT_CONDITION(timerWheel.nArmed == 4 && !timers[4].armed && !timers[0].armed,
+					 "Cancelling and re-arming timers",
+					 nErrors);
+
+	runEventLoop(&eventLoop);
+
+	inOrder = (nTimerWheelFired == 3);
+	for (int i = 0; inOrder && i < 3; i++)
+		inOrder = (timerWheelFired[i] == expected[i]);
+	ASSERT_CONDITION(inOrder,
+					 "Firing the armed timers once, in expiry order",
+					 nErrors);
+
+	// Never early (timer 3 isn't fired on the first lap of its slot)
+	ASSERT_CONDITION(nTimerWheelFired == 3 && timerWheelFiredMs[0] - start >= 80 && timerWheelFiredMs[1] - start >= 120
+					 && timerWheelFiredMs[2] - start >= 80 + TIMER_WHEEL_SLOTS * (int64_t) tickMs,
+					 "Firing the timers after their delay",
+					 nErrors);
+
+	ASSERT_CONDITION(timerWheel.nArmed == 0,
+					 "Disarming the fired timers",
+					 nErrors);
+
+	TEST_PRINT("Timers fired after %lld, %lld and %lld ms", (long long) (timerWheelFiredMs[0] - start),
+			   (long long) (timerWheelFiredMs[1] - start), (long long) (timerWheelFiredMs[2] - start));
+
+	terminateTimerWheel(&timerWheel);
+	terminateEventLoop(&eventLoop);
+
+	// 100 ms ticks: armed late in a tick, a timer still waits its whole delay
+	initializeEventLoop(&eventLoop);
+	ASSERT_CONDITION(initializeTimerWheel(&timerWheel, &eventLoop, 100) == RETURN_VALUE_OK,
+					 "Initializing the timer wheel",
+					 nErrors);
+
+	while ((testMonotonicMs() - (int64_t) timerWheel.startMs) % 100 < 90)
+		usleep(1000);
+
+	nTimerWheelFired = 0;
+	start = testMonotonicMs();
+	armTimer(&timerWheel, &timers[0], 100);
+	armTimer(&timerWheel, &stop, 300);
+	runEventLoop(&eventLoop);
+
+	ASSERT_CONDITION(nTimerWheelFired == 1 && timerWheelFiredMs[0] - start >= 100,
+					 "Firing a timer armed late in a tick after its delay",
+					 nErrors);
+
+	TEST_PRINT("Timer armed late in a tick fired after %lld ms", (long long) (timerWheelFiredMs[0] - start));
+
+	terminateTimerWheel(&timerWheel);
+	terminateEventLoop(&eventLoop);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Build a frame (length prefix and payload) of runTest_streamFramer().
+ *
+ * @return		Frame's length.
+ */
+size_t buildStreamFrame(unsigned char *frame, const char *payload)
+{
+	uint32_t header = htonl(strlen(payload));
+
+	memcpy(frame, &header, STREAM_FRAME_HEADER_SIZE);
+	memcpy(frame + STREAM_FRAME_HEADER_SIZE, payload, strlen(payload));
+
+	return STREAM_FRAME_HEADER_SIZE + strlen(payload);
+}
+
+/**
+ * Test - Stream framer (coalesced frames, frames split at every byte, oversize lengths,
+ * partial sends).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_streamFramer()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0, ok;
+	int fds[2];
+	const char *payloads[] = {"{\"msgType\": 6, \"userId\": 1, \"gpsCoordinates\": {\"latitude\": 41.178, \"longitude\": -8.596, \"altitude\": 100}}",
+							  "{\"msgType\": 8}", "x"};
+	unsigned char frames[256];
+	char payload[STREAM_FRAMER_BUFFER_SIZE];
+	size_t size = 0, length;
+	uint32_t header;
+	StreamFramer framer;
+
+	socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+	initializeStreamFramer(&framer);
+
+	for (int i = 0; i < 3; i++)
+		size += buildStreamFrame(frames + size, payloads[i]);
+
+	// Coalesced: several frames in one read
+	write(fds[1], frames, size);
+	ok = (fillStreamFramer(&framer, fds[0]) == STREAM_FRAMER_FILLED);
+	for (int i = 0; i < 3; i++)
+		ok &= (nextStreamFrame(&framer, payload, sizeof(payload), &length) == STREAM_FRAME_READY
+			   && length == strlen(payloads[i]) && strcmp(payload, payloads[i]) == 0);
+	ok &= (nextStreamFrame(&framer, payload, sizeof(payload), &length) == STREAM_FRAME_INCOMPLETE);
+	ASSERT_CONDITION(ok,
+					 "Extracting frames received together",
+					 nErrors);
+
+	// Split at every byte boundary (the ring wraps around along the way)
+	ok = 1;
+	for (size_t split = 1; split < size; split++)
+	{
+		int n = 0;
+
+		write(fds[1], frames, split);
+		fillStreamFramer(&framer, fds[0]);
+		while (nextStreamFrame(&framer, payload, sizeof(payload), &length) == STREAM_FRAME_READY)
+			ok &= (strcmp(payload, payloads[n++]) == 0);
+
+		write(fds[1], frames + split, size - split);
+		fillStreamFramer(&framer, fds[0]);
+		while (nextStreamFrame(&framer, payload, sizeof(payload), &length) == STREAM_FRAME_READY)
+			ok &= (n < 3 && strcmp(payload, payloads[n++]) == 0);
+
+		ok &= (n == 3 && framer.head == framer.tail);
+	}
+	ASSERT_CONDITION(ok && framer.head > STREAM_FRAMER_BUFFER_SIZE,
+					 "Extracting frames split at every byte",
+					 nErrors);
+
+	// Oversize: beyond the frame limit, or the destination
+	header = htonl(STREAM_FRAME_MAX_PAYLOAD + 1);
+	write(fds[1], &header, sizeof(header));
+	fillStreamFramer(&framer, fds[0]);
+	ASSERT_CONDITION(nextStreamFrame(&framer, payload, sizeof(payload), &length) == STREAM_FRAME_INVALID,
+					 "Rejecting a frame longer than the limit",
+					 nErrors);
+
+	initializeStreamFramer(&framer);
+	header = htonl(16);
+	write(fds[1], &header, sizeof(header));
+	fillStreamFramer(&framer, fds[0]);
+	ASSERT_CONDITION(nextStreamFrame(&framer, payload, 16, &length) == STREAM_FRAME_INVALID,
+					 "Rejecting a frame longer than the destination",
+					 nErrors);
+
+	// Peer closed
+	close(fds[1]);
+	ASSERT_CONDITION(fillStreamFramer(&framer, fds[0]) == STREAM_FRAMER_CLOSED,
+					 "Detecting the closed peer",
+					 nErrors);
+	close(fds[0]);
+
+	// A full socket buffer: the rest of the frames is queued, up to the queue's size
+	StreamOutput output;
+	char numbered[1000] = {0};
+	int nSent = 0, nReceived = 0, res;
+
+	socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+	initializeStreamFramer(&framer);
+	initializeStreamOutput(&output);
+
+	do
+	{
+		snprintf(numbered, sizeof(numbered), "%d", nSent);
+		res = sendStreamFrame(&output, fds[0], numbered, sizeof(numbered));
+		nSent += (res != STREAM_OUTPUT_FAILED);
+	} while (res != STREAM_OUTPUT_FAILED && nSent < 100000);
+
+	ASSERT_CONDITION(res == STREAM_OUTPUT_FAILED && output.length > 0 && output.length <= STREAM_OUTPUT_BUFFER_SIZE,
+					 "Queueing what the socket can't take, up to the queue's size",
+					 nErrors);
+
+	// Flushed as the peer reads: every frame arrives whole, in order
+	ok = 1;
+	for (int i = 0; i < 100000 && nReceived < nSent; i++)
+	{
+		ok &= (flushStreamOutput(&output, fds[0]) != STREAM_OUTPUT_FAILED);
+		fillStreamFramer(&framer, fds[1]);
+		while (nextStreamFrame(&framer, payload, sizeof(payload), &length) == STREAM_FRAME_READY)
+			ok &= (length == sizeof(numbered) && atoi(payload) == nReceived++);
+	}
+	ASSERT_CONDITION(ok && nReceived == nSent && output.length == 0,
+					 "Flushing the queued frames, in order",
+					 nErrors);
+
+	TEST_PRINT("Stream output: %d frames of %zu bytes sent before the queue filled", nSent, sizeof(numbered));
+
+	close(fds[0]);
+	close(fds[1]);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - Binary encoding (round trip, rejection of bad versions and lengths).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_protocolBinary()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	const char json[PROTOCOL_BINARY_MSG_SIZE + 1] = "{\"msgType\": 6, \"userId\": 12}";
+	ProtocolBinaryMsg msg = {6, 7, 123456, 41.178f, -8.596f, 104.5f, 1526000000}, decoded;
+	unsigned char buffer[PROTOCOL_BINARY_MSG_SIZE + 1];
+
+	// Round trip of a GPS_COORDINATES_UPDATE (6), big endian on the wire
+	ASSERT_CONDITION(encodeProtocolBinaryMsg(buffer, &msg) == RETURN_VALUE_OK
+					 && buffer[0] == 6 && buffer[1] == PROTOCOL_BINARY_VERSION
+					 && buffer[2] == 0 && buffer[3] == 7 && buffer[4] == 0 && buffer[5] == 0x01 && buffer[6] == 0xE2,
+					 "Encoding a binary message",
+					 nErrors);
+
+	ASSERT_CONDITION(isProtocolBinaryMsg(buffer, PROTOCOL_BINARY_MSG_SIZE)
+					 && decodeProtocolBinaryMsg(&decoded, buffer, PROTOCOL_BINARY_MSG_SIZE) == RETURN_VALUE_OK
+					 && decoded.msgType == msg.msgType && decoded.updatePeriod == msg.updatePeriod
+					 && decoded.userId == msg.userId && decoded.latitude == msg.latitude
+					 && decoded.longitude == msg.longitude && decoded.altitude == msg.altitude
+					 && decoded.timestamp == msg.timestamp,
+					 "Decoding what was encoded",
+					 nErrors);
+
+	// Bad lengths, bad version, and JSON of the same length
+	ASSERT_CONDITION(decodeProtocolBinaryMsg(&decoded, buffer, PROTOCOL_BINARY_MSG_SIZE - 1) == RETURN_VALUE_ERROR
+					 && decodeProtocolBinaryMsg(&decoded, buffer, PROTOCOL_BINARY_MSG_SIZE + 1) == RETURN_VALUE_ERROR,
+					 "Rejecting a bad length",
+					 nErrors);
+
+	buffer[1] = PROTOCOL_BINARY_VERSION + 1;
+	ASSERT_CONDITION(decodeProtocolBinaryMsg(&decoded, buffer, PROTOCOL_BINARY_MSG_SIZE) == RETURN_VALUE_ERROR,
+					 "Rejecting a bad version",
+					 nErrors);
+
+	ASSERT_CONDITION(strlen(json) == PROTOCOL_BINARY_MSG_SIZE && !isProtocolBinaryMsg(json, PROTOCOL_BINARY_MSG_SIZE),
+					 "Telling JSON messages apart",
+					 nErrors);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - Datagram batch (queue, flush and receive over loopback).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_datagramBatch()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0, n = 0, ok;
+	int sender = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0), receiver = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	struct sockaddr_in senderAddress = {0}, receiverAddress = {0};
+	socklen_t length = sizeof(receiverAddress);
+	char payload[DATAGRAM_MAX_PAYLOAD + 1] = {0};
+	static DatagramBatch outgoing, incoming;
+
+	receiverAddress.sin_family = senderAddress.sin_family = AF_INET;
+	receiverAddress.sin_addr.s_addr = senderAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	bind(receiver, (struct sockaddr *) &receiverAddress, sizeof(receiverAddress));
+	getsockname(receiver, (struct sockaddr *) &receiverAddress, &length);
+	bind(sender, (struct sockaddr *) &senderAddress, sizeof(senderAddress));
+	length = sizeof(senderAddress);
+	getsockname(sender, (struct sockaddr *) &senderAddress, &length);
+
+	initializeDatagramBatch(&outgoing);
+	initializeDatagramBatch(&incoming);
+
+	ASSERT_CONDITION(receiveDatagramBatch(&incoming, receiver) == 0,
+					 "Receiving nothing (without blocking)",
+					 nErrors);
+
+	// Fill a batch (a payload too large, or a datagram too many, is refused)
+	ok = (queueDatagram(&outgoing, &receiverAddress, payload, DATAGRAM_MAX_PAYLOAD + 1) == RETURN_VALUE_ERROR);
+	for (int i = 0; i < DATAGRAM_BATCH_SIZE; i++)
+	{
+		snprintf(payload, sizeof(payload), "datagram %d", i);
+		ok &= (queueDatagram(&outgoing, &receiverAddress, payload, strlen(payload)) == RETURN_VALUE_OK);
+	}
+	ok &= (queueDatagram(&outgoing, &receiverAddress, payload, strlen(payload)) == RETURN_VALUE_ERROR);
+	ASSERT_CONDITION(ok && outgoing.count == DATAGRAM_BATCH_SIZE,
+					 "Queueing a batch of datagrams",
+					 nErrors);
+
+	ASSERT_CONDITION(flushDatagramBatch(&outgoing, sender) == DATAGRAM_BATCH_SIZE && outgoing.count == 0,
+					 "Sending the batch",
+					 nErrors);
+
+	// One receive (loopback delivers at once), in order, from the sender
+	ok = 1;
+	for (int tries = 0; tries < 100 && n < DATAGRAM_BATCH_SIZE; tries++)
+	{
+		int received = receiveDatagramBatch(&incoming, receiver);
+
+		for (int i = 0; i < received; i++, n++)
+		{
+			snprintf(payload, sizeof(payload), "datagram %d", n);
+			ok &= (incoming.lengths[i] == strlen(payload) && strcmp(incoming.payloads[i], payload) == 0
+				   && incoming.addresses[i].sin_port == senderAddress.sin_port);
+		}
+	}
+	ASSERT_CONDITION(ok && n == DATAGRAM_BATCH_SIZE,
+					 "Receiving the batch, in order",
+					 nErrors);
+
+	// Truncated datagrams are reported empty
+	memset(payload, 'x', sizeof(payload));
+	sendto(sender, payload, sizeof(payload), 0, (struct sockaddr *) &receiverAddress, sizeof(receiverAddress));
+	ASSERT_CONDITION(receiveDatagramBatch(&incoming, receiver) == 1 && incoming.lengths[0] == 0,
+					 "Reporting a truncated datagram",
+					 nErrors);
+
+	close(sender);
+	close(receiver);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - Protocol parser (in-place parsing and response templates).
+ * 
+ * @return		The number of errors detected.
+ */
+int runTest_protocolParser()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	ProtocolMsg msg;
+	Arena arena;
+	char buffer[128];
+	const char *update = "{ \"userId\": 42, \"msgType\": 6, \"unknown\": [1, {\"a\": null}, \"\\\"\"],"
+						 " \"gpsCoordinates\": {\"lat\": 41.1779, \"lon\": -8.5972, \"alt\": 10,"
+						 " \"timestamp\": \"2018-05-01T10:00:00Z\"} }";
+	const char *association = "{\"userId\":7,\"msgType\":1,\"encoding\":\"bin\\u0061ry\"}";
+	const char *invalid = "{\"userId\":7,\"msgType\":1,}";
+
+	// GPS coordinates update (unknown parameters are skipped)
+	ASSERT_CONDITION(parseProtocolMsg(&msg, update, strlen(update)) == RETURN_VALUE_OK,
+					 "Parsing a GPS coordinates update",
+					 nErrors);
+	ASSERT_CONDITION(msg.userId == 42 && msg.msgType == 6 && msg.hasGpsCoordinates
+					 && msg.gpsCoordinates.latitude == 41.1779f && msg.gpsCoordinates.longitude == -8.5972f
+					 && msg.gpsCoordinates.altitude == 10 && strcmp(msg.gpsCoordinates.timestamp, "2018-05-01T10:00:00Z") == 0,
+					 "GPS coordinates update parameters",
+					 nErrors);
+
+	// Escaped strings are left to parson, which allocates from the arena
+	ASSERT_CONDITION(initializeArena(&arena, 4096) == RETURN_VALUE_OK,
+					 "Initializing an arena",
+					 nErrors);
+	setJsonArena(&arena);
+
+	ASSERT_CONDITION(parseProtocolMsg(&msg, association, strlen(association)) == RETURN_VALUE_OK
+					 && msg.userId == 7 && msg.msgType == 1 && strcmp(msg.encoding, "binary") == 0,
+					 "Parsing an association request with escapes",
+					 nErrors);
+	ASSERT_CONDITION(arena.used > 0 && arena.overflows == 0,
+					 "Parser allocations served by the arena",
+					 nErrors);
+
+	resetArena(&arena);
+	setJsonArena(NULL);
+	terminateArena(&arena);
+
+	ASSERT_CONDITION(parseProtocolMsg(&msg, invalid, strlen(invalid)) == RETURN_VALUE_ERROR,
+					 "Rejecting invalid JSON",
+					 nErrors);
+
+	// Numbers: JSON's grammar only, and IDs and types that fit an int
+	const char *badNumbers[] = {"0x1F", "inf", "-inf", "nan", "+1", "01", "1.", ".5", "1e", "-", "1e999",
+								"4294967296", "2.5"};
+	int rejected = 1;
+
+	for (size_t i = 0; i < sizeof(badNumbers) / sizeof(badNumbers[0]); i++)
+	{
+		snprintf(buffer, sizeof(buffer), "{\"userId\":%s,\"msgType\":6}", badNumbers[i]);
+		rejected &= (parseProtocolMsg(&msg, buffer, strlen(buffer)) == RETURN_VALUE_ERROR);
+	}
+	ASSERT_CONDITION(rejected,
+					 "Rejecting numbers outside JSON's grammar or an int's range",
+					 nErrors);
+
+	snprintf(buffer, sizeof(buffer), "{\"\\u0061\":1,\"userId\":7,\"msgType\":1e10}");
+	ASSERT_CONDITION(parseProtocolMsg(&msg, buffer, strlen(buffer)) == RETURN_VALUE_ERROR,
+					 "Rejecting a message type out of range (escapes: parsed by parson)",
+					 nErrors);
+
+	snprintf(buffer, sizeof(buffer), "{\"userId\":-0,\"msgType\":6.0e0,\"gpsCoordinates\":{\"lat\":-1.5E+1}}");
+	ASSERT_CONDITION(parseProtocolMsg(&msg, buffer, strlen(buffer)) == RETURN_VALUE_OK
+					 && msg.userId == 0 && msg.msgType == 6 && msg.gpsCoordinates.latitude == -15,
+					 "Parsing numbers with fractions and exponents",
+					 nErrors);
+
+	// Responses
+	ASSERT_CONDITION(formatGpsCoordinatesAck(buffer, sizeof(buffer), 42, 7, "2018-05-01T10:00:00Z", 0) > 0
+					 && strcmp(buffer, "{\"userId\":42,\"msgType\":7,\"gpsTimestamp\":\"2018-05-01T10:00:00Z\"}") == 0,
+					 "Formatting a GPS coordinates ACK",
+					 nErrors);
+	ASSERT_CONDITION(formatGpsCoordinatesAck(buffer, sizeof(buffer), 42, 7, "2018-05-01T10:00:00Z", 4) > 0
+					 && strcmp(buffer, "{\"userId\":42,\"msgType\":7,\"gpsTimestamp\":\"2018-05-01T10:00:00Z\",\"updatePeriod\":4}") == 0,
+					 "Formatting a GPS coordinates ACK with the next update period",
+					 nErrors);
+	ASSERT_CONDITION(formatAssociationResponse(buffer, sizeof(buffer), 7, 2, "binary", NULL, 0) > 0
+					 && strcmp(buffer, "{\"userId\":7,\"msgType\":2,\"encoding\":\"binary\"}") == 0,
+					 "Formatting an association response",
+					 nErrors);
+	ASSERT_CONDITION(formatAssociationResponse(buffer, sizeof(buffer), 7, 2, NULL, "udp", 10) > 0
+					 && strcmp(buffer, "{\"userId\":7,\"msgType\":2,\"transport\":\"udp\",\"updatePeriod\":10}") == 0,
+					 "Formatting an association response with the update period",
+					 nErrors);
+	ASSERT_CONDITION(formatProtocolResponse(buffer, 8, 7, 5) == RETURN_VALUE_ERROR,
+					 "Formatting into a short buffer",
+					 nErrors);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+atomic_int positionTableWriterRunning;
+
+/**
+ * Writer of runTest_positionTable(): publishes positions whose
+ * coordinates are all equal, until stopped.
+ */
+void *positionTableWriter(void *arg)
+{
+	PositionTable *positionTable = arg;
+
+	for (int k = 1; atomic_load(&positionTableWriterRunning); k++)
+	{
+		publishPosition(positionTable, k % 8, k, k, k, k, k);
+		if (k % 1000 == 0)
+			clearPosition(positionTable, (k / 1000) % 8);
+	}
+
+	return NULL;
+}
+
+/**
+ * Test - Position table (consistent snapshots while positions are published).
+ * 
+ * @return		The number of errors detected.
+ */
+int runTest_positionTable()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	int nTorn = 0;
+	int64_t epochNs;
+	PositionTable positionTable;
+	PositionArrays snapshot;
+	GpsNedCoordinates coordinates[8];
+	pthread_t writer;
+
+	ASSERT_CONDITION(initializePositionTable(&positionTable, 8) == RETURN_VALUE_OK,
+					 "Initializing the position table",
+					 nErrors);
+	ASSERT_CONDITION(initializePositionArrays(&snapshot, 8) == RETURN_VALUE_OK,
+					 "Initializing the snapshot arrays",
+					 nErrors);
+	ASSERT_CONDITION(snapshotPositionArrays(&positionTable, &snapshot) == 0,
+					 "Empty position table",
+					 nErrors);
+
+	atomic_store(&positionTableWriterRunning, 1);
+	pthread_create(&writer, NULL, positionTableWriter, &positionTable);
+
+	for (int i = 0; i < 200000; i++)
+	{
+		int n = snapshotPositionArrays(&positionTable, &snapshot);
+
+		for (int j = 0; j < n; j++)
+		{
+			if (snapshot.x[j] != snapshot.y[j] || snapshot.y[j] != snapshot.z[j] || snapshot.epochNs[j] != snapshot.userId[j])
+				nTorn++;
+		}
+	}
+
+	// Stop the writer
+	atomic_store(&positionTableWriterRunning, 0);
+	pthread_join(writer, NULL);
+
+	ASSERT_CONDITION(nTorn == 0,
+					 "Torn position in a snapshot",
+					 nErrors);
+
+	// Conversion to GpsNedCoordinates (binary timestamps become ISO8601 again)
+	ASSERT_CONDITION(parseTimestampIso8601("2018-05-01T10:00:30Z", &epochNs) == RETURN_VALUE_OK
+					 && epochNs == 1525168830LL * 1000000000LL,
+					 "Parsing an ISO8601 timestamp",
+					 nErrors);
+	ASSERT_CONDITION(parseTimestampIso8601("2018-05-01T12:00+02:00", &epochNs) == RETURN_VALUE_OK
+					 && epochNs == 1525168800LL * 1000000000LL,
+					 "Parsing an ISO8601 timestamp with a UTC offset",
+					 nErrors);
+
+	publishPosition(&positionTable, 0, 1, 1, 2, 3, 1525168830LL * 1000000000LL);
+	ASSERT_CONDITION(snapshotPositions(&positionTable, coordinates, 8) >= 1
+					 && coordinates[0].x == 1 && coordinates[0].z == 3
+					 && strcmp(coordinates[0].timestamp, "2018-05-01T10:00:30Z") == 0,
+					 "Converting a snapshot to GpsNedCoordinates",
+					 nErrors);
+
+	terminatePositionArrays(&snapshot);
+	terminatePositionTable(&positionTable);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - Batch RAW to NED conversion (against gpsRawCoordinates2gpsNedCoordinates()).
+ * 
+ * @return		The number of errors detected.
+ */
+int runTest_nedConverter()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	float maxError = 0;
+	float latitude[103], longitude[103], altitude[103], x[103], y[103], z[103];
+	GpsRawCoordinates origin, coordinates, inverse;
+	GpsNedCoordinates expected, converted;
+	NedConverter converter;
+
+	initializeGpsRawCoordinates(&origin, 41.178f, -8.596f, 100, time(NULL));
+	ASSERT_CONDITION(initializeNedConverter(&converter, &origin) == RETURN_VALUE_OK,
+					 "Initializing the NED converter",
+					 nErrors);
+	TEST_PRINT("NED converter instruction set: %s", getNedConverterInstructionSet());
+
+	// Users around the origin (an odd count, to convert a partial last block)
+	for (int i = 0; i < 103; i++)
+	{
+		latitude[i] = origin.latitude + (i % 11 - 5) * 0.0005f;
+		longitude[i] = origin.longitude + (i % 7 - 3) * 0.0007f;
+		altitude[i] = i;
+	}
+	convertGpsRawCoordinatesBatch(&converter, latitude, longitude, altitude, x, y, z, 103);
+
+	for (int i = 0; i < 103; i++)
+	{
+		initializeGpsRawCoordinates(&coordinates, latitude[i], longitude[i], altitude[i], time(NULL));
+		gpsRawCoordinates2gpsNedCoordinates(&expected, &coordinates, &origin);
+		maxError = fmaxf(maxError, fmaxf(fabsf(x[i] - expected.x), fmaxf(fabsf(y[i] - expected.y), fabsf(z[i] - expected.z))));
+	}
+
+	ASSERT_CONDITION(maxError < 0.01f,
+					 "Batch conversion within 1 cm of gpsRawCoordinates2gpsNedCoordinates()",
+					 nErrors);
+
+	ASSERT_CONDITION(convertGpsRawCoordinates(&converter, &converted, &coordinates) == RETURN_VALUE_OK
+					 && fabsf(converted.x - x[102]) < 0.001f && fabsf(converted.y - y[102]) < 0.001f
+					 && fabsf(converted.z - z[102]) < 0.001f && strcmp(converted.timestamp, coordinates.timestamp) == 0,
+					 "Converting one set of coordinates",
+					 nErrors);
+
+	// x north, y east, z up: 0.001 degrees of latitude are about 111 m
+	initializeGpsRawCoordinates(&coordinates, origin.latitude + 0.001f, origin.longitude, origin.altitude + 10, time(NULL));
+	convertGpsRawCoordinates(&converter, &converted, &coordinates);
+	ASSERT_CONDITION(fabsf(converted.x - 111.1f) < 0.5f && fabsf(converted.y) < 0.01f && fabsf(converted.z - 10) < 0.01f,
+					 "NED coordinates point north, east and up",
+					 nErrors);
+
+	// NED back to RAW (e.g. a waypoint)
+	ASSERT_CONDITION(convertGpsNedCoordinates(&converter, &inverse, &converted) == RETURN_VALUE_OK
+					 && fabsf(inverse.latitude - coordinates.latitude) < 1e-5f && fabsf(inverse.longitude - coordinates.longitude) < 1e-5f
+					 && fabsf(inverse.altitude - coordinates.altitude) < 0.01f && strcmp(inverse.timestamp, converted.timestamp) == 0,
+					 "Converting NED coordinates back to RAW",
+					 nErrors);
+	ASSERT_CONDITION(gpsNedCoordinates2gpsRawCoordinates(&inverse, &converted, &origin) == RETURN_VALUE_OK
+					 && fabsf(inverse.latitude - coordinates.latitude) < 1e-5f && fabsf(inverse.longitude - coordinates.longitude) < 1e-5f
+					 && fabsf(inverse.altitude - coordinates.altitude) < 0.01f,
+					 "gpsNedCoordinates2gpsRawCoordinates() inverts gpsRawCoordinates2gpsNedCoordinates()",
+					 nErrors);
+
+	// Far from the origin
+	initializeGpsRawCoordinates(&coordinates, -33.9f, 151.2f, 0, time(NULL));
+	gpsRawCoordinates2gpsNedCoordinates(&expected, &coordinates, &origin);
+	ASSERT_CONDITION(convertGpsRawCoordinates(&converter, &converted, &coordinates) == RETURN_VALUE_OK
+					 && fabsf(converted.x - expected.x) < 4 && fabsf(converted.y - expected.y) < 4 && fabsf(converted.z - expected.z) < 4,
+					 "Converting coordinates far from the origin",
+					 nErrors);
+
+	// Origin frame invalidation
+	ASSERT_CONDITION(setNedConverterOrigin(&converter, &origin) == 0 && converter.generation == 0,
+					 "Setting the same origin keeps the origin frame",
+					 nErrors);
+	ASSERT_CONDITION(setNedConverterOrigin(&converter, &coordinates) == 1 && converter.generation == 1
+					 && convertGpsRawCoordinates(&converter, &converted, &coordinates) == RETURN_VALUE_OK
+					 && fabsf(converted.x) < 0.01f && fabsf(converted.y) < 0.01f && fabsf(converted.z) < 0.01f,
+					 "Setting a new origin rebuilds the origin frame",
+					 nErrors);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Nanoseconds elapsed since a start time.
+ */
+double elapsedNs(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+/**
+ * Test - WGS-84 geodesy (ECEF, NED and back; error versus throughput).
+ * 
+ * @return		The number of errors detected.
+ */
+int runTest_geodesy()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	double maxError = 0, maxFastError = 0, accurateNs, fastNs, sum = 0;
+	GeodeticCoordinates origin = {41.178, -8.596, 100}, geodetic, back;
+	EcefCoordinates ecef;
+	LocalNedCoordinates ned, accurate, fast;
+	GeodesyFrame frame;
+	struct timespec start;
+
+	geodetic = (GeodeticCoordinates) {0, 0, 0};
+	ASSERT_CONDITION(geodeticToEcef(&geodetic, &ecef) == RETURN_VALUE_OK
+					 && fabs(ecef.x - WGS84_SEMI_MAJOR_AXIS) < 1e-6 && fabs(ecef.y) < 1e-6 && fabs(ecef.z) < 1e-6,
+					 "Equator to ECEF",
+					 nErrors);
+	geodetic = (GeodeticCoordinates) {90, 0, 0};
+	ASSERT_CONDITION(geodeticToEcef(&geodetic, &ecef) == RETURN_VALUE_OK
+					 && fabs(ecef.z - 6356752.314245) < 1e-3
+					 && ecefToGeodetic(&ecef, &back) == RETURN_VALUE_OK && back.latitude == 90 && fabs(back.altitude) < 1e-3,
+					 "North pole to ECEF and back",
+					 nErrors);
+
+	ASSERT_CONDITION(initializeGeodesyFrame(&frame, &origin) == RETURN_VALUE_OK,
+					 "Initializing the NED frame",
+					 nErrors);
+
+	// 1 km north of the origin (the Earth curves about 8 cm away from the tangent plane)
+	ned = (LocalNedCoordinates) {1000, 0, 0};
+	ASSERT_CONDITION(nedToGeodetic(&frame, &ned, &geodetic) == RETURN_VALUE_OK
+					 && geodetic.latitude > origin.latitude && fabs(geodetic.longitude - origin.longitude) < 1e-9
+					 && fabs(geodetic.altitude - origin.altitude - 0.078) < 0.01,
+					 "NED to geodetic",
+					 nErrors);
+
+	// Round trips from the origin to ~5000 km away and 20 km up
+	for (int i = 0; i < 10000; i++)
+	{
+		double scale = pow(10, i % 7);
+
+		ned.north = (i % 13 - 6) * scale * 0.8;
+		ned.east = (i % 17 - 8) * scale * 0.6;
+		ned.down = -(i % 20) * 1000.0;
+
+		nedToGeodetic(&frame, &ned, &geodetic);
+		geodeticToNed(&frame, &geodetic, &accurate);
+		geodeticToNedFast(&frame, &geodetic, &fast);
+
+		maxError = fmax(maxError, fmax(fabs(accurate.north - ned.north), fmax(fabs(accurate.east - ned.east), fabs(accurate.down - ned.down))));
+		maxFastError = fmax(maxFastError, fmax(fabs(fast.north - accurate.north), fmax(fabs(fast.east - accurate.east), fabs(fast.down - accurate.down))));
+	}
+
+	ASSERT_CONDITION(maxError < 1e-6,
+					 "NED to geodetic and back within a micrometer",
+					 nErrors);
+	ASSERT_CONDITION(maxFastError < 1e-6,
+					 "Fast conversion within a micrometer of the accurate one",
+					 nErrors);
+
+	// Throughput (points around the origin)
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < 100000; i++)
+	{
+		geodetic = (GeodeticCoordinates) {origin.latitude + (i % 100) * 1e-5, origin.longitude + (i % 77) * 1e-5, i % 50};
+		geodeticToNed(&frame, &geodetic, &ned);
+		sum += ned.north;
+	}
+	accurateNs = elapsedNs(&start) / 100000;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < 100000; i++)
+	{
+		geodetic = (GeodeticCoordinates) {origin.latitude + (i % 100) * 1e-5, origin.longitude + (i % 77) * 1e-5, i % 50};
+		geodeticToNedFast(&frame, &geodetic, &ned);
+		sum -= ned.north;
+	}
+	fastNs = elapsedNs(&start) / 100000;
+
+	TEST_PRINT("Geodetic to NED: accurate %.1f ns/point, fast %.1f ns/point (max difference %.2e m, checksum %.3f)",
+			   accurateNs, fastNs, maxFastError, sum);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - Spatial index (queries against a scan of every user, while users move).
+ * 
+ * @return		The number of errors detected.
+ */
+int runTest_spatialIndex()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	int nMismatches = 0;
+	int slots[1000], nearest[10];
+	float x[1000], y[1000], z[1000], distances[10];
+	int indexed[1000] = {0};
+	SpatialIndex spatialIndex;
+
+	ASSERT_CONDITION(initializeSpatialIndex(&spatialIndex, 1000, SPATIAL_INDEX_CELL_SIZE) == RETURN_VALUE_OK,
+					 "Initializing the spatial index",
+					 nErrors);
+
+	srand(1);
+	for (int round = 0; round < 50; round++)
+	{
+		float qx = rand() % 800 - 400, qy = rand() % 800 - 400, radius = rand() % 300;
+		int expected = 0, expectedOutside = 0, n;
+
+		// Move (or remove) some users
+		for (int i = 0; i < 200; i++)
+		{
+			int slot = rand() % 1000;
+
+			if (rand() % 10 == 0)
+			{
+				removeSpatialIndex(&spatialIndex, slot);
+				indexed[slot] = 0;
+				continue;
+			}
+			x[slot] = rand() % 1200 - 600;
+			y[slot] = rand() % 1200 - 600;
+			z[slot] = rand() % 100;
+			updateSpatialIndex(&spatialIndex, slot, x[slot], y[slot], z[slot]);
+			indexed[slot] = 1;
+		}
+
+		for (int slot = 0; slot < 1000; slot++)
+		{
+			float d = sqrtf((x[slot] - qx) * (x[slot] - qx) + (y[slot] - qy) * (y[slot] - qy) + z[slot] * z[slot]);
+
+			if (indexed[slot])
+			{
+				expected += (d <= radius);
+				expectedOutside += (d > radius);
+			}
+		}
+
+		n = findUsersWithinRadius(&spatialIndex, qx, qy, 0, radius, slots, 1000);
+		for (int i = 0; i < n; i++)
+			nMismatches += !indexed[slots[i]];
+		nMismatches += (n != expected);
+
+		n = findUsersOutsideRadius(&spatialIndex, qx, qy, 0, radius, slots, 1000);
+		for (int i = 0; i < n; i++)
+			nMismatches += !indexed[slots[i]];
+		nMismatches += (n != expectedOutside);
+
+		// No indexed user nearer than the farthest of the 10 nearest, except those
+		n = findNearestUsers(&spatialIndex, qx, qy, 0, 10, nearest, distances);
+		nMismatches += (n != 10);
+		for (int slot = 0; slot < 1000 && n == 10; slot++)
+		{
+			float d = sqrtf((x[slot] - qx) * (x[slot] - qx) + (y[slot] - qy) * (y[slot] - qy) + z[slot] * z[slot]);
+			int listed = 0;
+
+			for (int i = 0; i < n; i++)
+				listed |= (nearest[i] == slot);
+			if (indexed[slot] && !listed && d < distances[9])
+				nMismatches++;
+		}
+	}
+
+	ASSERT_CONDITION(nMismatches == 0,
+					 "Range, out of range and nearest-user queries",
+					 nErrors);
+
+	terminateSpatialIndex(&spatialIndex);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - FAP placement (minimum enclosing circle against the diametral circles
+ * of every pair of points; altitude model; hysteresis; refresh cost).
+ * 
+ * @return		The number of errors detected.
+ */
+int runTest_fapPlacement()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	int nMismatches = 0;
+	float x[24], y[24], z[24] = {0}, cx, cy, r;
+	FapPlacement placement;
+
+	ASSERT_CONDITION(initializeFapPlacement(&placement, 24, FAP_PLACEMENT_HYSTERESIS_METERS, 0) == RETURN_VALUE_OK,
+					 "Initializing the FAP placement",
+					 nErrors);
+
+	srand(2);
+	for (int round = 0; round < 20; round++)
+	{
+		float best = INFINITY;
+
+		for (int i = 0; i < 24; i++)
+		{
+			x[i] = rand() % 600 - 300;
+			y[i] = rand() % 600 - 300;
+		}
+		computeEnclosingCircle(&placement, x, y, 24, &cx, &cy, &r);
+
+		// Every point inside
+		for (int i = 0; i < 24; i++)
+			nMismatches += (hypotf(x[i] - cx, y[i] - cy) > r + 0.01f);
+
+		// No smaller circle (through 2 points, diametral) encloses them all
+		for (int i = 0; i < 24; i++)
+		{
+			for (int j = i + 1; j < 24; j++)
+			{
+				float mx = (x[i] + x[j]) / 2, my = (y[i] + y[j]) / 2, mr = hypotf(x[i] - x[j], y[i] - y[j]) / 2;
+				int all = 1;
+
+				for (int k = 0; k < 24 && all; k++)
+					all = (hypotf(x[k] - mx, y[k] - my) <= mr + 0.01f);
+				if (all && mr < best)
+					best = mr;
+			}
+		}
+		nMismatches += (best < r - 0.01f);
+	}
+
+	ASSERT_CONDITION(nMismatches == 0,
+					 "Minimum enclosing circle",
+					 nErrors);
+
+	// Square of side 200: circle of radius 100*sqrt(2) centered at (100,100)
+	float sx[4] = {0, 200, 200, 0}, sy[4] = {0, 0, 200, 200};
+	ASSERT_CONDITION(updateFapPlacement(&placement, sx, sy, z, 4) == 1
+					 && fabsf(placement.target.x - 100) < 0.01f && fabsf(placement.target.y - 100) < 0.01f
+					 && fabsf(placement.target.z - computePlacementHeight(placement.radius)) < 0.01f
+					 && fabsf(placement.radius - 141.42f) < 0.01f,
+					 "Placing the FAP over the users",
+					 nErrors);
+
+	// Within the hysteresis: no new target; beyond: new target
+	sx[0] = 5;
+	ASSERT_CONDITION(updateFapPlacement(&placement, sx, sy, z, 4) == 0,
+					 "Keeping the target within the hysteresis",
+					 nErrors);
+	for (int i = 0; i < 4; i++)
+		sx[i] += 50;
+	ASSERT_CONDITION(updateFapPlacement(&placement, sx, sy, z, 4) == 1 && placement.target.x > 140,
+					 "Moving the target beyond the hysteresis",
+					 nErrors);
+
+	ASSERT_CONDITION(computePlacementHeight(0) == FAP_PLACEMENT_MIN_HEIGHT && computePlacementHeight(1e6) == FAP_PLACEMENT_MAX_HEIGHT,
+					 "Altitude model limits",
+					 nErrors);
+
+	terminateFapPlacement(&placement);
+
+	// Incremental: the circle and centroid kept user by user match the ones recomputed from scratch
+	FapPlacement reference;
+	SpatialIndex index;
+	float centroidX, centroidY, centroidZ;
+	double sumX, sumY, sumZ;
+	double refreshNs[2] = {0};
+	int rebuilds = 0;
+	double loopNs;
+	struct timespec start, loopStart;
+
+	initializeSpatialIndex(&index, 64, SPATIAL_INDEX_CELL_SIZE);
+	initializeFapPlacement(&placement, 64, FAP_PLACEMENT_HYSTERESIS_METERS, 0);
+	initializeFapPlacement(&reference, 64, FAP_PLACEMENT_HYSTERESIS_METERS, 0);
+
+	nMismatches = 0;
+	srand(3);
+	for (int i = 0; i < 5000; i++)
+	{
+		int slot = rand() % 64;
+
+		if (rand() % 8 == 0)
+			removeSpatialIndex(&index, slot);
+		else
+			updateSpatialIndex(&index, slot, rand() % 600 - 300, rand() % 600 - 300, -(rand() % 10));
+		refreshFapPlacement(&placement, &index, slot);
+
+		if (index.count == 0)
+			continue;
+
+		computeEnclosingCircle(&reference, index.x, index.y, index.count, &cx, &cy, &r);
+		nMismatches += (fabs(placement.centerX - cx) > 0.01 || fabs(placement.centerY - cy) > 0.01 || fabs(placement.radius - r) > 0.01);
+
+		sumX = sumY = sumZ = 0;
+		for (size_t j = 0; j < index.count; j++)
+		{
+			sumX += index.x[j];
+			sumY += index.y[j];
+			sumZ += index.z[j];
+		}
+		getSpatialIndexCentroid(&index, &centroidX, &centroidY, &centroidZ);
+		nMismatches += (fabs(centroidX - sumX / index.count) > 0.01 || fabs(centroidY - sumY / index.count) > 0.01
+						|| fabs(centroidZ - sumZ / index.count) > 0.01);
+	}
+
+	ASSERT_CONDITION(nMismatches == 0,
+					 "Refreshing the placement user by user",
+					 nErrors);
+
+	terminateFapPlacement(&placement);
+	terminateFapPlacement(&reference);
+	terminateSpatialIndex(&index);
+
+	// Refresh cost with 10k users: moves within the circle keep it, while moves of its
+	// support users (or out of it) rebuild it in O(n)
+	initializeSpatialIndex(&index, 10000, SPATIAL_INDEX_CELL_SIZE);
+	initializeFapPlacement(&placement, 10000, FAP_PLACEMENT_HYSTERESIS_METERS, 0);
+	initializeFapPlacement(&reference, 10000, FAP_PLACEMENT_HYSTERESIS_METERS, 0);
+	for (int slot = 0; slot < 10000; slot++)
+		updateSpatialIndex(&index, slot, rand() % 600 - 300, rand() % 600 - 300, 0);
+	refreshFapPlacement(&placement, &index, 0);
+
+	for (int i = 0; i < 20000; i++)
+	{
+		int slot = rand() % 10000;
+		int support = (i % 100 == 0);
+
+		// One move in a hundred is a support user's
+		if (support)
+			slot = placement.support[0];
+
+		updateSpatialIndex(&index, slot, rand() % 600 - 300, rand() % 600 - 300, 0);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		refreshFapPlacement(&placement, &index, slot);
+		refreshNs[support] += elapsedNs(&start);
+		rebuilds += support;
+	}
+	TEST_PRINT("Refresh with 10000 users: %.0f ns per move of another user, %.0f ns per move of a support user (%d of %d moves)",
+			   refreshNs[0] / (20000 - rebuilds), refreshNs[1] / rebuilds, rebuilds, 20000);
+
+	computeEnclosingCircle(&reference, index.x, index.y, index.count, &cx, &cy, &r);
+	ASSERT_CONDITION(fabs(placement.centerX - cx) < 0.01 && fabs(placement.centerY - cy) < 0.01 && fabs(placement.radius - r) < 0.01,
+					 "Refreshing the placement of 10000 users",
+					 nErrors);
+
+	terminateFapPlacement(&placement);
+
+	// Worst case: a support user jittering within the hysteresis on every move is only rebuilt once per period,
+	// while the circle stays within the hysteresis of the exact one
+	initializeFapPlacement(&placement, 10000, FAP_PLACEMENT_HYSTERESIS_METERS, FAP_PLACEMENT_REBUILD_PERIOD_MS);
+	refreshFapPlacement(&placement, &index, 0);
+	placement.rebuilds = 0;
+	refreshNs[0] = 0;
+	nMismatches = 0;
+	clock_gettime(CLOCK_MONOTONIC, &loopStart);
+
+	for (int i = 0; i < 20000; i++)
+	{
+		int slot = placement.support[0];
+
+		updateSpatialIndex(&index, slot, placement.supportX[0] + rand() % 7 - 3, placement.supportY[0] + rand() % 7 - 3, 0);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		refreshFapPlacement(&placement, &index, slot);
+		refreshNs[0] += elapsedNs(&start);
+
+		if (i % 1000 == 0)
+		{
+			computeEnclosingCircle(&reference, index.x, index.y, index.count, &cx, &cy, &r);
+			nMismatches += (hypot(placement.centerX - cx, placement.centerY - cy) >= FAP_PLACEMENT_HYSTERESIS_METERS
+							|| fabs(placement.radius - r) >= FAP_PLACEMENT_HYSTERESIS_METERS);
+		}
+	}
+	loopNs = elapsedNs(&loopStart);
+	TEST_PRINT("Support user moving on every move: %.0f ns per move, %zu rebuilds in %d moves (%.0f ms)",
+			   refreshNs[0] / 20000, placement.rebuilds, 20000, loopNs / 1e6);
+
+	ASSERT_CONDITION(nMismatches == 0 && placement.rebuilds <= 1 + loopNs / (FAP_PLACEMENT_REBUILD_PERIOD_MS * 1e6),
+					 "Throttling the rebuilds of a jittering support user",
+					 nErrors);
+
+	// Once the period is over, the next move rebuilds the exact circle
+	usleep(FAP_PLACEMENT_REBUILD_PERIOD_MS * 1000);
+	updateSpatialIndex(&index, 0, index.x[index.entries[0].position], index.y[index.entries[0].position], 0);
+	refreshFapPlacement(&placement, &index, 0);
+	computeEnclosingCircle(&reference, index.x, index.y, index.count, &cx, &cy, &r);
+	ASSERT_CONDITION(fabs(placement.centerX - cx) < 0.01 && fabs(placement.centerY - cy) < 0.01 && fabs(placement.radius - r) < 0.01,
+					 "Rebuilding a deferred circle after the period",
+					 nErrors);
+
+	terminateFapPlacement(&placement);
+	terminateFapPlacement(&reference);
+	terminateSpatialIndex(&index);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - Multi-FAP coordinator (clustering correctness and throughput).
+ * 
+ * @return		The number of errors detected.
+ */
+int runTest_fapCoordinator()
+{
+	PRINT_TEST_HEADER();
+
+	const int nUsers = 20000, nFaps = 8;
+	int nErrors = 0;
+	int nMismatches = 0;
+	int iterations[2];
+	double clusterNs[2];
+	float *x = malloc(nUsers * sizeof(float)), *y = malloc(nUsers * sizeof(float)), *z = calloc(nUsers, sizeof(float));
+	float centerX[FAP_COORDINATOR_MAX_THREADS], centerY[FAP_COORDINATOR_MAX_THREADS];
+	GpsRawCoordinates origin;
+	FapCoordinator coordinator;
+	struct timespec start;
+
+	initializeGpsRawCoordinates(&origin, 41.178, -8.596, 0, time(NULL));
+
+	// Users gathered around 8 spots, 1 km apart
+	srand(4);
+	for (int i = 0; i < nUsers; i++)
+	{
+		x[i] = (i % nFaps / 4) * 1000 + rand() % 200 - 100;
+		y[i] = (i % 4) * 1000 + rand() % 200 - 100;
+	}
+
+	// Single thread, then parallel: the same clusters
+	for (int run = 0; run < 2; run++)
+	{
+		ASSERT_CONDITION(initializeFapCoordinator(&coordinator, nFaps, nUsers, run ? 4 : 1, &origin) == RETURN_VALUE_OK,
+						 "Initializing the FAP coordinator",
+						 nErrors);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		iterations[run] = clusterUsers(&coordinator, x, y, nUsers);
+		clusterNs[run] = elapsedNs(&start);
+
+		for (int c = 0; c < nFaps; c++)
+		{
+			if (run == 0)
+			{
+				centerX[c] = coordinator.centerX[c];
+				centerY[c] = coordinator.centerY[c];
+			}
+			else
+				nMismatches += (fabsf(centerX[c] - coordinator.centerX[c]) > 0.01f || fabsf(centerY[c] - coordinator.centerY[c]) > 0.01f);
+		}
+
+		// Every user in its spot's cluster, with the spot's users
+		for (int i = 0; i < nUsers; i++)
+			nMismatches += (coordinator.assignment[i] != coordinator.assignment[i % nFaps]);
+		for (int c = 0; c < nFaps; c++)
+			nMismatches += (hypotf(coordinator.centerX[c] - roundf(coordinator.centerX[c] / 1000) * 1000,
+								   coordinator.centerY[c] - roundf(coordinator.centerY[c] / 1000) * 1000) > 10);
+
+		if (run == 0)
+			terminateFapCoordinator(&coordinator);
+	}
+
+	ASSERT_CONDITION(nMismatches == 0,
+					 "Clustering the users around their spots",
+					 nErrors);
+
+	TEST_PRINT("Clustering %d users for %d FAPs: %.2f ms (1 thread, %d iterations), %.2f ms (4 threads, %d iterations)",
+			   nUsers, nFaps, clusterNs[0] / 1e6, iterations[0], clusterNs[1] / 1e6, iterations[1]);
+
+	// Every FAP moved once over its spot; then kept within the hysteresis
+	ASSERT_CONDITION(updateFapCoordinator(&coordinator, x, y, z, nUsers) == nFaps,
+					 "Moving every FAP over its users",
+					 nErrors);
+	for (int f = 0; f < nFaps; f++)
+	{
+		nMismatches += (hypotf(coordinator.faps[f].gpsNedCoordinates.x - coordinator.centerX[f],
+							   coordinator.faps[f].gpsNedCoordinates.y - coordinator.centerY[f]) > 10);
+	}
+	x[0] += 1;
+	ASSERT_CONDITION(nMismatches == 0 && updateFapCoordinator(&coordinator, x, y, z, nUsers) == 0,
+					 "Keeping the FAPs within the hysteresis",
+					 nErrors);
+
+	terminateFapCoordinator(&coordinator);
+	free(x);
+	free(y);
+	free(z);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - Trajectory predictor (tracking, batches and throughput).
+ * 
+ * @return		The number of errors detected.
+ */
+int runTest_trajectoryPredictor()
+{
+	PRINT_TEST_HEADER();
+
+	const int nUsers = 1000;
+	const int64_t period = GPS_COORDINATES_UPDATE_PERIOD_SECONDS * 1000000000LL;
+	int nErrors = 0;
+	int nMismatches = 0;
+	int slots[3] = {0, 0, 0}, *batchSlots = malloc(nUsers * sizeof(int));
+	float x[3], y[3], z[3], px, py, pz, qx, qy, qz, *bx = malloc(nUsers * sizeof(float)), *by = malloc(nUsers * sizeof(float));
+	int64_t epochNs[3], *batchEpochNs = malloc(nUsers * sizeof(int64_t)), t = 1500000000LL * 1000000000LL;
+	double updateNs;
+	TrajectoryPredictor predictor, sequential;
+	struct timespec start;
+
+	ASSERT_CONDITION(initializeTrajectoryPredictor(&predictor, nUsers, TRAJECTORY_ACCELERATION_NOISE, TRAJECTORY_MEASUREMENT_NOISE) == RETURN_VALUE_OK
+					 && initializeTrajectoryPredictor(&sequential, nUsers, TRAJECTORY_ACCELERATION_NOISE, TRAJECTORY_MEASUREMENT_NOISE) == RETURN_VALUE_OK,
+					 "Initializing the trajectory predictor",
+					 nErrors);
+
+	ASSERT_CONDITION(predictPosition(&predictor, 0, t, &px, &py, &pz) == RETURN_VALUE_ERROR,
+					 "No prediction without a track",
+					 nErrors);
+
+	// A user walking at (1.5, -1) m/s, GPS errors up to 2 m: predicted 10 s ahead within 5 m (18 m away from the last position)
+	srand(5);
+	for (int i = 0; i < 15; i++)
+	{
+		x[0] = 1.5f * i * 10 + (rand() % 400 - 200) / 100.0f;
+		y[0] = -1.0f * i * 10 + (rand() % 400 - 200) / 100.0f;
+		z[0] = -2;
+		epochNs[0] = t + i * period;
+		updateTrajectories(&predictor, slots, x, y, z, epochNs, 1);
+	}
+	predictPosition(&predictor, 0, t + 15 * period, &px, &py, &pz);
+	ASSERT_CONDITION(hypotf(px - 1.5f * 150, py + 1.0f * 150) < 5 && fabsf(pz + 2) < 0.5f,
+					 "Extrapolating a constant velocity",
+					 nErrors);
+	ASSERT_CONDITION(estimateSpeed(&predictor, 0, &qx) == RETURN_VALUE_OK && qx > hypotf(1.5f, 1.0f) && qx < 3,
+					 "Estimating the speed",
+					 nErrors);
+
+	// A stale track restarts at the new position
+	x[0] = y[0] = z[0] = 7;
+	epochNs[0] = t + 15 * period + (TRAJECTORY_RESET_SECONDS + 1) * 1000000000LL;
+	updateTrajectories(&predictor, slots, x, y, z, epochNs, 1);
+	predictPosition(&predictor, 0, epochNs[0] + period, &px, &py, &pz);
+	ASSERT_CONDITION(px == 7 && py == 7 && pz == 7,
+					 "Restarting a stale track",
+					 nErrors);
+	ASSERT_CONDITION(estimateSpeed(&predictor, 0, &qx) == RETURN_VALUE_OK && qx > 3,
+					 "A new track is not taken as standing still",
+					 nErrors);
+
+	// A batch (with a slot three times) updates as the positions one by one
+	for (int i = 0; i < 3; i++)
+	{
+		x[i] = 10 + 3 * i;
+		y[i] = 20 - 2 * i;
+		z[i] = 0;
+		epochNs[i] = t + (i + 1) * period;
+		slots[i] = 5;
+	}
+	updateTrajectories(&predictor, slots, x, y, z, epochNs, 3);
+	for (int i = 0; i < 3; i++)
+		updateTrajectories(&sequential, &slots[i], &x[i], &y[i], &z[i], &epochNs[i], 1);
+	predictPosition(&predictor, 5, t + 4 * period, &px, &py, &pz);
+	predictPosition(&sequential, 5, t + 4 * period, &qx, &qy, &qz);
+	ASSERT_CONDITION(px == qx && py == qy && pz == qz,
+					 "Batch of updates equal to one by one",
+					 nErrors);
+
+	// Throughput: every user, batch after batch
+	for (int i = 0; i < nUsers; i++)
+	{
+		batchSlots[i] = i;
+		bx[i] = rand() % 600 - 300;
+		by[i] = rand() % 600 - 300;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < 100; round++)
+	{
+		for (int i = 0; i < nUsers; i++)
+		{
+			bx[i] += 0.5f;
+			batchEpochNs[i] = t + round * period;
+		}
+		updateTrajectories(&sequential, batchSlots, bx, by, by, batchEpochNs, nUsers);
+	}
+	updateNs = elapsedNs(&start) / (100 * nUsers);
+
+	for (int i = 0; i < nUsers; i++)
+	{
+		predictPosition(&sequential, i, t + 100 * period, &px, &py, &pz);
+		nMismatches += (fabsf(px - (bx[i] + 0.5f)) > 0.5f || fabsf(py - by[i]) > 0.5f);
+	}
+	ASSERT_CONDITION(nMismatches == 0,
+					 "Tracking every user of the batches",
+					 nErrors);
+
+	TEST_PRINT("Trajectory filters: %.1f ns/update", updateNs);
+
+	terminateTrajectoryPredictor(&predictor);
+	terminateTrajectoryPredictor(&sequential);
+	free(batchSlots);
+	free(bx);
+	free(by);
+	free(batchEpochNs);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Producer of runTest_logger(): logs 10000 numbered messages.
+ */
+void *loggerProducer(void *arg)
+{
+	for (int i = 0; i < 10000; i++)
+		LOGGER_INFO("Test", "Producer %d: message %d", *(int *) arg, i);
+
+	return NULL;
+}
+
+/**
+ * Test - Asynchronous logger (to a file, from several threads, never blocking).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_logger()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	int ids[4] = {0, 1, 2, 3}, evaluated = 0, lines = 0;
+	char path[] = "/tmp/Test_FapManagementProtocol_Server_XXXXXX", line[LOGGER_MESSAGE_SIZE + 128];
+	int fd = mkstemp(path);
+	unsigned long dropped;
+	pthread_t producers[4];
+	FILE *file;
+
+	close(fd);
+	ASSERT_CONDITION(initializeLogger(path, 1024) == RETURN_VALUE_OK && initializeLogger(path, 1024) == RETURN_VALUE_ERROR,
+					 "Starting the logger",
+					 nErrors);
+
+	// Debug messages are compiled out: their arguments aren't even evaluated
+	LOGGER_DEBUG("Test", "Not logged %d", ++evaluated);
+	ASSERT_CONDITION(evaluated == 0,
+					 "Compiling out the debug messages",
+					 nErrors);
+
+	for (int i = 0; i < 4; i++)
+		pthread_create(&producers[i], NULL, loggerProducer, &ids[i]);
+	for (int i = 0; i < 4; i++)
+		pthread_join(producers[i], NULL);
+	dropped = getLoggerDropped();
+	terminateLogger();
+
+	// Every message not dropped (when the ring was full) was written, whole
+	file = fopen(path, "r");
+	while (file != NULL && fgets(line, sizeof(line), file) != NULL)
+		lines += (strstr(line, " INFO    >> Test::loggerProducer(): Producer ") != NULL && line[strlen(line) - 1] == '\n');
+	if (file != NULL)
+		fclose(file);
+	unlink(path);
+
+	ASSERT_CONDITION(lines + dropped == 40000,
+					 "Writing every message (or counting it as dropped)",
+					 nErrors);
+
+	TEST_PRINT("Logger: %d messages written, %lu dropped (ring of 1024)", lines, dropped);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - Event log (records read back in order, across chunks).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_eventLog()
+{
+	PRINT_TEST_HEADER();
+
+	const int nRecords = 50000;
+	int nErrors = 0, n = 0, inOrder = 1;
+	char path[] = "/tmp/Test_FapManagementProtocol_Server_XXXXXX";
+	const char message[] = "{\"msgType\": 6, \"userId\": 1}";
+	float target[3] = {15, 20, 10};
+	int64_t previousNs = 0;
+	struct timespec start, end;
+	EventLog log;
+	EventLogReader reader;
+	EventLogRecord record;
+
+	close(mkstemp(path));
+	ASSERT_CONDITION(openEventLog(&log, path) == RETURN_VALUE_OK,
+					 "Opening the event log",
+					 nErrors);
+
+	// Enough messages to fill a few chunks, then one record of each other type
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < nRecords; i++)
+		appendEventLog(&log, EVENT_LOG_PROTOCOL_MESSAGE, 6, i % 8, i, message, sizeof(message) - 1);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	appendEventLog(&log, EVENT_LOG_MAVLINK_COMMAND, 84, -1, -1, target, sizeof(target));
+	appendEventLog(&log, EVENT_LOG_EVICTION, EVENT_LOG_EVICTION_TIMEOUT, 3, 7, NULL, 0);
+	appendEventLog(&log, EVENT_LOG_CONNECTION_CLOSED, 0, 3, 7, NULL, 0);
+	ASSERT_CONDITION(log.records == nRecords + 3 && log.chunkOffset > 0,
+					 "Appending records across chunks",
+					 nErrors);
+	ASSERT_CONDITION(closeEventLog(&log) == RETURN_VALUE_OK,
+					 "Closing the event log",
+					 nErrors);
+
+	// Read back, in order, with non-decreasing timestamps
+	ASSERT_CONDITION(openEventLogReader(&reader, path) == RETURN_VALUE_OK,
+					 "Opening the event log for reading",
+					 nErrors);
+
+	while (reader.map != NULL && readEventLog(&reader, &record) == RETURN_VALUE_OK)
+	{
+		inOrder &= (record.header.monotonicNs >= previousNs);
+		previousNs = record.header.monotonicNs;
+
+		if (n < nRecords)
+			inOrder &= (record.header.type == EVENT_LOG_PROTOCOL_MESSAGE && record.header.userId == n
+						&& record.header.payloadLength == sizeof(message) - 1
+						&& memcmp(record.payload, message, sizeof(message) - 1) == 0);
+		else if (n == nRecords)
+			inOrder &= (record.header.type == EVENT_LOG_MAVLINK_COMMAND && memcmp(record.payload, target, sizeof(target)) == 0);
+		else if (n == nRecords + 1)
+			inOrder &= (record.header.type == EVENT_LOG_EVICTION && record.header.code == EVENT_LOG_EVICTION_TIMEOUT);
+		else
+			inOrder &= (record.header.type == EVENT_LOG_CONNECTION_CLOSED && record.header.connectionId == 3);
+		n++;
+	}
+	closeEventLogReader(&reader);
+	unlink(path);
+
+	ASSERT_CONDITION(n == nRecords + 3 && inOrder,
+					 "Reading every record back, in order",
+					 nErrors);
+
+	TEST_PRINT("Event log: %d appends, %.0f ns per append",
+			   nRecords, ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / nRecords);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+atomic_int telemetryCacheWriterRunning;
+
+/**
+ * Writer of runTest_telemetryCache(): publishes positions whose
+ * coordinates are all equal, until stopped.
+ */
+void *telemetryCacheWriter(void *arg)
+{
+	TelemetryCache *cache = arg;
+	GpsNedCoordinates gpsNedCoordinates;
+
+	for (int k = 1; atomic_load(&telemetryCacheWriterRunning); k++)
+	{
+		initializeGpsNedCoordinates(&gpsNedCoordinates, k, k, k, k);
+		publishLocalPositionNed(cache, &gpsNedCoordinates, k);
+	}
+
+	return NULL;
+}
+
+/**
+ * Test - Telemetry cache (consistent reads while the autopilot's position is published).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_telemetryCache()
+{
+	PRINT_TEST_HEADER();
+
+	const int nReads = 1000000;
+	int nErrors = 0;
+	int nTorn = 0;
+	int64_t receivedNs;
+	double readNs;
+	TelemetryCache cache;
+	GpsNedCoordinates gpsNedCoordinates;
+	struct timespec start;
+	pthread_t writer;
+
+	initializeTelemetryCache(&cache);
+	ASSERT_CONDITION(readLocalPositionNed(&cache, &gpsNedCoordinates, &receivedNs) == RETURN_VALUE_ERROR,
+					 "No position before one is published",
+					 nErrors);
+
+	atomic_store(&telemetryCacheWriterRunning, 1);
+	pthread_create(&writer, NULL, telemetryCacheWriter, &cache);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < nReads; i++)
+	{
+		if (readLocalPositionNed(&cache, &gpsNedCoordinates, &receivedNs) != RETURN_VALUE_OK)
+			continue;
+
+		if (gpsNedCoordinates.x != gpsNedCoordinates.y || gpsNedCoordinates.y != gpsNedCoordinates.z
+				|| (float) receivedNs != gpsNedCoordinates.x)
+			nTorn++;
+	}
+	readNs = elapsedNs(&start) / nReads;
+
+	// Stop the writer
+	atomic_store(&telemetryCacheWriterRunning, 0);
+	pthread_join(writer, NULL);
+
+	ASSERT_CONDITION(nTorn == 0,
+					 "Torn position read",
+					 nErrors);
+
+	TEST_PRINT("Telemetry cache: %.1f ns/read (while being written)", readNs);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Task of runTest_periodicScheduler(): counts its runs, taking some time.
+ */
+int countPeriodicRun(void *context)
+{
+	atomic_fetch_add((atomic_int *) context, 1);
+	usleep(2000);
+
+	return RETURN_VALUE_OK;
+}
+
+/**
+ * Task of runTest_periodicScheduler(): fails.
+ */
+int failPeriodicRun(void *context)
+{
+	return RETURN_VALUE_ERROR;
+}
+
+/**
+ * Test - Periodic scheduler (exact rates, without drift, from one thread).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_periodicScheduler()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	atomic_int fast, slow;
+	int fastTask, slowTask;
+	PeriodicScheduler scheduler;
+	PeriodicTaskStats fastStats, slowStats;
+
+	atomic_init(&fast, 0);
+	atomic_init(&slow, 0);
+	ASSERT_CONDITION(initializePeriodicScheduler(&scheduler) == RETURN_VALUE_OK
+					 && (fastTask = addPeriodicTask(&scheduler, 10000000, countPeriodicRun, &fast)) == 0
+					 && (slowTask = addPeriodicTask(&scheduler, 25000000, countPeriodicRun, &slow)) == 1
+					 && addPeriodicTask(&scheduler, 0, countPeriodicRun, &slow) == RETURN_VALUE_ERROR,
+					 "Adding periodic tasks",
+					 nErrors);
+
+	// 10 ms and 25 ms tasks (taking 2 ms each) for 505 ms: no drift from the time they take
+	startPeriodicScheduler(&scheduler);
+	usleep(505000);
+	ASSERT_CONDITION(stopPeriodicScheduler(&scheduler) == RETURN_VALUE_OK,
+					 "Stopping the scheduler",
+					 nErrors);
+	getPeriodicTaskStats(&scheduler, fastTask, &fastStats);
+	getPeriodicTaskStats(&scheduler, slowTask, &slowStats);
+	ASSERT_CONDITION(atomic_load(&fast) >= 48 && atomic_load(&fast) <= 51 && atomic_load(&slow) >= 19 && atomic_load(&slow) <= 21
+					 && fastStats.runs == (unsigned long) atomic_load(&fast) && slowStats.runs == (unsigned long) atomic_load(&slow),
+					 "Running the tasks at their rates",
+					 nErrors);
+
+	TEST_PRINT("Periodic tasks: %lu and %lu runs (lateness: mean %.0f us, max %.0f us; %lu overruns)",
+			   fastStats.runs, slowStats.runs, fastStats.meanLatenessNs / 1e3, fastStats.maxLatenessNs / 1e3,
+			   fastStats.overruns + slowStats.overruns);
+	terminatePeriodicScheduler(&scheduler);
+
+	// A failed task stops the scheduler
+	initializePeriodicScheduler(&scheduler);
+	addPeriodicTask(&scheduler, 1000000, failPeriodicRun, NULL);
+	startPeriodicScheduler(&scheduler);
+	usleep(20000);
+	ASSERT_CONDITION(!atomic_load(&scheduler.running) && stopPeriodicScheduler(&scheduler) == RETURN_VALUE_ERROR,
+					 "Stopping on a failed task",
+					 nErrors);
+	terminatePeriodicScheduler(&scheduler);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Counters of the MAVLink ingest test's subscribers.
+ */
+typedef struct _MavlinkIngestCounters
+{
+	int heartbeats;
+	int positions;
+	int messages;
+	double positionsSum;
+} MavlinkIngestCounters;
+
+/**
+ * Subscriber of the MAVLink ingest test (every message).
+ */
+void countMavlinkMessage(const mavlink_message_t *msg, void *context)
+{
+	((MavlinkIngestCounters *) context)->messages++;
+}
+
+/**
+ * Subscriber of the MAVLink ingest test (HEARTBEAT).
+ */
+void countMavlinkHeartbeat(const mavlink_message_t *msg, void *context)
+{
+	((MavlinkIngestCounters *) context)->heartbeats++;
+}
+
+/**
+ * Subscriber of the MAVLink ingest test (LOCAL_POSITION_NED).
+ */
+void countMavlinkPosition(const mavlink_message_t *msg, void *context)
+{
+	MavlinkIngestCounters *counters = context;
+
+	counters->positions++;
+	counters->positionsSum += mavlink_msg_local_position_ned_get_x(msg) + mavlink_msg_local_position_ned_get_vz(msg);
+}
+
+/**
+ * Test the MAVLink ingest pipeline, and compare its throughput with
+ * mavlink_parse_char() (byte by byte) on recorded telemetry.
+ */
+int runTest_mavlinkIngest()
+{
+	PRINT_TEST_HEADER();
+
+	const int nFrames = 100000;
+	int nErrors = 0;
+	uint8_t buffer[4 * MAVLINK_MAX_PACKET_LEN], *recording = malloc(nFrames * MAVLINK_MAX_PACKET_LEN);
+	size_t size = 0, recorded = 0;
+	mavlink_message_t msg;
+	mavlink_status_t status;
+	MavlinkIngestCounters counters = {0};
+	MavlinkIngest ingest;
+	int frames, parsed = 0;
+	double parsedSum = 0, ingestNs, parseCharNs;
+	struct timespec start;
+
+	initializeMavlinkIngest(&ingest);
+	subscribeMavlinkIngest(&ingest, MAVLINK_MSG_ID_HEARTBEAT, countMavlinkHeartbeat, &counters);
+	subscribeMavlinkIngest(&ingest, MAVLINK_MSG_ID_LOCAL_POSITION_NED, countMavlinkPosition, &counters);
+	subscribeMavlinkIngest(&ingest, MAVLINK_INGEST_ANY_MESSAGE, countMavlinkMessage, &counters);
+
+	// Garbage, a heartbeat, a corrupted position, a position with a trimmed payload, and a truncated heartbeat
+	buffer[size++] = 0x55;
+	buffer[size++] = MAVLINK_STX;
+	buffer[size++] = 0x00;
+	mavlink_msg_heartbeat_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_ARDUPILOTMEGA, 0, 0, MAV_STATE_ACTIVE);
+	size += mavlink_msg_to_send_buffer(buffer + size, &msg);
+	mavlink_msg_local_position_ned_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, 1000, 5, 6, 7, 8, 9, 10);
+	frames = mavlink_msg_to_send_buffer(buffer + size, &msg);
+	buffer[size + MAVLINK_NUM_HEADER_BYTES] ^= 0x01;
+	size += frames;
+	mavlink_msg_local_position_ned_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, 1000, 3, 0, 0, 0, 0, 0);
+	frames = mavlink_msg_to_send_buffer(buffer + size, &msg);
+	ASSERT_CONDITION(frames < MAVLINK_NUM_NON_PAYLOAD_BYTES + MAVLINK_MSG_ID_LOCAL_POSITION_NED_LEN,
+					 "Trimming the payload's trailing zeros",
+					 nErrors);
+	size += frames;
+	mavlink_msg_heartbeat_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_ARDUPILOTMEGA, 0, 0, MAV_STATE_ACTIVE);
+	size += mavlink_msg_to_send_buffer(buffer + size, &msg) - 3;
+
+	frames = parseMavlinkFrames(&ingest, buffer, size);
+	ASSERT_CONDITION(frames == 2 && ingest.frames == 2 && ingest.badCrc == 1,
+					 "Framing the valid frames (skipping garbage, corrupted and truncated frames)",
+					 nErrors);
+	ASSERT_CONDITION(counters.heartbeats == 1 && counters.positions == 1 && counters.messages == 2 && counters.positionsSum == 3,
+					 "Dispatching to the subscribers (zero-extending trimmed payloads)",
+					 nErrors);
+
+	// Recorded telemetry: a stream of heartbeats, positions and attitudes, with line noise
+	srand(21);
+	for (int i = 0; i < nFrames; i++)
+	{
+		switch (i % 4)
+		{
+		case 0:
+			mavlink_msg_heartbeat_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_ARDUPILOTMEGA, 0, 0, MAV_STATE_ACTIVE);
+			break;
+		case 1:
+			mavlink_msg_local_position_ned_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, i, rand() % 600 - 300, rand() % 600 - 300, -20,
+												(rand() % 100) / 10.0f, 0, rand() % 3);
+			break;
+		case 2:
+			mavlink_msg_global_position_int_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, i, 411000000 + rand() % 10000, -86000000 + rand() % 10000,
+												 100000, 20000, 0, 0, 0, 0);
+			break;
+		default:
+			mavlink_msg_attitude_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, i, (rand() % 100) / 100.0f, (rand() % 100) / 100.0f, 0, 0, 0, 0);
+			break;
+		}
+		recorded += mavlink_msg_to_send_buffer(recording + recorded, &msg);
+
+		// Noise between frames (never a start of frame)
+		if (i % 50 == 0)
+			recording[recorded++] = 0x20 + rand() % 0x80;
+	}
+
+	memset(&counters, 0, sizeof(counters));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	frames = parseMavlinkFrames(&ingest, recording, recorded);
+	ingestNs = elapsedNs(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t b = 0; b < recorded; b++)
+	{
+		if (mavlink_parse_char(MAVLINK_COMM_2, recording[b], &msg, &status) != MAVLINK_FRAMING_OK)
+			continue;
+
+		parsed++;
+		if (msg.msgid == MAVLINK_MSG_ID_LOCAL_POSITION_NED)
+			parsedSum += mavlink_msg_local_position_ned_get_x(&msg) + mavlink_msg_local_position_ned_get_vz(&msg);
+	}
+	parseCharNs = elapsedNs(&start);
+
+	ASSERT_CONDITION(frames == nFrames && parsed == nFrames && counters.messages == nFrames
+					 && counters.positions == nFrames / 4 && counters.positionsSum == parsedSum,
+					 "Framing the recorded telemetry as mavlink_parse_char()",
+					 nErrors);
+
+	TEST_PRINT("MAVLink ingest: %.2f Mframes/s (mavlink_parse_char: %.2f Mframes/s, %zu bytes)",
+			   nFrames / ingestNs * 1e3, nFrames / parseCharNs * 1e3, recorded);
+
+	free(recording);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+GpsRawCoordinates mavlinkLinkOrigin;
+int mavlinkLinkOrigins;
+
+/**
+ * GPS_GLOBAL_ORIGIN callback of the MAVLink link test.
+ */
+void recordMavlinkLinkOrigin(const GpsRawCoordinates *originRawCoordinates)
+{
+	copyGpsRawCoordinates(&mavlinkLinkOrigin, originRawCoordinates);
+	mavlinkLinkOrigins++;
+}
+
+/**
+ * Test the MAVLink link against a stand-in autopilot (a UDP socket).
+ */
+int runTest_mavlinkLink()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	int autopilot = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in address = {0}, gcs;
+	socklen_t length = sizeof(address);
+	struct timeval timeout = {1, 0};
+	uint8_t datagram[2 * MAVLINK_MAX_PACKET_LEN];
+	mavlink_message_t msg;
+	mavlink_status_t status;
+	mavlink_set_position_target_local_ned_t target = {0};
+	int heartbeats = 0, requests = 0, targets = 0, v2 = 1, frames = 0;
+	ssize_t n;
+	uint16_t size;
+	GpsNedCoordinates gpsNedCoordinates;
+	MavlinkLink link;
+
+	// Stand-in autopilot, on any local port
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	bind(autopilot, (struct sockaddr *) &address, sizeof(address));
+	getsockname(autopilot, (struct sockaddr *) &address, &length);
+	setsockopt(autopilot, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	ASSERT_CONDITION(initializeMavlinkLink(&link, "127.0.0.1", ntohs(address.sin_port), 0) == RETURN_VALUE_OK,
+					 "Initializing the MAVLink link",
+					 nErrors);
+	link.gpsGlobalOriginCallback = recordMavlinkLinkOrigin;
+	mavlinkLinkOrigins = 0;
+
+	ASSERT_CONDITION(sendMavlinkLinkMsg_localPositionNed(&link, &gpsNedCoordinates) == RETURN_VALUE_ERROR,
+					 "No position before the autopilot reports it",
+					 nErrors);
+
+	// The stream request, a heartbeat and a position target (20 m up), in one batch
+	initializeGpsNedCoordinates(&gpsNedCoordinates, 10, -5, 20, time(NULL));
+	sendMavlinkLinkMsg_heartbeat(&link);
+	sendMavlinkLinkMsg_setPositionTargetLocalNed(&link, &gpsNedCoordinates);
+	ASSERT_CONDITION(flushMavlinkLink(&link) == 3,
+					 "Sending the queued frames",
+					 nErrors);
+
+	length = sizeof(gcs);
+	for (int i = 0; i < 3 && (n = recvfrom(autopilot, datagram, sizeof(datagram), 0, (struct sockaddr *) &gcs, &length)) > 0; i++)
+	{
+		for (ssize_t b = 0; b < n; b++)
+		{
+			if (mavlink_parse_char(MAVLINK_COMM_1, datagram[b], &msg, &status) != MAVLINK_FRAMING_OK)
+				continue;
+
+			v2 &= (msg.magic == MAVLINK_STX);
+			heartbeats += (msg.msgid == MAVLINK_MSG_ID_HEARTBEAT);
+			requests += (msg.msgid == MAVLINK_MSG_ID_COMMAND_LONG
+						 && mavlink_msg_command_long_get_command(&msg) == MAV_CMD_SET_MESSAGE_INTERVAL
+						 && mavlink_msg_command_long_get_param1(&msg) == MAVLINK_MSG_ID_LOCAL_POSITION_NED
+						 && mavlink_msg_command_long_get_param2(&msg) == MAVLINK_LINK_POSITION_INTERVAL_US);
+			if (msg.msgid == MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED)
+			{
+				mavlink_msg_set_position_target_local_ned_decode(&msg, &target);
+				targets++;
+			}
+		}
+	}
+	ASSERT_CONDITION(v2 && heartbeats == 1 && requests == 1 && targets == 1,
+					 "Encoding MAVLink v2 frames",
+					 nErrors);
+	ASSERT_CONDITION(target.x == 10 && target.y == -5 && target.z == -20 && target.coordinate_frame == MAV_FRAME_LOCAL_NED
+					 && target.target_system == MAVLINK_LINK_TARGET_SYSTEM_ID,
+					 "Encoding the position target (z down in MAVLink)",
+					 nErrors);
+
+	// The autopilot's heartbeat, position and origin (two frames in a datagram), then a corrupted frame
+	mavlink_msg_heartbeat_pack(7, MAV_COMP_ID_AUTOPILOT1, &msg, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_ARDUPILOTMEGA, 0, 0, MAV_STATE_ACTIVE);
+	size = mavlink_msg_to_send_buffer(datagram, &msg);
+	sendto(autopilot, datagram, size, 0, (struct sockaddr *) &gcs, length);
+
+	mavlink_msg_local_position_ned_pack(7, MAV_COMP_ID_AUTOPILOT1, &msg, 1000, 1, 2, -30, 0, 0, 0);
+	size = mavlink_msg_to_send_buffer(datagram, &msg);
+	mavlink_msg_gps_global_origin_pack(7, MAV_COMP_ID_AUTOPILOT1, &msg, 411000000, -86000000, 100000, 0);
+	size += mavlink_msg_to_send_buffer(datagram + size, &msg);
+	sendto(autopilot, datagram, size, 0, (struct sockaddr *) &gcs, length);
+
+	datagram[size - 1] ^= 0xFF;
+	sendto(autopilot, datagram, size, 0, (struct sockaddr *) &gcs, length);
+
+	for (int i = 0; i < 100 && frames < 4; i++)
+	{
+		usleep(10000);
+		frames += receiveMavlinkLink(&link);
+	}
+	ASSERT_CONDITION(frames == 4 && link.ingest.badCrc == 1,
+					 "Receiving MAVLink frames (dropping the corrupted one)",
+					 nErrors);
+	ASSERT_CONDITION(sendMavlinkLinkMsg_localPositionNed(&link, &gpsNedCoordinates) == RETURN_VALUE_OK
+					 && gpsNedCoordinates.x == 1 && gpsNedCoordinates.y == 2 && gpsNedCoordinates.z == 30,
+					 "Reporting the autopilot's position (30 m up)",
+					 nErrors);
+	ASSERT_CONDITION(mavlinkLinkOrigins == 1 && fabsf(mavlinkLinkOrigin.latitude - 41.1f) < 1e-4f
+					 && fabsf(mavlinkLinkOrigin.longitude + 8.6f) < 1e-4f && fabsf(mavlinkLinkOrigin.altitude - 100) < 1e-3f,
+					 "Reporting the autopilot's origin",
+					 nErrors);
+	ASSERT_CONDITION(link.targetSystem == 7,
+					 "Addressing the autopilot that sent the heartbeat",
+					 nErrors);
+
+	terminateMavlinkLink(&link);
+	close(autopilot);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Send a frame (length prefix and payload) of the tests through the server.
+ */
+void sendTestFrame(int fd, const char *payload)
+{
+	unsigned char frame[256];
+	size_t size = buildStreamFrame(frame, payload);
+
+	send(fd, frame, size, 0);
+}
+
+/**
+ * Receive a frame's payload (NUL-terminated) of the tests through the server.
+ *
+ * @return		Payload's length (-1 on errors).
+ */
+int receiveTestFrame(int fd, char *payload, size_t size)
+{
+	uint32_t header;
+
+	if (recv(fd, &header, sizeof(header), MSG_WAITALL) != sizeof(header) || (header = ntohl(header)) >= size
+			|| recv(fd, payload, header, MSG_WAITALL) != (ssize_t) header)
+		return -1;
+	payload[header] = '\0';
+
+	return header;
+}
+
+/**
+ * Test - GPS coordinates updates in binary over UDP (a round trip through
+ * the server, as a client associated with both options).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_udpBinaryUpdates()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0, n;
+	int tcp = socket(AF_INET, SOCK_STREAM, 0), udp = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in server = {0};
+	struct timeval timeout = {2, 0};
+	char response[256];
+	unsigned char datagram[PROTOCOL_BINARY_MSG_SIZE + 1];
+	// A GPS_COORDINATES_UPDATE (6) from user 77, at the emulator's origin (FEUP)
+	ProtocolBinaryMsg update = {6, 0, 77, 41.1779656f, -8.5971899f, 0, time(NULL)}, ack = {0};
+	const char *malformed = "{\"userId\":77,\"msgType\":6,\"gpsCoordinates\":"
+							"{\"lat\":41.1779656,\"lon\":-8.5971899,\"alt\":0,\"timestamp\":\"\"}}";
+
+	server.sin_family = AF_INET;
+	server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	server.sin_port = htons(40123);
+	setsockopt(tcp, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(udp, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	ASSERT_CONDITION(initializeFapManagementProtocol() == RETURN_VALUE_OK,
+					 "Initializing the FAP Management Protocol",
+					 nErrors);
+
+	// Associate (USER_ASSOCIATION_REQUEST), asking for both options
+	ASSERT_CONDITION(connect(tcp, (struct sockaddr *) &server, sizeof(server)) == 0,
+					 "Connecting to the server",
+					 nErrors);
+	sendTestFrame(tcp, "{\"userId\":77,\"msgType\":1,\"encoding\":\"binary\",\"transport\":\"udp\"}");
+	ASSERT_CONDITION(receiveTestFrame(tcp, response, sizeof(response)) > 0 && strstr(response, "\"msgType\":2") != NULL
+					 && strstr(response, "\"encoding\":\"binary\"") != NULL && strstr(response, "\"transport\":\"udp\"") != NULL,
+					 "Associating with the binary encoding and the UDP transport",
+					 nErrors);
+
+	// Update over UDP: a whole binary GPS_COORDINATES_ACK (7) comes back
+	encodeProtocolBinaryMsg(datagram, &update);
+	sendto(udp, datagram, PROTOCOL_BINARY_MSG_SIZE, 0, (struct sockaddr *) &server, sizeof(server));
+	n = recv(udp, datagram, sizeof(datagram), 0);
+
+	ASSERT_CONDITION(n == PROTOCOL_BINARY_MSG_SIZE && decodeProtocolBinaryMsg(&ack, datagram, n) == RETURN_VALUE_OK
+					 && ack.msgType == 7 && ack.userId == 77 && ack.timestamp == update.timestamp && ack.updatePeriod > 0,
+					 "Receiving the binary ACK of an update over UDP",
+					 nErrors);
+	TEST_PRINT("ACK: %d bytes (next update in %d s)", n, ack.updatePeriod);
+
+	// A malformed update (no timestamp) is dropped without an ACK, but the user stays associated
+	sendto(udp, malformed, strlen(malformed), 0, (struct sockaddr *) &server, sizeof(server));
+	timeout.tv_sec = 1;
+	setsockopt(udp, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	ASSERT_CONDITION(recv(udp, datagram, sizeof(datagram), 0) < 0,
+					 "Dropping a malformed update over UDP",
+					 nErrors);
+
+	// Desassociate (USER_DESASSOCIATION_REQUEST)
+	sendTestFrame(tcp, "{\"userId\":77,\"msgType\":4}");
+	ASSERT_CONDITION(receiveTestFrame(tcp, response, sizeof(response)) > 0 && strstr(response, "\"msgType\":5") != NULL,
+					 "Desassociating",
+					 nErrors);
+
+	close(tcp);
+	close(udp);
+
+	ASSERT_CONDITION(terminateFapManagementProtocol() == RETURN_VALUE_OK,
+					 "Terminating the FAP Management Protocol",
+					 nErrors);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - Coverage sweep (a user left out of the FAP's coverage by the FAP
+ * moving away is dropped without waiting for its next update).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_coverageSweep()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0, n;
+	int tcp = socket(AF_INET, SOCK_STREAM, 0), udp = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in server = {0};
+	struct timeval timeout = {2, 0};
+	struct timespec start;
+	char response[256];
+	unsigned char datagram[PROTOCOL_BINARY_MSG_SIZE];
+	// A GPS_COORDINATES_UPDATE (6) from user 78, at the emulator's origin (FEUP)
+	ProtocolBinaryMsg update = {6, 0, 78, 41.1779656f, -8.5971899f, 0, time(NULL)};
+	GpsNedCoordinates far, users[MAX_ASSOCIATED_USERS];
+
+	server.sin_family = AF_INET;
+	server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	server.sin_port = htons(40123);
+	setsockopt(udp, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	ASSERT_CONDITION(initializeFapManagementProtocol() == RETURN_VALUE_OK,
+					 "Initializing the FAP Management Protocol",
+					 nErrors);
+
+	connect(tcp, (struct sockaddr *) &server, sizeof(server));
+	sendTestFrame(tcp, "{\"userId\":78,\"msgType\":1,\"encoding\":\"binary\",\"transport\":\"udp\"}");
+	receiveTestFrame(tcp, response, sizeof(response));
+	encodeProtocolBinaryMsg(datagram, &update);
+	sendto(udp, datagram, PROTOCOL_BINARY_MSG_SIZE, 0, (struct sockaddr *) &server, sizeof(server));
+	ASSERT_CONDITION(recv(udp, datagram, sizeof(datagram), 0) == PROTOCOL_BINARY_MSG_SIZE
+					 && getAllUsersGpsNedCoordinates(users, &n) == RETURN_VALUE_OK && n == 1,
+					 "Associating a user at the origin",
+					 nErrors);
+
+	// The FAP flies 1 km north: the user is out of its coverage
+	initializeGpsNedCoordinates(&far, 1000, 0, 0, time(NULL));
+	moveFapToGpsNedCoordinates(&far);
+
+	// The server closes the connection within a sweep's period
+	timeout.tv_sec = 2 * 5;
+	setsockopt(tcp, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	n = recv(tcp, response, sizeof(response), 0);
+	TEST_PRINT("Dropped after %.1f s", elapsedNs(&start) / 1e9);
+
+	// The position is cleared right after the connection is closed
+	usleep(100000);
+	ASSERT_CONDITION(n == 0 && getAllUsersGpsNedCoordinates(users, &n) == RETURN_VALUE_OK && n == 0,
+					 "Dropping the user out of coverage",
+					 nErrors);
+
+	close(tcp);
+	close(udp);
+
+	ASSERT_CONDITION(terminateFapManagementProtocol() == RETURN_VALUE_OK,
+					 "Terminating the FAP Management Protocol",
+					 nErrors);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Test - Duplicate associations (a user ID already associated is rejected
+ * from another address, and taken over from the same one).
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_duplicateAssociation()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0;
+	int first = socket(AF_INET, SOCK_STREAM, 0), other = socket(AF_INET, SOCK_STREAM, 0), again = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in server = {0}, otherAddress = {0};
+	struct timeval timeout = {2, 0};
+	char response[256];
+
+	server.sin_family = AF_INET;
+	server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	server.sin_port = htons(40123);
+
+	// Another loopback address (127.0.0.2) plays another host
+	otherAddress.sin_family = AF_INET;
+	otherAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1);
+	bind(other, (struct sockaddr *) &otherAddress, sizeof(otherAddress));
+
+	setsockopt(first, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(other, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(again, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	ASSERT_CONDITION(initializeFapManagementProtocol() == RETURN_VALUE_OK,
+					 "Initializing the FAP Management Protocol",
+					 nErrors);
+
+	connect(first, (struct sockaddr *) &server, sizeof(server));
+	sendTestFrame(first, "{\"userId\":79,\"msgType\":1}");
+	ASSERT_CONDITION(receiveTestFrame(first, response, sizeof(response)) > 0 && strstr(response, "\"msgType\":2") != NULL,
+					 "Associating a user",
+					 nErrors);
+
+	// From another address: USER_ASSOCIATION_REJECTED (3), and the associated user is kept
+	connect(other, (struct sockaddr *) &server, sizeof(server));
+	sendTestFrame(other, "{\"userId\":79,\"msgType\":1}");
+	ASSERT_CONDITION(receiveTestFrame(other, response, sizeof(response)) > 0 && strstr(response, "\"msgType\":3") != NULL
+					 && recv(other, response, sizeof(response), 0) == 0,
+					 "Rejecting the user ID from another address",
+					 nErrors);
+
+	sendTestFrame(first, "{\"userId\":79,\"msgType\":4}");
+	ASSERT_CONDITION(receiveTestFrame(first, response, sizeof(response)) > 0 && strstr(response, "\"msgType\":5") != NULL,
+					 "Keeping the associated user",
+					 nErrors);
+	close(first);
+
+	// From the same address: the new connection replaces the old one
+	first = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(first, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	connect(first, (struct sockaddr *) &server, sizeof(server));
+	sendTestFrame(first, "{\"userId\":79,\"msgType\":1}");
+	receiveTestFrame(first, response, sizeof(response));
+
+	connect(again, (struct sockaddr *) &server, sizeof(server));
+	sendTestFrame(again, "{\"userId\":79,\"msgType\":1}");
+	ASSERT_CONDITION(receiveTestFrame(again, response, sizeof(response)) > 0 && strstr(response, "\"msgType\":2") != NULL
+					 && recv(first, response, sizeof(response), 0) == 0,
+					 "Re-associating the user ID from the same address",
+					 nErrors);
+
+	close(first);
+	close(other);
+	close(again);
+
+	ASSERT_CONDITION(terminateFapManagementProtocol() == RETURN_VALUE_OK,
+					 "Terminating the FAP Management Protocol",
+					 nErrors);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
+/**
+ * Write a big-endian integer, as Java's DataOutputStream and ByteBuffer do.
+ */
+void putJavaInteger(unsigned char *bytes, uint64_t value, int size)
+{
+	for (int i = size - 1; i >= 0; i--, value >>= 8)
+		bytes[i] = value & 0xFF;
+}
+
+/**
+ * Read a big-endian integer, as Java's DataInputStream and ByteBuffer do.
+ */
+uint64_t getJavaInteger(const unsigned char *bytes, int size)
+{
+	uint64_t value = 0;
+
+	for (int i = 0; i < size; i++)
+		value = (value << 8) | bytes[i];
+
+	return value;
+}
+
+/**
+ * Send a frame as the Java client's sendFrame() does (writeInt() of the
+ * length, then the payload), built byte by byte.
+ */
+void sendJavaFrame(int fd, const void *payload, size_t length)
+{
+	unsigned char frame[512];
+
+	putJavaInteger(frame, length, 4);
+	memcpy(frame + 4, payload, length);
+	send(fd, frame, 4 + length, 0);
+}
+
+/**
+ * Receive a frame as the Java client's receiveFrame() does (readInt() of
+ * the length, then readFully() of the payload).
+ *
+ * @return		Payload's length (-1 on errors).
+ */
+int receiveJavaFrame(int fd, unsigned char *payload, size_t size)
+{
+	unsigned char header[4];
+	uint64_t length;
+
+	if (recv(fd, header, sizeof(header), MSG_WAITALL) != sizeof(header) || (length = getJavaInteger(header, 4)) >= size
+			|| recv(fd, payload, length, MSG_WAITALL) != (ssize_t) length)
+		return -1;
+	payload[length] = '\0';
+
+	return length;
+}
+
+/**
+ * Encode a binary message as the Java client's ProtocolBinaryCodec.encode()
+ * does (ByteBuffer, big-endian), byte by byte.
+ */
+void encodeJavaBinaryMsg(unsigned char *bytes, int msgType, int userId, float latitude, float longitude, float altitude,
+						 int64_t timestamp)
+{
+	float coordinates[3] = {latitude, longitude, altitude};
+	uint32_t bits;
+
+	bytes[0] = msgType;
+	bytes[1] = 1;
+	putJavaInteger(bytes + 2, 0, 2);
+	putJavaInteger(bytes + 4, (uint32_t) userId, 4);
+	for (int i = 0; i < 3; i++)
+	{
+		memcpy(&bits, &coordinates[i], sizeof(bits));
+		putJavaInteger(bytes + 8 + 4 * i, bits, 4);
+	}
+	putJavaInteger(bytes + 20, (uint64_t) timestamp, 8);
+}
+
+/**
+ * Check a binary GPS_COORDINATES_ACK as the Java client does (its length and
+ * version in ProtocolBinaryCodec.decode(), then its fields).
+ */
+int isJavaBinaryAck(const unsigned char *bytes, int length, int userId, int64_t timestamp)
+{
+	return length == 28 && bytes[1] == 1 && bytes[0] == 7 && getJavaInteger(bytes + 2, 2) > 0
+		   && (int32_t) getJavaInteger(bytes + 4, 4) == userId && (int64_t) getJavaInteger(bytes + 20, 8) == timestamp;
+}
+
+/**
+ * Test - Wire format of the Java client (its length prefixed frames, the
+ * pretty printed JSON of its ObjectMapper, and its big-endian binary
+ * messages, over TCP and UDP), built byte by byte as the client does.
+ *
+ * @return		The number of errors detected.
+ */
+int runTest_javaClientWireFormat()
+{
+	PRINT_TEST_HEADER();
+
+	int nErrors = 0, n;
+	int json = socket(AF_INET, SOCK_STREAM, 0), binary = socket(AF_INET, SOCK_STREAM, 0), udp = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in server = {0};
+	struct timeval timeout = {2, 0};
+	unsigned char response[512], msg[28];
+	char update[512], timestamp[TIMESTAMP_ISO8601_SIZE], expected[64];
+	const char *associateJson = "{\n  \"userId\" : 80,\n  \"msgType\" : 1\n}";
+	const char *desassociateJson = "{\n  \"userId\" : 80,\n  \"msgType\" : 4\n}";
+	const char *desassociateBinary = "{\n  \"userId\" : 81,\n  \"msgType\" : 4\n}";
+	time_t now = time(NULL);
+
+	server.sin_family = AF_INET;
+	server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	server.sin_port = htons(40123);
+	setsockopt(json, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(binary, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(udp, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	// The client's timestamps: LocalDateTime.withNano(0).atZone(ZoneOffset.UTC).toString()
+	strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+	ASSERT_CONDITION(initializeFapManagementProtocol() == RETURN_VALUE_OK,
+					 "Initializing the FAP Management Protocol",
+					 nErrors);
+
+	// JSON over TCP (ObjectMapper with INDENT_OUTPUT, floats as Float.toString())
+	connect(json, (struct sockaddr *) &server, sizeof(server));
+	sendJavaFrame(json, associateJson, strlen(associateJson));
+	ASSERT_CONDITION(receiveJavaFrame(json, response, sizeof(response)) > 0 && strstr((char *) response, "\"msgType\":2") != NULL,
+					 "Associating a JSON client",
+					 nErrors);
+
+	n = snprintf(update, sizeof(update), "{\n  \"userId\" : 80,\n  \"msgType\" : 6,\n  \"gpsCoordinates\" : {\n"
+				 "    \"lat\" : 41.177967,\n    \"lon\" : -8.59719,\n    \"alt\" : 0.0,\n    \"timestamp\" : \"%s\"\n  }\n}",
+				 timestamp);
+	sendJavaFrame(json, update, n);
+	snprintf(expected, sizeof(expected), "\"gpsTimestamp\":\"%s\"", timestamp);
+	ASSERT_CONDITION(receiveJavaFrame(json, response, sizeof(response)) > 0 && strstr((char *) response, "\"msgType\":7") != NULL
+					 && strstr((char *) response, expected) != NULL && strstr((char *) response, "\"updatePeriod\":") != NULL,
+					 "Acknowledging a JSON client's update",
+					 nErrors);
+
+	sendJavaFrame(json, desassociateJson, strlen(desassociateJson));
+	ASSERT_CONDITION(receiveJavaFrame(json, response, sizeof(response)) > 0 && strstr((char *) response, "\"msgType\":5") != NULL,
+					 "Desassociating a JSON client",
+					 nErrors);
+
+	// Binary, over TCP and then over UDP
+	connect(binary, (struct sockaddr *) &server, sizeof(server));
+	n = snprintf(update, sizeof(update), "{\n  \"userId\" : 81,\n  \"msgType\" : 1,\n  \"encoding\" : \"binary\",\n"
+				 "  \"transport\" : \"udp\"\n}");
+	sendJavaFrame(binary, update, n);
+	ASSERT_CONDITION(receiveJavaFrame(binary, response, sizeof(response)) > 0 && strstr((char *) response, "\"encoding\":\"binary\"") != NULL
+					 && strstr((char *) response, "\"transport\":\"udp\"") != NULL,
+					 "Associating a binary client with the UDP transport",
+					 nErrors);
+
+	encodeJavaBinaryMsg(msg, 6, 81, 41.177967f, -8.59719f, 0, now);
+	sendJavaFrame(binary, msg, sizeof(msg));
+	n = receiveJavaFrame(binary, response, sizeof(response));
+	ASSERT_CONDITION(isJavaBinaryAck(response, n, 81, now),
+					 "Acknowledging a binary client's update over TCP",
+					 nErrors);
+
+	sendto(udp, msg, sizeof(msg), 0, (struct sockaddr *) &server, sizeof(server));
+	n = recv(udp, response, sizeof(response), 0);
+	ASSERT_CONDITION(isJavaBinaryAck(response, n, 81, now),
+					 "Acknowledging a binary client's update over UDP",
+					 nErrors);
+
+	sendJavaFrame(binary, desassociateBinary, strlen(desassociateBinary));
+	ASSERT_CONDITION(receiveJavaFrame(binary, response, sizeof(response)) > 0 && strstr((char *) response, "\"msgType\":5") != NULL,
+					 "Desassociating a binary client",
+					 nErrors);
+
+	close(json);
+	close(binary);
+	close(udp);
+
+	ASSERT_CONDITION(terminateFapManagementProtocol() == RETURN_VALUE_OK,
+					 "Terminating the FAP Management Protocol",
+					 nErrors);
+
+	// Print test summary
+	PRINT_TEST_SUMMARY(nErrors);
+
+	return nErrors;
+}
+
 /**
  * Run all tests.
  */
@@ -224,6 +2794,30 @@ void runTests()
 	int nErrors = 0;
 
 	// Run tests
+	nErrors += runTest_userRegistry();
+	nErrors += runTest_eventLoop();
+	nErrors += runTest_timerWheel();
+	nErrors += runTest_streamFramer();
+	nErrors += runTest_protocolBinary();
+	nErrors += runTest_datagramBatch();
+	nErrors += runTest_protocolParser();
+	nErrors += runTest_positionTable();
+	nErrors += runTest_nedConverter();
+	nErrors += runTest_geodesy();
+	nErrors += runTest_spatialIndex();
+	nErrors += runTest_fapPlacement();
+	nErrors += runTest_fapCoordinator();
+	nErrors += runTest_trajectoryPredictor();
+	nErrors += runTest_logger();
+	nErrors += runTest_eventLog();
+	nErrors += runTest_telemetryCache();
+	nErrors += runTest_periodicScheduler();
+	nErrors += runTest_mavlinkIngest();
+	nErrors += runTest_mavlinkLink();
+	nErrors += runTest_udpBinaryUpdates();
+	nErrors += runTest_coverageSweep();
+	nErrors += runTest_duplicateAssociation();
+	nErrors += runTest_javaClientWireFormat();
 	nErrors += runTest_fapManagementProtocol();
 	nErrors += runTest_getAllUsersGpsNedCoordinates();
 }
@@ -0,0 +1,134 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+/*
+ * Print an event log (see setFapEventLogFile()), one record per line:
+ *
+ *	<seconds since opened> <type> conn=<connection> user=<user ID> code=<code> <payload>
+ *
+ * Usage: EventLogReader <event log>
+ */
+
+// Module headers
+#include "EventLog.h"
+
+// C headers
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+
+// =========================================================
+//           AUXILIARY FUNCTIONS
+// =========================================================
+
+/**
+ * Name of a record's type.
+ */
+static const char *typeName(uint16_t type)
+{
+	switch (type)
+	{
+		case EVENT_LOG_PROTOCOL_MESSAGE:	return "MESSAGE";
+		case EVENT_LOG_MAVLINK_COMMAND:		return "MAVLINK";
+		case EVENT_LOG_EVICTION:			return "EVICTION";
+		case EVENT_LOG_CONNECTION_CLOSED:	return "CLOSED";
+		default:							return "UNKNOWN";
+	}
+}
+
+/**
+ * Name of an eviction's reason.
+ */
+static const char *evictionReasonName(uint16_t code)
+{
+	switch (code)
+	{
+		case EVENT_LOG_EVICTION_TIMEOUT:			return "timeout";
+		case EVENT_LOG_EVICTION_REASSOCIATED:		return "re-associated";
+		case EVENT_LOG_EVICTION_OUT_OF_COVERAGE:	return "out-of-coverage";
+		default:									return "unknown";
+	}
+}
+
+/**
+ * Print a payload: as text if printable (JSON messages), in hex otherwise.
+ */
+static void printPayload(const EventLogRecord *record)
+{
+	const uint8_t *payload = record->payload;
+	uint32_t length = record->header.payloadLength;
+	int printable = 1;
+
+	if (record->header.type == EVENT_LOG_MAVLINK_COMMAND && length == 3 * sizeof(float))
+	{
+		float target[3];
+
+		memcpy(target, payload, sizeof(target));
+		printf(" x=%.2f y=%.2f z=%.2f", target[0], target[1], target[2]);
+		return;
+	}
+
+	if (record->header.type == EVENT_LOG_EVICTION)
+		printf(" %s", evictionReasonName(record->header.code));
+
+	for (uint32_t i = 0; i < length && printable; i++)
+		printable = isprint(payload[i]) || isspace(payload[i]);
+
+	if (length > 0 && printable)
+		printf(" %.*s", (int) length, (const char *) payload);
+	else if (length > 0)
+	{
+		printf(" ");
+		for (uint32_t i = 0; i < length; i++)
+			printf("%02x", payload[i]);
+	}
+}
+
+
+// =========================================================
+//           MAIN
+// =========================================================
+int main(int argc, char *argv[])
+{
+	EventLogReader reader;
+	EventLogRecord record;
+	unsigned long n = 0;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: %s <event log>\n", argv[0]);
+		return 1;
+	}
+
+	if (openEventLogReader(&reader, argv[1]) != RETURN_VALUE_OK)
+	{
+		fprintf(stderr, "%s: not an event log\n", argv[1]);
+		return 1;
+	}
+
+	printf("# Opened at %lld.%09lld (Unix time)\n",
+		   (long long) (reader.header.epochNs / 1000000000LL), (long long) (reader.header.epochNs % 1000000000LL));
+
+	while (readEventLog(&reader, &record) == RETURN_VALUE_OK)
+	{
+		int64_t elapsedNs = record.header.monotonicNs - reader.header.monotonicNs;
+
+		printf("%lld.%09lld %-8s conn=%d user=%d code=%u", (long long) (elapsedNs / 1000000000LL),
+			   (long long) (elapsedNs % 1000000000LL), typeName(record.header.type), record.header.connectionId,
+			   record.header.userId, record.header.code);
+		printPayload(&record);
+		printf("\n");
+		n++;
+	}
+
+	printf("# %lu records\n", n);
+	closeEventLogReader(&reader);
+
+	return 0;
+}
@@ -0,0 +1,47 @@
+/******************************************************************************
+*                         User-Aware Flying AP Project
+*                       FAP Management Protocol (Server)
+*******************************************************************************
+*                        Comunicacoes Moveis 2017/2018
+*                             FEUP | MIEEC / MIEIC
+*******************************************************************************/
+
+/*
+ * Run the FAP Management Protocol (with the MAVLink emulator) until
+ * interrupted (SIGINT or SIGTERM), e.g. for the clients' tests.
+ *
+ * Usage: FapServer
+ */
+
+// Module headers
+#include "FapManagementProtocol_Server.h"
+
+// C headers
+#include <signal.h>
+#include <stdio.h>
+
+
+// =========================================================
+//           MAIN
+// =========================================================
+int main()
+{
+	sigset_t signals;
+	int signal;
+
+	// Blocked before any thread starts, so every thread inherits the mask
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+	if (initializeFapManagementProtocol() != RETURN_VALUE_OK)
+	{
+		fprintf(stderr, "Error initializing the FAP Management Protocol\n");
+		return 1;
+	}
+
+	sigwait(&signals, &signal);
+
+	return terminateFapManagementProtocol() == RETURN_VALUE_OK ? 0 : 1;
+}